@@ -496,6 +496,27 @@
 #   define PJ_LOG_THREAD_WIDTH      12
 #endif
 
+/**
+ * Maximum number of threads which can have their own ring in the
+ * asynchronous logging pipeline (see pj_log_async_start()). Other threads
+ * write their log messages synchronously. The value must not exceed 255.
+ *
+ * Default: 64
+ */
+#ifndef PJ_LOG_ASYNC_MAX_THREADS
+#   define PJ_LOG_ASYNC_MAX_THREADS 64
+#endif
+
+/**
+ * Default size of each thread's ring in the asynchronous logging
+ * pipeline, in bytes.
+ *
+ * Default: 65536
+ */
+#ifndef PJ_LOG_ASYNC_RING_SIZE
+#   define PJ_LOG_ASYNC_RING_SIZE   65536
+#endif
+
 /**
  * Colorfull terminal (for logging etc).
  *
@@ -560,6 +581,59 @@
 #endif
 
 
+/**
+ * Maximum number of threads which get their own cache of free pools in a
+ * caching pool. With a thread cache, creating and releasing pools in a
+ * thread normally does not take the caching pool's lock, which otherwise
+ * serializes all threads creating pools (e.g. SIP worker threads, which
+ * create a pool for every message). Threads beyond this number use the
+ * caching pool's shared free lists.
+ *
+ * Note that with thread caches enabled:
+ *  - free pools held in the thread caches are not counted against the
+ *    caching pool's max_capacity,
+ *  - a cache is not reclaimed when its thread exits, only when the caching
+ *    pool is destroyed,
+ *  - pools created by threads with a cache are not in the caching pool's
+ *    used_list, so code walking that list directly will not see them
+ *    (pj_pool_factory_dump() does report them),
+ *  - each caching pool allocates a thread local storage key.
+ *
+ * Set it to 0 to disable thread caches. The value must be less than 255.
+ * Thread caches are only available with GCC, Clang, and MSVC.
+ *
+ * Default: 0 (disabled)
+ */
+#ifndef PJ_CACHING_POOL_THREAD_CACHE_MAX
+#   define PJ_CACHING_POOL_THREAD_CACHE_MAX     0
+#endif
+
+
+/**
+ * Maximum number of free pools of each size kept in a thread cache of a
+ * caching pool. When a thread cache runs out of pools of a size, it takes
+ * up to half of this number from the shared free list at once, and when it
+ * is full, it returns half of them at once.
+ *
+ * Default: 16
+ */
+#ifndef PJ_CACHING_POOL_THREAD_CACHE_DEPTH
+#   define PJ_CACHING_POOL_THREAD_CACHE_DEPTH   16
+#endif
+
+
+/**
+ * Maximum total capacity, in bytes, of the free pools kept in a thread
+ * cache of a caching pool. This comes in addition to the max_capacity of
+ * the caching pool, which only applies to its shared free lists.
+ *
+ * Default: 262144
+ */
+#ifndef PJ_CACHING_POOL_THREAD_CACHE_SIZE
+#   define PJ_CACHING_POOL_THREAD_CACHE_SIZE    (256 * 1024)
+#endif
+
+
 /**
  * Enable timer debugging facility. When this is enabled, application
  * can call pj_timer_heap_dump() to show the contents of the timer
@@ -605,6 +679,36 @@
 #  define PJ_TIMER_USE_LINKED_LIST    0
 #endif
 
+
+/**
+ * If enabled, the timer heap API is implemented with a hierarchical timing
+ * wheel (timer_wheel.c) instead of the binary heap. Scheduling and
+ * cancelling are O(1), and entries are spread over several independently
+ * locked wheels (see PJ_TIMER_WHEEL_SHARDS), which helps when many threads
+ * schedule and cancel timers concurrently, e.g. with a large number of SIP
+ * transactions. Timers have a resolution of one millisecond, and the lock
+ * set with pj_timer_heap_set_lock() only enables the internal locks of the
+ * wheels rather than being used directly.
+ *
+ * PJ_TIMER_USE_LINKED_LIST has no effect when this is enabled.
+ *
+ * Default: 0 (Use binary heap tree)
+ */
+#ifndef PJ_TIMER_USE_WHEEL
+#  define PJ_TIMER_USE_WHEEL    0
+#endif
+
+
+/**
+ * Number of independently locked wheels when PJ_TIMER_USE_WHEEL is
+ * enabled. Timer entries are assigned to a wheel based on their address.
+ *
+ * Default: 8
+ */
+#ifndef PJ_TIMER_WHEEL_SHARDS
+#  define PJ_TIMER_WHEEL_SHARDS 8
+#endif
+
 /**
  * Set this to 1 to enable debugging on the group lock. Default: 0
  */
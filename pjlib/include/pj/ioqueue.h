@@ -92,6 +92,9 @@ PJ_BEGIN_DECL
  *  - <tt><b>/dev/epoll</b></tt> on Linux (user mode and kernel mode),
  *    a much faster replacement for select() on Linux (and more importantly
  *    doesn't have limitation on number of descriptors).
+ *  - <tt><b>io_uring</b></tt> on Linux 6.0 or newer (enabled with
+ *    \c --enable-io-uring), which submits the socket operations to the
+ *    kernel and completes them without the extra readiness round trip.
  *  - <b>I/O Completion ports</b> on Windows NT/2000/XP, which is the most
  *    efficient way to dispatch events in Windows NT based OSes, and most
  *    importantly, it doesn't have the limit on how many handles to monitor.
@@ -218,14 +221,16 @@ typedef struct pj_ioqueue_op_key_t
 typedef struct pj_ioqueue_callback
 {
     /**
-     * This callback is called when #pj_ioqueue_recv or #pj_ioqueue_recvfrom
-     * completes.
+     * This callback is called when #pj_ioqueue_recv, #pj_ioqueue_recvfrom
+     * or #pj_ioqueue_recvmmsg completes.
      *
      * @param key           The key.
      * @param op_key        Operation key.
-     * @param bytes_read    >= 0 to indicate the amount of data read,
-     *                      otherwise negative value containing the error
-     *                      code. To obtain the pj_status_t error code, use
+     * @param bytes_read    >= 0 to indicate the amount of data read (or
+     *                      the number of datagrams for
+     *                      #pj_ioqueue_recvmmsg), otherwise negative value
+     *                      containing the error code. To obtain the
+     *                      pj_status_t error code, use
      *                      (pj_status_t code = -bytes_read).
      */
     void (*on_read_complete)(pj_ioqueue_key_t *key,
@@ -284,6 +289,7 @@ typedef enum pj_ioqueue_operation_e
     PJ_IOQUEUE_OP_WRITE         = 8,    /**< write() operation.     */
     PJ_IOQUEUE_OP_SEND          = 16,   /**< send() operation.      */
     PJ_IOQUEUE_OP_SEND_TO       = 32,   /**< sendto() operation.    */
+    PJ_IOQUEUE_OP_RECV_MMSG     = 256,  /**< recvmmsg() operation.  */
 #if defined(PJ_HAS_TCP) && PJ_HAS_TCP != 0
     PJ_IOQUEUE_OP_ACCEPT        = 64,   /**< accept() operation.    */
     PJ_IOQUEUE_OP_CONNECT       = 128   /**< connect() operation.   */
@@ -848,6 +854,46 @@ PJ_DECL(pj_status_t) pj_ioqueue_recvfrom( pj_ioqueue_key_t *key,
                                           pj_sockaddr_t *addr,
                                           int *addrlen);
 
+/**
+ * This function behaves similarly as #pj_ioqueue_recvfrom(), except that
+ * it receives several datagrams at once: when the socket is readable, the
+ * framework reads the datagrams already queued on the socket, up to
+ * \a count, with one system call when the platform has recvmmsg() (see
+ * #pj_sock_recvmmsg()). The \a bytes_read argument of the read callback
+ * is then the number of datagrams received, and the length and source
+ * address of each datagram are in \a msg. Caller MUST make sure that
+ * \a msg, and the buffers and addresses it points to, remain valid until
+ * the framework completes reading the data.
+ *
+ * This function is implemented by the select, epoll, kqueue and io_uring
+ * backends, the others return PJ_ENOTSUP and the caller should use
+ * #pj_ioqueue_recvfrom() instead.
+ *
+ * @param key       The key that uniquely identifies the handle.
+ * @param op_key    An operation specific key to be associated with the
+ *                  pending operation.
+ * @param msg       The buffers to receive the datagrams.
+ * @param count     On input, it specifies the number of buffers in
+ *                  \a msg. If data is available to be read immediately,
+ *                  the function returns PJ_SUCCESS and this argument will
+ *                  be filled with the number of datagrams read.
+ * @param flags     Recv flag. If flags has PJ_IOQUEUE_ALWAYS_ASYNC then
+ *                  the function will never return PJ_SUCCESS.
+ *
+ * @return
+ *  - PJ_SUCCESS    If immediate data has been received. In this case, the
+ *                  callback must have been called before this function
+ *                  returns, and no pending operation is scheduled.
+ *  - PJ_EPENDING   If the operation has been queued.
+ *  - PJ_ENOTSUP    If the ioqueue backend does not support it.
+ *  - non-zero      The return value indicates the error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_recvmmsg( pj_ioqueue_key_t *key,
+                                          pj_ioqueue_op_key_t *op_key,
+                                          pj_sock_mmsg *msg,
+                                          unsigned *count,
+                                          pj_uint32_t flags);
+
 /**
  * Instruct the I/O Queue to write to the handle. This function will return
  * immediately (i.e. non-blocking) regardless whether some data has been
@@ -937,8 +983,8 @@ PJ_DECL(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
  * @param ioqueue        The ioqueue instance.
  *
  * @return          The OS handle associated with the instance.
- *                  For epoll/kqueue this will be a pointer to the file
- *                  descriptor. For all other platforms, this will be a pointer
+ *                  For epoll/kqueue/io_uring this will be a pointer to
+ *                  the file descriptor. For all other platforms, this will be a pointer
  *                  to a platform-specific handle.
  *                  If no handle is available, NULL will be returned.
  */
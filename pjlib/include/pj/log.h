@@ -378,6 +378,135 @@ pj_status_t pj_log_init(void);
 
 #endif  /* #if PJ_LOG_MAX_LEVEL >= 1 */
 
+
+/**
+ * This enumeration describes what to do with a log message when the
+ * asynchronous log ring of the calling thread is full.
+ */
+typedef enum pj_log_async_policy
+{
+    /**
+     * Drop the message and count it, if its level is equal to or above
+     * \a drop_level of #pj_log_async_param. More important messages wait
+     * for the log thread to make room.
+     */
+    PJ_LOG_ASYNC_DROP,
+
+    /**
+     * Always wait for the log thread to make room.
+     */
+    PJ_LOG_ASYNC_WAIT
+
+} pj_log_async_policy;
+
+/**
+ * Asynchronous logging settings, see #pj_log_async_start().
+ */
+typedef struct pj_log_async_param
+{
+    /**
+     * Size of each thread's log ring, in bytes. The value is rounded up
+     * to a power of two, and to at least twice PJ_LOG_MAX_SIZE.
+     *
+     * Default: PJ_LOG_ASYNC_RING_SIZE
+     */
+    unsigned            ring_size;
+
+    /**
+     * What to do when a ring is full.
+     *
+     * Default: PJ_LOG_ASYNC_DROP
+     */
+    pj_log_async_policy policy;
+
+    /**
+     * With PJ_LOG_ASYNC_DROP policy, only messages with this level or
+     * above (i.e. less important) may be dropped.
+     *
+     * Default: 4
+     */
+    int                 drop_level;
+
+    /**
+     * How long the log thread sleeps when there are no messages, in
+     * milliseconds.
+     *
+     * Default: 10
+     */
+    unsigned            interval;
+
+} pj_log_async_param;
+
+
+/**
+ * Initialize asynchronous logging settings with default values.
+ *
+ * @param prm       The settings to be initialized.
+ */
+PJ_DECL(void) pj_log_async_param_default(pj_log_async_param *prm);
+
+/**
+ * Start asynchronous logging. Once started, log messages are still
+ * formatted by the thread calling the logging function, but instead of
+ * calling the log output function (see #pj_log_set_log_func()) directly,
+ * the message is put in a lock-free ring owned by the calling thread. A
+ * background thread takes the messages from all rings in the order they
+ * were logged and passes them to the log output function. Hence the
+ * output function (and any file or console I/O it does) only ever runs
+ * on the log thread.
+ *
+ * A thread gets its ring on its first log message and keeps it until
+ * asynchronous logging is stopped. Up to PJ_LOG_ASYNC_MAX_THREADS threads
+ * can have a ring; other threads, threads not registered to PJLIB and
+ * the log thread itself write synchronously as before.
+ *
+ * Messages which are still queued when the process crashes are lost.
+ * This feature requires thread support and a compiler with atomic
+ * intrinsics (GCC, Clang or MSVC).
+ *
+ * @param pf        Pool factory to allocate the rings from. The factory
+ *                  must remain valid until #pj_log_async_stop() is
+ *                  called.
+ * @param prm       Settings, or NULL to use the default values.
+ *
+ * @return          PJ_SUCCESS on success, PJ_EEXISTS if it has been
+ *                  started, PJ_ENOTSUP if it's not supported, or the
+ *                  appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_log_async_start(pj_pool_factory *pf,
+                                        const pj_log_async_param *prm);
+
+/**
+ * Stop asynchronous logging. All queued messages are written before this
+ * function returns, and subsequent messages are written synchronously.
+ *
+ * @return          PJ_SUCCESS on success, or PJ_EINVALIDOP if
+ *                  asynchronous logging is not running.
+ */
+PJ_DECL(pj_status_t) pj_log_async_stop(void);
+
+/**
+ * Check whether asynchronous logging is running.
+ *
+ * @return          PJ_TRUE if asynchronous logging is running.
+ */
+PJ_DECL(pj_bool_t) pj_log_async_is_running(void);
+
+/**
+ * Wait until all messages which have been queued by the time this
+ * function is called are written.
+ */
+PJ_DECL(void) pj_log_async_flush(void);
+
+/**
+ * Get the number of messages dropped because the ring of the logging
+ * thread was full, since asynchronous logging was started. The log thread
+ * also reports new drops as a log message.
+ *
+ * @return          Number of dropped messages.
+ */
+PJ_DECL(pj_uint32_t) pj_log_async_get_dropped(void);
+
 /** 
  * @}
  */
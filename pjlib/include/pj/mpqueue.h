@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_MPQUEUE_H__
+#define __PJ_MPQUEUE_H__
+
+/**
+ * @file mpqueue.h
+ * @brief Lock-free multi-producer queues.
+ */
+
+#include <pj/types.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_MPQUEUE Lock-free Multi-producer Queues
+ * @ingroup PJ_DS
+ * @{
+ * These queues pass items between threads without taking a lock, so a
+ * thread that is preempted while using the queue never blocks the others.
+ * Three variants are provided:
+ *
+ *  - #pj_mpmc_queue_t is a bounded queue of pointers for any number of
+ *    producers and consumers. Its storage is an array allocated once when
+ *    the queue is created, so it never allocates or frees memory
+ *    afterwards. Pushing to a full queue fails instead of blocking.
+ *
+ *  - #pj_mpsc_queue_t is an unbounded intrusive queue for any number of
+ *    producers and a single consumer. Items embed a #pj_mpsc_queue_node,
+ *    so pushing never fails and never allocates. Once an item has been
+ *    popped, the queue and the producers no longer reference it, so the
+ *    consumer may free or reuse it right away.
+ *
+ *  - #pj_mpmc_uqueue_t is an unbounded intrusive queue for any number of
+ *    producers and consumers, with the same nodes and guarantees as
+ *    #pj_mpsc_queue_t. Pushing is lock-free. Consumers take turns: a
+ *    consumer that finds another one popping is told to retry instead of
+ *    waiting, which is what lets a popped node be freed right away without
+ *    hazard pointers.
+ *
+ * Pops never wait for a producer. A push becomes visible to consumers in
+ * two steps, and a consumer that sees a push between these steps, which
+ * only happens when the producer is preempted in the middle of it, gets
+ * PJ_EPENDING and should retry later rather than treat the queue as empty.
+ *
+ * All queues are FIFO: items pushed by one thread are popped in the
+ * order they were pushed.
+ *
+ * On compilers without atomic operation support (anything other than
+ * GCC, Clang, and MSVC), the queues fall back to using a lock internally.
+ */
+
+/**
+ * Opaque data type for bounded multi-producer multi-consumer queue.
+ */
+typedef struct pj_mpmc_queue_t pj_mpmc_queue_t;
+
+/**
+ * Opaque data type for unbounded multi-producer single-consumer queue.
+ */
+typedef struct pj_mpsc_queue_t pj_mpsc_queue_t;
+
+/**
+ * Opaque data type for unbounded multi-producer multi-consumer queue.
+ */
+typedef struct pj_mpmc_uqueue_t pj_mpmc_uqueue_t;
+
+/**
+ * Link to be embedded in items stored in #pj_mpsc_queue_t or
+ * #pj_mpmc_uqueue_t. The node is owned by the queue between the push and
+ * the pop that returns it, and must not be modified by the application
+ * during that time.
+ */
+typedef struct pj_mpsc_queue_node
+{
+    /** Internal: next node in the queue. */
+    struct pj_mpsc_queue_node * volatile next;
+
+} pj_mpsc_queue_node;
+
+
+/**
+ * Create a bounded multi-producer multi-consumer queue.
+ *
+ * @param pool          Pool to allocate the queue and its storage.
+ * @param capacity      Maximum number of items in the queue. It is rounded
+ *                      up to a power of two.
+ * @param p_queue       Pointer to receive the queue.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_mpmc_queue_create(pj_pool_t *pool,
+                                          unsigned capacity,
+                                          pj_mpmc_queue_t **p_queue);
+
+/**
+ * Destroy the queue. Items remaining in the queue are discarded. The
+ * memory is owned by the pool given to #pj_mpmc_queue_create().
+ *
+ * @param queue         The queue.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_mpmc_queue_destroy(pj_mpmc_queue_t *queue);
+
+/**
+ * Get the capacity of the queue, i.e. the capacity given to
+ * #pj_mpmc_queue_create() rounded up to a power of two.
+ *
+ * @param queue         The queue.
+ *
+ * @return              The capacity.
+ */
+PJ_DECL(unsigned) pj_mpmc_queue_capacity(const pj_mpmc_queue_t *queue);
+
+/**
+ * Add an item to the back of the queue. This may be called from any
+ * thread.
+ *
+ * @param queue         The queue.
+ * @param item          The item, which may be any value including NULL.
+ *
+ * @return              PJ_SUCCESS on success, or PJ_ETOOMANY if the queue
+ *                      is full.
+ */
+PJ_DECL(pj_status_t) pj_mpmc_queue_push(pj_mpmc_queue_t *queue, void *item);
+
+/**
+ * Remove the item at the front of the queue. This may be called from any
+ * thread.
+ *
+ * @param queue         The queue.
+ * @param p_item        Pointer to receive the item.
+ *
+ * @return              PJ_SUCCESS on success, or PJ_ENOTFOUND if the queue
+ *                      is empty.
+ */
+PJ_DECL(pj_status_t) pj_mpmc_queue_pop(pj_mpmc_queue_t *queue,
+                                       void **p_item);
+
+
+/**
+ * Create an unbounded multi-producer single-consumer queue.
+ *
+ * @param pool          Pool to allocate the queue.
+ * @param p_queue       Pointer to receive the queue.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_mpsc_queue_create(pj_pool_t *pool,
+                                          pj_mpsc_queue_t **p_queue);
+
+/**
+ * Destroy the queue. Nodes remaining in the queue are not touched. The
+ * memory is owned by the pool given to #pj_mpsc_queue_create().
+ *
+ * @param queue         The queue.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_mpsc_queue_destroy(pj_mpsc_queue_t *queue);
+
+/**
+ * Add a node to the back of the queue. This may be called from any
+ * thread.
+ *
+ * @param queue         The queue.
+ * @param node          The node, which must not currently be in a queue.
+ */
+PJ_DECL(void) pj_mpsc_queue_push(pj_mpsc_queue_t *queue,
+                                 pj_mpsc_queue_node *node);
+
+/**
+ * Remove the node at the front of the queue. This must only be called by
+ * the consumer, i.e. by one thread at a time.
+ *
+ * @param queue         The queue.
+ * @param p_node        Pointer to receive the node, or NULL if none was
+ *                      removed.
+ *
+ * @return              PJ_SUCCESS on success, PJ_ENOTFOUND if the queue is
+ *                      empty, or PJ_EPENDING if a producer is in the middle
+ *                      of pushing the next node, in which case the call
+ *                      should be retried later.
+ */
+PJ_DECL(pj_status_t) pj_mpsc_queue_pop(pj_mpsc_queue_t *queue,
+                                       pj_mpsc_queue_node **p_node);
+
+/**
+ * Check whether the queue is empty. When called by the consumer, a
+ * PJ_FALSE result means that the next #pj_mpsc_queue_pop() will not
+ * return PJ_ENOTFOUND. When called by other threads, the result is only
+ * a hint.
+ *
+ * @param queue         The queue.
+ *
+ * @return              PJ_TRUE if the queue is empty.
+ */
+PJ_DECL(pj_bool_t) pj_mpsc_queue_is_empty(const pj_mpsc_queue_t *queue);
+
+
+/**
+ * Create an unbounded multi-producer multi-consumer queue.
+ *
+ * @param pool          Pool to allocate the queue.
+ * @param p_queue       Pointer to receive the queue.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_mpmc_uqueue_create(pj_pool_t *pool,
+                                           pj_mpmc_uqueue_t **p_queue);
+
+/**
+ * Destroy the queue. Nodes remaining in the queue are not touched. The
+ * memory is owned by the pool given to #pj_mpmc_uqueue_create().
+ *
+ * @param queue         The queue.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_mpmc_uqueue_destroy(pj_mpmc_uqueue_t *queue);
+
+/**
+ * Add a node to the back of the queue. This may be called from any
+ * thread.
+ *
+ * @param queue         The queue.
+ * @param node          The node, which must not currently be in a queue.
+ */
+PJ_DECL(void) pj_mpmc_uqueue_push(pj_mpmc_uqueue_t *queue,
+                                  pj_mpsc_queue_node *node);
+
+/**
+ * Remove the node at the front of the queue. This may be called from any
+ * thread. Once a node has been returned, the queue and the other threads
+ * no longer reference it.
+ *
+ * @param queue         The queue.
+ * @param p_node        Pointer to receive the node, or NULL if none was
+ *                      removed.
+ *
+ * @return              PJ_SUCCESS on success, PJ_ENOTFOUND if the queue is
+ *                      empty, or PJ_EPENDING if another consumer is popping
+ *                      or a producer is in the middle of pushing the next
+ *                      node, in which case the call should be retried
+ *                      later.
+ */
+PJ_DECL(pj_status_t) pj_mpmc_uqueue_pop(pj_mpmc_uqueue_t *queue,
+                                        pj_mpsc_queue_node **p_node);
+
+/**
+ * Check whether the queue is empty. The result is only a hint, as other
+ * threads may push or pop meanwhile.
+ *
+ * @param queue         The queue.
+ *
+ * @return              PJ_TRUE if the queue is empty.
+ */
+PJ_DECL(pj_bool_t) pj_mpmc_uqueue_is_empty(const pj_mpmc_uqueue_t *queue);
+
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif  /* __PJ_MPQUEUE_H__ */
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_OHASH_H__
+#define __PJ_OHASH_H__
+
+/**
+ * @file ohash.h
+ * @brief Open addressing hash table.
+ */
+
+#include <pj/hash.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_OHASH Open Addressing Hash Table
+ * @ingroup PJ_DS
+ * @{
+ * This is a hash table which stores its entries directly in a flat slot
+ * array instead of chaining them in lists. Next to the slots, the table
+ * keeps one control byte per slot holding seven bits of the entry's hash,
+ * and lookups compare a whole group of control bytes at once (one machine
+ * word) before touching any slot, so most probes cost a single cache line.
+ * The full key hash is cached in each slot, hence keys are only compared
+ * when the hash matches.
+ *
+ * Unlike #pj_hash_table_t, the table grows as entries are added. Growing
+ * is incremental: a new slot array twice as large is allocated and the
+ * entries of the old array are migrated a few at a time by subsequent
+ * insertions, so no single insertion pays for rehashing the whole table.
+ * Slot arrays are allocated from their own pools (created from the factory
+ * of the pool given to #pj_ohash_create()), so the memory of an outgrown
+ * array is returned as soon as migration completes. Call
+ * #pj_ohash_destroy() to release them.
+ *
+ * Keys are not copied: the application must keep the key valid for as
+ * long as the entry is in the table (the same requirement as
+ * #pj_hash_set_np()). The hash value of a key is the same as the one
+ * calculated by #pj_hash_calc() (or #pj_hash_calc_tolower() for tables
+ * created with #PJ_OHASH_ICASE), so precalculated hash values can be
+ * shared with #pj_hash_table_t.
+ *
+ * The table is not thread safe. While iterating, entries may be modified
+ * or removed (including the current entry), but no new entry may be
+ * added.
+ */
+
+/**
+ * Opaque data type for open addressing hash table.
+ */
+typedef struct pj_ohash_t pj_ohash_t;
+
+/**
+ * Data type for open addressing hash table iterator.
+ */
+typedef struct pj_ohash_iterator_t
+{
+    unsigned    tbl;            /**< Internal table index.  */
+    unsigned    index;          /**< Internal slot index.   */
+} pj_ohash_iterator_t;
+
+/**
+ * Flags to be specified when creating the hash table.
+ */
+typedef enum pj_ohash_flag
+{
+    /**
+     * Keys are compared case insensitively, and the hash value of a key
+     * is calculated as if it were converted to lowercase.
+     */
+    PJ_OHASH_ICASE = 1
+
+} pj_ohash_flag;
+
+
+/**
+ * Create an open addressing hash table.
+ *
+ * @param pool      The pool from which the table object is allocated. The
+ *                  slot arrays are allocated from separate pools created
+ *                  from the same pool factory.
+ * @param size      The expected number of entries. The table grows
+ *                  beyond this as needed.
+ * @param flags     Bitmask of #pj_ohash_flag.
+ * @param p_ht      Pointer to receive the hash table.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ohash_create(pj_pool_t *pool, unsigned size,
+                                     unsigned flags, pj_ohash_t **p_ht);
+
+/**
+ * Destroy the hash table, releasing the memory of its slot arrays. The
+ * table object itself is owned by the pool given to #pj_ohash_create().
+ *
+ * @param ht        The hash table.
+ */
+PJ_DECL(void) pj_ohash_destroy(pj_ohash_t *ht);
+
+/**
+ * Get the value associated with the specified key.
+ *
+ * @param ht        The hash table.
+ * @param key       The key to look for.
+ * @param keylen    The length of the key, or PJ_HASH_KEY_STRING to use
+ *                  the string length of the key.
+ * @param hval      If this argument is not NULL and the value is not zero,
+ *                  the value will be used as the computed hash value. If
+ *                  the argument is not NULL and the value is zero, it will
+ *                  be filled with the computed hash upon return.
+ *
+ * @return          The value associated with the key, or NULL if the key
+ *                  is not found.
+ */
+PJ_DECL(void*) pj_ohash_get(pj_ohash_t *ht, const void *key,
+                            unsigned keylen, pj_uint32_t *hval);
+
+/**
+ * Associate a value with the specified key, or remove the key from the
+ * table if the value is NULL. The key is not copied. If the key already
+ * exists, both the value and the key pointer of the entry are replaced,
+ * so this can also be used to move the entry's key to another buffer
+ * holding an equal key.
+ *
+ * @param ht        The hash table.
+ * @param key       The key.
+ * @param keylen    The length of the key, or PJ_HASH_KEY_STRING to use
+ *                  the string length of the key.
+ * @param hval      If the value is not zero, then the hash table will use
+ *                  this value to search the entry's index, otherwise it
+ *                  will compute the key.
+ * @param value     Value to be associated with the key. If the value is
+ *                  NULL, the entry will be deleted.
+ *
+ * @return          PJ_SUCCESS on success, or PJ_ENOMEM if the table needs
+ *                  to grow and memory can not be allocated.
+ */
+PJ_DECL(pj_status_t) pj_ohash_set(pj_ohash_t *ht, const void *key,
+                                  unsigned keylen, pj_uint32_t hval,
+                                  void *value);
+
+/**
+ * Get the total number of entries in the hash table.
+ *
+ * @param ht        The hash table.
+ *
+ * @return          The number of entries in the hash table.
+ */
+PJ_DECL(unsigned) pj_ohash_count(pj_ohash_t *ht);
+
+/**
+ * Get the iterator to the first element in the hash table.
+ *
+ * @param ht        The hash table.
+ * @param it        The iterator buffer.
+ *
+ * @return          The iterator, or NULL if the table is empty.
+ */
+PJ_DECL(pj_ohash_iterator_t*) pj_ohash_first(pj_ohash_t *ht,
+                                             pj_ohash_iterator_t *it);
+
+/**
+ * Get the next element from the iterator.
+ *
+ * @param ht        The hash table.
+ * @param it        The iterator.
+ *
+ * @return          The next iterator, or NULL if there's no more element.
+ */
+PJ_DECL(pj_ohash_iterator_t*) pj_ohash_next(pj_ohash_t *ht,
+                                            pj_ohash_iterator_t *it);
+
+/**
+ * Get the value associated with a hash iterator.
+ *
+ * @param ht        The hash table.
+ * @param it        The hash iterator.
+ *
+ * @return          The value associated with the current element.
+ */
+PJ_DECL(void*) pj_ohash_this(pj_ohash_t *ht, pj_ohash_iterator_t *it);
+
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif  /* __PJ_OHASH_H__ */
@@ -273,6 +273,20 @@ PJ_DECL(int) pj_thread_get_prio_min(pj_thread_t *thread);
 PJ_DECL(int) pj_thread_get_prio_max(pj_thread_t *thread);
 
 
+/**
+ * Bind the thread to the specified CPU, so that the scheduler only runs
+ * the thread on that CPU.
+ *
+ * @param thread        Thread handle.
+ * @param cpu           Zero based index of the CPU.
+ *
+ * @return              PJ_SUCCESS on success, PJ_ENOTSUP if the platform
+ *                      does not support it, or the error code.
+ */
+PJ_DECL(pj_status_t) pj_thread_set_cpu_affinity(pj_thread_t *thread,
+                                                unsigned cpu);
+
+
 /**
  * Return native handle from pj_thread_t for manipulation using native
  * OS APIs.
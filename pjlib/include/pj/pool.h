@@ -868,7 +868,10 @@ struct pj_caching_pool
     pj_list         free_list[PJ_CACHING_POOL_ARRAY_SIZE];
 
     /**
-     * List of pools currently allocated by applications.
+     * List of pools currently allocated by applications. Pools created by
+     * threads which have a thread cache (see
+     * PJ_CACHING_POOL_THREAD_CACHE_MAX) are kept in per-thread lists
+     * instead.
      */
     pj_list         used_list;
 
@@ -881,6 +884,11 @@ struct pj_caching_pool
      * Mutex.
      */
     pj_lock_t      *lock;
+
+    /**
+     * Internal: per-thread caches.
+     */
+    void           *tcache;
 };
 
 
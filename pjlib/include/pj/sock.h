@@ -1493,6 +1493,82 @@ PJ_DECL(pj_status_t) pj_sock_sendto(pj_sock_t sockfd,
                                     const pj_sockaddr_t *to,
                                     int tolen);
 
+/**
+ * This structure describes one datagram of a batch, see
+ * #pj_sock_sendmmsg() and #pj_sock_recvmmsg().
+ */
+struct pj_sock_mmsg
+{
+    /** The datagram buffer. */
+    void            *buf;
+
+    /**
+     * On input, the length of the datagram to send, or the size of the
+     * buffer to receive. Upon return, it will be filled with the length
+     * of data sent or received.
+     */
+    pj_ssize_t       len;
+
+    /**
+     * The destination address, or the buffer to receive the source
+     * address. Can be NULL when receiving.
+     */
+    pj_sockaddr_t   *addr;
+
+    /**
+     * The length of the address in bytes. When receiving, it specifies
+     * the size of the address buffer on input, and will be filled with
+     * the actual length of the address.
+     */
+    int              addr_len;
+
+};
+
+/**
+ * Transmit several datagrams to the socket with one system call, when
+ * the platform supports it (sendmmsg() on Linux, see
+ * PJ_SOCK_HAS_SENDMMSG), otherwise the datagrams are sent one by one
+ * with #pj_sock_sendto(). The function stops at the first datagram
+ * which can not be sent, including when the socket would block, and
+ * may also send fewer datagrams than requested when the batch is
+ * larger than what the platform accepts in one call.
+ *
+ * @param sockfd        Socket descriptor.
+ * @param msg           The datagrams to send.
+ * @param count         On input, the number of datagrams in \a msg.
+ *                      Upon return, it will be filled with the number
+ *                      of datagrams sent.
+ * @param flags         Flags (such as pj_MSG_DONTROUTE()).
+ *
+ * @return              PJ_SUCCESS when at least one datagram was sent,
+ *                      otherwise the status code of the first datagram.
+ */
+PJ_DECL(pj_status_t) pj_sock_sendmmsg(pj_sock_t sockfd,
+                                      pj_sock_mmsg msg[],
+                                      unsigned *count,
+                                      unsigned flags);
+
+/**
+ * Receive several datagrams from the socket with one system call, when
+ * the platform supports it (recvmmsg() on Linux, see
+ * PJ_SOCK_HAS_RECVMMSG), otherwise only one datagram is received with
+ * #pj_sock_recvfrom(). Only the first datagram may block, the function
+ * returns the datagrams which are already queued on the socket after it.
+ *
+ * @param sockfd        Socket descriptor.
+ * @param msg           The buffers to receive the datagrams.
+ * @param count         On input, the number of buffers in \a msg. Upon
+ *                      return, it will be filled with the number of
+ *                      datagrams received.
+ * @param flags         Flags (such as pj_MSG_PEEK()).
+ *
+ * @return              PJ_SUCCESS or the error code.
+ */
+PJ_DECL(pj_status_t) pj_sock_recvmmsg(pj_sock_t sockfd,
+                                      pj_sock_mmsg msg[],
+                                      unsigned *count,
+                                      unsigned flags);
+
 #if PJ_HAS_TCP
 /**
  * The shutdown call causes all or part of a full-duplex connection on the
@@ -55,6 +55,11 @@ PJ_BEGIN_DECL
  *
  * ACE is Copyright (C)1993-2006 Douglas C. Schmidt <d.schmidt@vanderbilt.edu>
  *
+ * Alternatively, when PJ_TIMER_USE_WHEEL is enabled, the same API is
+ * implemented with a hierarchical timing wheel, where scheduling and
+ * cancelling are O(1) and the entries are spread over several independently
+ * locked wheels (see PJ_TIMER_WHEEL_SHARDS).
+ *
  * @{
  *
  * \section pj_timer_examples_sec Examples
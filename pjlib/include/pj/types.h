@@ -287,6 +287,9 @@ typedef void pj_sockaddr_t;
 /** Forward declaration. */
 typedef struct pj_sockaddr_in pj_sockaddr_in;
 
+/** Forward declaration. */
+typedef struct pj_sock_mmsg pj_sock_mmsg;
+
 /** Color type. */
 typedef unsigned int pj_color_t;
 
@@ -44,7 +44,9 @@
 #include <pj/list.h>
 #include <pj/lock.h>
 #include <pj/log.h>
+#include <pj/ohash.h>
 #include <pj/math.h>
+#include <pj/mpqueue.h>
 #include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/pool_buf.h>
@@ -521,6 +521,14 @@ pj_bool_t ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue,
                                   read_op->flags,
                                   read_op->rmt_addr, 
                                   read_op->rmt_addrlen);
+        } else if (read_op->op == PJ_IOQUEUE_OP_RECV_MMSG) {
+            unsigned count = (unsigned)read_op->size;
+
+            /* Pull all the queued datagrams for this readiness event */
+            read_op->op = PJ_IOQUEUE_OP_NONE;
+            rc = pj_sock_recvmmsg(h->fd, (pj_sock_mmsg*)read_op->buf,
+                                  &count, read_op->flags);
+            bytes_read = count;
         } else if (read_op->op == PJ_IOQUEUE_OP_RECV) {
             read_op->op = PJ_IOQUEUE_OP_NONE;
             rc = pj_sock_recv(h->fd, read_op->buf, &bytes_read, 
@@ -850,6 +858,80 @@ PJ_DEF(pj_status_t) pj_ioqueue_recvfrom( pj_ioqueue_key_t *key,
     return PJ_EPENDING;
 }
 
+/*
+ * pj_ioqueue_recvmmsg()
+ *
+ * Start asynchronous recvmmsg() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvmmsg( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+                                         pj_sock_mmsg *msg,
+                                         unsigned *count,
+                                         pj_uint32_t flags)
+{
+    struct read_operation *read_op;
+
+    PJ_ASSERT_RETURN(key && op_key && msg && count && *count, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    read_op = (struct read_operation*)op_key;
+    PJ_ASSERT_RETURN(read_op->op == PJ_IOQUEUE_OP_NONE, PJ_EPENDING);
+    read_op->op = PJ_IOQUEUE_OP_NONE;
+
+    /* Try to see if there's data immediately available. 
+     */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0) {
+        pj_status_t status;
+        unsigned cnt = *count;
+
+        status = pj_sock_recvmmsg(key->fd, msg, &cnt, flags);
+        if (status == PJ_SUCCESS) {
+            /* Yes! Data is available! */
+            *count = cnt;
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))
+                return status;
+        }
+    }
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /*
+     * No data is immediately available.
+     * Must schedule asynchronous operation to the ioqueue. The message
+     * array and its size are kept in the buffer fields.
+     */
+    read_op->op = PJ_IOQUEUE_OP_RECV_MMSG;
+    read_op->buf = msg;
+    read_op->size = *count;
+    read_op->flags = flags;
+    read_op->rmt_addr = NULL;
+    read_op->rmt_addrlen = NULL;
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app. If we add bad handle to the set it will
+     * corrupt the ioqueue set. See #913
+     */
+    if (IS_CLOSING(key)) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_ECANCELLED;
+    }
+    pj_list_insert_before(&key->read_list, read_op);
+    ioqueue_add_to_set(key->ioqueue, key, READABLE_EVENT);
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_EPENDING;
+}
+
 /*
  * pj_ioqueue_send()
  *
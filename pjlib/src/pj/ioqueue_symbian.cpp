@@ -755,6 +755,25 @@ PJ_DEF(pj_status_t) pj_ioqueue_recvfrom( pj_ioqueue_key_t *key,
 }
 
 
+/*
+ * pj_ioqueue_recvmmsg()
+ *
+ * Not supported, caller should use pj_ioqueue_recvfrom() instead.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvmmsg( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+                                         pj_sock_mmsg *msg,
+                                         unsigned *count,
+                                         pj_uint32_t flags)
+{
+    PJ_UNUSED_ARG(key);
+    PJ_UNUSED_ARG(op_key);
+    PJ_UNUSED_ARG(msg);
+    PJ_UNUSED_ARG(count);
+    PJ_UNUSED_ARG(flags);
+    return PJ_ENOTSUP;
+}
+
 /*
  * Instruct the I/O Queue to write to the handle.
  */
@@ -0,0 +1,2110 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/*
+ * ioqueue_uring.c
+ *
+ * This is the implementation of IOQueue framework using Linux io_uring.
+ *
+ * Unlike the select/epoll/kqueue backends, which wait for readiness and
+ * then perform the socket call themselves (ioqueue_common_abs.c), this
+ * backend is completion based like the IOCP backend: the recv, recvfrom,
+ * send, sendto and accept operations are submitted to the kernel as
+ * submission queue entries and the callbacks are called when their
+ * completion queue entries are reaped by pj_ioqueue_poll().
+ *
+ * Only one operation per direction (read, write, accept) is submitted to
+ * the kernel for a key at any time, the others wait in the key's pending
+ * lists. This keeps datagrams and stream data in the order the operations
+ * were posted, as the other backends do. Stream sends are resubmitted
+ * until the whole buffer is written.
+ *
+ * The io_uring system calls are invoked directly, so liburing is not
+ * needed. Kernel 6.0 or newer is required for synchronous cancellation
+ * (IORING_REGISTER_SYNC_CANCEL), which is what guarantees that the kernel
+ * no longer touches the application buffers once pj_ioqueue_unregister(),
+ * pj_ioqueue_clear_key() or pj_ioqueue_post_completion() returns.
+ */
+#include <pj/ioqueue.h>
+#include <pj/os.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/list.h>
+#include <pj/math.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/sock.h>
+#include <pj/compat/socket.h>
+
+#include <linux/io_uring.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define THIS_FILE   "ioq_uring"
+
+//#define TRACE_(expr) PJ_LOG(3,expr)
+#define TRACE_(expr)
+
+/* Minimum and maximum number of submission queue entries. The completion
+ * queue is twice as large, and the kernel keeps overflowing completions
+ * on its own list (IORING_FEAT_NODROP) anyway.
+ */
+#define MIN_SQ_ENTRIES      64
+#define MAX_SQ_ENTRIES      4096
+
+#define PENDING_RETRY       2
+
+#define IS_CLOSING(key)     (key->closing)
+
+/*
+ * Internal record of a pending operation. Records are owned by a key,
+ * the kernel refers to them with the user_data of the submission, so
+ * they stay valid after the application has released its op_key.
+ */
+struct uring_op
+{
+    PJ_DECL_LIST_MEMBER(struct uring_op);
+    struct uring_op         *owner_next;
+    pj_ioqueue_key_t        *key;
+    pj_ioqueue_op_key_t     *op_key;
+    pj_ioqueue_operation_e   op;
+    pj_bool_t                submitted;
+    pj_bool_t                discarded;
+    pj_status_t              status;
+    unsigned                 flags;
+    char                    *buf;
+    pj_ssize_t               size;
+    pj_ssize_t               done;
+    pj_sockaddr_t           *rmt_addr;
+    int                     *rmt_addrlen;
+    pj_sock_t               *accept_fd;
+    pj_sockaddr_t           *local_addr;
+    struct msghdr            msg;
+    struct iovec             iov;
+    pj_sockaddr              addr;
+    socklen_t                addrlen;
+};
+
+/* The pending record of an operation is kept in the op_key. */
+#define OP_REC(op_key)      (*(struct uring_op**)(op_key)->internal__)
+
+/*
+ * This describes each key.
+ */
+struct pj_ioqueue_key_t
+{
+    PJ_DECL_LIST_MEMBER(struct pj_ioqueue_key_t);
+    pj_ioqueue_t           *ioqueue;
+    pj_grp_lock_t          *grp_lock;
+    pj_lock_t              *lock;
+    pj_bool_t               allow_concurrent;
+    pj_sock_t               fd;
+    int                     fd_type;
+    void                   *user_data;
+    pj_ioqueue_callback     cb;
+    int                     connecting;
+    struct uring_op        *connect_op;
+    struct uring_op         read_list;
+    struct uring_op         write_list;
+    struct uring_op         accept_list;
+    struct uring_op         free_ops;
+    struct uring_op        *owned_ops;
+    int                     inflight;
+    int                     ref_count;
+    pj_bool_t               closing;
+    pj_time_val             free_time;
+};
+
+/*
+ * This describes the I/O queue.
+ */
+struct pj_ioqueue_t
+{
+    pj_lock_t          *lock;
+    pj_bool_t           auto_delete_lock;
+    pj_ioqueue_cfg      cfg;
+    pj_pool_t          *pool;
+
+    unsigned            max, count;
+    pj_ioqueue_key_t    active_list;
+    pj_ioqueue_key_t    closing_list;
+    pj_ioqueue_key_t    free_list;
+    pj_mutex_t         *ref_cnt_mutex;
+
+    /* Thread local flag set while a thread dispatches completions, to
+     * defer the submission of operations posted by the callbacks until
+     * the end of the poll.
+     */
+    long                tls_id;
+
+    int                 ring_fd;
+    void               *sq_ptr, *cq_ptr;
+    pj_size_t           sq_size, cq_size, sqes_size;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned           *sq_khead, *sq_ktail, *sq_kflags;
+    unsigned            sq_mask, sq_entries;
+    unsigned           *cq_khead, *cq_ktail;
+    unsigned            cq_mask;
+
+    pj_mutex_t         *sq_mutex;
+    unsigned            sq_tail;
+    unsigned            sq_unsubmitted;
+    pj_mutex_t         *cq_mutex;
+};
+
+/* Reaped completion. */
+struct uring_event
+{
+    struct uring_op    *op;
+    int                 res;
+};
+
+
+/*
+ * The io_uring system calls.
+ */
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags,
+                              void *arg, pj_size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg,
+                                 unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+/*
+ * pj_ioqueue_name()
+ */
+PJ_DEF(const char*) pj_ioqueue_name(void)
+{
+    return "io_uring";
+}
+
+
+PJ_DEF(void) pj_ioqueue_cfg_default(pj_ioqueue_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->epoll_flags = PJ_IOQUEUE_DEFAULT_EPOLL_FLAGS;
+    cfg->default_concurrency = PJ_IOQUEUE_DEFAULT_ALLOW_CONCURRENCY;
+}
+
+
+/* Map the rings of a newly created io_uring instance. */
+static pj_status_t map_rings(pj_ioqueue_t *ioqueue,
+                             const struct io_uring_params *p)
+{
+    char *sq, *cq;
+
+    ioqueue->sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    ioqueue->cq_size = p->cq_off.cqes +
+                       p->cq_entries * sizeof(struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ioqueue->cq_size > ioqueue->sq_size)
+            ioqueue->sq_size = ioqueue->cq_size;
+        ioqueue->cq_size = ioqueue->sq_size;
+    }
+
+    ioqueue->sq_ptr = mmap(NULL, ioqueue->sq_size, PROT_READ|PROT_WRITE,
+                           MAP_SHARED|MAP_POPULATE, ioqueue->ring_fd,
+                           IORING_OFF_SQ_RING);
+    if (ioqueue->sq_ptr == MAP_FAILED) {
+        ioqueue->sq_ptr = NULL;
+        return PJ_RETURN_OS_ERROR(pj_get_native_os_error());
+    }
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        ioqueue->cq_ptr = ioqueue->sq_ptr;
+    } else {
+        ioqueue->cq_ptr = mmap(NULL, ioqueue->cq_size, PROT_READ|PROT_WRITE,
+                               MAP_SHARED|MAP_POPULATE, ioqueue->ring_fd,
+                               IORING_OFF_CQ_RING);
+        if (ioqueue->cq_ptr == MAP_FAILED) {
+            ioqueue->cq_ptr = NULL;
+            return PJ_RETURN_OS_ERROR(pj_get_native_os_error());
+        }
+    }
+
+    ioqueue->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    ioqueue->sqes = (struct io_uring_sqe*)
+                    mmap(NULL, ioqueue->sqes_size, PROT_READ|PROT_WRITE,
+                         MAP_SHARED|MAP_POPULATE, ioqueue->ring_fd,
+                         IORING_OFF_SQES);
+    if (ioqueue->sqes == MAP_FAILED) {
+        ioqueue->sqes = NULL;
+        return PJ_RETURN_OS_ERROR(pj_get_native_os_error());
+    }
+
+    sq = (char*)ioqueue->sq_ptr;
+    ioqueue->sq_khead = (unsigned*)(sq + p->sq_off.head);
+    ioqueue->sq_ktail = (unsigned*)(sq + p->sq_off.tail);
+    ioqueue->sq_kflags = (unsigned*)(sq + p->sq_off.flags);
+    ioqueue->sq_mask = *(unsigned*)(sq + p->sq_off.ring_mask);
+    ioqueue->sq_entries = p->sq_entries;
+    ioqueue->sq_tail = *ioqueue->sq_ktail;
+
+    /* We always fill the SQEs in ring order, so the index array is an
+     * identity mapping which only needs to be set once.
+     */
+    {
+        unsigned *array = (unsigned*)(sq + p->sq_off.array);
+        unsigned i;
+
+        for (i = 0; i < p->sq_entries; ++i)
+            array[i] = i;
+    }
+
+    cq = (char*)ioqueue->cq_ptr;
+    ioqueue->cq_khead = (unsigned*)(cq + p->cq_off.head);
+    ioqueue->cq_ktail = (unsigned*)(cq + p->cq_off.tail);
+    ioqueue->cq_mask = *(unsigned*)(cq + p->cq_off.ring_mask);
+    ioqueue->cqes = (struct io_uring_cqe*)(cq + p->cq_off.cqes);
+
+    return PJ_SUCCESS;
+}
+
+/* Synchronously cancel the requests matching user_data, or all requests
+ * on fd when IORING_ASYNC_CANCEL_FD is specified. When this returns, the
+ * completions of the cancelled requests have been posted.
+ */
+static int sync_cancel(pj_ioqueue_t *ioqueue, int fd, void *user_data,
+                       unsigned flags)
+{
+    struct io_uring_sync_cancel_reg reg;
+    int rc;
+
+    pj_bzero(&reg, sizeof(reg));
+    reg.addr = (__u64)(pj_size_t)user_data;
+    reg.fd = fd;
+    reg.flags = flags;
+    reg.timeout.tv_sec = -1;
+    reg.timeout.tv_nsec = -1;
+
+    do {
+        rc = sys_io_uring_register(ioqueue->ring_fd,
+                                   IORING_REGISTER_SYNC_CANCEL, &reg, 1);
+    } while (rc < 0 && errno == EINTR);
+
+    return rc < 0 ? errno : 0;
+}
+
+/* Destroy the ring and everything that was created for it. */
+static void destroy_ring(pj_ioqueue_t *ioqueue)
+{
+    if (ioqueue->sqes)
+        munmap(ioqueue->sqes, ioqueue->sqes_size);
+    if (ioqueue->cq_ptr && ioqueue->cq_ptr != ioqueue->sq_ptr)
+        munmap(ioqueue->cq_ptr, ioqueue->cq_size);
+    if (ioqueue->sq_ptr)
+        munmap(ioqueue->sq_ptr, ioqueue->sq_size);
+    if (ioqueue->ring_fd >= 0)
+        close(ioqueue->ring_fd);
+
+    ioqueue->sqes = NULL;
+    ioqueue->cq_ptr = ioqueue->sq_ptr = NULL;
+    ioqueue->ring_fd = -1;
+}
+
+/* Create the io_uring instance. */
+static pj_status_t create_ring(pj_ioqueue_t *ioqueue, pj_size_t max_fd)
+{
+    struct io_uring_params p;
+    unsigned entries;
+    pj_status_t status;
+    int err;
+
+    /* Each key has at most one read, one write and one accept operation
+     * submitted at a time.
+     */
+    entries = MIN_SQ_ENTRIES;
+    while (entries < max_fd * 3 && entries < MAX_SQ_ENTRIES)
+        entries <<= 1;
+
+    pj_bzero(&p, sizeof(p));
+    p.flags = IORING_SETUP_CLAMP | IORING_SETUP_SUBMIT_ALL;
+    ioqueue->ring_fd = sys_io_uring_setup(entries, &p);
+    if (ioqueue->ring_fd < 0 && errno == EINVAL) {
+        pj_bzero(&p, sizeof(p));
+        p.flags = IORING_SETUP_CLAMP;
+        ioqueue->ring_fd = sys_io_uring_setup(entries, &p);
+    }
+    if (ioqueue->ring_fd < 0) {
+        status = PJ_RETURN_OS_ERROR(pj_get_native_os_error());
+        PJ_PERROR(2,(THIS_FILE, status, "io_uring_setup() error"));
+        return status;
+    }
+
+    if ((p.features & IORING_FEAT_NODROP) == 0 ||
+        (p.features & IORING_FEAT_EXT_ARG) == 0)
+    {
+        PJ_LOG(2,(THIS_FILE, "io_uring features 0x%x are not sufficient",
+                  p.features));
+        destroy_ring(ioqueue);
+        return PJ_ENOTSUP;
+    }
+
+    /* Probe synchronous cancellation. Nothing is submitted yet, so a
+     * supporting kernel reports nothing or that no request was found,
+     * older kernels reject the opcode.
+     */
+    err = sync_cancel(ioqueue, -1, NULL, IORING_ASYNC_CANCEL_ANY);
+    if (err != 0 && err != ENOENT) {
+        PJ_LOG(2,(THIS_FILE, "io_uring synchronous cancellation is not "
+                  "supported (err=%d)", err));
+        destroy_ring(ioqueue);
+        return PJ_ENOTSUP;
+    }
+
+    status = map_rings(ioqueue, &p);
+    if (status != PJ_SUCCESS) {
+        destroy_ring(ioqueue);
+        return status;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * pj_ioqueue_create()
+ *
+ * Create io_uring ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
+                                       pj_size_t max_fd,
+                                       pj_ioqueue_t **p_ioqueue)
+{
+    return pj_ioqueue_create2(pool, max_fd, NULL, p_ioqueue);
+}
+
+/*
+ * pj_ioqueue_create2()
+ *
+ * Create io_uring ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create2(pj_pool_t *pool,
+                                       pj_size_t max_fd,
+                                       const pj_ioqueue_cfg *cfg,
+                                       pj_ioqueue_t **p_ioqueue)
+{
+    pj_ioqueue_t *ioqueue;
+    pj_lock_t *lock;
+    pj_size_t i;
+    pj_status_t rc;
+
+    /* Check that arguments are valid. */
+    PJ_ASSERT_RETURN(pool != NULL && p_ioqueue != NULL &&
+                     max_fd > 0, PJ_EINVAL);
+
+    ioqueue = PJ_POOL_ZALLOC_T(pool, pj_ioqueue_t);
+    ioqueue->pool = pool;
+    ioqueue->ring_fd = -1;
+    ioqueue->tls_id = -1;
+
+    if (cfg)
+        pj_memcpy(&ioqueue->cfg, cfg, sizeof(*cfg));
+    else
+        pj_ioqueue_cfg_default(&ioqueue->cfg);
+
+    ioqueue->max = (unsigned)max_fd;
+    ioqueue->count = 0;
+    pj_list_init(&ioqueue->active_list);
+    pj_list_init(&ioqueue->closing_list);
+    pj_list_init(&ioqueue->free_list);
+
+    rc = create_ring(ioqueue, max_fd);
+    if (rc != PJ_SUCCESS)
+        return rc;
+
+    rc = pj_thread_local_alloc(&ioqueue->tls_id);
+    if (rc != PJ_SUCCESS)
+        goto on_error;
+
+    rc = pj_mutex_create_simple(pool, "ioqsq%p", &ioqueue->sq_mutex);
+    if (rc != PJ_SUCCESS)
+        goto on_error;
+
+    rc = pj_mutex_create_simple(pool, "ioqcq%p", &ioqueue->cq_mutex);
+    if (rc != PJ_SUCCESS)
+        goto on_error;
+
+    /* Mutex to protect key's reference counter and closing flag. We don't
+     * want to use key's mutex or ioqueue's mutex because that would create
+     * deadlock situation in some cases.
+     */
+    rc = pj_mutex_create_simple(pool, NULL, &ioqueue->ref_cnt_mutex);
+    if (rc != PJ_SUCCESS)
+        goto on_error;
+
+    /* Keys are always pre-created and recycled through the closing list,
+     * as the kernel may still hold completions referring to a key after
+     * it has been unregistered.
+     */
+    for (i=0; i<max_fd; ++i) {
+        pj_ioqueue_key_t *key;
+
+        key = PJ_POOL_ZALLOC_T(pool, pj_ioqueue_key_t);
+        pj_list_init(&key->free_ops);
+        rc = pj_lock_create_recursive_mutex(pool, NULL, &key->lock);
+        if (rc != PJ_SUCCESS)
+            goto on_error;
+
+        pj_list_push_back(&ioqueue->free_list, key);
+    }
+
+    rc = pj_lock_create_simple_mutex(pool, "ioq%p", &lock);
+    if (rc != PJ_SUCCESS)
+        goto on_error;
+
+    rc = pj_ioqueue_set_lock(ioqueue, lock, PJ_TRUE);
+    if (rc != PJ_SUCCESS)
+        goto on_error;
+
+    PJ_LOG(4, ("pjlib", "io_uring I/O Queue created (entries=%u, ptr=%p)",
+               ioqueue->sq_entries, ioqueue));
+
+    *p_ioqueue = ioqueue;
+    return PJ_SUCCESS;
+
+on_error:
+    {
+        pj_ioqueue_key_t *key = ioqueue->free_list.next;
+        while (key != &ioqueue->free_list) {
+            pj_lock_destroy(key->lock);
+            key = key->next;
+        }
+    }
+    if (ioqueue->ref_cnt_mutex)
+        pj_mutex_destroy(ioqueue->ref_cnt_mutex);
+    if (ioqueue->cq_mutex)
+        pj_mutex_destroy(ioqueue->cq_mutex);
+    if (ioqueue->sq_mutex)
+        pj_mutex_destroy(ioqueue->sq_mutex);
+    if (ioqueue->tls_id != -1)
+        pj_thread_local_free(ioqueue->tls_id);
+    destroy_ring(ioqueue);
+    return rc;
+}
+
+/*
+ * pj_ioqueue_destroy()
+ *
+ * Destroy ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_destroy(pj_ioqueue_t *ioqueue)
+{
+    pj_ioqueue_key_t *lists[3], *key;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    PJ_ASSERT_RETURN(ioqueue->ring_fd >= 0, PJ_EINVALIDOP);
+
+    pj_lock_acquire(ioqueue->lock);
+
+    /* Closing the ring cancels whatever is still pending. */
+    destroy_ring(ioqueue);
+
+    lists[0] = &ioqueue->active_list;
+    lists[1] = &ioqueue->closing_list;
+    lists[2] = &ioqueue->free_list;
+    for (i=0; i<PJ_ARRAY_SIZE(lists); ++i) {
+        key = lists[i]->next;
+        while (key != lists[i]) {
+            pj_lock_destroy(key->lock);
+            key = key->next;
+        }
+    }
+
+    pj_mutex_destroy(ioqueue->ref_cnt_mutex);
+    pj_mutex_destroy(ioqueue->cq_mutex);
+    pj_mutex_destroy(ioqueue->sq_mutex);
+    pj_thread_local_free(ioqueue->tls_id);
+
+    if (ioqueue->auto_delete_lock && ioqueue->lock ) {
+        pj_lock_release(ioqueue->lock);
+        return pj_lock_destroy(ioqueue->lock);
+    }
+    pj_lock_release(ioqueue->lock);
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_set_lock()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_lock( pj_ioqueue_t *ioqueue,
+                                         pj_lock_t *lock,
+                                         pj_bool_t auto_delete )
+{
+    PJ_ASSERT_RETURN(ioqueue && lock, PJ_EINVAL);
+
+    if (ioqueue->auto_delete_lock && ioqueue->lock) {
+        pj_lock_destroy(ioqueue->lock);
+    }
+
+    ioqueue->lock = lock;
+    ioqueue->auto_delete_lock = auto_delete;
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_default_concurrency( pj_ioqueue_t *ioqueue,
+                                                        pj_bool_t allow)
+{
+    PJ_ASSERT_RETURN(ioqueue != NULL, PJ_EINVAL);
+    ioqueue->cfg.default_concurrency = allow;
+    return PJ_SUCCESS;
+}
+
+
+/* Scan closing keys to be put to free list again. Keys are only reused
+ * once the kernel has returned all of their completions.
+ */
+static void scan_closing_keys(pj_ioqueue_t *ioqueue)
+{
+    pj_time_val now;
+    pj_ioqueue_key_t *h;
+
+    pj_gettickcount(&now);
+    pj_mutex_lock(ioqueue->ref_cnt_mutex);
+    h = ioqueue->closing_list.next;
+    while (h != &ioqueue->closing_list) {
+        pj_ioqueue_key_t *next = h->next;
+
+        pj_assert(h->closing != 0);
+
+        if (PJ_TIME_VAL_GTE(now, h->free_time) && h->ref_count == 0 &&
+            __atomic_load_n(&h->inflight, __ATOMIC_ACQUIRE) == 0)
+        {
+            pj_list_erase(h);
+            pj_list_push_back(&ioqueue->free_list, h);
+        }
+        h = next;
+    }
+    pj_mutex_unlock(ioqueue->ref_cnt_mutex);
+}
+
+
+/*
+ * Submission.
+ */
+
+/* Pass the SQEs which have been queued so far to the kernel.
+ * sq_mutex must be held.
+ */
+static pj_status_t flush_sq(pj_ioqueue_t *ioqueue)
+{
+    while (ioqueue->sq_unsubmitted) {
+        int rc = sys_io_uring_enter(ioqueue->ring_fd,
+                                    ioqueue->sq_unsubmitted, 0, 0, NULL, 0);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            return PJ_RETURN_OS_ERROR(pj_get_native_os_error());
+        } else if (rc == 0) {
+            return PJ_ETOOMANY;
+        }
+        ioqueue->sq_unsubmitted -= rc;
+    }
+    return PJ_SUCCESS;
+}
+
+static void lock_flush_sq(pj_ioqueue_t *ioqueue)
+{
+    pj_status_t status;
+
+    pj_mutex_lock(ioqueue->sq_mutex);
+    status = flush_sq(ioqueue);
+    pj_mutex_unlock(ioqueue->sq_mutex);
+
+    if (status != PJ_SUCCESS)
+        PJ_PERROR(2,(THIS_FILE, status, "io_uring_enter() submit error"));
+}
+
+/* Fill in the SQE for the operation. */
+static void prep_sqe(struct io_uring_sqe *sqe, struct uring_op *op)
+{
+    pj_ioqueue_key_t *key = op->key;
+
+    pj_bzero(sqe, sizeof(*sqe));
+    sqe->fd = key->fd;
+    sqe->user_data = (__u64)(pj_size_t)op;
+
+    switch (op->op) {
+    case PJ_IOQUEUE_OP_RECV:
+        sqe->opcode = IORING_OP_RECV;
+        sqe->addr = (__u64)(pj_size_t)op->buf;
+        sqe->len = (__u32)op->size;
+        sqe->msg_flags = op->flags;
+        break;
+    case PJ_IOQUEUE_OP_RECV_FROM:
+        /* The address is written directly to the application's buffer */
+        pj_bzero(&op->msg, sizeof(op->msg));
+        op->iov.iov_base = op->buf;
+        op->iov.iov_len = op->size;
+        op->msg.msg_iov = &op->iov;
+        op->msg.msg_iovlen = 1;
+        if (op->rmt_addr && op->rmt_addrlen) {
+            op->msg.msg_name = op->rmt_addr;
+            op->msg.msg_namelen = *op->rmt_addrlen;
+        }
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->addr = (__u64)(pj_size_t)&op->msg;
+        sqe->len = 1;
+        sqe->msg_flags = op->flags;
+        break;
+    case PJ_IOQUEUE_OP_SEND:
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = (__u64)(pj_size_t)(op->buf + op->done);
+        sqe->len = (__u32)(op->size - op->done);
+        sqe->msg_flags = op->flags | MSG_NOSIGNAL;
+        break;
+    case PJ_IOQUEUE_OP_SEND_TO:
+        pj_bzero(&op->msg, sizeof(op->msg));
+        op->iov.iov_base = op->buf + op->done;
+        op->iov.iov_len = op->size - op->done;
+        op->msg.msg_iov = &op->iov;
+        op->msg.msg_iovlen = 1;
+        op->msg.msg_name = &op->addr;
+        op->msg.msg_namelen = op->addrlen;
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = (__u64)(pj_size_t)&op->msg;
+        sqe->len = 1;
+        sqe->msg_flags = op->flags | MSG_NOSIGNAL;
+        break;
+#if PJ_HAS_TCP
+    case PJ_IOQUEUE_OP_ACCEPT:
+        op->addrlen = sizeof(op->addr);
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->addr = (__u64)(pj_size_t)&op->addr;
+        sqe->addr2 = (__u64)(pj_size_t)&op->addrlen;
+        break;
+#endif
+    default:
+        /* recvmmsg() and connect() have no completion based counterpart,
+         * wait for the socket to be ready and do the call on completion.
+         */
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->poll32_events = (op->op == PJ_IOQUEUE_OP_RECV_MMSG) ?
+                             POLLIN : POLLOUT;
+#if defined(PJ_IS_BIG_ENDIAN) && PJ_IS_BIG_ENDIAN != 0
+        sqe->poll32_events = (sqe->poll32_events << 16) |
+                             (sqe->poll32_events >> 16);
+#endif
+        break;
+    }
+}
+
+/* Submit the operation to the kernel. The key must be locked. When called
+ * from a callback during pj_ioqueue_poll(), the submission is deferred
+ * until the end of the poll so that it goes with the other submissions
+ * in one system call.
+ */
+static pj_status_t submit_op(pj_ioqueue_key_t *key, struct uring_op *op)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+    struct io_uring_sqe *sqe;
+    pj_status_t status = PJ_SUCCESS;
+
+    pj_mutex_lock(ioqueue->sq_mutex);
+
+    if (ioqueue->sq_tail - __atomic_load_n(ioqueue->sq_khead,
+                                           __ATOMIC_ACQUIRE) >=
+        ioqueue->sq_entries)
+    {
+        status = flush_sq(ioqueue);
+        if (status != PJ_SUCCESS) {
+            pj_mutex_unlock(ioqueue->sq_mutex);
+            return status;
+        }
+    }
+
+    sqe = &ioqueue->sqes[ioqueue->sq_tail & ioqueue->sq_mask];
+    prep_sqe(sqe, op);
+
+    __atomic_add_fetch(&key->inflight, 1, __ATOMIC_RELAXED);
+    op->submitted = PJ_TRUE;
+    op->discarded = PJ_FALSE;
+
+    ++ioqueue->sq_tail;
+    __atomic_store_n(ioqueue->sq_ktail, ioqueue->sq_tail, __ATOMIC_RELEASE);
+    ++ioqueue->sq_unsubmitted;
+
+    if (pj_thread_local_get(ioqueue->tls_id) == NULL)
+        status = flush_sq(ioqueue);
+
+    pj_mutex_unlock(ioqueue->sq_mutex);
+
+    /* If the kernel refuses the submission now, it will be retried with
+     * the next submission or poll, there is no way to take it back.
+     */
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(2,(THIS_FILE, status, "io_uring_enter() submit error"));
+        status = PJ_SUCCESS;
+    }
+
+    return status;
+}
+
+
+/*
+ * Operation records.
+ */
+
+/* Get an operation record for the key. The key must be locked. */
+static struct uring_op *alloc_op(pj_ioqueue_key_t *key)
+{
+    struct uring_op *op;
+
+    if (!pj_list_empty(&key->free_ops)) {
+        op = key->free_ops.next;
+        pj_list_erase(op);
+    } else {
+        pj_lock_acquire(key->ioqueue->lock);
+        op = PJ_POOL_ZALLOC_T(key->ioqueue->pool, struct uring_op);
+        pj_lock_release(key->ioqueue->lock);
+        if (!op)
+            return NULL;
+        op->owner_next = key->owned_ops;
+        key->owned_ops = op;
+    }
+
+    op->key = key;
+    op->submitted = op->discarded = PJ_FALSE;
+    op->done = 0;
+    op->status = PJ_SUCCESS;
+    return op;
+}
+
+/* Return the operation record to the key. The key must be locked. */
+static void free_op(pj_ioqueue_key_t *key, struct uring_op *op)
+{
+    op->op = PJ_IOQUEUE_OP_NONE;
+    op->op_key = NULL;
+    pj_list_push_back(&key->free_ops, op);
+}
+
+/* Queue the operation to the list, and submit it if it is the first one.
+ * The key must be locked.
+ */
+static pj_status_t queue_op(pj_ioqueue_key_t *key, struct uring_op *list,
+                            struct uring_op *op)
+{
+    pj_status_t status;
+
+    OP_REC(op->op_key) = op;
+    pj_list_push_back(list, op);
+    if (list->next != op)
+        return PJ_EPENDING;
+
+    status = submit_op(key, op);
+    if (status != PJ_SUCCESS) {
+        pj_list_erase(op);
+        OP_REC(op->op_key) = NULL;
+        free_op(key, op);
+        return status;
+    }
+
+    return PJ_EPENDING;
+}
+
+/* Submit the next queued operation of the list, after the previous one has
+ * completed. Operations which can't be submitted are moved to the failed
+ * list, to be completed with error by the caller. The key must be locked.
+ */
+static void submit_next(pj_ioqueue_key_t *key, struct uring_op *list,
+                        struct uring_op *failed)
+{
+    while (!pj_list_empty(list) && !list->next->submitted) {
+        struct uring_op *op = list->next;
+
+        op->status = submit_op(key, op);
+        if (op->status == PJ_SUCCESS)
+            break;
+
+        pj_list_erase(op);
+        OP_REC(op->op_key) = NULL;
+        pj_list_push_back(failed, op);
+    }
+}
+
+/* Complete the operations which could not be submitted. */
+static void complete_failed(pj_ioqueue_key_t *key, struct uring_op *failed)
+{
+    while (!pj_list_empty(failed)) {
+        struct uring_op *op = failed->next;
+        pj_ioqueue_op_key_t *op_key = op->op_key;
+        pj_ioqueue_operation_e type = op->op;
+        pj_status_t status = op->status;
+
+        pj_ioqueue_lock_key(key);
+        pj_list_erase(op);
+        free_op(key, op);
+        pj_ioqueue_unlock_key(key);
+
+        if (IS_CLOSING(key))
+            continue;
+
+        if (type == PJ_IOQUEUE_OP_ACCEPT) {
+            if (key->cb.on_accept_complete)
+                (*key->cb.on_accept_complete)(key, op_key, PJ_INVALID_SOCKET,
+                                              status);
+        } else if (type == PJ_IOQUEUE_OP_SEND ||
+                   type == PJ_IOQUEUE_OP_SEND_TO)
+        {
+            if (key->cb.on_write_complete)
+                (*key->cb.on_write_complete)(key, op_key, -status);
+        } else {
+            if (key->cb.on_read_complete)
+                (*key->cb.on_read_complete)(key, op_key, -status);
+        }
+    }
+}
+
+
+/*
+ * pj_ioqueue_register_sock()
+ *
+ * Register a socket to ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
+                                              pj_ioqueue_t *ioqueue,
+                                              pj_sock_t sock,
+                                              pj_grp_lock_t *grp_lock,
+                                              void *user_data,
+                                              const pj_ioqueue_callback *cb,
+                                              pj_ioqueue_key_t **p_key)
+{
+    pj_ioqueue_key_t *key = NULL;
+    struct uring_op *op;
+    pj_uint32_t value;
+    int optlen;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(pool && ioqueue && sock != PJ_INVALID_SOCKET &&
+                     cb && p_key, PJ_EINVAL);
+
+    pj_lock_acquire(ioqueue->lock);
+
+    if (ioqueue->count >= ioqueue->max) {
+        status = PJ_ETOOMANY;
+        TRACE_((THIS_FILE, "pj_ioqueue_register_sock error: too many files"));
+        goto on_return;
+    }
+
+    /* Set socket to nonblocking, for the immediate calls. */
+    value = 1;
+    if (ioctl(sock, FIONBIO, &value)) {
+        status = pj_get_netos_error();
+        goto on_return;
+    }
+
+    /* Scan closing_keys first to let them come back to free_list */
+    scan_closing_keys(ioqueue);
+
+    if (pj_list_empty(&ioqueue->free_list)) {
+        status = PJ_ETOOMANY;
+        goto on_return;
+    }
+
+    key = ioqueue->free_list.next;
+    pj_list_erase(key);
+
+    key->ioqueue = ioqueue;
+    key->fd = sock;
+    key->user_data = user_data;
+    pj_memcpy(&key->cb, cb, sizeof(pj_ioqueue_callback));
+    key->connecting = 0;
+    key->connect_op = NULL;
+    key->closing = 0;
+    key->ref_count = 0;
+    pj_list_init(&key->read_list);
+    pj_list_init(&key->write_list);
+    pj_list_init(&key->accept_list);
+
+    /* All completions of the previous user of the key have been reaped,
+     * so every record it owns is free again.
+     */
+    pj_list_init(&key->free_ops);
+    for (op = key->owned_ops; op; op = op->owner_next) {
+        op->op = PJ_IOQUEUE_OP_NONE;
+        pj_list_push_back(&key->free_ops, op);
+    }
+
+    pj_ioqueue_set_concurrency(key, ioqueue->cfg.default_concurrency);
+
+    /* Get socket type. Stream sends are resubmitted until completed. */
+    optlen = sizeof(key->fd_type);
+    if (pj_sock_getsockopt(sock, pj_SOL_SOCKET(), pj_SO_TYPE(),
+                           &key->fd_type, &optlen) != PJ_SUCCESS)
+    {
+        key->fd_type = pj_SOCK_STREAM();
+    }
+
+    /* Group lock */
+    key->grp_lock = grp_lock;
+    if (key->grp_lock) {
+        pj_grp_lock_add_ref_dbg(key->grp_lock, "ioqueue", 0);
+    }
+
+    pj_list_insert_before(&ioqueue->active_list, key);
+    ++ioqueue->count;
+
+on_return:
+    *p_key = (status == PJ_SUCCESS) ? key : NULL;
+    pj_lock_release(ioqueue->lock);
+
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_register_sock( pj_pool_t *pool,
+                                              pj_ioqueue_t *ioqueue,
+                                              pj_sock_t sock,
+                                              void *user_data,
+                                              const pj_ioqueue_callback *cb,
+                                              pj_ioqueue_key_t **p_key)
+{
+    return pj_ioqueue_register_sock2(pool, ioqueue, sock, NULL, user_data,
+                                     cb, p_key);
+}
+
+/*
+ * pj_ioqueue_unregister()
+ *
+ * Unregister handle from ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_unregister( pj_ioqueue_key_t *key)
+{
+    pj_ioqueue_t *ioqueue;
+    int err;
+
+    PJ_ASSERT_RETURN(key != NULL, PJ_EINVAL);
+
+    ioqueue = key->ioqueue;
+
+    /* Lock the key to make sure no callback is simultaneously modifying
+     * the key. We need to lock the key before ioqueue here to prevent
+     * deadlock.
+     */
+    pj_ioqueue_lock_key(key);
+
+    /* Best effort to avoid double key-unregistration */
+    if (IS_CLOSING(key)) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_SUCCESS;
+    }
+
+    /* Also lock ioqueue */
+    pj_lock_acquire(ioqueue->lock);
+
+    /* Avoid "negative" ioqueue count */
+    if (ioqueue->count > 0) {
+        --ioqueue->count;
+    } else {
+        /* If this happens, very likely there is double unregistration
+         * of a key.
+         */
+        pj_assert(!"Bad ioqueue count in key unregistration!");
+        PJ_LOG(1,(THIS_FILE, "Bad ioqueue count in key unregistration!"));
+    }
+
+    /* Mark key is closing, completions reaped from now on are discarded */
+    pj_mutex_lock(ioqueue->ref_cnt_mutex);
+    key->closing = 1;
+    pj_gettickcount(&key->free_time);
+    key->free_time.msec += PJ_IOQUEUE_KEY_FREE_DELAY;
+    pj_time_val_normalize(&key->free_time);
+    pj_list_erase(key);
+    pj_list_push_back(&ioqueue->closing_list, key);
+    pj_mutex_unlock(ioqueue->ref_cnt_mutex);
+
+    pj_lock_release(ioqueue->lock);
+
+    /* Make sure the operations are known to the kernel, then cancel them
+     * so that the application may release the buffers once we return.
+     */
+    lock_flush_sq(ioqueue);
+    err = sync_cancel(ioqueue, key->fd, NULL,
+                      IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL);
+    if (err != 0 && err != ENOENT) {
+        PJ_PERROR(2,(THIS_FILE, PJ_STATUS_FROM_OS(err),
+                     "Ignoring io_uring cancellation error"));
+    }
+
+    /* Destroy the key. */
+    pj_sock_close(key->fd);
+
+    if (key->grp_lock) {
+        /* just dec_ref and unlock. we will set grp_lock to NULL
+         * elsewhere */
+        pj_grp_lock_t *grp_lock = key->grp_lock;
+        // Don't set grp_lock to NULL otherwise the other thread
+        // will crash. Just leave it as dangling pointer, but this
+        // should be safe
+        //key->grp_lock = NULL;
+        pj_grp_lock_dec_ref_dbg(grp_lock, "ioqueue", 0);
+        pj_grp_lock_release(grp_lock);
+    } else {
+        pj_ioqueue_unlock_key(key);
+    }
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_get_user_data()
+ */
+PJ_DEF(void*) pj_ioqueue_get_user_data( pj_ioqueue_key_t *key )
+{
+    PJ_ASSERT_RETURN(key != NULL, NULL);
+    return key->user_data;
+}
+
+/*
+ * pj_ioqueue_set_user_data()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_user_data( pj_ioqueue_key_t *key,
+                                              void *user_data,
+                                              void **old_data)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+    if (old_data)
+        *old_data = key->user_data;
+    key->user_data = user_data;
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_concurrency(pj_ioqueue_key_t *key,
+                                               pj_bool_t allow)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+    key->allow_concurrent = allow;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_lock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+        return pj_grp_lock_acquire(key->grp_lock);
+    else
+        return pj_lock_acquire(key->lock);
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_trylock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+        return pj_grp_lock_tryacquire(key->grp_lock);
+    else
+        return pj_lock_tryacquire(key->lock);
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_unlock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+        return pj_grp_lock_release(key->grp_lock);
+    else
+        return pj_lock_release(key->lock);
+}
+
+
+/*
+ * Completion dispatching.
+ */
+
+/* Process a completion. Returns PJ_TRUE if a callback was called. */
+static pj_bool_t dispatch_event(pj_ioqueue_t *ioqueue,
+                                struct uring_op *op, int res)
+{
+    pj_ioqueue_key_t *key = op->key;
+    pj_ioqueue_op_key_t *op_key;
+    pj_ioqueue_operation_e type;
+    struct uring_op failed;
+    pj_ssize_t bytes = 0;
+    pj_sock_t new_sock = PJ_INVALID_SOCKET;
+    pj_status_t status = PJ_SUCCESS;
+    pj_bool_t has_lock;
+
+    /* Completions of an unregistered key are discarded. Otherwise hold a
+     * reference so that the key is not reused while it is being processed.
+     */
+    pj_mutex_lock(ioqueue->ref_cnt_mutex);
+    if (IS_CLOSING(key)) {
+        __atomic_sub_fetch(&key->inflight, 1, __ATOMIC_RELEASE);
+        pj_mutex_unlock(ioqueue->ref_cnt_mutex);
+        return PJ_FALSE;
+    }
+    ++key->ref_count;
+    __atomic_sub_fetch(&key->inflight, 1, __ATOMIC_RELEASE);
+    if (key->grp_lock)
+        pj_grp_lock_add_ref_dbg(key->grp_lock, "ioqueue", 0);
+    pj_mutex_unlock(ioqueue->ref_cnt_mutex);
+
+    pj_list_init(&failed);
+    pj_ioqueue_lock_key(key);
+
+    if (IS_CLOSING(key)) {
+        pj_ioqueue_unlock_key(key);
+        goto on_return;
+    }
+
+    op->submitted = PJ_FALSE;
+    if (op->discarded) {
+        /* The operation was completed by pj_ioqueue_post_completion() or
+         * pj_ioqueue_clear_key().
+         */
+        free_op(key, op);
+        pj_ioqueue_unlock_key(key);
+        goto on_return;
+    }
+
+    /* Spurious wakeup, do it again. */
+    if (res == -EAGAIN || res == -EINTR) {
+        status = submit_op(key, op);
+        if (status == PJ_SUCCESS) {
+            pj_ioqueue_unlock_key(key);
+            goto on_return;
+        }
+        res = -EAGAIN;
+    }
+
+    type = op->op;
+    op_key = op->op_key;
+
+    switch (type) {
+    case PJ_IOQUEUE_OP_RECV:
+    case PJ_IOQUEUE_OP_RECV_FROM:
+        if (res >= 0) {
+            bytes = res;
+            if (type == PJ_IOQUEUE_OP_RECV_FROM && op->rmt_addrlen)
+                *op->rmt_addrlen = op->msg.msg_namelen;
+        } else {
+            bytes = -PJ_STATUS_FROM_OS(-res);
+        }
+        break;
+
+    case PJ_IOQUEUE_OP_RECV_MMSG:
+        if (res >= 0) {
+            unsigned cnt = (unsigned)op->size;
+
+            status = pj_sock_recvmmsg(key->fd, (pj_sock_mmsg*)op->buf, &cnt,
+                                      op->flags);
+            if (status == PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL) &&
+                submit_op(key, op) == PJ_SUCCESS)
+            {
+                pj_ioqueue_unlock_key(key);
+                goto on_return;
+            }
+            bytes = (status == PJ_SUCCESS) ? (pj_ssize_t)cnt : -status;
+        } else {
+            bytes = -PJ_STATUS_FROM_OS(-res);
+        }
+        break;
+
+    case PJ_IOQUEUE_OP_SEND:
+    case PJ_IOQUEUE_OP_SEND_TO:
+        if (res >= 0) {
+            op->done += res;
+            if (op->done < op->size && res > 0 &&
+                key->fd_type == pj_SOCK_STREAM() &&
+                submit_op(key, op) == PJ_SUCCESS)
+            {
+                /* Send the remaining data */
+                pj_ioqueue_unlock_key(key);
+                goto on_return;
+            }
+            bytes = op->done;
+        } else {
+            bytes = -PJ_STATUS_FROM_OS(-res);
+        }
+        break;
+
+#if PJ_HAS_TCP
+    case PJ_IOQUEUE_OP_ACCEPT:
+        if (res >= 0) {
+            new_sock = res;
+            if (op->rmt_addr && op->rmt_addrlen) {
+                int len = PJ_MIN(*op->rmt_addrlen, (int)op->addrlen);
+                pj_memcpy(op->rmt_addr, &op->addr, len);
+                *op->rmt_addrlen = op->addrlen;
+            }
+            if (op->local_addr && op->rmt_addrlen) {
+                status = pj_sock_getsockname(new_sock, op->local_addr,
+                                             op->rmt_addrlen);
+                if (status != PJ_SUCCESS) {
+                    pj_sock_close(new_sock);
+                    new_sock = PJ_INVALID_SOCKET;
+                }
+            }
+        } else {
+            status = PJ_STATUS_FROM_OS(-res);
+        }
+        if (op->accept_fd)
+            *op->accept_fd = new_sock;
+        break;
+
+    case PJ_IOQUEUE_OP_CONNECT:
+        if (res >= 0) {
+            int value;
+            int vallen = sizeof(value);
+
+            status = pj_sock_getsockopt(key->fd, SOL_SOCKET, SO_ERROR,
+                                        &value, &vallen);
+            if (status == PJ_SUCCESS && value != 0)
+                status = PJ_STATUS_FROM_OS(value);
+        } else {
+            status = PJ_STATUS_FROM_OS(-res);
+        }
+        break;
+#endif
+
+    default:
+        pj_assert(!"Invalid operation");
+        pj_ioqueue_unlock_key(key);
+        goto on_return;
+    }
+
+    /* Done with the operation, start the next one. */
+    if (type == PJ_IOQUEUE_OP_CONNECT) {
+        key->connecting = 0;
+        key->connect_op = NULL;
+        free_op(key, op);
+    } else {
+        struct uring_op *list;
+
+        if (type == PJ_IOQUEUE_OP_ACCEPT)
+            list = &key->accept_list;
+        else if (type == PJ_IOQUEUE_OP_SEND || type == PJ_IOQUEUE_OP_SEND_TO)
+            list = &key->write_list;
+        else
+            list = &key->read_list;
+
+        pj_list_erase(op);
+        OP_REC(op_key) = NULL;
+        free_op(key, op);
+        submit_next(key, list, &failed);
+    }
+
+    /* Unlock; from this point we don't need to hold key's mutex
+     * (unless concurrency is disabled, which in this case we should
+     * hold the mutex while calling the callback) */
+    has_lock = !key->allow_concurrent;
+    if (!has_lock)
+        pj_ioqueue_unlock_key(key);
+
+    switch (type) {
+#if PJ_HAS_TCP
+    case PJ_IOQUEUE_OP_ACCEPT:
+        if (key->cb.on_accept_complete && !IS_CLOSING(key))
+            (*key->cb.on_accept_complete)(key, op_key, new_sock, status);
+        break;
+    case PJ_IOQUEUE_OP_CONNECT:
+        if (key->cb.on_connect_complete && !IS_CLOSING(key))
+            (*key->cb.on_connect_complete)(key, status);
+        break;
+#endif
+    case PJ_IOQUEUE_OP_SEND:
+    case PJ_IOQUEUE_OP_SEND_TO:
+        if (key->cb.on_write_complete && !IS_CLOSING(key))
+            (*key->cb.on_write_complete)(key, op_key, bytes);
+        break;
+    default:
+        if (key->cb.on_read_complete && !IS_CLOSING(key))
+            (*key->cb.on_read_complete)(key, op_key, bytes);
+        break;
+    }
+
+    if (has_lock)
+        pj_ioqueue_unlock_key(key);
+
+    complete_failed(key, &failed);
+
+    pj_mutex_lock(ioqueue->ref_cnt_mutex);
+    --key->ref_count;
+    pj_mutex_unlock(ioqueue->ref_cnt_mutex);
+    if (key->grp_lock)
+        pj_grp_lock_dec_ref_dbg(key->grp_lock, "ioqueue", 0);
+
+    return PJ_TRUE;
+
+on_return:
+    pj_mutex_lock(ioqueue->ref_cnt_mutex);
+    --key->ref_count;
+    pj_mutex_unlock(ioqueue->ref_cnt_mutex);
+    if (key->grp_lock)
+        pj_grp_lock_dec_ref_dbg(key->grp_lock, "ioqueue", 0);
+
+    return PJ_FALSE;
+}
+
+/* Take the available completions off the completion queue. */
+static unsigned reap_events(pj_ioqueue_t *ioqueue, struct uring_event ev[],
+                            unsigned max_cnt)
+{
+    unsigned head, tail, cnt = 0;
+
+    pj_mutex_lock(ioqueue->cq_mutex);
+    head = *ioqueue->cq_khead;
+    tail = __atomic_load_n(ioqueue->cq_ktail, __ATOMIC_ACQUIRE);
+    while (head != tail && cnt < max_cnt) {
+        struct io_uring_cqe *cqe = &ioqueue->cqes[head & ioqueue->cq_mask];
+
+        ev[cnt].op = (struct uring_op*)(pj_size_t)cqe->user_data;
+        ev[cnt].res = cqe->res;
+        ++cnt;
+        ++head;
+    }
+    __atomic_store_n(ioqueue->cq_khead, head, __ATOMIC_RELEASE);
+    pj_mutex_unlock(ioqueue->cq_mutex);
+
+    return cnt;
+}
+
+/*
+ * pj_ioqueue_poll()
+ *
+ */
+PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
+{
+    enum { MAX_EVENTS = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL };
+    struct uring_event events[MAX_EVENTS];
+    unsigned i, count, processed_cnt = 0;
+
+    PJ_CHECK_STACK();
+
+    count = reap_events(ioqueue, events, MAX_EVENTS);
+    if (count == 0) {
+        struct io_uring_getevents_arg arg;
+        struct __kernel_timespec ts;
+        unsigned flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        int msec, rc;
+
+        msec = timeout ? PJ_TIME_VAL_MSEC(*timeout) : 9000;
+        ts.tv_sec = msec / 1000;
+        ts.tv_nsec = (msec % 1000) * 1000000L;
+
+        pj_bzero(&arg, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = (__u64)(pj_size_t)&ts;
+
+        /* Submit what is still queued, then wait for a completion. The
+         * kernel flushes overflowed completions in io_uring_enter() too.
+         */
+        lock_flush_sq(ioqueue);
+
+        TRACE_((THIS_FILE, "start io_uring_enter, msec=%d", msec));
+        rc = sys_io_uring_enter(ioqueue->ring_fd, 0, msec ? 1 : 0, flags,
+                                &arg, sizeof(arg));
+        if (rc < 0 && errno != ETIME && errno != EINTR && errno != EAGAIN &&
+            errno != EBUSY)
+        {
+            TRACE_((THIS_FILE, "  io_uring_enter error"));
+            return -pj_get_netos_error();
+        }
+
+        count = reap_events(ioqueue, events, MAX_EVENTS);
+        if (count == 0) {
+            /* Check the closing keys only when there's no activity and
+             * when there are pending closing keys.
+             */
+            if (!pj_list_empty(&ioqueue->closing_list)) {
+                pj_lock_acquire(ioqueue->lock);
+                scan_closing_keys(ioqueue);
+                pj_lock_release(ioqueue->lock);
+            }
+            TRACE_((THIS_FILE, "  io_uring_enter timed out"));
+            return 0;
+        }
+    }
+
+    /* Operations posted by the callbacks are submitted together below. */
+    pj_thread_local_set(ioqueue->tls_id, ioqueue);
+
+    for (i=0; i<count; ++i) {
+        if (dispatch_event(ioqueue, events[i].op, events[i].res))
+            ++processed_cnt;
+    }
+
+    pj_thread_local_set(ioqueue->tls_id, NULL);
+    lock_flush_sq(ioqueue);
+
+    TRACE_((THIS_FILE, "     poll: count=%d processed=%d",
+                       count, processed_cnt));
+
+    return processed_cnt;
+}
+
+
+/*
+ * Operations.
+ */
+
+/* Queue a read operation. */
+static pj_status_t queue_read(pj_ioqueue_key_t *key,
+                              pj_ioqueue_op_key_t *op_key,
+                              pj_ioqueue_operation_e type,
+                              void *buffer, pj_ssize_t size,
+                              pj_uint32_t flags,
+                              pj_sockaddr_t *addr, int *addrlen)
+{
+    struct uring_op *op;
+    pj_status_t status;
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app. See #913
+     */
+    if (IS_CLOSING(key)) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_ECANCELLED;
+    }
+
+    op = alloc_op(key);
+    if (!op) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_ENOMEM;
+    }
+    op->op = type;
+    op->op_key = op_key;
+    op->buf = (char*)buffer;
+    op->size = size;
+    op->flags = flags;
+    op->rmt_addr = addr;
+    op->rmt_addrlen = addrlen;
+
+    status = queue_op(key, &key->read_list, op);
+    pj_ioqueue_unlock_key(key);
+
+    return status;
+}
+
+/*
+ * pj_ioqueue_recv()
+ *
+ * Start asynchronous recv() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recv(  pj_ioqueue_key_t *key,
+                                      pj_ioqueue_op_key_t *op_key,
+                                      void *buffer,
+                                      pj_ssize_t *length,
+                                      unsigned flags )
+{
+    PJ_ASSERT_RETURN(key && op_key && buffer && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    PJ_ASSERT_RETURN(OP_REC(op_key) == NULL, PJ_EPENDING);
+
+    /* Try to see if there's data immediately available.
+     */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0 &&
+        pj_list_empty(&key->read_list))
+    {
+        pj_status_t status;
+        pj_ssize_t size;
+
+        size = *length;
+        status = pj_sock_recv(key->fd, buffer, &size, flags);
+        if (status == PJ_SUCCESS) {
+            /* Yes! Data is available! */
+            *length = size;
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))
+                return status;
+        }
+    }
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    return queue_read(key, op_key, PJ_IOQUEUE_OP_RECV, buffer, *length,
+                      flags, NULL, NULL);
+}
+
+/*
+ * pj_ioqueue_recvfrom()
+ *
+ * Start asynchronous recvfrom() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvfrom( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+                                         void *buffer,
+                                         pj_ssize_t *length,
+                                         unsigned flags,
+                                         pj_sockaddr_t *addr,
+                                         int *addrlen)
+{
+    PJ_ASSERT_RETURN(key && op_key && buffer && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    PJ_ASSERT_RETURN(OP_REC(op_key) == NULL, PJ_EPENDING);
+
+    /* Try to see if there's data immediately available.
+     */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0 &&
+        pj_list_empty(&key->read_list))
+    {
+        pj_status_t status;
+        pj_ssize_t size;
+
+        size = *length;
+        status = pj_sock_recvfrom(key->fd, buffer, &size, flags,
+                                  addr, addrlen);
+        if (status == PJ_SUCCESS) {
+            /* Yes! Data is available! */
+            *length = size;
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))
+                return status;
+        }
+    }
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    return queue_read(key, op_key, PJ_IOQUEUE_OP_RECV_FROM, buffer, *length,
+                      flags, addr, addrlen);
+}
+
+/*
+ * pj_ioqueue_recvmmsg()
+ *
+ * Start asynchronous recvmmsg() from the socket. There is no io_uring
+ * operation for it, so the socket is polled for readability and the
+ * datagrams are received on completion.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvmmsg( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+                                         pj_sock_mmsg *msg,
+                                         unsigned *count,
+                                         pj_uint32_t flags)
+{
+    PJ_ASSERT_RETURN(key && op_key && msg && count && *count, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    PJ_ASSERT_RETURN(OP_REC(op_key) == NULL, PJ_EPENDING);
+
+    /* Try to see if there's data immediately available.
+     */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0 &&
+        pj_list_empty(&key->read_list))
+    {
+        pj_status_t status;
+        unsigned cnt = *count;
+
+        status = pj_sock_recvmmsg(key->fd, msg, &cnt, flags);
+        if (status == PJ_SUCCESS) {
+            /* Yes! Data is available! */
+            *count = cnt;
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))
+                return status;
+        }
+    }
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    return queue_read(key, op_key, PJ_IOQUEUE_OP_RECV_MMSG, msg, *count,
+                      flags, NULL, NULL);
+}
+
+/* Queue a write operation. */
+static pj_status_t queue_write(pj_ioqueue_key_t *key,
+                               pj_ioqueue_op_key_t *op_key,
+                               pj_ioqueue_operation_e type,
+                               const void *data, pj_ssize_t size,
+                               unsigned flags,
+                               const pj_sockaddr_t *addr, int addrlen)
+{
+    struct uring_op *op;
+    unsigned retry;
+    pj_status_t status;
+
+    /* Spin if op_key has pending operation */
+    for (retry=0; OP_REC(op_key) != NULL && retry<PENDING_RETRY; ++retry)
+        pj_thread_sleep(0);
+
+    /* Last chance */
+    if (OP_REC(op_key)) {
+        /* Unable to send packet because there is already pending write on
+         * the op_key. Aplication should specify multiple write operation
+         * keys on situation like this.
+         */
+        return PJ_EBUSY;
+    }
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app. See #913
+     */
+    if (IS_CLOSING(key)) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_ECANCELLED;
+    }
+
+    op = alloc_op(key);
+    if (!op) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_ENOMEM;
+    }
+    op->op = type;
+    op->op_key = op_key;
+    op->buf = (char*)data;
+    op->size = size;
+    op->flags = flags;
+    if (addr) {
+        pj_memcpy(&op->addr, addr, addrlen);
+        op->addrlen = addrlen;
+    }
+
+    status = queue_op(key, &key->write_list, op);
+    pj_ioqueue_unlock_key(key);
+
+    return status;
+}
+
+/*
+ * pj_ioqueue_send()
+ *
+ * Start asynchronous send() to the descriptor.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_send( pj_ioqueue_key_t *key,
+                                     pj_ioqueue_op_key_t *op_key,
+                                     const void *data,
+                                     pj_ssize_t *length,
+                                     unsigned flags)
+{
+    pj_status_t status;
+    pj_ssize_t sent;
+
+    PJ_ASSERT_RETURN(key && op_key && data && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    /* We can not use PJ_IOQUEUE_ALWAYS_ASYNC for socket write. */
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Fast track:
+     *   Try to send data immediately, only if there's no pending write!
+     */
+    if (pj_list_empty(&key->write_list)) {
+        sent = *length;
+        status = pj_sock_send(key->fd, data, &sent, flags);
+        if (status == PJ_SUCCESS) {
+            /* Success! */
+            *length = sent;
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+                return status;
+            }
+        }
+    }
+
+    return queue_write(key, op_key, PJ_IOQUEUE_OP_SEND, data, *length,
+                       flags, NULL, 0);
+}
+
+/*
+ * pj_ioqueue_sendto()
+ *
+ * Start asynchronous write() to the descriptor.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
+                                       pj_ioqueue_op_key_t *op_key,
+                                       const void *data,
+                                       pj_ssize_t *length,
+                                       pj_uint32_t flags,
+                                       const pj_sockaddr_t *addr,
+                                       int addrlen)
+{
+    pj_status_t status;
+    pj_ssize_t sent;
+
+    PJ_ASSERT_RETURN(key && op_key && data && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    /* We can not use PJ_IOQUEUE_ALWAYS_ASYNC for socket write */
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Fast track:
+     *   Try to send data immediately, only if there's no pending write!
+     */
+    if (pj_list_empty(&key->write_list)) {
+        sent = *length;
+        status = pj_sock_sendto(key->fd, data, &sent, flags, addr, addrlen);
+        if (status == PJ_SUCCESS) {
+            /* Success! */
+            *length = sent;
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+                return status;
+            }
+        }
+    }
+
+    PJ_ASSERT_RETURN(addrlen <= (int)sizeof(pj_sockaddr), PJ_EBUG);
+
+    return queue_write(key, op_key, PJ_IOQUEUE_OP_SEND_TO, data, *length,
+                       flags, addr, addrlen);
+}
+
+#if PJ_HAS_TCP
+/*
+ * Initiate overlapped accept() operation.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_accept( pj_ioqueue_key_t *key,
+                                       pj_ioqueue_op_key_t *op_key,
+                                       pj_sock_t *new_sock,
+                                       pj_sockaddr_t *local,
+                                       pj_sockaddr_t *remote,
+                                       int *addrlen)
+{
+    struct uring_op *op;
+    pj_status_t status;
+
+    /* check parameters. All must be specified! */
+    PJ_ASSERT_RETURN(key && op_key && new_sock, PJ_EINVAL);
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    PJ_ASSERT_RETURN(OP_REC(op_key) == NULL, PJ_EPENDING);
+
+    /* Fast track:
+     *  See if there's new connection available immediately.
+     */
+    if (pj_list_empty(&key->accept_list)) {
+        status = pj_sock_accept(key->fd, new_sock, remote, addrlen);
+        if (status == PJ_SUCCESS) {
+            /* Yes! New connection is available! */
+            if (local && addrlen) {
+                status = pj_sock_getsockname(*new_sock, local, addrlen);
+                if (status != PJ_SUCCESS) {
+                    pj_sock_close(*new_sock);
+                    *new_sock = PJ_INVALID_SOCKET;
+                    return status;
+                }
+            }
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+                return status;
+            }
+        }
+    }
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app. See #913
+     */
+    if (IS_CLOSING(key)) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_ECANCELLED;
+    }
+
+    op = alloc_op(key);
+    if (!op) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_ENOMEM;
+    }
+    op->op = PJ_IOQUEUE_OP_ACCEPT;
+    op->op_key = op_key;
+    op->accept_fd = new_sock;
+    op->rmt_addr = remote;
+    op->rmt_addrlen = addrlen;
+    op->local_addr = local;
+
+    status = queue_op(key, &key->accept_list, op);
+    pj_ioqueue_unlock_key(key);
+
+    return status;
+}
+
+/*
+ * Initiate overlapped connect() operation (well, it's non-blocking actually,
+ * since there's no overlapped version of connect()).
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_connect( pj_ioqueue_key_t *key,
+                                        const pj_sockaddr_t *addr,
+                                        int addrlen )
+{
+    struct uring_op *op;
+    pj_status_t status;
+
+    /* check parameters. All must be specified! */
+    PJ_ASSERT_RETURN(key && addr && addrlen, PJ_EINVAL);
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+        return PJ_ECANCELLED;
+
+    /* Check if socket has not been marked for connecting */
+    if (key->connecting != 0)
+        return PJ_EPENDING;
+
+    status = pj_sock_connect(key->fd, addr, addrlen);
+    if (status == PJ_SUCCESS) {
+        /* Connected! */
+        return PJ_SUCCESS;
+    } else if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_CONNECT_ERROR_VAL)) {
+        /* Error! */
+        return status;
+    }
+
+    /* Pending! Wait until the socket becomes writable. */
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous
+     * check in multithreaded app. See #913
+     */
+    if (IS_CLOSING(key)) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_ECANCELLED;
+    }
+
+    op = alloc_op(key);
+    if (!op) {
+        pj_ioqueue_unlock_key(key);
+        return PJ_ENOMEM;
+    }
+    op->op = PJ_IOQUEUE_OP_CONNECT;
+
+    status = submit_op(key, op);
+    if (status != PJ_SUCCESS) {
+        free_op(key, op);
+        pj_ioqueue_unlock_key(key);
+        return status;
+    }
+    key->connecting = PJ_TRUE;
+    key->connect_op = op;
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_EPENDING;
+}
+#endif  /* PJ_HAS_TCP */
+
+
+PJ_DEF(void) pj_ioqueue_op_key_init( pj_ioqueue_op_key_t *op_key,
+                                     pj_size_t size )
+{
+    pj_bzero(op_key, size);
+}
+
+
+/*
+ * pj_ioqueue_is_pending()
+ */
+PJ_DEF(pj_bool_t) pj_ioqueue_is_pending( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key )
+{
+    PJ_UNUSED_ARG(key);
+    return OP_REC(op_key) != NULL;
+}
+
+
+/* Take the operation out of the key. If it has been submitted, the kernel
+ * request is cancelled and its completion will be discarded. The key must
+ * be locked.
+ */
+static void cancel_op(pj_ioqueue_key_t *key, struct uring_op *op)
+{
+    if (op->submitted) {
+        sync_cancel(key->ioqueue, -1, op, 0);
+        op->discarded = PJ_TRUE;
+    } else {
+        free_op(key, op);
+    }
+}
+
+/*
+ * pj_ioqueue_post_completion()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_post_completion( pj_ioqueue_key_t *key,
+                                                pj_ioqueue_op_key_t *op_key,
+                                                pj_ssize_t bytes_status )
+{
+    struct uring_op *op, *list, failed;
+    pj_ioqueue_operation_e type;
+
+    PJ_ASSERT_RETURN(key && op_key, PJ_EINVAL);
+
+    pj_list_init(&failed);
+    pj_ioqueue_lock_key(key);
+
+    /* Find the operation in the pending lists to really make sure that
+     * it's still there; then call the callback.
+     */
+    op = OP_REC(op_key);
+    if (op == NULL || op->key != key || op->op_key != op_key ||
+        op->op == PJ_IOQUEUE_OP_NONE || op->op == PJ_IOQUEUE_OP_CONNECT)
+    {
+        /* Clear connecting operation. */
+        if (key->connecting) {
+            key->connecting = 0;
+            if (key->connect_op) {
+                lock_flush_sq(key->ioqueue);
+                cancel_op(key, key->connect_op);
+                key->connect_op = NULL;
+            }
+        }
+        pj_ioqueue_unlock_key(key);
+        return PJ_EINVALIDOP;
+    }
+
+    type = op->op;
+    if (type == PJ_IOQUEUE_OP_ACCEPT)
+        list = &key->accept_list;
+    else if (type == PJ_IOQUEUE_OP_SEND || type == PJ_IOQUEUE_OP_SEND_TO)
+        list = &key->write_list;
+    else
+        list = &key->read_list;
+
+    lock_flush_sq(key->ioqueue);
+    pj_list_erase(op);
+    OP_REC(op_key) = NULL;
+    cancel_op(key, op);
+    submit_next(key, list, &failed);
+
+    pj_ioqueue_unlock_key(key);
+
+    if (type == PJ_IOQUEUE_OP_ACCEPT) {
+        if (key->cb.on_accept_complete) {
+            (*key->cb.on_accept_complete)(key, op_key, PJ_INVALID_SOCKET,
+                                          (pj_status_t)bytes_status);
+        }
+    } else if (list == &key->write_list) {
+        if (key->cb.on_write_complete)
+            (*key->cb.on_write_complete)(key, op_key, bytes_status);
+    } else {
+        if (key->cb.on_read_complete)
+            (*key->cb.on_read_complete)(key, op_key, bytes_status);
+    }
+
+    complete_failed(key, &failed);
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_clear_key()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_clear_key( pj_ioqueue_key_t *key )
+{
+    struct uring_op *lists[3];
+    unsigned i;
+
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+    pj_ioqueue_lock_key(key);
+
+    /* Cancel whatever the kernel is still doing for the key */
+    lock_flush_sq(key->ioqueue);
+    sync_cancel(key->ioqueue, key->fd, NULL,
+                IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL);
+
+    /* Reset pending lists */
+    lists[0] = &key->read_list;
+    lists[1] = &key->write_list;
+    lists[2] = &key->accept_list;
+    for (i=0; i<PJ_ARRAY_SIZE(lists); ++i) {
+        while (!pj_list_empty(lists[i])) {
+            struct uring_op *op = lists[i]->next;
+
+            pj_list_erase(op);
+            OP_REC(op->op_key) = NULL;
+            if (op->submitted)
+                op->discarded = PJ_TRUE;
+            else
+                free_op(key, op);
+        }
+    }
+
+    if (key->connect_op) {
+        key->connect_op->discarded = PJ_TRUE;
+        key->connect_op = NULL;
+    }
+    key->connecting = 0;
+
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_oshandle_t) pj_ioqueue_get_os_handle( pj_ioqueue_t *ioqueue )
+{
+    return ioqueue ? (pj_oshandle_t)&ioqueue->ring_fd : NULL;
+}
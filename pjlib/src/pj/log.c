@@ -20,8 +20,19 @@
 #include <pj/log.h>
 #include <pj/string.h>
 #include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/errno.h>
+#include <pj/assert.h>
 #include <pj/compat/stdarg.h>
 
+/* Asynchronous logging needs threads and atomic intrinsics. */
+#if PJ_LOG_MAX_LEVEL >= 1 && PJ_HAS_THREADS && \
+    (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#   define LOG_HAS_ASYNC        1
+#else
+#   define LOG_HAS_ASYNC        0
+#endif
+
 #if PJ_LOG_MAX_LEVEL >= 1
 
 #if 0
@@ -83,9 +94,16 @@ static char log_buffer[PJ_LOG_MAX_SIZE];
 
 #define LOG_MAX_INDENT          80
 
+#if LOG_HAS_ASYNC
+static void log_async_shutdown(void);
+#endif
+
 #if PJ_HAS_THREADS
 static void logging_shutdown(void)
 {
+#  if LOG_HAS_ASYNC
+    log_async_shutdown();
+#  endif
     if (thread_suspended_tls_id != -1) {
         pj_thread_local_free(thread_suspended_tls_id);
         thread_suspended_tls_id = -1;
@@ -335,6 +353,438 @@ static pj_bool_t is_logging_suspended(void)
     }
 }
 
+#if LOG_HAS_ASYNC
+/*
+ * Asynchronous logging.
+ *
+ * Each thread which logs while asynchronous logging is running is given
+ * a slot with a single-producer/single-consumer byte ring. The thread
+ * appends records (header and formatted message) to its ring, and the log
+ * thread consumes them, always taking the oldest record across all rings
+ * so the output stays in logging order. Only the head (written by the
+ * producer) and tail (written by the consumer) counters are shared, so
+ * no lock is needed. Slots are claimed with an atomic increment and the
+ * slot index is kept in thread local storage, tagged with a generation
+ * number which changes every time asynchronous logging is stopped.
+ *
+ * To let pj_log_async_stop() release the rings safely, a producer marks
+ * its slot busy and then checks that logging is still running in the
+ * same generation. The stopper clears the running flag and then waits
+ * until no slot is busy.
+ */
+#if PJ_LOG_ASYNC_MAX_THREADS > 255
+#   error "PJ_LOG_ASYNC_MAX_THREADS must not exceed 255"
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#   define LOG_FENCE_ACQ()      __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#   define LOG_FENCE_REL()      __atomic_thread_fence(__ATOMIC_RELEASE)
+#   define LOG_FENCE_FULL()     __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#   define LOG_ATOMIC_INC(p)    __atomic_add_fetch(p, 1, __ATOMIC_SEQ_CST)
+#else
+#   include <intrin.h>
+#   if defined(_M_ARM) || defined(_M_ARM64)
+#       define LOG_FENCE_ACQ()  __dmb(0xB)
+#       define LOG_FENCE_REL()  __dmb(0xB)
+#       define LOG_FENCE_FULL() __dmb(0xB)
+#   else
+#       define LOG_FENCE_ACQ()  _ReadWriteBarrier()
+#       define LOG_FENCE_REL()  _ReadWriteBarrier()
+#       define LOG_FENCE_FULL() _mm_mfence()
+#   endif
+#   define LOG_ATOMIC_INC(p)    _InterlockedIncrement(p)
+#endif
+
+/* Record header. Records are 16 bytes aligned and never wrap around the
+ * end of the ring; a padding record fills the rest of the ring instead.
+ */
+typedef struct log_rec
+{
+    pj_timestamp    ts;         /* Queueing time, to merge the rings    */
+    pj_uint32_t     len;        /* Message length incl. NULL, or REC_PAD */
+    pj_int32_t      level;
+} log_rec;
+
+#define REC_PAD         ((pj_uint32_t)0xFFFFFFFF)
+#define REC_SIZE(len)   ((pj_uint32_t)((sizeof(log_rec) + (len) + 15) & ~15))
+
+typedef struct log_slot
+{
+    /* Written by the producer */
+    volatile pj_uint32_t     head;
+    volatile pj_uint32_t     busy;
+    volatile pj_uint32_t     dropped;
+    char * volatile          buf;
+    pj_pool_t               *pool;
+
+    /* Written by the log thread, in its own cache line */
+    char                     pad[64];
+    volatile pj_uint32_t     tail;
+} log_slot;
+
+static struct log_async
+{
+    long                     tls_id;
+    volatile long            claimed;   /* Number of claimed slots      */
+    volatile int             running;
+    volatile pj_uint32_t     gen;
+    volatile pj_bool_t       quit;
+    pj_pool_factory         *pf;
+    pj_pool_t               *pool;
+    pj_thread_t             *thread;
+    pj_log_async_param       param;
+    pj_uint32_t              ring_size; /* Power of two                 */
+    pj_uint32_t              reported_drops;
+    log_slot                 slots[PJ_LOG_ASYNC_MAX_THREADS];
+} log_async = { -1 };
+
+#define LOG_ASYNC_SENDER        "log_async"
+
+static unsigned log_async_slot_count(void)
+{
+    unsigned cnt = (unsigned)log_async.claimed;
+    return cnt > PJ_LOG_ASYNC_MAX_THREADS ? PJ_LOG_ASYNC_MAX_THREADS : cnt;
+}
+
+/* Get the slot of the calling thread, claiming one on first use. Returns
+ * NULL if the thread can not have a slot.
+ */
+static log_slot *log_async_get_slot(pj_uint32_t *gen)
+{
+    pj_size_t tag, v;
+    unsigned idx;
+
+    *gen = log_async.gen;
+    tag = (*gen & 0xFFFFFF);
+
+    v = (pj_size_t)pj_thread_local_get(log_async.tls_id);
+    if (v == 0 || (v >> 8) != tag) {
+        idx = (unsigned)LOG_ATOMIC_INC(&log_async.claimed);
+        if (idx > PJ_LOG_ASYNC_MAX_THREADS)
+            idx = 0;
+        v = (tag << 8) | idx;
+        pj_thread_local_set(log_async.tls_id, (void*)v);
+    }
+
+    idx = (unsigned)(v & 0xFF);
+    return idx ? &log_async.slots[idx-1] : NULL;
+}
+
+/* Queue a formatted message. Returns PJ_FALSE if the message must be
+ * written synchronously instead.
+ */
+static pj_bool_t log_async_put(int level, const char *msg, int len)
+{
+    pj_uint32_t size = log_async.ring_size;
+    pj_uint32_t gen, need, head, gap;
+    log_slot *slot;
+    log_rec *rec;
+
+    if (!pj_thread_is_registered() || pj_thread_this() == log_async.thread)
+        return PJ_FALSE;
+
+    slot = log_async_get_slot(&gen);
+    if (!slot)
+        return PJ_FALSE;
+
+    slot->busy = 1;
+    LOG_FENCE_FULL();
+    if (!log_async.running || log_async.gen != gen) {
+        slot->busy = 0;
+        return PJ_FALSE;
+    }
+
+    /* Allocate the ring on first use */
+    if (!slot->buf) {
+        pj_pool_t *pool;
+        char *buf;
+
+        pool = pj_pool_create(log_async.pf, "logring", size + 512, 512,
+                              NULL);
+        if (!pool) {
+            slot->busy = 0;
+            return PJ_FALSE;
+        }
+        buf = (char*) pj_pool_alloc(pool, size);
+        slot->pool = pool;
+        slot->head = slot->tail = slot->dropped = 0;
+        LOG_FENCE_REL();
+        slot->buf = buf;
+    }
+
+    need = REC_SIZE(len + 1);
+    for (;;) {
+        head = slot->head;
+        gap = size - (head & (size-1));
+        if (gap >= need)
+            gap = 0;
+        if (head + gap + need - slot->tail <= size)
+            break;
+
+        if (log_async.param.policy == PJ_LOG_ASYNC_DROP &&
+            level >= log_async.param.drop_level)
+        {
+            ++slot->dropped;
+            LOG_FENCE_REL();
+            slot->busy = 0;
+            return PJ_TRUE;
+        }
+        pj_thread_sleep(1);
+    }
+    LOG_FENCE_ACQ();
+
+    if (gap) {
+        rec = (log_rec*)(slot->buf + (head & (size-1)));
+        rec->len = REC_PAD;
+        head += gap;
+    }
+
+    rec = (log_rec*)(slot->buf + (head & (size-1)));
+    pj_get_timestamp(&rec->ts);
+    rec->len = (pj_uint32_t)len + 1;
+    rec->level = level;
+    pj_memcpy(rec + 1, msg, len + 1);
+
+    LOG_FENCE_REL();
+    slot->head = head + need;
+    LOG_FENCE_REL();
+    slot->busy = 0;
+
+    return PJ_TRUE;
+}
+
+/* Write all records queued so far. Returns the number of records. */
+static unsigned log_async_drain(void)
+{
+    pj_uint32_t heads[PJ_LOG_ASYNC_MAX_THREADS];
+    pj_uint32_t size = log_async.ring_size;
+    pj_uint32_t dropped = 0;
+    unsigned i, cnt, written = 0;
+
+    cnt = log_async_slot_count();
+    for (i=0; i<cnt; ++i) {
+        log_slot *slot = &log_async.slots[i];
+        heads[i] = slot->buf ? slot->head : slot->tail;
+        dropped += slot->dropped;
+    }
+    LOG_FENCE_ACQ();
+
+    for (;;) {
+        log_slot *best = NULL;
+        log_rec *best_rec = NULL;
+
+        /* Take the oldest record across all rings */
+        for (i=0; i<cnt; ++i) {
+            log_slot *slot = &log_async.slots[i];
+            log_rec *rec;
+
+            if (slot->tail == heads[i])
+                continue;
+
+            rec = (log_rec*)(slot->buf + (slot->tail & (size-1)));
+            if (rec->len == REC_PAD) {
+                LOG_FENCE_REL();
+                slot->tail += size - (slot->tail & (size-1));
+                if (slot->tail == heads[i])
+                    continue;
+                rec = (log_rec*)slot->buf;
+            }
+
+            if (!best_rec || pj_cmp_timestamp(&rec->ts, &best_rec->ts) < 0) {
+                best = slot;
+                best_rec = rec;
+            }
+        }
+
+        if (!best)
+            break;
+
+        if (log_writer) {
+            (*log_writer)(best_rec->level, (const char*)(best_rec + 1),
+                          (int)best_rec->len - 1);
+        }
+
+        LOG_FENCE_REL();
+        best->tail += REC_SIZE(best_rec->len);
+        ++written;
+    }
+
+    if (dropped != log_async.reported_drops) {
+        PJ_LOG(2,(LOG_ASYNC_SENDER, "%u log message(s) dropped, log "
+                  "ring is full", dropped - log_async.reported_drops));
+        log_async.reported_drops = dropped;
+    }
+
+    return written;
+}
+
+static int log_async_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    while (!log_async.quit) {
+        if (log_async_drain() == 0)
+            pj_thread_sleep(log_async.param.interval);
+    }
+
+    /* Write whatever is left */
+    log_async_drain();
+
+    return 0;
+}
+
+static void log_async_shutdown(void)
+{
+    if (log_async.thread)
+        pj_log_async_stop();
+
+    if (log_async.tls_id != -1) {
+        pj_thread_local_free(log_async.tls_id);
+        log_async.tls_id = -1;
+    }
+}
+
+PJ_DEF(pj_status_t) pj_log_async_start(pj_pool_factory *pf,
+                                       const pj_log_async_param *prm)
+{
+    pj_uint32_t size;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pf, PJ_EINVAL);
+    PJ_ASSERT_RETURN(sizeof(log_rec) <= 16, PJ_EBUG);
+
+    if (log_async.thread)
+        return PJ_EEXISTS;
+
+    if (log_async.tls_id == -1) {
+        status = pj_thread_local_alloc(&log_async.tls_id);
+        if (status != PJ_SUCCESS) {
+            log_async.tls_id = -1;
+            return status;
+        }
+    }
+
+    if (prm)
+        pj_memcpy(&log_async.param, prm, sizeof(*prm));
+    else
+        pj_log_async_param_default(&log_async.param);
+
+    size = 1024;
+    while (size < log_async.param.ring_size ||
+           size < 2 * REC_SIZE(PJ_LOG_MAX_SIZE))
+    {
+        size <<= 1;
+    }
+
+    log_async.ring_size = size;
+    log_async.pf = pf;
+    log_async.quit = PJ_FALSE;
+    log_async.reported_drops = 0;
+
+    log_async.pool = pj_pool_create(pf, "logasync", 512, 512, NULL);
+    if (!log_async.pool)
+        return PJ_ENOMEM;
+
+    status = pj_thread_create(log_async.pool, "log", &log_async_thread,
+                              NULL, 0, 0, &log_async.thread);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(log_async.pool);
+        log_async.pool = NULL;
+        log_async.thread = NULL;
+        return status;
+    }
+
+    LOG_FENCE_REL();
+    log_async.running = 1;
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_log_async_stop(void)
+{
+    unsigned i, cnt;
+
+    if (!log_async.thread)
+        return PJ_EINVALIDOP;
+
+    /* Stop accepting records and wait for producers which may not have
+     * seen that yet.
+     */
+    log_async.running = 0;
+    ++log_async.gen;
+    LOG_FENCE_FULL();
+
+    cnt = log_async_slot_count();
+    for (i=0; i<cnt; ++i) {
+        while (log_async.slots[i].busy)
+            pj_thread_sleep(1);
+    }
+
+    /* The log thread writes the remaining records before quitting */
+    log_async.quit = PJ_TRUE;
+    pj_thread_join(log_async.thread);
+    pj_thread_destroy(log_async.thread);
+    log_async.thread = NULL;
+
+    for (i=0; i<cnt; ++i) {
+        log_slot *slot = &log_async.slots[i];
+
+        if (slot->pool)
+            pj_pool_release(slot->pool);
+        slot->pool = NULL;
+        slot->buf = NULL;
+        slot->head = slot->tail = slot->dropped = 0;
+    }
+    log_async.claimed = 0;
+
+    pj_pool_release(log_async.pool);
+    log_async.pool = NULL;
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_bool_t) pj_log_async_is_running(void)
+{
+    return log_async.running != 0;
+}
+
+PJ_DEF(void) pj_log_async_flush(void)
+{
+    unsigned i, cnt;
+
+    if (!log_async.running || !pj_thread_is_registered() ||
+        pj_thread_this() == log_async.thread)
+    {
+        return;
+    }
+
+    cnt = log_async_slot_count();
+    for (i=0; i<cnt; ++i) {
+        log_slot *slot = &log_async.slots[i];
+        pj_uint32_t head;
+
+        if (!slot->buf)
+            continue;
+
+        head = slot->head;
+        while (log_async.running && (pj_int32_t)(head - slot->tail) > 0)
+            pj_thread_sleep(1);
+    }
+}
+
+PJ_DEF(pj_uint32_t) pj_log_async_get_dropped(void)
+{
+    pj_uint32_t dropped = 0;
+    unsigned i, cnt;
+
+    cnt = log_async_slot_count();
+    for (i=0; i<cnt; ++i)
+        dropped += log_async.slots[i].dropped;
+
+    return dropped;
+}
+#endif  /* LOG_HAS_ASYNC */
+
 PJ_DEF(void) pj_log( const char *sender, int level, 
                      const char *format, va_list marker)
 {
@@ -491,6 +941,16 @@ PJ_DEF(void) pj_log( const char *sender, int level,
         log_buffer[sizeof(log_buffer)-1] = '\0';
     }
 
+#if LOG_HAS_ASYNC
+    /* Hand the message to the log thread. This is done before resuming
+     * logging, so anything logged while queueing is ignored.
+     */
+    if (log_async.running && log_async_put(level, log_buffer, len)) {
+        resume_logging(&saved_level);
+        return;
+    }
+#endif
+
     /* It should be safe to resume logging at this point. Application can
      * recursively call the logging function inside the callback.
      */
@@ -569,3 +1029,40 @@ PJ_DEF(void) pj_log_6(const char *obj, const char *format, ...)
 }
 #endif
 
+PJ_DEF(void) pj_log_async_param_default(pj_log_async_param *prm)
+{
+    pj_bzero(prm, sizeof(*prm));
+    prm->ring_size = PJ_LOG_ASYNC_RING_SIZE;
+    prm->policy = PJ_LOG_ASYNC_DROP;
+    prm->drop_level = 4;
+    prm->interval = 10;
+}
+
+#if !LOG_HAS_ASYNC
+PJ_DEF(pj_status_t) pj_log_async_start(pj_pool_factory *pf,
+                                       const pj_log_async_param *prm)
+{
+    PJ_UNUSED_ARG(pf);
+    PJ_UNUSED_ARG(prm);
+    return PJ_ENOTSUP;
+}
+
+PJ_DEF(pj_status_t) pj_log_async_stop(void)
+{
+    return PJ_EINVALIDOP;
+}
+
+PJ_DEF(pj_bool_t) pj_log_async_is_running(void)
+{
+    return PJ_FALSE;
+}
+
+PJ_DEF(void) pj_log_async_flush(void)
+{
+}
+
+PJ_DEF(pj_uint32_t) pj_log_async_get_dropped(void)
+{
+    return 0;
+}
+#endif  /* !LOG_HAS_ASYNC */
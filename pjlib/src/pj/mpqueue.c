@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/mpqueue.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/lock.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+
+/*
+ * Bounded MPMC queue
+ * ------------------
+ * This is the array based queue by Dmitry Vyukov. Each cell carries a
+ * sequence number next to the item. A producer claims position pos by
+ * advancing enq_pos with compare-and-swap, but only when the cell's
+ * sequence equals pos (the cell is free for this round). After storing
+ * the item it publishes the cell by setting the sequence to pos+1, which
+ * is what a consumer claiming position pos waits for. The consumer then
+ * sets the sequence to pos+capacity, freeing the cell for the producer of
+ * the next round. Producers and consumers only contend on their own
+ * position counter, and the 32-bit counters may wrap around.
+ *
+ * Unbounded MPSC queue
+ * --------------------
+ * This is the intrusive node based queue by Dmitry Vyukov. Producers
+ * atomically exchange the head pointer with the new node and then link
+ * the previous head to it. The consumer follows the links from tail. A
+ * stub node, owned by the queue, is re-pushed whenever the consumer is
+ * about to pop the last node, so the consumer never has to unlink a node
+ * that a producer may still be linking to. When the consumer finds a node
+ * that is not linked yet, it spins for a bounded time and then tells the
+ * caller to retry, leaving the queue in a state the next pop resumes from.
+ *
+ * Unbounded MPMC queue
+ * --------------------
+ * This is the MPSC queue above, with the consumer side taken by one
+ * consumer at a time with a test-and-set flag. A node may be freed by the
+ * consumer that popped it, so other consumers must not be reading it
+ * concurrently; serializing the consumers gives that guarantee without
+ * hazard pointers or epochs. A consumer that finds the flag taken does
+ * not wait for it but tells the caller to retry.
+ */
+
+/* Keep producer and consumer fields on separate cache lines. */
+#define CACHE_LINE      64
+
+/* Number of times the MPSC consumer polls a link that a producer is about
+ * to set, before reporting PJ_EPENDING.
+ */
+#define MPSC_SPIN_CNT   128
+
+#if defined(__GNUC__) || defined(__clang__)
+#   define MPQ_LOAD_RLX(p)      __atomic_load_n(p, __ATOMIC_RELAXED)
+#   define MPQ_LOAD_ACQ(p)      __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#   define MPQ_STORE_REL(p,v)   __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#   define MPQ_XCHG(p,v)        __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL)
+#   define MPQ_CAS(p,e,d)       __atomic_compare_exchange_n(p, e, d, 1, \
+                                                __ATOMIC_RELAXED, \
+                                                __ATOMIC_RELAXED)
+#   define MPQ_USE_LOCK         0
+#elif defined(_MSC_VER)
+#   include <intrin.h>
+#   if defined(_M_ARM) || defined(_M_ARM64)
+#       define MPQ_FENCE()      __dmb(0xB)
+#   else
+#       define MPQ_FENCE()      _ReadWriteBarrier()
+#   endif
+#   define MPQ_LOAD_RLX(p)      (*(p))
+#   define MPQ_LOAD_ACQ(p)      mpq_load_acq((void* volatile*)(p))
+#   define MPQ_STORE_REL(p,v)   do { MPQ_FENCE(); *(p) = (v); } while (0)
+#   define MPQ_XCHG(p,v)        _InterlockedExchangePointer( \
+                                                (void* volatile*)(p), v)
+#   define MPQ_CAS(p,e,d)       mpq_cas32(p, e, d)
+#   define MPQ_USE_LOCK         0
+
+static void *mpq_load_acq(void * volatile *p)
+{
+    void *v = *p;
+    MPQ_FENCE();
+    return v;
+}
+
+static pj_bool_t mpq_cas32(volatile pj_uint32_t *p, pj_uint32_t *expected,
+                           pj_uint32_t desired)
+{
+    pj_uint32_t old;
+
+    old = (pj_uint32_t)_InterlockedCompareExchange((volatile long*)p,
+                                                   (long)desired,
+                                                   (long)*expected);
+    if (old == *expected)
+        return PJ_TRUE;
+    *expected = old;
+    return PJ_FALSE;
+}
+#else
+    /* All operations are done while holding the queue's lock. */
+#   define MPQ_LOAD_RLX(p)      (*(p))
+#   define MPQ_LOAD_ACQ(p)      (*(p))
+#   define MPQ_STORE_REL(p,v)   (*(p) = (v))
+#   define MPQ_XCHG(p,v)        mpq_xchg((void**)(p), v)
+#   define MPQ_CAS(p,e,d)       mpq_cas32(p, e, d)
+#   define MPQ_USE_LOCK         PJ_HAS_THREADS
+
+static void *mpq_xchg(void **p, void *v)
+{
+    void *old = *p;
+    *p = v;
+    return old;
+}
+
+static pj_bool_t mpq_cas32(volatile pj_uint32_t *p, pj_uint32_t *expected,
+                           pj_uint32_t desired)
+{
+    if (*p == *expected) {
+        *p = desired;
+        return PJ_TRUE;
+    }
+    *expected = *p;
+    return PJ_FALSE;
+}
+#endif
+
+#if MPQ_USE_LOCK
+#   define MPQ_DECL_LOCK        pj_lock_t *lock;
+#   define MPQ_LOCK(q)          pj_lock_acquire((q)->lock)
+#   define MPQ_UNLOCK(q)        pj_lock_release((q)->lock)
+#else
+#   define MPQ_DECL_LOCK
+#   define MPQ_LOCK(q)
+#   define MPQ_UNLOCK(q)
+#endif
+
+/* On MSVC, the sequence numbers are read with the pointer sized
+ * mpq_load_acq(), hence cells keep them in a pointer sized field.
+ */
+typedef struct mpmc_cell
+{
+    volatile pj_size_t   seq;
+    void                *item;
+} mpmc_cell;
+
+struct pj_mpmc_queue_t
+{
+    mpmc_cell           *cells;
+    pj_uint32_t          mask;
+    MPQ_DECL_LOCK
+    char                 pad0[CACHE_LINE];
+    volatile pj_uint32_t enq_pos;
+    char                 pad1[CACHE_LINE];
+    volatile pj_uint32_t deq_pos;
+    char                 pad2[CACHE_LINE];
+};
+
+struct pj_mpsc_queue_t
+{
+    pj_mpsc_queue_node * volatile head;     /* Last pushed, producers   */
+    char                 pad0[CACHE_LINE];
+    pj_mpsc_queue_node  *tail;              /* Next to pop, consumer    */
+    pj_mpsc_queue_node   stub;
+    MPQ_DECL_LOCK
+    char                 pad1[CACHE_LINE];
+};
+
+struct pj_mpmc_uqueue_t
+{
+    pj_mpsc_queue_t     *mpsc;
+    void * volatile      consumer;          /* Non-NULL while popping   */
+    char                 pad0[CACHE_LINE];
+};
+
+
+PJ_DEF(pj_status_t) pj_mpmc_queue_create(pj_pool_t *pool,
+                                         unsigned capacity,
+                                         pj_mpmc_queue_t **p_queue)
+{
+    pj_mpmc_queue_t *q;
+    pj_uint32_t size, i;
+
+    PJ_ASSERT_RETURN(pool && capacity && p_queue, PJ_EINVAL);
+    PJ_ASSERT_RETURN(capacity <= 0x40000000, PJ_ETOOBIG);
+
+    for (size = 2; size < capacity; size <<= 1)
+        ;
+
+    q = PJ_POOL_ZALLOC_T(pool, pj_mpmc_queue_t);
+    q->cells = (mpmc_cell*) pj_pool_calloc(pool, size, sizeof(mpmc_cell));
+    if (!q->cells)
+        return PJ_ENOMEM;
+
+    for (i = 0; i < size; ++i)
+        q->cells[i].seq = i;
+    q->mask = size - 1;
+
+#if MPQ_USE_LOCK
+    {
+        pj_status_t status;
+
+        status = pj_lock_create_simple_mutex(pool, "mpmc%p", &q->lock);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+#endif
+
+    *p_queue = q;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_mpmc_queue_destroy(pj_mpmc_queue_t *q)
+{
+    PJ_ASSERT_RETURN(q, PJ_EINVAL);
+
+#if MPQ_USE_LOCK
+    pj_lock_destroy(q->lock);
+    q->lock = NULL;
+#endif
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(unsigned) pj_mpmc_queue_capacity(const pj_mpmc_queue_t *q)
+{
+    PJ_ASSERT_RETURN(q, 0);
+    return q->mask + 1;
+}
+
+PJ_DEF(pj_status_t) pj_mpmc_queue_push(pj_mpmc_queue_t *q, void *item)
+{
+    mpmc_cell *cell;
+    pj_uint32_t pos, seq;
+    pj_int32_t dif;
+
+    PJ_ASSERT_RETURN(q, PJ_EINVAL);
+
+    MPQ_LOCK(q);
+
+    pos = MPQ_LOAD_RLX(&q->enq_pos);
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        seq = (pj_uint32_t)(pj_size_t)MPQ_LOAD_ACQ(&cell->seq);
+        dif = (pj_int32_t)(seq - pos);
+        if (dif == 0) {
+            /* Cell is free, try to claim the position */
+            if (MPQ_CAS(&q->enq_pos, &pos, pos + 1))
+                break;
+        } else if (dif < 0) {
+            /* Cell still holds the item of the previous round */
+            MPQ_UNLOCK(q);
+            return PJ_ETOOMANY;
+        } else {
+            /* Another producer has claimed the position */
+            pos = MPQ_LOAD_RLX(&q->enq_pos);
+        }
+    }
+
+    cell->item = item;
+    MPQ_STORE_REL(&cell->seq, (pj_size_t)(pj_uint32_t)(pos + 1));
+
+    MPQ_UNLOCK(q);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_mpmc_queue_pop(pj_mpmc_queue_t *q, void **p_item)
+{
+    mpmc_cell *cell;
+    pj_uint32_t pos, seq;
+    pj_int32_t dif;
+
+    PJ_ASSERT_RETURN(q && p_item, PJ_EINVAL);
+
+    MPQ_LOCK(q);
+
+    pos = MPQ_LOAD_RLX(&q->deq_pos);
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        seq = (pj_uint32_t)(pj_size_t)MPQ_LOAD_ACQ(&cell->seq);
+        dif = (pj_int32_t)(seq - (pos + 1));
+        if (dif == 0) {
+            /* Cell is published, try to claim the position */
+            if (MPQ_CAS(&q->deq_pos, &pos, pos + 1))
+                break;
+        } else if (dif < 0) {
+            /* Nothing has been published at this position yet */
+            MPQ_UNLOCK(q);
+            return PJ_ENOTFOUND;
+        } else {
+            /* Another consumer has claimed the position */
+            pos = MPQ_LOAD_RLX(&q->deq_pos);
+        }
+    }
+
+    *p_item = cell->item;
+    MPQ_STORE_REL(&cell->seq, (pj_size_t)(pj_uint32_t)(pos + q->mask + 1));
+
+    MPQ_UNLOCK(q);
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_mpsc_queue_create(pj_pool_t *pool,
+                                         pj_mpsc_queue_t **p_queue)
+{
+    pj_mpsc_queue_t *q;
+
+    PJ_ASSERT_RETURN(pool && p_queue, PJ_EINVAL);
+
+    q = PJ_POOL_ZALLOC_T(pool, pj_mpsc_queue_t);
+    q->stub.next = NULL;
+    q->head = &q->stub;
+    q->tail = &q->stub;
+
+#if MPQ_USE_LOCK
+    {
+        pj_status_t status;
+
+        status = pj_lock_create_simple_mutex(pool, "mpsc%p", &q->lock);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+#endif
+
+    *p_queue = q;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_mpsc_queue_destroy(pj_mpsc_queue_t *q)
+{
+    PJ_ASSERT_RETURN(q, PJ_EINVAL);
+
+#if MPQ_USE_LOCK
+    pj_lock_destroy(q->lock);
+    q->lock = NULL;
+#endif
+
+    return PJ_SUCCESS;
+}
+
+static void mpsc_push(pj_mpsc_queue_t *q, pj_mpsc_queue_node *node)
+{
+    pj_mpsc_queue_node *prev;
+
+    node->next = NULL;
+    prev = (pj_mpsc_queue_node*) MPQ_XCHG(&q->head, node);
+
+    /* Between the exchange above and this store, the node is in the
+     * queue but not reachable by the consumer yet.
+     */
+    MPQ_STORE_REL(&prev->next, node);
+}
+
+PJ_DEF(void) pj_mpsc_queue_push(pj_mpsc_queue_t *q, pj_mpsc_queue_node *node)
+{
+    PJ_ASSERT_ON_FAIL(q && node, return);
+
+    MPQ_LOCK(q);
+    mpsc_push(q, node);
+    MPQ_UNLOCK(q);
+}
+
+/* Wait a little for the producer which has pushed after node to link it.
+ * Returns NULL if the producer is still in the middle of its push.
+ */
+static pj_mpsc_queue_node *mpsc_wait_next(pj_mpsc_queue_node *node)
+{
+    pj_mpsc_queue_node *next;
+    unsigned i;
+
+    for (i = 0; i < MPSC_SPIN_CNT; ++i) {
+        next = (pj_mpsc_queue_node*) MPQ_LOAD_ACQ(&node->next);
+        if (next)
+            return next;
+    }
+
+    return NULL;
+}
+
+PJ_DEF(pj_status_t) pj_mpsc_queue_pop(pj_mpsc_queue_t *q,
+                                      pj_mpsc_queue_node **p_node)
+{
+    pj_mpsc_queue_node *tail, *next, *head;
+
+    PJ_ASSERT_RETURN(q && p_node, PJ_EINVAL);
+
+    *p_node = NULL;
+
+    MPQ_LOCK(q);
+
+    tail = q->tail;
+    next = (pj_mpsc_queue_node*) MPQ_LOAD_ACQ(&tail->next);
+
+    if (tail == &q->stub) {
+        if (next == NULL) {
+            head = (pj_mpsc_queue_node*) MPQ_LOAD_ACQ(&q->head);
+            if (head == &q->stub) {
+                MPQ_UNLOCK(q);
+                return PJ_ENOTFOUND;
+            }
+            next = mpsc_wait_next(tail);
+            if (next == NULL) {
+                MPQ_UNLOCK(q);
+                return PJ_EPENDING;
+            }
+        }
+        /* Skip the stub */
+        q->tail = next;
+        tail = next;
+        next = (pj_mpsc_queue_node*) MPQ_LOAD_ACQ(&tail->next);
+    }
+
+    if (next == NULL) {
+        head = (pj_mpsc_queue_node*) MPQ_LOAD_ACQ(&q->head);
+        if (tail == head) {
+            /* tail is the last node. Push the stub behind it so that
+             * tail can be unlinked without racing with producers. Once
+             * pushed, head has moved past tail, so a retry won't push
+             * the stub again.
+             */
+            mpsc_push(q, &q->stub);
+        }
+        next = mpsc_wait_next(tail);
+        if (next == NULL) {
+            /* tail stays at the front, the next pop resumes from here */
+            MPQ_UNLOCK(q);
+            return PJ_EPENDING;
+        }
+    }
+
+    q->tail = next;
+
+    MPQ_UNLOCK(q);
+
+    *p_node = tail;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_bool_t) pj_mpsc_queue_is_empty(const pj_mpsc_queue_t *q)
+{
+    PJ_ASSERT_RETURN(q, PJ_TRUE);
+
+    return q->tail == &q->stub &&
+           MPQ_LOAD_ACQ(&q->stub.next) == NULL &&
+           MPQ_LOAD_ACQ(&q->head) == &q->stub;
+}
+
+
+PJ_DEF(pj_status_t) pj_mpmc_uqueue_create(pj_pool_t *pool,
+                                          pj_mpmc_uqueue_t **p_queue)
+{
+    pj_mpmc_uqueue_t *q;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && p_queue, PJ_EINVAL);
+
+    q = PJ_POOL_ZALLOC_T(pool, pj_mpmc_uqueue_t);
+    status = pj_mpsc_queue_create(pool, &q->mpsc);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    *p_queue = q;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_mpmc_uqueue_destroy(pj_mpmc_uqueue_t *q)
+{
+    PJ_ASSERT_RETURN(q, PJ_EINVAL);
+
+    return pj_mpsc_queue_destroy(q->mpsc);
+}
+
+PJ_DEF(void) pj_mpmc_uqueue_push(pj_mpmc_uqueue_t *q,
+                                 pj_mpsc_queue_node *node)
+{
+    PJ_ASSERT_ON_FAIL(q && node, return);
+
+    pj_mpsc_queue_push(q->mpsc, node);
+}
+
+PJ_DEF(pj_status_t) pj_mpmc_uqueue_pop(pj_mpmc_uqueue_t *q,
+                                       pj_mpsc_queue_node **p_node)
+{
+#if MPQ_USE_LOCK
+    PJ_ASSERT_RETURN(q && p_node, PJ_EINVAL);
+
+    /* The MPSC queue's lock already serializes the consumers */
+    return pj_mpsc_queue_pop(q->mpsc, p_node);
+#else
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(q && p_node, PJ_EINVAL);
+
+    *p_node = NULL;
+
+    /* Become the consumer, the exchange orders our reads of the queue
+     * after the release by the previous consumer.
+     */
+    if (MPQ_XCHG(&q->consumer, (void*)q) != NULL) {
+        /* Another consumer is popping. Don't report the queue as empty
+         * when it may not be.
+         */
+        return pj_mpsc_queue_is_empty(q->mpsc)? PJ_ENOTFOUND : PJ_EPENDING;
+    }
+
+    status = pj_mpsc_queue_pop(q->mpsc, p_node);
+
+    MPQ_STORE_REL(&q->consumer, NULL);
+
+    return status;
+#endif
+}
+
+PJ_DEF(pj_bool_t) pj_mpmc_uqueue_is_empty(const pj_mpmc_uqueue_t *q)
+{
+    PJ_ASSERT_RETURN(q, PJ_TRUE);
+
+    return pj_mpsc_queue_is_empty(q->mpsc);
+}
@@ -0,0 +1,524 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/ohash.h>
+#include <pj/string.h>
+#include <pj/pool.h>
+#include <pj/ctype.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+
+/*
+ * Layout
+ * ------
+ * Each table has a power of two number of slots, split into groups of
+ * GROUP_SIZE slots. For every slot there is one control byte:
+ *  - CTRL_EMPTY:   the slot has never been used (terminates probing),
+ *  - CTRL_DELETED: the slot was used and its entry removed,
+ *  - 0..0x7F:      the slot is in use; the value is seven bits of the
+ *                  (mixed) entry hash.
+ *
+ * A lookup loads the control bytes of a whole group as one word and finds
+ * the candidate slots with a few bitwise operations, then probes the next
+ * group in triangular sequence until a group with an empty slot is seen.
+ * Slots are only touched for candidates whose control byte matches.
+ *
+ * Resizing
+ * --------
+ * When the table becomes too full, a new table is allocated and becomes
+ * tbl[0], while the old one is kept as tbl[1]. Each later insertion moves
+ * up to MIGRATE_STEP slots from tbl[1] to tbl[0], and tbl[1] is released
+ * once it is empty. An entry always lives in exactly one of the tables.
+ * New entries are always added to tbl[0], lookups and removals check
+ * tbl[0] first and then tbl[1]. Migrated slots in tbl[1] are marked as
+ * deleted so that probe sequences in tbl[1] stay intact.
+ */
+
+#define PJ_HASH_MULTIPLIER      33
+
+#define CTRL_EMPTY      0x80
+#define CTRL_DELETED    0xFE
+
+#if defined(PJ_HAS_INT64) && PJ_HAS_INT64!=0
+typedef pj_uint64_t group_t;
+#else
+typedef pj_uint32_t group_t;
+#endif
+
+#define GROUP_SIZE      ((unsigned)sizeof(group_t))
+#define LSBS            ((group_t)-1 / 0xFF)    /* 0x0101..01 */
+#define MSBS            (LSBS << 7)             /* 0x8080..80 */
+
+/* Minimum number of slots in a table (power of two, >= GROUP_SIZE) */
+#define MIN_CAPACITY    16
+
+/* Number of old table slots to migrate on each insertion. */
+#define MIGRATE_STEP    16
+
+/* Maximum number of used and deleted slots before growing (7/8). */
+#define MAX_LOAD(cap)   ((cap) - (cap)/8)
+
+struct slot
+{
+    pj_uint32_t     hash;
+    pj_uint32_t     keylen;
+    const void     *key;
+    void           *value;
+};
+
+struct table
+{
+    pj_pool_t      *pool;
+    pj_uint8_t     *ctrl;
+    struct slot    *slots;
+    unsigned        capacity;
+    unsigned        gmask;          /* Number of groups - 1 */
+    unsigned        count;
+    unsigned        deleted;
+};
+
+struct pj_ohash_t
+{
+    pj_pool_factory *pf;
+    unsigned         flags;
+    struct table     tbl[2];        /* Current and migrating table */
+    unsigned         migrate_pos;   /* Next tbl[1] slot to migrate */
+};
+
+
+/* Spread the (weak) multiplicative hash over all bits. */
+PJ_INLINE(pj_uint32_t) mix32(pj_uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+PJ_INLINE(group_t) load_group(const pj_uint8_t *p)
+{
+    group_t g;
+#if defined(PJ_IS_LITTLE_ENDIAN) && PJ_IS_LITTLE_ENDIAN!=0
+    pj_memcpy(&g, p, sizeof(g));
+#else
+    unsigned i;
+
+    /* Control byte i must end up in byte i of the word */
+    for (g=0, i=GROUP_SIZE; i>0; --i)
+        g = (g << 8) | p[i-1];
+#endif
+    return g;
+}
+
+/* Bytes of the group equal to h2 (may have false positives above a real
+ * match, which are weeded out by comparing the slot hash).
+ */
+PJ_INLINE(group_t) match_h2(group_t g, pj_uint32_t h2)
+{
+    group_t x = g ^ (LSBS * h2);
+    return (x - LSBS) & ~x & MSBS;
+}
+
+/* Bytes of the group which are CTRL_EMPTY. */
+PJ_INLINE(group_t) match_empty(group_t g)
+{
+    return g & (~g << 6) & MSBS;
+}
+
+/* Bytes of the group which are CTRL_EMPTY or CTRL_DELETED. */
+PJ_INLINE(group_t) match_free(group_t g)
+{
+    return g & MSBS;
+}
+
+/* Index of the lowest matching byte of a non-zero match mask. */
+PJ_INLINE(unsigned) first_match(group_t m)
+{
+#if defined(__GNUC__)
+    if (sizeof(group_t) == 8)
+        return (unsigned)__builtin_ctzll((unsigned long long)m) >> 3;
+    return (unsigned)__builtin_ctz((unsigned)m) >> 3;
+#else
+    unsigned n = 0;
+    while ((m & 0x80) == 0) {
+        m >>= 8;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+static pj_uint32_t calc_hash(const pj_ohash_t *ht, const void *key,
+                             unsigned *keylen, pj_uint32_t hval)
+{
+    const pj_uint8_t *p = (const pj_uint8_t*)key;
+    pj_bool_t icase = (ht->flags & PJ_OHASH_ICASE) != 0;
+    pj_uint32_t hash = 0;
+
+    if (hval != 0) {
+        if (*keylen == PJ_HASH_KEY_STRING)
+            *keylen = (unsigned)pj_ansi_strlen((const char*)key);
+        return hval;
+    }
+
+    /* Same as pj_hash_calc()/pj_hash_calc_tolower() */
+    if (*keylen == PJ_HASH_KEY_STRING) {
+        for ( ; *p; ++p) {
+            if (icase)
+                hash = hash * PJ_HASH_MULTIPLIER + pj_tolower(*p);
+            else
+                hash = hash * PJ_HASH_MULTIPLIER + *p;
+        }
+        *keylen = (unsigned)(p - (const pj_uint8_t*)key);
+    } else {
+        const pj_uint8_t *end = p + *keylen;
+        for ( ; p != end; ++p) {
+            if (icase)
+                hash = hash * PJ_HASH_MULTIPLIER + pj_tolower(*p);
+            else
+                hash = hash * PJ_HASH_MULTIPLIER + *p;
+        }
+    }
+
+    return hash;
+}
+
+static pj_status_t tbl_init(pj_ohash_t *ht, struct table *t,
+                            unsigned capacity)
+{
+    pj_size_t size;
+
+    size = capacity + capacity * sizeof(struct slot) + 256;
+    t->pool = pj_pool_create(ht->pf, "ohash%p", size, 256, NULL);
+    if (!t->pool)
+        return PJ_ENOMEM;
+
+    t->ctrl = (pj_uint8_t*) pj_pool_alloc(t->pool, capacity);
+    t->slots = (struct slot*)
+               pj_pool_alloc(t->pool, capacity * sizeof(struct slot));
+    pj_memset(t->ctrl, CTRL_EMPTY, capacity);
+    t->capacity = capacity;
+    t->gmask = capacity / GROUP_SIZE - 1;
+    t->count = t->deleted = 0;
+
+    return PJ_SUCCESS;
+}
+
+static void tbl_release(struct table *t)
+{
+    if (t->pool)
+        pj_pool_release(t->pool);
+    pj_bzero(t, sizeof(*t));
+}
+
+static int tbl_find(const pj_ohash_t *ht, const struct table *t,
+                    pj_uint32_t hash, pj_uint32_t mixed,
+                    const void *key, unsigned keylen)
+{
+    unsigned g = (mixed >> 7) & t->gmask;
+    unsigned i;
+
+    for (i=0; i<=t->gmask; ++i) {
+        group_t grp = load_group(t->ctrl + g * GROUP_SIZE);
+        group_t m = match_h2(grp, mixed & 0x7F);
+
+        while (m) {
+            unsigned idx = g * GROUP_SIZE + first_match(m);
+            const struct slot *s = &t->slots[idx];
+
+            if (s->hash == hash && s->keylen == keylen &&
+                ((ht->flags & PJ_OHASH_ICASE) ?
+                    pj_ansi_strnicmp((const char*)s->key,
+                                     (const char*)key, keylen)==0 :
+                    pj_memcmp(s->key, key, keylen)==0))
+            {
+                return (int)idx;
+            }
+            m &= m - 1;
+        }
+
+        if (match_empty(grp))
+            break;
+
+        g = (g + i + 1) & t->gmask;
+    }
+
+    return -1;
+}
+
+/* Add an entry which is known not to be in the table. The table must
+ * have at least one free slot.
+ */
+static void tbl_put(struct table *t, pj_uint32_t hash, pj_uint32_t mixed,
+                    const void *key, unsigned keylen, void *value)
+{
+    unsigned g = (mixed >> 7) & t->gmask;
+    unsigned i, idx;
+    struct slot *s;
+
+    for (i=0; ; ++i) {
+        group_t m = match_free(load_group(t->ctrl + g * GROUP_SIZE));
+        if (m) {
+            idx = g * GROUP_SIZE + first_match(m);
+            break;
+        }
+        g = (g + i + 1) & t->gmask;
+    }
+
+    if (t->ctrl[idx] == CTRL_DELETED)
+        --t->deleted;
+    t->ctrl[idx] = (pj_uint8_t)(mixed & 0x7F);
+
+    s = &t->slots[idx];
+    s->hash = hash;
+    s->keylen = keylen;
+    s->key = key;
+    s->value = value;
+    ++t->count;
+}
+
+static void tbl_erase(struct table *t, unsigned idx)
+{
+    unsigned g = idx & ~(GROUP_SIZE - 1);
+
+    /* If the group still has an empty slot, no probe sequence continues
+     * past this group, so the slot can be made empty again.
+     */
+    if (match_empty(load_group(t->ctrl + g))) {
+        t->ctrl[idx] = CTRL_EMPTY;
+    } else {
+        t->ctrl[idx] = CTRL_DELETED;
+        ++t->deleted;
+    }
+    --t->count;
+}
+
+/* Move up to "steps" slots from the old table to the current table. */
+static void migrate(pj_ohash_t *ht, unsigned steps)
+{
+    struct table *old = &ht->tbl[1];
+
+    while (old->ctrl && old->count && steps--) {
+        unsigned idx = ht->migrate_pos++;
+
+        if ((old->ctrl[idx] & CTRL_EMPTY) == 0) {
+            const struct slot *s = &old->slots[idx];
+
+            tbl_put(&ht->tbl[0], s->hash, mix32(s->hash), s->key,
+                    s->keylen, s->value);
+            old->ctrl[idx] = CTRL_DELETED;
+            --old->count;
+        }
+    }
+
+    if (old->ctrl && old->count == 0)
+        tbl_release(old);
+}
+
+/* Start moving the entries to a new table. */
+static pj_status_t grow(pj_ohash_t *ht)
+{
+    struct table t;
+    unsigned capacity;
+    pj_status_t status;
+
+    /* Finish any pending migration first (this does not normally happen,
+     * as migration completes well before the new table fills up).
+     */
+    migrate(ht, (unsigned)-1);
+
+    /* Double the size, unless the table is mostly filled with deleted
+     * slots, in which case just rehash to a table of the same size.
+     */
+    capacity = ht->tbl[0].capacity;
+    if (ht->tbl[0].count >= capacity / 2)
+        capacity *= 2;
+
+    pj_bzero(&t, sizeof(t));
+    status = tbl_init(ht, &t, capacity);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    ht->tbl[1] = ht->tbl[0];
+    ht->tbl[0] = t;
+    ht->migrate_pos = 0;
+
+    if (ht->tbl[1].count == 0)
+        tbl_release(&ht->tbl[1]);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_ohash_create(pj_pool_t *pool, unsigned size,
+                                    unsigned flags, pj_ohash_t **p_ht)
+{
+    pj_ohash_t *ht;
+    unsigned capacity;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && p_ht, PJ_EINVAL);
+
+    ht = PJ_POOL_ZALLOC_T(pool, pj_ohash_t);
+    ht->pf = pool->factory;
+    ht->flags = flags;
+
+    capacity = MIN_CAPACITY;
+    while (MAX_LOAD(capacity) <= size && capacity < 0x40000000)
+        capacity <<= 1;
+
+    status = tbl_init(ht, &ht->tbl[0], capacity);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    *p_ht = ht;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_ohash_destroy(pj_ohash_t *ht)
+{
+    PJ_ASSERT_ON_FAIL(ht, return);
+
+    tbl_release(&ht->tbl[1]);
+    tbl_release(&ht->tbl[0]);
+}
+
+PJ_DEF(void*) pj_ohash_get(pj_ohash_t *ht, const void *key,
+                           unsigned keylen, pj_uint32_t *hval)
+{
+    pj_uint32_t hash, mixed;
+    int idx;
+
+    PJ_ASSERT_RETURN(ht && key, NULL);
+
+    hash = calc_hash(ht, key, &keylen, hval ? *hval : 0);
+    if (hval)
+        *hval = hash;
+    mixed = mix32(hash);
+
+    idx = tbl_find(ht, &ht->tbl[0], hash, mixed, key, keylen);
+    if (idx >= 0)
+        return ht->tbl[0].slots[idx].value;
+
+    if (ht->tbl[1].ctrl) {
+        idx = tbl_find(ht, &ht->tbl[1], hash, mixed, key, keylen);
+        if (idx >= 0)
+            return ht->tbl[1].slots[idx].value;
+    }
+
+    return NULL;
+}
+
+PJ_DEF(pj_status_t) pj_ohash_set(pj_ohash_t *ht, const void *key,
+                                 unsigned keylen, pj_uint32_t hval,
+                                 void *value)
+{
+    pj_uint32_t hash, mixed;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(ht && key, PJ_EINVAL);
+
+    hash = calc_hash(ht, key, &keylen, hval);
+    mixed = mix32(hash);
+
+    /* Existing entry: replace or remove */
+    for (i=0; i<PJ_ARRAY_SIZE(ht->tbl); ++i) {
+        struct table *t = &ht->tbl[i];
+        int idx;
+
+        if (!t->ctrl)
+            continue;
+
+        idx = tbl_find(ht, t, hash, mixed, key, keylen);
+        if (idx < 0)
+            continue;
+
+        if (value) {
+            t->slots[idx].key = key;
+            t->slots[idx].value = value;
+        } else {
+            tbl_erase(t, idx);
+            if (i == 1 && t->count == 0)
+                tbl_release(t);
+        }
+        return PJ_SUCCESS;
+    }
+
+    if (!value)
+        return PJ_SUCCESS;
+
+    /* New entry */
+    migrate(ht, MIGRATE_STEP);
+
+    if (ht->tbl[0].count + ht->tbl[0].deleted >=
+        MAX_LOAD(ht->tbl[0].capacity))
+    {
+        status = grow(ht);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+
+    tbl_put(&ht->tbl[0], hash, mixed, key, keylen, value);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(unsigned) pj_ohash_count(pj_ohash_t *ht)
+{
+    return ht->tbl[0].count + ht->tbl[1].count;
+}
+
+/* Advance the iterator to the first used slot at or after its position */
+static pj_ohash_iterator_t *seek(pj_ohash_t *ht, pj_ohash_iterator_t *it)
+{
+    while (it->tbl < PJ_ARRAY_SIZE(ht->tbl)) {
+        const struct table *t = &ht->tbl[it->tbl];
+
+        for (; it->index < t->capacity; ++it->index) {
+            if ((t->ctrl[it->index] & CTRL_EMPTY) == 0)
+                return it;
+        }
+
+        ++it->tbl;
+        it->index = 0;
+    }
+
+    return NULL;
+}
+
+PJ_DEF(pj_ohash_iterator_t*) pj_ohash_first(pj_ohash_t *ht,
+                                            pj_ohash_iterator_t *it)
+{
+    it->tbl = 0;
+    it->index = 0;
+    return seek(ht, it);
+}
+
+PJ_DEF(pj_ohash_iterator_t*) pj_ohash_next(pj_ohash_t *ht,
+                                           pj_ohash_iterator_t *it)
+{
+    ++it->index;
+    return seek(ht, it);
+}
+
+PJ_DEF(void*) pj_ohash_this(pj_ohash_t *ht, pj_ohash_iterator_t *it)
+{
+    return ht->tbl[it->tbl].slots[it->index].value;
+}
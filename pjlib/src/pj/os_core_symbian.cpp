@@ -563,6 +563,18 @@ PJ_DEF(int) pj_thread_get_prio_max(pj_thread_t *thread)
 }
 
 
+/*
+ * pj_thread_set_cpu_affinity()
+ */
+PJ_DEF(pj_status_t) pj_thread_set_cpu_affinity(pj_thread_t *thread,
+                                               unsigned cpu)
+{
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(cpu);
+    return PJ_ENOTSUP;
+}
+
+
 /*
  * pj_thread_get_os_handle()
  */
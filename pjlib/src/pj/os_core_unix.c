@@ -523,6 +523,37 @@ PJ_DEF(int) pj_thread_get_prio_max(pj_thread_t *thread)
 }
 
 
+/*
+ * Bind the thread to a CPU.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_cpu_affinity(pj_thread_t *thread,
+                                               unsigned cpu)
+{
+    PJ_ASSERT_RETURN(thread, PJ_EINVAL);
+
+#if PJ_HAS_THREADS && defined(PJ_HAS_PTHREAD_SETAFFINITY_NP) && \
+    PJ_HAS_PTHREAD_SETAFFINITY_NP != 0
+    {
+        cpu_set_t set;
+        int rc;
+
+        PJ_ASSERT_RETURN(cpu < CPU_SETSIZE, PJ_EINVAL);
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        rc = pthread_setaffinity_np(thread->thread, sizeof(set), &set);
+        if (rc != 0)
+            return PJ_RETURN_OS_ERROR(rc);
+
+        return PJ_SUCCESS;
+    }
+#else
+    PJ_UNUSED_ARG(cpu);
+    return PJ_ENOTSUP;
+#endif
+}
+
+
 /*
  * Get native thread handle
  */
@@ -361,6 +361,26 @@ PJ_DEF(int) pj_thread_get_prio_max(pj_thread_t *thread)
 }
 
 
+/*
+ * Bind the thread to a CPU.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_cpu_affinity(pj_thread_t *thread,
+                                               unsigned cpu)
+{
+    PJ_ASSERT_RETURN(thread, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cpu < sizeof(DWORD_PTR) * 8, PJ_EINVAL);
+
+#if PJ_HAS_THREADS
+    if (SetThreadAffinityMask(thread->hthread, (DWORD_PTR)1 << cpu) == 0)
+        return PJ_RETURN_OS_ERROR(GetLastError());
+
+    return PJ_SUCCESS;
+#else
+    return PJ_ENOTSUP;
+#endif
+}
+
+
 /*
  * Get native thread handle
  */
@@ -50,6 +50,99 @@ static pj_size_t pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE] =
 #define START_SIZE  5
 
 
+/*
+ * Thread caches
+ * -------------
+ * Each thread (up to PJ_CACHING_POOL_THREAD_CACHE_MAX threads) claims a
+ * cache holding a bounded number of free pools per size (a "magazine"),
+ * and its own list of pools in use. A thread creates pools from its cache
+ * and releases pools into its cache, so normally only the cache's own
+ * lock is taken, which other threads only take when they release a pool
+ * created by this thread. When the cache has no pool of the requested
+ * size, half a magazine is taken from the shared free list in one go, and
+ * when the cache is full, half a magazine is returned in one go.
+ *
+ * The owner of a pool is recorded in pool->factory_data together with the
+ * size index: (cache index + 1) << 8 | size index. Pools created without
+ * a thread cache have zero as the cache part, and are in cp->used_list.
+ *
+ * The cache of the calling thread is found with a thread local variable
+ * holding the generation of the cache set (so that a stale value left
+ * by a destroyed caching pool is never used) and the cache index, or
+ * NO_TCACHE if no cache is available for the thread.
+ *
+ * Lock order: cp->lock, then cache lock.
+ */
+#if PJ_HAS_THREADS && PJ_CACHING_POOL_THREAD_CACHE_MAX > 0 && \
+    (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#   define CPOOL_HAS_TCACHE     1
+#else
+#   define CPOOL_HAS_TCACHE     0
+#endif
+
+#if CPOOL_HAS_TCACHE
+
+#if PJ_CACHING_POOL_THREAD_CACHE_MAX >= 255
+#   error "PJ_CACHING_POOL_THREAD_CACHE_MAX must be less than 255"
+#endif
+
+#define NO_TCACHE       0xFF
+#define TCACHE_BATCH    ((PJ_CACHING_POOL_THREAD_CACHE_DEPTH + 1) / 2)
+
+#if defined(__GNUC__) || defined(__clang__)
+#   define CPOOL_USED_ADD(cp,n) __atomic_add_fetch(&(cp)->used_count, n, \
+                                                   __ATOMIC_RELAXED)
+#   define CPOOL_USED_SUB(cp,n) __atomic_sub_fetch(&(cp)->used_count, n, \
+                                                   __ATOMIC_RELAXED)
+#   define CPOOL_GEN_INC(p)     __atomic_add_fetch(p, 1, __ATOMIC_RELAXED)
+#else
+#   include <intrin.h>
+#   if defined(_WIN64)
+#       define CPOOL_USED_ADD(cp,n) _InterlockedExchangeAdd64( \
+                                (volatile __int64*)&(cp)->used_count, (n))
+#   else
+#       define CPOOL_USED_ADD(cp,n) _InterlockedExchangeAdd( \
+                                (volatile long*)&(cp)->used_count, (n))
+#   endif
+#   define CPOOL_USED_SUB(cp,n) CPOOL_USED_ADD(cp, -(n))
+#   define CPOOL_GEN_INC(p)     _InterlockedIncrement(p)
+#endif
+
+typedef struct cpool_tcache
+{
+    unsigned         index;
+    pj_lock_t       *lock;
+    pj_list          used_list;
+    pj_list          free_list[PJ_CACHING_POOL_ARRAY_SIZE];
+    unsigned         free_cnt[PJ_CACHING_POOL_ARRAY_SIZE];
+    pj_size_t        capacity;
+} cpool_tcache;
+
+typedef struct cpool_tcache_set
+{
+    pj_pool_t       *pool;
+    long             tls_id;
+    pj_uint32_t      gen;
+    unsigned         cnt;       /* Protected by cp->lock    */
+    cpool_tcache    *cache[PJ_CACHING_POOL_THREAD_CACHE_MAX];
+} cpool_tcache_set;
+
+static volatile long tcache_gen;
+
+static void tcache_init(pj_caching_pool *cp);
+static void tcache_destroy(pj_caching_pool *cp);
+static pj_pool_t *tcache_create_pool(pj_caching_pool *cp, int idx,
+                                     const char *name,
+                                     pj_size_t increment_sz,
+                                     pj_pool_callback *callback);
+static void tcache_release_pool(pj_caching_pool *cp, pj_pool_t *pool);
+
+#else
+#   define CPOOL_USED_ADD(cp,n) ((cp)->used_count += (n))
+#   define CPOOL_USED_SUB(cp,n) ((cp)->used_count -= (n))
+#endif  /* CPOOL_HAS_TCACHE */
+
+
 PJ_DEF(void) pj_caching_pool_init( pj_caching_pool *cp, 
                                    const pj_pool_factory_policy *policy,
                                    pj_size_t max_capacity)
@@ -89,6 +182,10 @@ PJ_DEF(void) pj_caching_pool_init( pj_caching_pool *cp,
     /* This mostly serves to silent coverity warning about unchecked 
      * return value. There's not much we can do if it fails. */
     PJ_ASSERT_ON_FAIL(status==PJ_SUCCESS, return);
+
+#if CPOOL_HAS_TCACHE
+    tcache_init(cp);
+#endif
 }
 
 PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
@@ -98,6 +195,10 @@ PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
 
     PJ_CHECK_STACK();
 
+#if CPOOL_HAS_TCACHE
+    tcache_destroy(cp);
+#endif
+
     /* Delete all pool in free list */
     for (i=0; i < PJ_CACHING_POOL_ARRAY_SIZE; ++i) {
         pj_pool_t *next;
@@ -138,8 +239,6 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
 
     PJ_CHECK_STACK();
 
-    pj_lock_acquire(cp->lock);
-
     /* Use pool factory's policy when callback is NULL */
     if (callback == NULL) {
         callback = pf->policy.callback;
@@ -164,6 +263,16 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
             ;
     }
 
+#if CPOOL_HAS_TCACHE
+    if (idx < PJ_CACHING_POOL_ARRAY_SIZE && cp->tcache) {
+        pool = tcache_create_pool(cp, idx, name, increment_sz, callback);
+        if (pool)
+            return pool;
+    }
+#endif
+
+    pj_lock_acquire(cp->lock);
+
     /* Check whether there's a pool in the list. */
     if (idx==PJ_CACHING_POOL_ARRAY_SIZE || pj_list_empty(&cp->free_list[idx])) {
         /* No pool is available. */
@@ -205,7 +314,7 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
     pool->factory_data = (void*) (pj_ssize_t) idx;
 
     /* Increment used count. */
-    ++cp->used_count;
+    CPOOL_USED_ADD(cp, 1);
 
     pj_lock_release(cp->lock);
     return pool;
@@ -221,6 +330,13 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
 
     PJ_ASSERT_ON_FAIL(pf && pool, return);
 
+#if CPOOL_HAS_TCACHE
+    if ((pj_ssize_t)pool->factory_data >> 8) {
+        tcache_release_pool(cp, pool);
+        return;
+    }
+#endif
+
     pj_lock_acquire(cp->lock);
 
 #if PJ_SAFE_POOL
@@ -236,7 +352,7 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
     pj_list_erase(pool);
 
     /* Decrement used count. */
-    --cp->used_count;
+    CPOOL_USED_SUB(cp, 1);
 
     pool_capacity = pj_pool_get_capacity(pool);
 
@@ -281,10 +397,371 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
     pj_lock_release(cp->lock);
 }
 
+#if CPOOL_HAS_TCACHE
+
+static void tcache_init(pj_caching_pool *cp)
+{
+    pj_pool_t *pool;
+    cpool_tcache_set *set;
+
+    pool = pj_pool_create_int(&cp->factory, "cpooltc",
+                              sizeof(cpool_tcache_set) + 512,
+                              4 * sizeof(cpool_tcache) + 512, NULL);
+    if (!pool)
+        return;
+
+    set = PJ_POOL_ZALLOC_T(pool, cpool_tcache_set);
+    set->pool = pool;
+    if (pj_thread_local_alloc(&set->tls_id) != PJ_SUCCESS) {
+        pj_pool_destroy_int(pool);
+        return;
+    }
+
+    set->gen = (pj_uint32_t)CPOOL_GEN_INC(&tcache_gen) & 0xFFFFFF;
+    if (set->gen == 0)
+        set->gen = 1;
+
+    cp->tcache = set;
+}
+
+static void tcache_destroy(pj_caching_pool *cp)
+{
+    cpool_tcache_set *set = (cpool_tcache_set*)cp->tcache;
+    unsigned i, j;
+
+    if (!set)
+        return;
+
+    cp->tcache = NULL;
+
+    for (i=0; i<set->cnt; ++i) {
+        cpool_tcache *tc = set->cache[i];
+        pj_pool_t *pool, *next;
+
+        for (j=0; j<PJ_CACHING_POOL_ARRAY_SIZE; ++j) {
+            pool = (pj_pool_t*) tc->free_list[j].next;
+            for (; pool != (void*)&tc->free_list[j]; pool = next) {
+                next = pool->next;
+                pj_list_erase(pool);
+                pj_pool_destroy_int(pool);
+            }
+        }
+
+        pool = (pj_pool_t*) tc->used_list.next;
+        for (; pool != (void*)&tc->used_list; pool = next) {
+            next = pool->next;
+            pj_list_erase(pool);
+            PJ_LOG(4,(pool->obj_name,
+                      "Pool is not released by application, releasing now"));
+            pj_pool_destroy_int(pool);
+        }
+
+        pj_lock_destroy(tc->lock);
+    }
+
+    pj_thread_local_free(set->tls_id);
+    pj_pool_destroy_int(set->pool);
+}
+
+/* Get the cache of the calling thread, claiming one on first use. */
+static cpool_tcache *tcache_get(pj_caching_pool *cp, cpool_tcache_set *set)
+{
+    pj_size_t val = (pj_size_t)pj_thread_local_get(set->tls_id);
+    cpool_tcache *tc = NULL;
+    unsigned i;
+
+    if ((val >> 8) == set->gen) {
+        i = (unsigned)(val & 0xFF);
+        return (i == NO_TCACHE) ? NULL : set->cache[i];
+    }
+
+    pj_lock_acquire(cp->lock);
+    i = set->cnt;
+    if (i < PJ_CACHING_POOL_THREAD_CACHE_MAX) {
+        pj_status_t status;
+        unsigned j;
+
+        tc = PJ_POOL_ZALLOC_T(set->pool, cpool_tcache);
+        status = pj_lock_create_simple_mutex(set->pool, "cpooltc%p",
+                                             &tc->lock);
+        if (status == PJ_SUCCESS) {
+            tc->index = i;
+            pj_list_init(&tc->used_list);
+            for (j=0; j<PJ_CACHING_POOL_ARRAY_SIZE; ++j)
+                pj_list_init(&tc->free_list[j]);
+            set->cache[i] = tc;
+            ++set->cnt;
+        } else {
+            tc = NULL;
+        }
+    }
+    pj_lock_release(cp->lock);
+
+    val = ((pj_size_t)set->gen << 8) | (tc ? i : NO_TCACHE);
+    pj_thread_local_set(set->tls_id, (void*)val);
+
+    return tc;
+}
+
+/* Move up to TCACHE_BATCH pools of the size from the shared free list
+ * to the cache. Only the owner thread adds pools to its cache.
+ */
+static void tcache_refill(pj_caching_pool *cp, cpool_tcache *tc, int idx)
+{
+    pj_list batch;
+    pj_size_t batch_capacity = 0;
+    unsigned n = 0;
+
+    pj_list_init(&batch);
+
+    pj_lock_acquire(cp->lock);
+    while (n < TCACHE_BATCH && !pj_list_empty(&cp->free_list[idx])) {
+        pj_pool_t *pool = (pj_pool_t*) cp->free_list[idx].next;
+        pj_size_t pool_capacity = pj_pool_get_capacity(pool);
+
+        if (tc->capacity + batch_capacity + pool_capacity >
+                PJ_CACHING_POOL_THREAD_CACHE_SIZE && n > 0)
+        {
+            break;
+        }
+
+        pj_list_erase(pool);
+        pj_list_push_back(&batch, pool);
+        batch_capacity += pool_capacity;
+        ++n;
+
+        if (cp->capacity > pool_capacity) {
+            cp->capacity -= pool_capacity;
+        } else {
+            cp->capacity = 0;
+        }
+    }
+    pj_lock_release(cp->lock);
+
+    if (n == 0)
+        return;
+
+    pj_lock_acquire(tc->lock);
+    pj_list_merge_last(&tc->free_list[idx], &batch);
+    tc->free_cnt[idx] += n;
+    tc->capacity += batch_capacity;
+    pj_lock_release(tc->lock);
+}
+
+/* Take a pool of the size from the cache and put it in the used list. */
+static pj_pool_t *tcache_pop(cpool_tcache *tc, int idx,
+                             const char *name,
+                             pj_size_t increment_sz,
+                             pj_pool_callback *callback)
+{
+    pj_pool_t *pool = NULL;
+
+    pj_lock_acquire(tc->lock);
+    if (!pj_list_empty(&tc->free_list[idx])) {
+        pool = (pj_pool_t*) tc->free_list[idx].next;
+        pj_list_erase(pool);
+        --tc->free_cnt[idx];
+        tc->capacity -= pj_pool_get_capacity(pool);
+
+        pj_pool_init_int(pool, name, increment_sz, callback);
+        pj_list_insert_before(&tc->used_list, pool);
+    }
+    pj_lock_release(tc->lock);
+
+    return pool;
+}
+
+static pj_pool_t *tcache_create_pool(pj_caching_pool *cp, int idx,
+                                     const char *name,
+                                     pj_size_t increment_sz,
+                                     pj_pool_callback *callback)
+{
+    cpool_tcache_set *set = (cpool_tcache_set*)cp->tcache;
+    cpool_tcache *tc;
+    pj_pool_t *pool;
+
+    tc = tcache_get(cp, set);
+    if (!tc)
+        return NULL;
+
+    pool = tcache_pop(tc, idx, name, increment_sz, callback);
+    if (!pool) {
+        tcache_refill(cp, tc, idx);
+        pool = tcache_pop(tc, idx, name, increment_sz, callback);
+    }
+
+    if (pool) {
+        PJ_LOG(6, (pool->obj_name, "pool reused, size=%lu",
+                   (unsigned long)pool->capacity));
+    } else {
+        /* No pool is available, create new pool */
+        pool = pj_pool_create_int(&cp->factory, name, pool_sizes[idx],
+                                  increment_sz, callback);
+        if (!pool)
+            return NULL;
+
+        pj_lock_acquire(tc->lock);
+        pj_list_insert_before(&tc->used_list, pool);
+        pj_lock_release(tc->lock);
+    }
+
+    /* Mark factory data */
+    pool->factory_data = (void*) (pj_ssize_t) (((tc->index + 1) << 8) | idx);
+
+    CPOOL_USED_ADD(cp, 1);
+    return pool;
+}
+
+static void tcache_release_pool(pj_caching_pool *cp, pj_pool_t *pool)
+{
+    cpool_tcache_set *set = (cpool_tcache_set*)cp->tcache;
+    pj_ssize_t tag = (pj_ssize_t) pool->factory_data;
+    unsigned owner = (unsigned)(tag >> 8) - 1;
+    unsigned i = (unsigned)(tag & 0xFF);
+    cpool_tcache *tc;
+    pj_size_t pool_capacity;
+    pj_list batch;
+
+    PJ_ASSERT_ON_FAIL(set && owner < set->cnt, return);
+
+    /* Erase from the used list of the thread which created the pool. */
+    tc = set->cache[owner];
+    pj_lock_acquire(tc->lock);
+#if PJ_SAFE_POOL
+    if (pj_list_find_node(&tc->used_list, pool) != pool) {
+        pj_lock_release(tc->lock);
+        pj_assert(!"Attempt to destroy pool that has been destroyed before");
+        return;
+    }
+#endif
+    pj_list_erase(pool);
+    pj_lock_release(tc->lock);
+
+    CPOOL_USED_SUB(cp, 1);
+
+    pool_capacity = pj_pool_get_capacity(pool);
+    if (pool_capacity > pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE-1] ||
+        i >= PJ_CACHING_POOL_ARRAY_SIZE)
+    {
+        pj_pool_destroy_int(pool);
+        return;
+    }
+
+    PJ_LOG(6, (pool->obj_name, "recycle(): cap=%lu, used=%lu(%lu%%)", 
+               (unsigned long)pool_capacity,
+               (unsigned long)pj_pool_get_used_size(pool), 
+               (unsigned long)(pj_pool_get_used_size(pool)*100/
+                               pool_capacity)));
+    pj_pool_reset(pool);
+
+    pool_capacity = pj_pool_get_capacity(pool);
+
+    /* Put the pool in the cache of the calling thread, which may be
+     * different than the thread which created it.
+     */
+    pj_list_init(&batch);
+    tc = tcache_get(cp, set);
+    if (tc) {
+        unsigned n;
+
+        pj_lock_acquire(tc->lock);
+        if (tc->free_cnt[i] < PJ_CACHING_POOL_THREAD_CACHE_DEPTH &&
+            tc->capacity + pool_capacity <= PJ_CACHING_POOL_THREAD_CACHE_SIZE)
+        {
+            pj_list_insert_after(&tc->free_list[i], pool);
+            ++tc->free_cnt[i];
+            tc->capacity += pool_capacity;
+            pj_lock_release(tc->lock);
+            return;
+        }
+
+        /* The cache is full, return the least recently used pools of the
+         * size to the shared free list along with this one.
+         */
+        for (n=0; n<TCACHE_BATCH && !pj_list_empty(&tc->free_list[i]); ++n) {
+            pj_pool_t *p = (pj_pool_t*) tc->free_list[i].prev;
+
+            pj_list_erase(p);
+            pj_list_push_back(&batch, p);
+            --tc->free_cnt[i];
+            tc->capacity -= pj_pool_get_capacity(p);
+        }
+        pj_lock_release(tc->lock);
+    }
+    pj_list_push_back(&batch, pool);
+
+    pj_lock_acquire(cp->lock);
+    while (!pj_list_empty(&batch)) {
+        pj_pool_t *p = (pj_pool_t*) batch.next;
+
+        pool_capacity = pj_pool_get_capacity(p);
+        pj_list_erase(p);
+        if (cp->capacity + pool_capacity > cp->max_capacity) {
+            pj_pool_destroy_int(p);
+        } else {
+            pj_list_insert_after(&cp->free_list[i], p);
+            cp->capacity += pool_capacity;
+        }
+    }
+    pj_lock_release(cp->lock);
+}
+
+#endif  /* CPOOL_HAS_TCACHE */
+
+#if PJ_LOG_MAX_LEVEL >= 3
+static void dump_pool_list(const pj_list *list, pj_size_t *total_used,
+                           pj_size_t *total_capacity)
+{
+    pj_pool_t *pool = (pj_pool_t*) list->next;
+
+    while (pool != (const void*)list) {
+        pj_size_t pool_capacity = pj_pool_get_capacity(pool);
+        pj_pool_block *block = pool->block_list.next;
+        unsigned nblocks = 0;
+
+        while (block != &pool->block_list) {
+#if 0
+            PJ_LOG(6, ("cachpool", "   %16s block %u, size %ld",
+                                   pj_pool_getobjname(pool), nblocks,
+                                   (long)(block->end - block->buf + 1)));
+#endif
+            nblocks++;
+            block = block->next;
+        }
+
+        PJ_LOG(3,("cachpool", "   %16s: %8lu of %8lu (%lu%%) used, "
+                              "nblocks: %d",
+                              pj_pool_getobjname(pool), 
+                              (unsigned long)pj_pool_get_used_size(pool), 
+                              (unsigned long)pool_capacity,
+                              (unsigned long)(pj_pool_get_used_size(pool)*
+                                              100/pool_capacity),
+                              nblocks));
+
+#if PJ_POOL_MAX_SEARCH_BLOCK_COUNT == 0
+        if (nblocks >= 10) {
+            PJ_LOG(3,("cachpool", "   %16s has too many blocks (%d), "
+                                  "consider increasing its initial and/or "
+                                  "increment size for better performance",
+                                  pj_pool_getobjname(pool), nblocks));
+        }
+#endif
+
+        *total_used += pj_pool_get_used_size(pool);
+        *total_capacity += pool_capacity;
+        pool = pool->next;
+    }
+}
+#endif  /* PJ_LOG_MAX_LEVEL >= 3 */
+
 static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
 {
 #if PJ_LOG_MAX_LEVEL >= 3
     pj_caching_pool *cp = (pj_caching_pool*)factory;
+#if CPOOL_HAS_TCACHE
+    cpool_tcache_set *set;
+    unsigned i;
+#endif
 
     pj_lock_acquire(cp->lock);
 
@@ -292,47 +769,34 @@ static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
     PJ_LOG(3,("cachpool", "   Capacity=%lu, max_capacity=%lu, used_cnt=%lu",
               (unsigned long)cp->capacity, (unsigned long)cp->max_capacity,
               (unsigned long)cp->used_count));
-    if (detail) {
-        pj_pool_t *pool = (pj_pool_t*) cp->used_list.next;
-        pj_size_t total_used = 0, total_capacity = 0;
-        PJ_LOG(3,("cachpool", "  Dumping all active pools:"));
-        while (pool != (void*)&cp->used_list) {
-            pj_size_t pool_capacity = pj_pool_get_capacity(pool);
-            pj_pool_block *block = pool->block_list.next;
-            unsigned nblocks = 0;
 
-            while (block != &pool->block_list) {
-#if 0
-                PJ_LOG(6, ("cachpool", "   %16s block %u, size %ld",
-                                       pj_pool_getobjname(pool), nblocks,
-                                       (long)(block->end - block->buf + 1)));
-#endif
-                nblocks++;
-                block = block->next;
-            }
-
-            PJ_LOG(3,("cachpool", "   %16s: %8lu of %8lu (%lu%%) used, "
-                                  "nblocks: %d",
-                                  pj_pool_getobjname(pool), 
-                                  (unsigned long)pj_pool_get_used_size(pool), 
-                                  (unsigned long)pool_capacity,
-                                  (unsigned long)(pj_pool_get_used_size(pool)*
-                                                  100/pool_capacity),
-                                  nblocks));
+#if CPOOL_HAS_TCACHE
+    set = (cpool_tcache_set*)cp->tcache;
+    if (set) {
+        pj_size_t tcache_capacity = 0;
 
-#if PJ_POOL_MAX_SEARCH_BLOCK_COUNT == 0
-            if (nblocks >= 10) {
-                PJ_LOG(3,("cachpool", "   %16s has too many blocks (%d), "
-                                      "consider increasing its initial and/or "
-                                      "increment size for better performance",
-                                      pj_pool_getobjname(pool), nblocks));
-            }
+        for (i=0; i<set->cnt; ++i) {
+            pj_lock_acquire(set->cache[i]->lock);
+            tcache_capacity += set->cache[i]->capacity;
+            pj_lock_release(set->cache[i]->lock);
+        }
+        PJ_LOG(3,("cachpool", "   Thread caches=%u, capacity=%lu",
+                  set->cnt, (unsigned long)tcache_capacity));
+    }
 #endif
 
-            total_used += pj_pool_get_used_size(pool);
-            total_capacity += pool_capacity;
-            pool = pool->next;
+    if (detail) {
+        pj_size_t total_used = 0, total_capacity = 0;
+        PJ_LOG(3,("cachpool", "  Dumping all active pools:"));
+        dump_pool_list(&cp->used_list, &total_used, &total_capacity);
+#if CPOOL_HAS_TCACHE
+        for (i=0; set && i<set->cnt; ++i) {
+            pj_lock_acquire(set->cache[i]->lock);
+            dump_pool_list(&set->cache[i]->used_list, &total_used,
+                           &total_capacity);
+            pj_lock_release(set->cache[i]->lock);
         }
+#endif
         if (total_capacity) {
             PJ_LOG(3,("cachpool", "  Total %9lu of %9lu (%lu %%) used!",
                                   (unsigned long)total_used,
@@ -349,7 +813,6 @@ static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
 #endif
 }
 
-
 static pj_bool_t cpool_on_block_alloc(pj_pool_factory *f, pj_size_t sz)
 {
     pj_caching_pool *cp = (pj_caching_pool*)f;
@@ -16,6 +16,10 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
  */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE          /* for sendmmsg() and recvmmsg() */
+#endif
+
 #include <pj/sock.h>
 #include <pj/os.h>
 #include <pj/assert.h>
@@ -758,6 +762,116 @@ PJ_DEF(pj_status_t) pj_sock_sendto(pj_sock_t sock,
         return PJ_SUCCESS;
 }
 
+#if defined(PJ_SOCK_HAS_SENDMMSG) && PJ_SOCK_HAS_SENDMMSG != 0
+/* Maximum datagrams given to sendmmsg() in one call. */
+#define MAX_MMSG    64
+
+/*
+ * Send several datagrams with one system call.
+ */
+PJ_DEF(pj_status_t) pj_sock_sendmmsg(pj_sock_t sock,
+                                     pj_sock_mmsg msg[],
+                                     unsigned *count,
+                                     unsigned flags)
+{
+    struct mmsghdr hdr[MAX_MMSG];
+    struct iovec iov[MAX_MMSG];
+    unsigned i, cnt;
+    int rc;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msg && count, PJ_EINVAL);
+
+    cnt = (*count < MAX_MMSG)? *count : MAX_MMSG;
+    if (cnt == 0)
+        return PJ_SUCCESS;
+
+    pj_bzero(hdr, cnt * sizeof(hdr[0]));
+    for (i = 0; i < cnt; ++i) {
+        CHECK_ADDR_LEN(msg[i].addr, msg[i].addr_len);
+
+        iov[i].iov_base = msg[i].buf;
+        iov[i].iov_len = msg[i].len;
+        hdr[i].msg_hdr.msg_name = msg[i].addr;
+        hdr[i].msg_hdr.msg_namelen = msg[i].addr_len;
+        hdr[i].msg_hdr.msg_iov = &iov[i];
+        hdr[i].msg_hdr.msg_iovlen = 1;
+    }
+
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+
+    rc = sendmmsg(sock, hdr, cnt, flags);
+    if (rc < 0) {
+        *count = 0;
+        return PJ_RETURN_OS_ERROR(pj_get_native_netos_error());
+    }
+
+    for (i = 0; i < (unsigned)rc; ++i)
+        msg[i].len = hdr[i].msg_len;
+    *count = rc;
+
+    return PJ_SUCCESS;
+}
+#endif  /* PJ_SOCK_HAS_SENDMMSG */
+
+#if defined(PJ_SOCK_HAS_RECVMMSG) && PJ_SOCK_HAS_RECVMMSG != 0
+/* Maximum datagrams given to recvmmsg() in one call. */
+#define MAX_RMMSG   64
+
+/*
+ * Receive several datagrams with one system call.
+ */
+PJ_DEF(pj_status_t) pj_sock_recvmmsg(pj_sock_t sock,
+                                     pj_sock_mmsg msg[],
+                                     unsigned *count,
+                                     unsigned flags)
+{
+    struct mmsghdr hdr[MAX_RMMSG];
+    struct iovec iov[MAX_RMMSG];
+    unsigned i, cnt;
+    int rc;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msg && count, PJ_EINVAL);
+
+    cnt = (*count < MAX_RMMSG)? *count : MAX_RMMSG;
+    if (cnt == 0)
+        return PJ_SUCCESS;
+
+    pj_bzero(hdr, cnt * sizeof(hdr[0]));
+    for (i = 0; i < cnt; ++i) {
+        iov[i].iov_base = msg[i].buf;
+        iov[i].iov_len = msg[i].len;
+        if (msg[i].addr) {
+            hdr[i].msg_hdr.msg_name = msg[i].addr;
+            hdr[i].msg_hdr.msg_namelen = msg[i].addr_len;
+        }
+        hdr[i].msg_hdr.msg_iov = &iov[i];
+        hdr[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    /* Only wait for the first datagram */
+    rc = recvmmsg(sock, hdr, cnt, flags | MSG_WAITFORONE, NULL);
+    if (rc < 0) {
+        *count = 0;
+        return PJ_RETURN_OS_ERROR(pj_get_native_netos_error());
+    }
+
+    for (i = 0; i < (unsigned)rc; ++i) {
+        msg[i].len = hdr[i].msg_len;
+        if (msg[i].addr) {
+            msg[i].addr_len = hdr[i].msg_hdr.msg_namelen;
+            PJ_SOCKADDR_RESET_LEN(msg[i].addr);
+        }
+    }
+    *count = rc;
+
+    return PJ_SUCCESS;
+}
+#endif  /* PJ_SOCK_HAS_RECVMMSG */
+
 /*
  * Receive data.
  */
@@ -1410,6 +1410,59 @@ PJ_DEF(pj_status_t) pj_sock_socketpair(int family,
 }
 #endif
 
+#if !defined(PJ_SOCK_HAS_SENDMMSG) || PJ_SOCK_HAS_SENDMMSG == 0
+/*
+ * Send datagrams one by one when there is no sendmmsg().
+ */
+PJ_DEF(pj_status_t) pj_sock_sendmmsg(pj_sock_t sock,
+                                     pj_sock_mmsg msg[],
+                                     unsigned *count,
+                                     unsigned flags)
+{
+    pj_status_t status = PJ_SUCCESS;
+    unsigned i;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msg && count, PJ_EINVAL);
+
+    for (i = 0; i < *count; ++i) {
+        status = pj_sock_sendto(sock, msg[i].buf, &msg[i].len, flags,
+                                msg[i].addr, msg[i].addr_len);
+        if (status != PJ_SUCCESS)
+            break;
+    }
+
+    *count = i;
+    return (i == 0)? status : PJ_SUCCESS;
+}
+#endif
+
+#if !defined(PJ_SOCK_HAS_RECVMMSG) || PJ_SOCK_HAS_RECVMMSG == 0
+/*
+ * Receive only one datagram when there is no recvmmsg(), as the next
+ * recvfrom() could block.
+ */
+PJ_DEF(pj_status_t) pj_sock_recvmmsg(pj_sock_t sock,
+                                     pj_sock_mmsg msg[],
+                                     unsigned *count,
+                                     unsigned flags)
+{
+    pj_status_t status;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msg && count, PJ_EINVAL);
+
+    if (*count == 0)
+        return PJ_SUCCESS;
+
+    status = pj_sock_recvfrom(sock, msg[0].buf, &msg[0].len, flags,
+                              msg[0].addr,
+                              msg[0].addr? &msg[0].addr_len : NULL);
+    *count = (status == PJ_SUCCESS)? 1 : 0;
+    return status;
+}
+#endif
+
 
 /* Check IP address type. */
 PJ_DEF(pj_bool_t) pj_check_addr_type(const pj_sockaddr *addr, unsigned type)
@@ -84,6 +84,37 @@ PJ_EXPORT_SYMBOL(pj_hash_first)
 PJ_EXPORT_SYMBOL(pj_hash_next)
 PJ_EXPORT_SYMBOL(pj_hash_this)
 
+/*
+ * ohash.h
+ */
+PJ_EXPORT_SYMBOL(pj_ohash_create)
+PJ_EXPORT_SYMBOL(pj_ohash_destroy)
+PJ_EXPORT_SYMBOL(pj_ohash_get)
+PJ_EXPORT_SYMBOL(pj_ohash_set)
+PJ_EXPORT_SYMBOL(pj_ohash_count)
+PJ_EXPORT_SYMBOL(pj_ohash_first)
+PJ_EXPORT_SYMBOL(pj_ohash_next)
+PJ_EXPORT_SYMBOL(pj_ohash_this)
+
+/*
+ * mpqueue.h
+ */
+PJ_EXPORT_SYMBOL(pj_mpmc_queue_create)
+PJ_EXPORT_SYMBOL(pj_mpmc_queue_destroy)
+PJ_EXPORT_SYMBOL(pj_mpmc_queue_capacity)
+PJ_EXPORT_SYMBOL(pj_mpmc_queue_push)
+PJ_EXPORT_SYMBOL(pj_mpmc_queue_pop)
+PJ_EXPORT_SYMBOL(pj_mpsc_queue_create)
+PJ_EXPORT_SYMBOL(pj_mpsc_queue_destroy)
+PJ_EXPORT_SYMBOL(pj_mpsc_queue_push)
+PJ_EXPORT_SYMBOL(pj_mpsc_queue_pop)
+PJ_EXPORT_SYMBOL(pj_mpsc_queue_is_empty)
+PJ_EXPORT_SYMBOL(pj_mpmc_uqueue_create)
+PJ_EXPORT_SYMBOL(pj_mpmc_uqueue_destroy)
+PJ_EXPORT_SYMBOL(pj_mpmc_uqueue_push)
+PJ_EXPORT_SYMBOL(pj_mpmc_uqueue_pop)
+PJ_EXPORT_SYMBOL(pj_mpmc_uqueue_is_empty)
+
 /*
  * ioqueue.h
  */
@@ -147,6 +178,12 @@ PJ_EXPORT_SYMBOL(pj_log_5)
 #if PJ_LOG_MAX_LEVEL >= 6
 PJ_EXPORT_SYMBOL(pj_log_6)
 #endif
+PJ_EXPORT_SYMBOL(pj_log_async_param_default)
+PJ_EXPORT_SYMBOL(pj_log_async_start)
+PJ_EXPORT_SYMBOL(pj_log_async_stop)
+PJ_EXPORT_SYMBOL(pj_log_async_is_running)
+PJ_EXPORT_SYMBOL(pj_log_async_flush)
+PJ_EXPORT_SYMBOL(pj_log_async_get_dropped)
 
 /*
  * os.h
@@ -37,6 +37,9 @@
 #include <pj/rand.h>
 #include <pj/limits.h>
 
+/* The timing wheel implementation is in timer_wheel.c */
+#if !PJ_TIMER_USE_WHEEL
+
 #define THIS_FILE       "timer.c"
 
 #define HEAP_PARENT(X)  (X == 0 ? 0 : (((X) - 1) / 2))
@@ -1030,3 +1033,4 @@ PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
 }
 #endif
 
+#endif  /* !PJ_TIMER_USE_WHEEL */
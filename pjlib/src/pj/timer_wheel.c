@@ -0,0 +1,1046 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Hierarchical timing wheel implementation of the timer heap API, enabled
+ * with PJ_TIMER_USE_WHEEL.
+ *
+ * Time is measured in ticks of one millisecond of pj_gettickcount(). The
+ * first level of the wheel has 256 slots, one per tick, and holds entries
+ * expiring within the next 256 ticks. Four more levels of 64 slots each
+ * hold entries further in the future, each slot of a level covering a
+ * whole round of the level below. When the first level wraps around, the
+ * next slot of the level above is cascaded down, i.e. its entries are
+ * redistributed to the lower levels. Scheduling and cancelling are O(1),
+ * and polling only visits occupied slots thanks to a bitmap per level.
+ *
+ * Entries are spread over PJ_TIMER_WHEEL_SHARDS independent wheels, each
+ * with its own lock, by hashing the address of the timer entry, so that
+ * threads scheduling and cancelling unrelated entries rarely contend.
+ */
+#include <pj/timer.h>
+#include <pj/pool.h>
+#include <pj/os.h>
+#include <pj/string.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/list.h>
+#include <pj/limits.h>
+
+#if PJ_TIMER_USE_WHEEL
+
+#define THIS_FILE       "timer_wheel.c"
+
+#define DEFAULT_MAX_TIMED_OUT_PER_POLL  (64)
+
+/* Wheel geometry */
+#define TVR_BITS        8
+#define TVN_BITS        6
+#define TVR_SIZE        (1 << TVR_BITS)
+#define TVN_SIZE        (1 << TVN_BITS)
+#define TVR_MASK        (TVR_SIZE - 1)
+#define TVN_MASK        (TVN_SIZE - 1)
+#define TVN_LEVELS      4
+#define TVN_SHIFT(l)    (TVR_BITS + (l) * TVN_BITS)
+
+/* Longest delay that can be put in the wheel; longer ones are cascaded
+ * down again when they get there.
+ */
+#define MAX_TICKS       ((tick_t)1 << TVN_SHIFT(TVN_LEVELS))
+
+/* Pseudo level of entries that have expired and wait for their callback */
+#define LEVEL_PENDING   (TVN_LEVELS + 1)
+
+#define SHARD_CNT       PJ_TIMER_WHEEL_SHARDS
+
+
+enum
+{
+    F_DONT_CALL = 1,
+    F_DONT_ASSERT = 2,
+    F_SET_ID = 4
+};
+
+typedef pj_uint64_t tick_t;
+
+/* A scheduled timer entry. */
+typedef struct wheel_node
+{
+    PJ_DECL_LIST_MEMBER(struct wheel_node);
+
+    /** The original timer entry. */
+    pj_timer_entry     *entry;
+
+#if PJ_TIMER_USE_COPY
+    /** The duplicate copy, to detect deallocated entries. */
+    pj_timer_entry      dup;
+#endif
+
+    /** The tick when the timer expires. */
+    tick_t              expires;
+
+    /** The group lock used by this entry, if any. */
+    pj_grp_lock_t      *grp_lock;
+
+    /** Id of the node in its shard. */
+    pj_timer_id_t       local_id;
+
+    /** Next free node id, when the node is in the freelist. */
+    pj_timer_id_t       next_free;
+
+    /** Non-zero if the node is scheduled. */
+    pj_bool_t           in_use;
+
+    /** Where the node is: level (0 is the first level) and slot index. */
+    unsigned            level;
+    unsigned            idx;
+
+#if PJ_TIMER_DEBUG
+    const char         *src_file;
+    int                 src_line;
+#endif
+} wheel_node;
+
+/* One wheel, protected by its own lock. */
+typedef struct wheel_shard
+{
+    pj_lock_t          *lock;
+
+    /** The next tick to be processed. */
+    tick_t              cur;
+
+    /** Number of scheduled entries, including pending ones. */
+    pj_size_t           count;
+
+    pj_list             tv1[TVR_SIZE];
+    pj_list             tvn[TVN_LEVELS][TVN_SIZE];
+    pj_uint32_t         tv1_map[TVR_SIZE / 32];
+    pj_uint32_t         tvn_map[TVN_LEVELS][(TVN_SIZE + 31) / 32];
+    pj_list             pending;
+
+    /** Nodes indexed by their local id. Id zero is not used. */
+    wheel_node        **nodes;
+    pj_size_t           max_size;
+    pj_timer_id_t       freelist;
+} wheel_shard;
+
+/**
+ * The implementation of timer heap.
+ */
+struct pj_timer_heap_t
+{
+    /** Pool from which the shards grow. */
+    pj_pool_t          *pool;
+
+    /** Max timed out entries to process per poll. */
+    unsigned            max_entries_per_poll;
+
+    /** Lock object set by application. */
+    pj_lock_t          *lock;
+
+    /** Autodelete lock. */
+    pj_bool_t           auto_delete_lock;
+
+    /** The wheels. */
+    wheel_shard        *shards[SHARD_CNT];
+
+    /** The shard to start with on the next poll. */
+    unsigned            poll_start;
+};
+
+
+PJ_INLINE(void) lock_shard(wheel_shard *s)
+{
+    if (s->lock)
+        pj_lock_acquire(s->lock);
+}
+
+PJ_INLINE(void) unlock_shard(wheel_shard *s)
+{
+    if (s->lock)
+        pj_lock_release(s->lock);
+}
+
+PJ_INLINE(tick_t) now_tick(void)
+{
+    pj_time_val now;
+
+    pj_gettickcount(&now);
+    return (tick_t)now.sec * 1000 + now.msec;
+}
+
+/* An entry always maps to the same shard, so that the "already running"
+ * check when scheduling and the lookup when cancelling see the same lock.
+ */
+PJ_INLINE(unsigned) entry_shard(const pj_timer_entry *entry)
+{
+    pj_size_t h = (pj_size_t)entry;
+
+    h ^= (h >> 7) ^ (h >> 13);
+    return (unsigned)(h % SHARD_CNT);
+}
+
+PJ_INLINE(unsigned) ctz32(pj_uint32_t x)
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctz(x);
+#else
+    unsigned n = 0;
+    while ((x & 1) == 0) {
+        x >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+/* Find the first set bit in [from, to), or -1. */
+static int find_bit(const pj_uint32_t *map, unsigned from, unsigned to)
+{
+    unsigned i = from;
+
+    while (i < to) {
+        pj_uint32_t w = map[i >> 5] >> (i & 31);
+
+        if (w) {
+            i += ctz32(w);
+            return (i < to)? (int)i : -1;
+        }
+        i = (i | 31) + 1;
+    }
+    return -1;
+}
+
+PJ_INLINE(void) set_bit(pj_uint32_t *map, unsigned i)
+{
+    map[i >> 5] |= (1u << (i & 31));
+}
+
+PJ_INLINE(void) clear_bit(pj_uint32_t *map, unsigned i)
+{
+    map[i >> 5] &= ~(1u << (i & 31));
+}
+
+
+/* Put a node in the slot matching its expiry. */
+static void add_node(wheel_shard *s, wheel_node *node)
+{
+    tick_t expires = node->expires;
+    tick_t delta;
+    unsigned level;
+
+    if (expires < s->cur) {
+        /* Already expired, make it due on the next poll */
+        node->level = LEVEL_PENDING;
+        pj_list_push_back(&s->pending, node);
+        return;
+    }
+
+    delta = expires - s->cur;
+    if (delta < TVR_SIZE) {
+        node->level = 0;
+        node->idx = (unsigned)(expires & TVR_MASK);
+        pj_list_push_back(&s->tv1[node->idx], node);
+        set_bit(s->tv1_map, node->idx);
+        return;
+    }
+
+    if (delta >= MAX_TICKS)
+        expires = s->cur + MAX_TICKS - 1;
+
+    for (level = 0; level < TVN_LEVELS - 1; ++level) {
+        if (delta < ((tick_t)1 << TVN_SHIFT(level + 1)))
+            break;
+    }
+
+    node->level = level + 1;
+    node->idx = (unsigned)((expires >> TVN_SHIFT(level)) & TVN_MASK);
+    pj_list_push_back(&s->tvn[level][node->idx], node);
+    set_bit(s->tvn_map[level], node->idx);
+}
+
+/* Unlink a node from whichever slot it is in. */
+static void unlink_node(wheel_shard *s, wheel_node *node)
+{
+    pj_list_erase(node);
+
+    if (node->level == LEVEL_PENDING) {
+        /* Nothing to update */
+    } else if (node->level == 0) {
+        if (pj_list_empty(&s->tv1[node->idx]))
+            clear_bit(s->tv1_map, node->idx);
+    } else {
+        unsigned level = node->level - 1;
+        if (pj_list_empty(&s->tvn[level][node->idx]))
+            clear_bit(s->tvn_map[level], node->idx);
+    }
+}
+
+/* Redistribute a slot of an upper level to the levels below. */
+static unsigned cascade(wheel_shard *s, unsigned level)
+{
+    unsigned idx = (unsigned)((s->cur >> TVN_SHIFT(level)) & TVN_MASK);
+    pj_list tmp;
+
+    pj_list_init(&tmp);
+    pj_list_merge_last(&tmp, &s->tvn[level][idx]);
+    clear_bit(s->tvn_map[level], idx);
+
+    while (!pj_list_empty(&tmp)) {
+        wheel_node *node = (wheel_node*)tmp.next;
+        pj_list_erase(node);
+        add_node(s, node);
+    }
+
+    return idx;
+}
+
+/* Check whether all slots of the wheel are empty. */
+static pj_bool_t wheel_empty(const wheel_shard *s)
+{
+    unsigned i, j;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(s->tv1_map); ++i) {
+        if (s->tv1_map[i])
+            return PJ_FALSE;
+    }
+    for (i = 0; i < TVN_LEVELS; ++i) {
+        for (j = 0; j < PJ_ARRAY_SIZE(s->tvn_map[i]); ++j) {
+            if (s->tvn_map[i][j])
+                return PJ_FALSE;
+        }
+    }
+    return PJ_TRUE;
+}
+
+/* Move the content of a first level slot to the pending list. */
+static void expire_slot(wheel_shard *s, unsigned idx)
+{
+    pj_list *slot = &s->tv1[idx];
+    wheel_node *node;
+
+    for (node = (wheel_node*)slot->next; node != (wheel_node*)slot;
+         node = node->next)
+    {
+        node->level = LEVEL_PENDING;
+    }
+    pj_list_merge_last(&s->pending, slot);
+    clear_bit(s->tv1_map, idx);
+}
+
+/* Process all ticks up to and including target, moving the expired
+ * entries to the pending list.
+ */
+static void advance(wheel_shard *s, tick_t target)
+{
+    if (wheel_empty(s)) {
+        /* Nothing in the wheel */
+        if (s->cur <= target)
+            s->cur = target + 1;
+        return;
+    }
+
+    while (s->cur <= target) {
+        unsigned idx = (unsigned)(s->cur & TVR_MASK);
+        unsigned last;
+        int next;
+
+        if (idx == 0) {
+            unsigned level;
+            for (level = 0; level < TVN_LEVELS; ++level) {
+                if (cascade(s, level) != 0)
+                    break;
+            }
+        }
+
+        /* Skip empty slots, but stop at the end of this round so that
+         * the upper levels get cascaded.
+         */
+        last = TVR_MASK;
+        if (target - s->cur < (tick_t)(TVR_MASK - idx))
+            last = idx + (unsigned)(target - s->cur);
+
+        next = find_bit(s->tv1_map, idx, last + 1);
+        if (next < 0) {
+            s->cur += last - idx + 1;
+            continue;
+        }
+
+        s->cur += (unsigned)next - idx;
+        expire_slot(s, next);
+        s->cur++;
+    }
+}
+
+/* Lower bound of the earliest expiry in the shard. Exact for entries in
+ * the first level and for pending ones.
+ */
+static pj_bool_t shard_earliest(wheel_shard *s, tick_t *p_tick)
+{
+    unsigned idx = (unsigned)(s->cur & TVR_MASK);
+    tick_t best = (tick_t)-1;
+    unsigned level;
+    int next;
+
+    if (s->count == 0)
+        return PJ_FALSE;
+
+    if (!pj_list_empty(&s->pending)) {
+        *p_tick = ((wheel_node*)s->pending.next)->expires;
+        return PJ_TRUE;
+    }
+
+    next = find_bit(s->tv1_map, idx, TVR_SIZE);
+    if (next >= 0) {
+        *p_tick = s->cur + ((unsigned)next - idx);
+        return PJ_TRUE;
+    }
+    next = find_bit(s->tv1_map, 0, idx);
+    if (next >= 0)
+        best = s->cur - idx + TVR_SIZE + (unsigned)next;
+
+    for (level = 0; level < TVN_LEVELS; ++level) {
+        tick_t base = s->cur >> TVN_SHIFT(level);
+        unsigned cur_idx = (unsigned)(base & TVN_MASK);
+        unsigned dist;
+        tick_t t;
+
+        next = find_bit(s->tvn_map[level], cur_idx + 1, TVN_SIZE);
+        if (next < 0)
+            next = find_bit(s->tvn_map[level], 0, cur_idx + 1);
+        if (next < 0)
+            continue;
+
+        dist = ((unsigned)next - cur_idx) & TVN_MASK;
+        if (dist == 0)
+            dist = TVN_SIZE;
+        t = (base + dist) << TVN_SHIFT(level);
+        if (t < best)
+            best = t;
+    }
+
+    *p_tick = best;
+    return PJ_TRUE;
+}
+
+
+static pj_status_t grow_shard(pj_pool_t *pool, wheel_shard *s)
+{
+    pj_size_t new_size = s->max_size * 2;
+    wheel_node **new_nodes;
+    wheel_node *chunk;
+    pj_size_t i;
+
+    PJ_LOG(6,(THIS_FILE, "Growing timer wheel shard from %lu to %lu",
+                         (unsigned long)s->max_size,
+                         (unsigned long)new_size));
+
+    new_nodes = (wheel_node**)
+                pj_pool_calloc(pool, new_size, sizeof(wheel_node*));
+    chunk = (wheel_node*)
+            pj_pool_calloc(pool, new_size - s->max_size, sizeof(wheel_node));
+    if (!new_nodes || !chunk)
+        return PJ_ENOMEM;
+
+    /* Nodes don't move, only the index table is reallocated */
+    pj_memcpy(new_nodes, s->nodes, s->max_size * sizeof(wheel_node*));
+    for (i = s->max_size; i < new_size; ++i) {
+        new_nodes[i] = &chunk[i - s->max_size];
+        new_nodes[i]->local_id = (pj_timer_id_t)i;
+        new_nodes[i]->next_free = (i + 1 < new_size)? (pj_timer_id_t)(i+1) : 0;
+    }
+    s->freelist = (pj_timer_id_t)s->max_size;
+    s->nodes = new_nodes;
+    s->max_size = new_size;
+
+    return PJ_SUCCESS;
+}
+
+static wheel_shard *create_shard(pj_pool_t *pool, pj_size_t size,
+                                 tick_t now)
+{
+    wheel_shard *s;
+    wheel_node *chunk;
+    unsigned i, j;
+
+    s = PJ_POOL_ZALLOC_T(pool, wheel_shard);
+    if (!s)
+        return NULL;
+
+    s->cur = now;
+    for (i = 0; i < TVR_SIZE; ++i)
+        pj_list_init(&s->tv1[i]);
+    for (i = 0; i < TVN_LEVELS; ++i) {
+        for (j = 0; j < TVN_SIZE; ++j)
+            pj_list_init(&s->tvn[i][j]);
+    }
+    pj_list_init(&s->pending);
+
+    s->max_size = size;
+    s->nodes = (wheel_node**)pj_pool_calloc(pool, size, sizeof(wheel_node*));
+    chunk = (wheel_node*)pj_pool_calloc(pool, size - 1, sizeof(wheel_node));
+    if (!s->nodes || !chunk)
+        return NULL;
+
+    for (i = 1; i < size; ++i) {
+        s->nodes[i] = &chunk[i - 1];
+        s->nodes[i]->local_id = (pj_timer_id_t)i;
+        s->nodes[i]->next_free = (i + 1 < size)? (pj_timer_id_t)(i + 1) : 0;
+    }
+    s->freelist = 1;
+
+    return s;
+}
+
+/* Release a node to the freelist. */
+static void free_node(wheel_shard *s, wheel_node *node)
+{
+    node->in_use = PJ_FALSE;
+    node->entry = NULL;
+    node->grp_lock = NULL;
+    node->next_free = s->freelist;
+    s->freelist = node->local_id;
+    --s->count;
+}
+
+
+/*
+ * Calculate memory size required to create a timer heap.
+ */
+PJ_DEF(pj_size_t) pj_timer_heap_mem_size(pj_size_t count)
+{
+    return /* size of the timer heap itself: */
+           sizeof(pj_timer_heap_t) +
+           SHARD_CNT * sizeof(wheel_shard) +
+           /* size of each entry: */
+           (count + 2 * SHARD_CNT) * (sizeof(wheel_node*) +
+                                      sizeof(wheel_node)) +
+           /* lock, pool etc: */
+           132 * SHARD_CNT;
+}
+
+/*
+ * Create a new timer heap.
+ */
+PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
+                                          pj_size_t size,
+                                          pj_timer_heap_t **p_heap)
+{
+    pj_timer_heap_t *ht;
+    tick_t now;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(pool && p_heap, PJ_EINVAL);
+
+    *p_heap = NULL;
+
+    ht = PJ_POOL_ZALLOC_T(pool, pj_timer_heap_t);
+    if (!ht)
+        return PJ_ENOMEM;
+
+    ht->pool = pool;
+    ht->max_entries_per_poll = DEFAULT_MAX_TIMED_OUT_PER_POLL;
+
+    /* Id zero is not used, hence the extra slot */
+    size = size / SHARD_CNT + 2;
+
+    now = now_tick();
+    for (i = 0; i < SHARD_CNT; ++i) {
+        ht->shards[i] = create_shard(pool, size, now);
+        if (!ht->shards[i])
+            return PJ_ENOMEM;
+    }
+
+    *p_heap = ht;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_timer_heap_destroy( pj_timer_heap_t *ht )
+{
+    unsigned i;
+
+    for (i = 0; i < SHARD_CNT; ++i) {
+        if (ht->shards[i]->lock) {
+            pj_lock_destroy(ht->shards[i]->lock);
+            ht->shards[i]->lock = NULL;
+        }
+    }
+
+    if (ht->lock && ht->auto_delete_lock) {
+        pj_lock_destroy(ht->lock);
+        ht->lock = NULL;
+    }
+}
+
+/*
+ * The wheel doesn't use the application lock itself. Setting one enables
+ * the per-shard locks.
+ */
+PJ_DEF(void) pj_timer_heap_set_lock(  pj_timer_heap_t *ht,
+                                      pj_lock_t *lock,
+                                      pj_bool_t auto_del )
+{
+    unsigned i;
+
+    if (ht->lock && ht->auto_delete_lock)
+        pj_lock_destroy(ht->lock);
+
+    ht->lock = lock;
+    ht->auto_delete_lock = auto_del;
+
+    if (!lock)
+        return;
+
+    for (i = 0; i < SHARD_CNT; ++i) {
+        wheel_shard *s = ht->shards[i];
+        pj_status_t status;
+
+        if (s->lock)
+            continue;
+
+        status = pj_lock_create_simple_mutex(ht->pool, "tmrwheel%p",
+                                             &s->lock);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(1,(THIS_FILE, status,
+                         "Unable to create timer wheel lock"));
+        }
+    }
+}
+
+
+PJ_DEF(unsigned) pj_timer_heap_set_max_timed_out_per_poll(pj_timer_heap_t *ht,
+                                                          unsigned count )
+{
+    unsigned old_count = ht->max_entries_per_poll;
+    ht->max_entries_per_poll = count;
+    return old_count;
+}
+
+PJ_DEF(pj_timer_entry*) pj_timer_entry_init( pj_timer_entry *entry,
+                                             int id,
+                                             void *user_data,
+                                             pj_timer_heap_callback *cb )
+{
+    pj_assert(entry && cb);
+
+    entry->_timer_id = -1;
+    entry->id = id;
+    entry->user_data = user_data;
+    entry->cb = cb;
+#if !PJ_TIMER_USE_COPY
+    entry->_grp_lock = NULL;
+#endif
+
+    return entry;
+}
+
+PJ_DEF(pj_bool_t) pj_timer_entry_running( pj_timer_entry *entry )
+{
+    return (entry->_timer_id >= 1);
+}
+
+#if PJ_TIMER_DEBUG
+static pj_status_t schedule_w_grp_lock_dbg(pj_timer_heap_t *ht,
+                                           pj_timer_entry *entry,
+                                           const pj_time_val *delay,
+                                           pj_bool_t set_id,
+                                           int id_val,
+                                           pj_grp_lock_t *grp_lock,
+                                           const char *src_file,
+                                           int src_line)
+#else
+static pj_status_t schedule_w_grp_lock(pj_timer_heap_t *ht,
+                                       pj_timer_entry *entry,
+                                       const pj_time_val *delay,
+                                       pj_bool_t set_id,
+                                       int id_val,
+                                       pj_grp_lock_t *grp_lock)
+#endif
+{
+    unsigned shard_idx;
+    wheel_shard *s;
+    wheel_node *node;
+    pj_timer_id_t local_id;
+    tick_t expires;
+    long msec;
+
+    PJ_ASSERT_RETURN(ht && entry && delay, PJ_EINVAL);
+    PJ_ASSERT_RETURN(entry->cb != NULL, PJ_EINVAL);
+
+    msec = PJ_TIME_VAL_MSEC(*delay);
+    expires = now_tick() + (msec > 0? (tick_t)msec : 0);
+
+    shard_idx = entry_shard(entry);
+    s = ht->shards[shard_idx];
+
+    lock_shard(s);
+
+    /* Prevent same entry from being scheduled more than once */
+    if (pj_timer_entry_running(entry)) {
+        unlock_shard(s);
+        PJ_LOG(3,(THIS_FILE, "Warning! Rescheduling outstanding entry (%p)",
+                  entry));
+        return PJ_EINVALIDOP;
+    }
+
+    if (s->freelist == 0) {
+        pj_status_t status = grow_shard(ht->pool, s);
+        if (status != PJ_SUCCESS) {
+            unlock_shard(s);
+            return status;
+        }
+    }
+
+    local_id = s->freelist;
+    node = s->nodes[local_id];
+    s->freelist = node->next_free;
+
+    entry->_timer_id = (pj_timer_id_t)(local_id * SHARD_CNT + shard_idx);
+    if (set_id)
+        entry->id = id_val;
+
+    node->entry = entry;
+#if PJ_TIMER_USE_COPY
+    pj_memcpy(&node->dup, entry, sizeof(*entry));
+#endif
+    node->expires = expires;
+    node->in_use = PJ_TRUE;
+    node->grp_lock = grp_lock;
+    if (grp_lock)
+        pj_grp_lock_add_ref(grp_lock);
+#if PJ_TIMER_DEBUG
+    node->src_file = src_file;
+    node->src_line = src_line;
+#endif
+
+    add_node(s, node);
+    ++s->count;
+
+    unlock_shard(s);
+
+    return PJ_SUCCESS;
+}
+
+
+#if PJ_TIMER_DEBUG
+PJ_DEF(pj_status_t) pj_timer_heap_schedule_dbg( pj_timer_heap_t *ht,
+                                                pj_timer_entry *entry,
+                                                const pj_time_val *delay,
+                                                const char *src_file,
+                                                int src_line)
+{
+    return schedule_w_grp_lock_dbg(ht, entry, delay, PJ_FALSE, 1, NULL,
+                                   src_file, src_line);
+}
+
+PJ_DEF(pj_status_t) pj_timer_heap_schedule_w_grp_lock_dbg(
+                                                pj_timer_heap_t *ht,
+                                                pj_timer_entry *entry,
+                                                const pj_time_val *delay,
+                                                int id_val,
+                                                pj_grp_lock_t *grp_lock,
+                                                const char *src_file,
+                                                int src_line)
+{
+    return schedule_w_grp_lock_dbg(ht, entry, delay, PJ_TRUE, id_val,
+                                   grp_lock, src_file, src_line);
+}
+
+#else
+PJ_DEF(pj_status_t) pj_timer_heap_schedule( pj_timer_heap_t *ht,
+                                            pj_timer_entry *entry,
+                                            const pj_time_val *delay)
+{
+    return schedule_w_grp_lock(ht, entry, delay, PJ_FALSE, 1, NULL);
+}
+
+PJ_DEF(pj_status_t) pj_timer_heap_schedule_w_grp_lock(pj_timer_heap_t *ht,
+                                                      pj_timer_entry *entry,
+                                                      const pj_time_val *delay,
+                                                      int id_val,
+                                                      pj_grp_lock_t *grp_lock)
+{
+    return schedule_w_grp_lock(ht, entry, delay, PJ_TRUE, id_val, grp_lock);
+}
+#endif
+
+static int cancel_timer(pj_timer_heap_t *ht,
+                        pj_timer_entry *entry,
+                        unsigned flags,
+                        int id_val)
+{
+    unsigned shard_idx;
+    wheel_shard *s;
+    wheel_node *node;
+    pj_timer_id_t timer_id, local_id;
+    pj_grp_lock_t *grp_lock;
+
+    PJ_ASSERT_RETURN(ht && entry, PJ_EINVAL);
+
+    shard_idx = entry_shard(entry);
+    s = ht->shards[shard_idx];
+
+    lock_shard(s);
+
+    // Check to see if the timer_id is out of range
+    timer_id = entry->_timer_id;
+    local_id = timer_id / SHARD_CNT;
+    if (timer_id < 1 || (unsigned)(timer_id % SHARD_CNT) != shard_idx ||
+        local_id < 1 || (pj_size_t)local_id >= s->max_size)
+    {
+        unlock_shard(s);
+        return 0;
+    }
+
+    node = s->nodes[local_id];
+    if (!node->in_use) {
+        entry->_timer_id = -1;
+        unlock_shard(s);
+        return 0;
+    }
+
+    if (node->entry != entry) {
+        if ((flags & F_DONT_ASSERT) == 0)
+            pj_assert(node->entry == entry);
+        entry->_timer_id = -1;
+        unlock_shard(s);
+        return 0;
+    }
+
+    grp_lock = node->grp_lock;
+    unlink_node(s, node);
+    free_node(s, node);
+    entry->_timer_id = -1;
+
+    if (flags & F_SET_ID) {
+        entry->id = id_val;
+    }
+
+    unlock_shard(s);
+
+    if (grp_lock) {
+        pj_grp_lock_dec_ref(grp_lock);
+    }
+
+    return 1;
+}
+
+PJ_DEF(int) pj_timer_heap_cancel( pj_timer_heap_t *ht,
+                                  pj_timer_entry *entry)
+{
+    return cancel_timer(ht, entry, 0, 0);
+}
+
+PJ_DEF(int) pj_timer_heap_cancel_if_active(pj_timer_heap_t *ht,
+                                           pj_timer_entry *entry,
+                                           int id_val)
+{
+    return cancel_timer(ht, entry, F_SET_ID | F_DONT_ASSERT, id_val);
+}
+
+PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
+                                     pj_time_val *next_delay )
+{
+    tick_t now, earliest = (tick_t)-1;
+    unsigned count = 0;
+    unsigned start, i;
+
+    PJ_ASSERT_RETURN(ht, 0);
+
+    now = now_tick();
+
+    /* Rotate the first shard so that none is starved when there are
+     * more expired entries than max_entries_per_poll.
+     */
+    start = ht->poll_start++;
+
+    for (i = 0; i < SHARD_CNT && count < ht->max_entries_per_poll; ++i) {
+        wheel_shard *s = ht->shards[(start + i) % SHARD_CNT];
+
+        lock_shard(s);
+
+        advance(s, now);
+
+        while (!pj_list_empty(&s->pending) &&
+               count < ht->max_entries_per_poll)
+        {
+            wheel_node *node = (wheel_node*)s->pending.next;
+            pj_timer_entry *entry = node->entry;
+            pj_grp_lock_t *grp_lock = node->grp_lock;
+            pj_bool_t valid = PJ_TRUE;
+
+            ++count;
+
+#if PJ_TIMER_USE_COPY
+            if (node->dup.cb != entry->cb ||
+                node->dup.user_data != entry->user_data ||
+                node->dup._timer_id != entry->_timer_id)
+            {
+                valid = PJ_FALSE;
+#if PJ_TIMER_DEBUG
+                PJ_LOG(3,(THIS_FILE, "Bug! Polling entry %p from %s line %d "
+                                     "has been deallocated without being "
+                                     "cancelled",
+                                     entry, node->src_file, node->src_line));
+#else
+                PJ_LOG(3,(THIS_FILE, "Bug! Polling entry %p has "
+                                     "been deallocated without being "
+                                     "cancelled", entry));
+#endif
+            }
+#endif
+
+            unlink_node(s, node);
+            free_node(s, node);
+            if (valid)
+                entry->_timer_id = -1;
+
+            unlock_shard(s);
+
+            PJ_RACE_ME(5);
+
+            if (valid && entry->cb)
+                (*entry->cb)(ht, entry);
+
+            if (valid && grp_lock)
+                pj_grp_lock_dec_ref(grp_lock);
+
+            lock_shard(s);
+        }
+
+        unlock_shard(s);
+    }
+
+    if (next_delay) {
+        for (i = 0; i < SHARD_CNT; ++i) {
+            wheel_shard *s = ht->shards[i];
+            tick_t t;
+
+            lock_shard(s);
+            if (shard_earliest(s, &t) && t < earliest)
+                earliest = t;
+            unlock_shard(s);
+        }
+
+        if (earliest == (tick_t)-1) {
+            next_delay->sec = next_delay->msec = PJ_MAXINT32;
+        } else {
+            if (count > 0)
+                now = now_tick();
+            if (earliest <= now) {
+                next_delay->sec = next_delay->msec = 0;
+            } else {
+                tick_t delta = earliest - now;
+                next_delay->sec = (long)(delta / 1000);
+                next_delay->msec = (long)(delta % 1000);
+            }
+        }
+    }
+
+    return count;
+}
+
+PJ_DEF(pj_size_t) pj_timer_heap_count( pj_timer_heap_t *ht )
+{
+    pj_size_t count = 0;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(ht, 0);
+
+    for (i = 0; i < SHARD_CNT; ++i)
+        count += ht->shards[i]->count;
+
+    return count;
+}
+
+PJ_DEF(pj_status_t) pj_timer_heap_earliest_time( pj_timer_heap_t * ht,
+                                                 pj_time_val *timeval)
+{
+    tick_t earliest = (tick_t)-1;
+    unsigned i;
+
+    for (i = 0; i < SHARD_CNT; ++i) {
+        wheel_shard *s = ht->shards[i];
+        tick_t t;
+
+        lock_shard(s);
+        if (shard_earliest(s, &t) && t < earliest)
+            earliest = t;
+        unlock_shard(s);
+    }
+
+    pj_assert(earliest != (tick_t)-1);
+    if (earliest == (tick_t)-1)
+        return PJ_ENOTFOUND;
+
+    timeval->sec = (long)(earliest / 1000);
+    timeval->msec = (long)(earliest % 1000);
+
+    return PJ_SUCCESS;
+}
+
+#if PJ_TIMER_DEBUG
+PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
+{
+    tick_t now = now_tick();
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, "Dumping timer wheel:"));
+    PJ_LOG(3,(THIS_FILE, "  Cur size: %d entries in %d shards",
+                         (int)pj_timer_heap_count(ht), SHARD_CNT));
+
+    for (i = 0; i < SHARD_CNT; ++i) {
+        wheel_shard *s = ht->shards[i];
+        pj_size_t j;
+
+        lock_shard(s);
+
+        if (s->count) {
+            PJ_LOG(3,(THIS_FILE, "  Shard %d, %d entries: ", i,
+                                 (int)s->count));
+            PJ_LOG(3,(THIS_FILE, "    _id\tId\tElapsed\tSource"));
+            PJ_LOG(3,(THIS_FILE, "    ----------------------------------"));
+        }
+
+        for (j = 1; j < s->max_size && s->count; ++j) {
+            wheel_node *e = s->nodes[j];
+            tick_t delta;
+
+            if (!e->in_use)
+                continue;
+
+            delta = (e->expires > now)? e->expires - now : 0;
+            PJ_LOG(3,(THIS_FILE, "    %d\t%d\t%d.%03d\t%s:%d",
+                      (int)(j * SHARD_CNT + i), e->entry->id,
+                      (int)(delta / 1000), (int)(delta % 1000),
+                      e->src_file, e->src_line));
+        }
+
+        unlock_shard(s);
+    }
+}
+#endif
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when the timing wheel is not used.
+ */
+int dummy_timer_wheel;
+#endif  /* PJ_TIMER_USE_WHEEL */
@@ -17,9 +17,12 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
  */
 #include <pj/hash.h>
+#include <pj/ohash.h>
 #include <pj/rand.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/pool.h>
+#include <pj/string.h>
 #include "test.h"
 
 #if INCLUDE_HASH_TEST
@@ -128,6 +131,251 @@ static int hash_collision_test(pj_pool_t *pool)
     return 0;
 }
 
+static int ohash_basic_test(pj_pool_t *pool)
+{
+    enum {
+        COUNT = 5000
+    };
+    pj_ohash_t *ht;
+    pj_ohash_iterator_t it_buf, *it;
+    unsigned *keys;
+    unsigned i, j, n;
+    pj_status_t status;
+
+    /* Start small to exercise growing and migration */
+    status = pj_ohash_create(pool, 0, 0, &ht);
+    if (status != PJ_SUCCESS)
+        return -300;
+
+    keys = (unsigned*) pj_pool_alloc(pool, COUNT * sizeof(unsigned));
+
+    for (i=0; i<COUNT; ++i) {
+        keys[i] = i * 2654435761U;
+        status = pj_ohash_set(ht, &keys[i], sizeof(unsigned), 0, &keys[i]);
+        if (status != PJ_SUCCESS) {
+            pj_ohash_destroy(ht);
+            return -310;
+        }
+
+        /* Periodically verify everything inserted so far */
+        if (i % 97 == 0 || i == COUNT-1) {
+            for (j=0; j<=i; ++j) {
+                if (pj_ohash_get(ht, &keys[j], sizeof(unsigned),
+                                 NULL) != &keys[j])
+                {
+                    pj_ohash_destroy(ht);
+                    return -320;
+                }
+            }
+        }
+    }
+
+    if (pj_ohash_count(ht) != COUNT) {
+        pj_ohash_destroy(ht);
+        return -330;
+    }
+
+    /* Remove half of the entries */
+    for (i=0; i<COUNT; i+=2)
+        pj_ohash_set(ht, &keys[i], sizeof(unsigned), 0, NULL);
+
+    for (i=0; i<COUNT; ++i) {
+        void *value = pj_ohash_get(ht, &keys[i], sizeof(unsigned), NULL);
+        if ((i % 2 == 0 && value != NULL) ||
+            (i % 2 == 1 && value != &keys[i]))
+        {
+            pj_ohash_destroy(ht);
+            return -340;
+        }
+    }
+
+    if (pj_ohash_count(ht) != COUNT / 2) {
+        pj_ohash_destroy(ht);
+        return -350;
+    }
+
+    /* Insert them back (reusing deleted slots) */
+    for (i=0; i<COUNT; i+=2)
+        pj_ohash_set(ht, &keys[i], sizeof(unsigned), 0, &keys[i]);
+
+    /* Iterate, removing each entry while iterating */
+    n = 0;
+    it = pj_ohash_first(ht, &it_buf);
+    while (it) {
+        unsigned *entry = (unsigned*) pj_ohash_this(ht, it);
+        it = pj_ohash_next(ht, it);
+        pj_ohash_set(ht, entry, sizeof(unsigned), 0, NULL);
+        ++n;
+    }
+
+    if (n != COUNT || pj_ohash_count(ht) != 0 ||
+        pj_ohash_first(ht, &it_buf) != NULL)
+    {
+        pj_ohash_destroy(ht);
+        return -360;
+    }
+
+    pj_ohash_destroy(ht);
+    return 0;
+}
+
+
+static int ohash_icase_test(pj_pool_t *pool)
+{
+    pj_ohash_t *ht;
+    pj_str_t key = { "Z9hG4bK-Branch", 14 };
+    pj_uint32_t hval = 0;
+    int value = 1;
+    pj_status_t status;
+
+    status = pj_ohash_create(pool, 16, PJ_OHASH_ICASE, &ht);
+    if (status != PJ_SUCCESS)
+        return -400;
+
+    pj_ohash_set(ht, key.ptr, (unsigned)key.slen, 0, &value);
+
+    /* Hash value must be compatible with pj_hash_calc_tolower() */
+    if (pj_ohash_get(ht, "z9hg4bk-branch", PJ_HASH_KEY_STRING,
+                     &hval) != &value ||
+        hval != pj_hash_calc_tolower(0, NULL, &key))
+    {
+        pj_ohash_destroy(ht);
+        return -410;
+    }
+
+    /* Precalculated hash value */
+    if (pj_ohash_get(ht, "Z9HG4BK-BRANCH", 14, &hval) != &value) {
+        pj_ohash_destroy(ht);
+        return -420;
+    }
+
+    pj_ohash_set(ht, "z9hG4bK-branch", PJ_HASH_KEY_STRING, hval, NULL);
+    if (pj_ohash_count(ht) != 0) {
+        pj_ohash_destroy(ht);
+        return -430;
+    }
+
+    pj_ohash_destroy(ht);
+    return 0;
+}
+
+
+#if WITH_BENCHMARK
+/*
+ * Compare pj_hash and pj_ohash with SIP-like keys, both created with the
+ * default transaction table size.
+ */
+static int hash_bench(unsigned count)
+{
+    enum {
+        TABLE_SIZE = 1023,
+        KEY_LEN = 32
+    };
+    pj_pool_t *pool;
+    pj_hash_table_t *ht;
+    pj_ohash_t *oht;
+    char *keys;
+    pj_uint32_t *hvals;
+    pj_timestamp t1, t2;
+    pj_uint32_t usec[2][3];
+    unsigned i, miss = 0;
+
+    pool = pj_pool_create(mem, "hashbench", 64*1024, 64*1024, NULL);
+    if (!pool)
+        return -500;
+
+    keys = (char*) pj_pool_alloc(pool, count * KEY_LEN);
+    hvals = (pj_uint32_t*) pj_pool_zalloc(pool, count * sizeof(pj_uint32_t));
+    for (i=0; i<count; ++i) {
+        pj_ansi_snprintf(keys + i*KEY_LEN, KEY_LEN, "z9hG4bK%08x%06u",
+                         pj_rand(), i);
+    }
+
+    /* pj_hash */
+    ht = pj_hash_create(pool, TABLE_SIZE);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<count; ++i) {
+        pj_hash_set_lower(pool, ht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING,
+                          0, keys + i*KEY_LEN);
+    }
+    pj_get_timestamp(&t2);
+    usec[0][0] = pj_elapsed_usec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<count; ++i) {
+        if (pj_hash_get_lower(ht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING,
+                              &hvals[i]) == NULL)
+        {
+            ++miss;
+        }
+    }
+    pj_get_timestamp(&t2);
+    usec[0][1] = pj_elapsed_usec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<count; ++i) {
+        pj_hash_set_lower(NULL, ht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING,
+                          hvals[i], NULL);
+    }
+    pj_get_timestamp(&t2);
+    usec[0][2] = pj_elapsed_usec(&t1, &t2);
+
+    /* pj_ohash */
+    if (pj_ohash_create(pool, TABLE_SIZE, PJ_OHASH_ICASE,
+                        &oht) != PJ_SUCCESS)
+    {
+        pj_pool_release(pool);
+        return -510;
+    }
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<count; ++i) {
+        pj_ohash_set(oht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING, 0,
+                     keys + i*KEY_LEN);
+    }
+    pj_get_timestamp(&t2);
+    usec[1][0] = pj_elapsed_usec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<count; ++i) {
+        if (pj_ohash_get(oht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING,
+                         &hvals[i]) == NULL)
+        {
+            ++miss;
+        }
+    }
+    pj_get_timestamp(&t2);
+    usec[1][1] = pj_elapsed_usec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<count; ++i) {
+        pj_ohash_set(oht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING, hvals[i],
+                     NULL);
+    }
+    pj_get_timestamp(&t2);
+    usec[1][2] = pj_elapsed_usec(&t1, &t2);
+
+    if (pj_hash_count(ht) != 0 || pj_ohash_count(oht) != 0)
+        miss = 1;
+
+    pj_ohash_destroy(oht);
+    pj_pool_release(pool);
+
+    if (miss)
+        return -520;
+
+    for (i=0; i<2; ++i) {
+        PJ_LOG(3,("", "    %-8s %7u entries: insert %6u usec, "
+                  "lookup %6u usec, remove %6u usec",
+                  (i==0? "pj_hash" : "pj_ohash"), count,
+                  usec[i][0], usec[i][1], usec[i][2]));
+    }
+
+    return 0;
+}
+#endif  /* WITH_BENCHMARK */
+
 
 /*
  * Hash table test.
@@ -154,6 +402,34 @@ int hash_test(void)
         return rc;
     }
 
+    /* Open addressing hash table tests */
+    rc = ohash_basic_test(pool);
+    if (rc != 0) {
+        pj_pool_release(pool);
+        return rc;
+    }
+
+    rc = ohash_icase_test(pool);
+    if (rc != 0) {
+        pj_pool_release(pool);
+        return rc;
+    }
+
+#if WITH_BENCHMARK
+    {
+        static const unsigned counts[] = { 1000, 10000, 100000 };
+
+        PJ_LOG(3,("", "  Benchmarking pj_hash vs pj_ohash:"));
+        for (i=0; i<PJ_ARRAY_SIZE(counts); ++i) {
+            rc = hash_bench(counts[i]);
+            if (rc != 0) {
+                pj_pool_release(pool);
+                return rc;
+            }
+        }
+    }
+#endif
+
     pj_pool_release(pool);
     return 0;
 }
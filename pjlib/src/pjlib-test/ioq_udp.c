@@ -184,6 +184,7 @@ static int compliance_test(const pj_ioqueue_cfg *cfg)
     ioque_name = pj_str((char*)pj_ioqueue_name());
     if (pj_strncmp(&ioque_name, pj_cstr(&ioqueue_type, "epoll"), 5) == 0 ||
         pj_strncmp(&ioque_name, pj_cstr(&ioqueue_type, "kqueue"), 6) == 0 ||
+        pj_strncmp(&ioque_name, pj_cstr(&ioqueue_type, "io_uring"), 8) == 0 ||
         pj_strncmp(&ioque_name, pj_cstr(&ioqueue_type, "iocp"), 4) == 0) {
       if (pj_ioqueue_get_os_handle(ioque) == NULL) {
         PJ_LOG(1,(
@@ -1168,6 +1169,145 @@ on_error:
     return -1;
 }
 
+/*
+ * recvmmsg_test()
+ * Post a single pj_ioqueue_recvmmsg() and verify that one completion
+ * delivers one or more datagrams intact, until all sent datagrams have
+ * been received.
+ */
+static int recvmmsg_test(const pj_ioqueue_cfg *cfg)
+{
+    enum { RPORT = 50002, SPORT = 50003, PKT_CNT = 8, PKT_LEN = 40 };
+    pj_pool_t *pool;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_sock_t ssock = PJ_INVALID_SOCKET, rsock = PJ_INVALID_SOCKET;
+    pj_ioqueue_key_t *key = NULL;
+    pj_ioqueue_op_key_t opkey;
+    pj_sock_mmsg msg[PKT_CNT];
+    pj_sockaddr_in src_addr[PKT_CNT], dst_addr;
+    char sendbuf[PKT_CNT][PKT_LEN], recvbuf[PKT_CNT][PKT_LEN];
+    unsigned i, count, received = 0;
+    pj_str_t temp;
+    pj_status_t status;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "recvmmsg", 4000, 4000, NULL);
+    if (!pool) {
+        app_perror("Unable to create pool", PJ_ENOMEM);
+        return -300;
+    }
+
+    status = pj_ioqueue_create2(pool, 4, cfg, &ioqueue);
+    if (status != PJ_SUCCESS) {
+        app_perror("Error creating ioqueue", status);
+        rc = -310; goto on_return;
+    }
+
+    status = app_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, SPORT, &ssock);
+    if (status == PJ_SUCCESS)
+        status = app_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, RPORT, &rsock);
+    if (status != PJ_SUCCESS) {
+        app_perror("Error initializing socket", status);
+        rc = -320; goto on_return;
+    }
+
+    status = pj_ioqueue_register_sock(pool, ioqueue, rsock, NULL,
+                                      &test_cb, &key);
+    if (status != PJ_SUCCESS) {
+        app_perror("Error registering to ioqueue", status);
+        rc = -330; goto on_return;
+    }
+
+    pj_sockaddr_in_init(&dst_addr, pj_cstr(&temp, "127.0.0.1"), RPORT);
+    for (i = 0; i < PKT_CNT; ++i) {
+        pj_memset(sendbuf[i], 'a' + i, PKT_LEN);
+    }
+
+    pj_ioqueue_op_key_init(&opkey, sizeof(opkey));
+
+    while (received < PKT_CNT) {
+        pj_time_val timeout = { 1, 0 };
+        pj_timestamp t1, t2;
+
+        for (i = 0; i < PKT_CNT; ++i) {
+            msg[i].buf = recvbuf[i];
+            msg[i].len = PKT_LEN;
+            msg[i].addr = &src_addr[i];
+            msg[i].addr_len = sizeof(src_addr[i]);
+        }
+        count = PKT_CNT - received;
+        callback_read_size = -1;
+        callback_read_key = NULL;
+
+        status = pj_ioqueue_recvmmsg(key, &opkey, msg, &count,
+                                     PJ_IOQUEUE_ALWAYS_ASYNC);
+        if (status == PJ_ENOTSUP) {
+            PJ_LOG(3, (THIS_FILE, "....recvmmsg not supported by %s, "
+                       "skipped", pj_ioqueue_name()));
+            goto on_return;
+        } else if (status != PJ_EPENDING) {
+            app_perror("Expecting PJ_EPENDING, but got this", status);
+            rc = -340; goto on_return;
+        }
+
+        /* Send the whole burst before polling on the first round. */
+        if (received == 0) {
+            for (i = 0; i < PKT_CNT; ++i) {
+                pj_ssize_t bytes = PKT_LEN;
+                status = pj_sock_sendto(ssock, sendbuf[i], &bytes, 0,
+                                        &dst_addr, sizeof(dst_addr));
+                if (status != PJ_SUCCESS || bytes != PKT_LEN) {
+                    app_perror("sendto() error", status);
+                    rc = -350; goto on_return;
+                }
+            }
+        }
+
+        pj_get_timestamp(&t1);
+        while (callback_read_key != key) {
+            pj_ioqueue_poll(ioqueue, &timeout);
+            pj_get_timestamp(&t2);
+            if (pj_elapsed_msec(&t1, &t2) > 5000) {
+                PJ_LOG(3, (THIS_FILE, "...error: timed out waiting for "
+                           "recvmmsg completion"));
+                rc = -360; goto on_return;
+            }
+        }
+
+        if (callback_read_op != &opkey || callback_read_size < 1 ||
+            callback_read_size > (pj_ssize_t)(PKT_CNT - received))
+        {
+            PJ_LOG(3, (THIS_FILE, "...error: recvmmsg completed with "
+                       "%d datagrams", (int)callback_read_size));
+            rc = -370; goto on_return;
+        }
+
+        for (i = 0; i < (unsigned)callback_read_size; ++i) {
+            if (msg[i].len != PKT_LEN ||
+                pj_memcmp(recvbuf[i], sendbuf[received], PKT_LEN) != 0 ||
+                src_addr[i].sin_port != pj_htons(SPORT))
+            {
+                PJ_LOG(3, (THIS_FILE, "...error: datagram %u mismatch",
+                           received));
+                rc = -380; goto on_return;
+            }
+            ++received;
+        }
+    }
+
+on_return:
+    if (key)
+        pj_ioqueue_unregister(key);
+    else if (rsock != PJ_INVALID_SOCKET)
+        pj_sock_close(rsock);
+    if (ssock != PJ_INVALID_SOCKET)
+        pj_sock_close(ssock);
+    if (ioqueue)
+        pj_ioqueue_destroy(ioqueue);
+    pj_pool_release(pool);
+    return rc;
+}
+
 static int udp_ioqueue_test_imp(const pj_ioqueue_cfg *cfg)
 {
     int status;
@@ -1185,6 +1325,12 @@ static int udp_ioqueue_test_imp(const pj_ioqueue_cfg *cfg)
     }
     PJ_LOG(3, (THIS_FILE, "....compliance test ok"));
 
+    PJ_LOG(3, (THIS_FILE, "...recvmmsg test (%s)", title));
+    if ((status=recvmmsg_test(cfg)) != 0) {
+        return status;
+    }
+    PJ_LOG(3, (THIS_FILE, "....recvmmsg test ok"));
+
 
     PJ_LOG(3, (THIS_FILE, "...unregister test (%s)", title));
     if ((status=unregister_test(cfg)) != 0) {
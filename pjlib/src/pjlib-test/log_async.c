@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+#include <pj/errno.h>
+#include <string.h>
+#include <stdio.h>
+
+/**
+ * \page page_pjlib_log_async_test Test: Asynchronous Logging
+ *
+ * This file provides implementation of \b log_async_test(). It tests the
+ * asynchronous logging pipeline:
+ *  - messages from several threads are all written, in order for each
+ *    thread, and only by the log thread,
+ *  - with PJ_LOG_ASYNC_DROP policy, messages are dropped and counted
+ *    when the writer can not keep up.
+ *
+ * This file is <b>pjlib-test/log_async.c</b>
+ *
+ * \include pjlib-test/log_async.c
+ */
+
+#if INCLUDE_LOG_ASYNC_TEST
+
+#define THIS_FILE       "log_async.c"
+#define THREAD_CNT      4
+
+static struct log_test_state
+{
+    pj_thread_t    *writer_thread;
+    pj_bool_t       slow;
+    unsigned        count;
+    unsigned        drop_reports;
+    unsigned        err;
+    unsigned        last_seq[THREAD_CNT];
+    unsigned        msg_per_thread;
+} state;
+
+static void test_writer(int level, const char *buffer, int len)
+{
+    unsigned id, seq;
+
+    PJ_UNUSED_ARG(level);
+    PJ_UNUSED_ARG(len);
+
+    if (!state.writer_thread)
+        state.writer_thread = pj_thread_this();
+    else if (state.writer_thread != pj_thread_this())
+        ++state.err;
+
+    if (strstr(buffer, "dropped")) {
+        ++state.drop_reports;
+        return;
+    }
+
+    if (sscanf(buffer, "thread %u seq %u", &id, &seq) != 2 ||
+        id >= THREAD_CNT || seq <= state.last_seq[id])
+    {
+        ++state.err;
+        return;
+    }
+
+    state.last_seq[id] = seq;
+    ++state.count;
+
+    if (state.slow)
+        pj_thread_sleep(1);
+}
+
+static int producer(void *arg)
+{
+    unsigned id = (unsigned)(pj_ssize_t)arg;
+    unsigned i;
+
+    for (i=1; i<=state.msg_per_thread; ++i)
+        PJ_LOG(5,(THIS_FILE, "thread %u seq %u", id, i));
+
+    return 0;
+}
+
+static int run_producers(pj_pool_t *pool)
+{
+    pj_thread_t *threads[THREAD_CNT];
+    unsigned i;
+    pj_status_t status;
+
+    for (i=0; i<THREAD_CNT; ++i) {
+        status = pj_thread_create(pool, "logprod", &producer,
+                                  (void*)(pj_ssize_t)i, 0, 0, &threads[i]);
+        if (status != PJ_SUCCESS)
+            return -10;
+    }
+
+    for (i=0; i<THREAD_CNT; ++i) {
+        pj_thread_join(threads[i]);
+        pj_thread_destroy(threads[i]);
+    }
+
+    return 0;
+}
+
+static int async_test(pj_pool_t *pool, pj_log_async_policy policy)
+{
+    pj_log_async_param prm;
+    pj_uint32_t dropped;
+    pj_status_t status;
+    int rc;
+
+    pj_bzero(&state, sizeof(state));
+    state.slow = (policy == PJ_LOG_ASYNC_DROP);
+    state.msg_per_thread = state.slow ? 2000 : 20000;
+
+    pj_log_async_param_default(&prm);
+    prm.ring_size = 0;  /* Smallest possible */
+    prm.policy = policy;
+
+    status = pj_log_async_start(mem, &prm);
+    if (status == PJ_ENOTSUP)
+        return 0;
+    if (status != PJ_SUCCESS)
+        return -20;
+
+    rc = run_producers(pool);
+
+    dropped = pj_log_async_get_dropped();
+    pj_log_async_stop();
+
+    if (rc != 0)
+        return rc;
+
+    if (state.err)
+        return -30;
+
+    if (state.writer_thread == NULL || state.writer_thread == pj_thread_this())
+        return -40;
+
+    if (state.count + dropped != THREAD_CNT * state.msg_per_thread)
+        return -50;
+
+    if (policy == PJ_LOG_ASYNC_WAIT && dropped != 0)
+        return -60;
+
+    if (policy == PJ_LOG_ASYNC_DROP && (dropped == 0 || !state.drop_reports))
+        return -70;
+
+    return 0;
+}
+
+int log_async_test(void)
+{
+    pj_pool_t *pool;
+    pj_log_func *old_func = pj_log_get_log_func();
+    unsigned old_decor = pj_log_get_decor();
+    int old_level = pj_log_get_level();
+    int rc;
+
+    pool = pj_pool_create(mem, "logtest", 4000, 4000, NULL);
+
+    pj_log_set_log_func(&test_writer);
+    pj_log_set_decor(PJ_LOG_HAS_NEWLINE);
+    pj_log_set_level(5);
+
+    rc = async_test(pool, PJ_LOG_ASYNC_WAIT);
+    if (rc == 0)
+        rc = async_test(pool, PJ_LOG_ASYNC_DROP);
+
+    pj_log_set_level(old_level);
+    pj_log_set_decor(old_decor);
+    pj_log_set_log_func(old_func);
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_log_async_test;
+#endif  /* INCLUDE_LOG_ASYNC_TEST */
@@ -0,0 +1,684 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pj/mpqueue.h>
+#include <pj/errno.h>
+#include <pj/list.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+/**
+ * \page page_pjlib_mpqueue_test Test: Lock-free Multi-producer Queues
+ *
+ * This file provides implementation of \b mpqueue_test(). It tests the
+ * functionality of #pj_mpmc_queue_t, #pj_mpsc_queue_t and
+ * #pj_mpmc_uqueue_t, and stresses them with several producer (and consumer) threads, checking that every
+ * item is received exactly once and in the order each producer pushed
+ * it.
+ *
+ * This file is <b>pjlib-test/mpqueue_test.c</b>
+ *
+ * \include pjlib-test/mpqueue_test.c
+ */
+
+#if INCLUDE_MPQUEUE_TEST
+
+#define THIS_FILE       "mpqueue_test.c"
+#define PRODUCER_CNT    4
+#define CONSUMER_CNT    4
+#define ITEM_CNT        100000
+
+/* Item value pushed to the MPMC queue: producer id and sequence. */
+#define ITEM(id,seq)    ((void*)(pj_ssize_t)(((id) << 24) | (seq)))
+#define ITEM_ID(it)     ((unsigned)((pj_ssize_t)(it) >> 24))
+#define ITEM_SEQ(it)    ((unsigned)((pj_ssize_t)(it) & 0xFFFFFF))
+
+typedef struct mpsc_item
+{
+    pj_mpsc_queue_node  node;
+    unsigned            id;
+    unsigned            seq;
+} mpsc_item;
+
+static struct stress_state
+{
+    pj_mpmc_queue_t    *mpmc;
+    pj_mpsc_queue_t    *mpsc;
+    pj_mpmc_uqueue_t   *umpmc;
+    mpsc_item          *items[PRODUCER_CNT];
+    pj_atomic_t        *popped;
+    pj_atomic_t        *errors;
+} st;
+
+
+static int mpmc_basic_test(pj_pool_t *pool)
+{
+    pj_mpmc_queue_t *q;
+    unsigned i, cap;
+    void *item;
+    pj_status_t status;
+
+    status = pj_mpmc_queue_create(pool, 5, &q);
+    if (status != PJ_SUCCESS)
+        return -10;
+
+    cap = pj_mpmc_queue_capacity(q);
+    if (cap != 8)
+        return -20;
+
+    if (pj_mpmc_queue_pop(q, &item) != PJ_ENOTFOUND)
+        return -30;
+
+    /* Wrap around the ring several times */
+    for (i=0; i<cap*3; ++i) {
+        unsigned j;
+
+        for (j=0; j<cap; ++j) {
+            if (pj_mpmc_queue_push(q, ITEM(0, i*cap + j)) != PJ_SUCCESS)
+                return -40;
+        }
+        if (pj_mpmc_queue_push(q, ITEM(0, 0)) != PJ_ETOOMANY)
+            return -50;
+
+        for (j=0; j<cap; ++j) {
+            if (pj_mpmc_queue_pop(q, &item) != PJ_SUCCESS)
+                return -60;
+            if (ITEM_SEQ(item) != i*cap + j)
+                return -70;
+        }
+        if (pj_mpmc_queue_pop(q, &item) != PJ_ENOTFOUND)
+            return -80;
+    }
+
+    /* NULL is a valid item */
+    if (pj_mpmc_queue_push(q, NULL) != PJ_SUCCESS ||
+        pj_mpmc_queue_pop(q, &item) != PJ_SUCCESS || item != NULL)
+    {
+        return -90;
+    }
+
+    pj_mpmc_queue_destroy(q);
+    return 0;
+}
+
+/* Pop a node, retrying while a push is in progress. */
+static pj_mpsc_queue_node *mpsc_pop(pj_mpsc_queue_t *q)
+{
+    pj_mpsc_queue_node *node;
+
+    while (pj_mpsc_queue_pop(q, &node) == PJ_EPENDING)
+        pj_thread_sleep(0);
+
+    return node;
+}
+
+static int mpsc_basic_test(pj_pool_t *pool)
+{
+    pj_mpsc_queue_t *q;
+    pj_mpsc_queue_node *node;
+    mpsc_item items[4];
+    mpsc_item *it;
+    unsigned i, round;
+    pj_status_t status;
+
+    status = pj_mpsc_queue_create(pool, &q);
+    if (status != PJ_SUCCESS)
+        return -110;
+
+    if (!pj_mpsc_queue_is_empty(q) ||
+        pj_mpsc_queue_pop(q, &node) != PJ_ENOTFOUND || node != NULL)
+    {
+        return -120;
+    }
+
+    /* Alternate between single and multiple nodes, so the queue goes
+     * through the empty state (with the stub re-pushed) several times.
+     */
+    for (round=1; round<=PJ_ARRAY_SIZE(items); ++round) {
+        for (i=0; i<round; ++i) {
+            items[i].seq = i;
+            pj_mpsc_queue_push(q, &items[i].node);
+        }
+
+        if (pj_mpsc_queue_is_empty(q))
+            return -130;
+
+        for (i=0; i<round; ++i) {
+            if (pj_mpsc_queue_pop(q, &node) != PJ_SUCCESS)
+                return -135;
+            it = (mpsc_item*) node;
+            if (it != &items[i])
+                return -140;
+        }
+
+        if (!pj_mpsc_queue_is_empty(q) ||
+            pj_mpsc_queue_pop(q, &node) != PJ_ENOTFOUND)
+        {
+            return -150;
+        }
+    }
+
+    /* A popped node can be pushed again right away */
+    pj_mpsc_queue_push(q, &items[0].node);
+    it = (mpsc_item*) mpsc_pop(q);
+    pj_mpsc_queue_push(q, &it->node);
+    if (mpsc_pop(q) != &items[0].node || mpsc_pop(q))
+        return -160;
+
+    /* A producer preempted in the middle of a push, i.e. after exchanging
+     * the head but before linking the previous node, is reported as
+     * pending until the link is made.
+     */
+    pj_mpsc_queue_push(q, &items[0].node);
+    pj_mpsc_queue_push(q, &items[1].node);
+    items[0].node.next = NULL;
+    if (pj_mpsc_queue_pop(q, &node) != PJ_EPENDING || node != NULL)
+        return -170;
+    items[0].node.next = &items[1].node;
+    if (mpsc_pop(q) != &items[0].node || mpsc_pop(q) != &items[1].node ||
+        !pj_mpsc_queue_is_empty(q))
+    {
+        return -180;
+    }
+
+    pj_mpsc_queue_destroy(q);
+    return 0;
+}
+
+static int mpmc_uqueue_basic_test(pj_pool_t *pool)
+{
+    pj_mpmc_uqueue_t *q;
+    pj_mpsc_queue_node *node;
+    mpsc_item items[4];
+    unsigned i;
+    pj_status_t status;
+
+    status = pj_mpmc_uqueue_create(pool, &q);
+    if (status != PJ_SUCCESS)
+        return -210;
+
+    if (!pj_mpmc_uqueue_is_empty(q) ||
+        pj_mpmc_uqueue_pop(q, &node) != PJ_ENOTFOUND || node != NULL)
+    {
+        return -220;
+    }
+
+    for (i=0; i<PJ_ARRAY_SIZE(items); ++i)
+        pj_mpmc_uqueue_push(q, &items[i].node);
+
+    if (pj_mpmc_uqueue_is_empty(q))
+        return -230;
+
+    for (i=0; i<PJ_ARRAY_SIZE(items); ++i) {
+        if (pj_mpmc_uqueue_pop(q, &node) != PJ_SUCCESS ||
+            node != &items[i].node)
+        {
+            return -240;
+        }
+    }
+
+    if (!pj_mpmc_uqueue_is_empty(q) ||
+        pj_mpmc_uqueue_pop(q, &node) != PJ_ENOTFOUND)
+    {
+        return -250;
+    }
+
+    pj_mpmc_uqueue_destroy(q);
+    return 0;
+}
+
+
+static int mpmc_producer(void *arg)
+{
+    unsigned id = (unsigned)(pj_ssize_t)arg;
+    unsigned seq;
+
+    for (seq=1; seq<=ITEM_CNT; ++seq) {
+        while (pj_mpmc_queue_push(st.mpmc, ITEM(id, seq)) != PJ_SUCCESS)
+            pj_thread_sleep(0);
+    }
+    return 0;
+}
+
+static int mpmc_consumer(void *arg)
+{
+    unsigned last[PRODUCER_CNT];
+    void *item;
+
+    PJ_UNUSED_ARG(arg);
+    pj_bzero(last, sizeof(last));
+
+    while (pj_atomic_get(st.popped) < PRODUCER_CNT * ITEM_CNT) {
+        unsigned id, seq;
+
+        if (pj_mpmc_queue_pop(st.mpmc, &item) != PJ_SUCCESS) {
+            pj_thread_sleep(0);
+            continue;
+        }
+
+        /* Items of each producer must arrive in order */
+        id = ITEM_ID(item);
+        seq = ITEM_SEQ(item);
+        if (id >= PRODUCER_CNT || seq <= last[id])
+            pj_atomic_inc(st.errors);
+        else
+            last[id] = seq;
+
+        pj_atomic_inc(st.popped);
+    }
+    return 0;
+}
+
+static int mpsc_producer(void *arg)
+{
+    unsigned id = (unsigned)(pj_ssize_t)arg;
+    unsigned i;
+
+    for (i=0; i<ITEM_CNT; ++i) {
+        mpsc_item *it = &st.items[id][i];
+
+        it->id = id;
+        it->seq = i + 1;
+        pj_mpsc_queue_push(st.mpsc, &it->node);
+    }
+    return 0;
+}
+
+static int mpsc_consumer(void *arg)
+{
+    unsigned last[PRODUCER_CNT];
+    unsigned count = 0;
+
+    PJ_UNUSED_ARG(arg);
+    pj_bzero(last, sizeof(last));
+
+    while (count < PRODUCER_CNT * ITEM_CNT) {
+        pj_mpsc_queue_node *node;
+        mpsc_item *it;
+
+        if (pj_mpsc_queue_pop(st.mpsc, &node) != PJ_SUCCESS) {
+            pj_thread_sleep(0);
+            continue;
+        }
+        it = (mpsc_item*) node;
+
+        if (it->id >= PRODUCER_CNT || it->seq != last[it->id] + 1)
+            pj_atomic_inc(st.errors);
+        else
+            last[it->id] = it->seq;
+
+        /* The node is ours now. Trash it, so that any later access by
+         * the queue would show up as a lost or corrupted item.
+         */
+        pj_memset(it, 0xDD, sizeof(*it));
+        ++count;
+    }
+
+    pj_atomic_set(st.popped, count);
+    return 0;
+}
+
+static int umpmc_producer(void *arg)
+{
+    unsigned id = (unsigned)(pj_ssize_t)arg;
+    unsigned i;
+
+    for (i=0; i<ITEM_CNT; ++i) {
+        mpsc_item *it = &st.items[id][i];
+
+        it->id = id;
+        it->seq = i + 1;
+        pj_mpmc_uqueue_push(st.umpmc, &it->node);
+    }
+    return 0;
+}
+
+static int umpmc_consumer(void *arg)
+{
+    unsigned last[PRODUCER_CNT];
+
+    PJ_UNUSED_ARG(arg);
+    pj_bzero(last, sizeof(last));
+
+    while (pj_atomic_get(st.popped) < PRODUCER_CNT * ITEM_CNT) {
+        pj_mpsc_queue_node *node;
+        mpsc_item *it;
+
+        if (pj_mpmc_uqueue_pop(st.umpmc, &node) != PJ_SUCCESS) {
+            pj_thread_sleep(0);
+            continue;
+        }
+        it = (mpsc_item*) node;
+
+        /* Items of each producer must arrive in order */
+        if (it->id >= PRODUCER_CNT || it->seq <= last[it->id])
+            pj_atomic_inc(st.errors);
+        else
+            last[it->id] = it->seq;
+
+        /* Trash the node, as in mpsc_consumer() */
+        pj_memset(it, 0xDD, sizeof(*it));
+        pj_atomic_inc(st.popped);
+    }
+    return 0;
+}
+
+static int run_threads(pj_pool_t *pool, pj_thread_proc *producer,
+                       pj_thread_proc *consumer, unsigned consumer_cnt)
+{
+    pj_thread_t *threads[PRODUCER_CNT + CONSUMER_CNT];
+    unsigned i, cnt = 0;
+    pj_status_t status;
+    int rc = 0;
+
+    for (i=0; i<consumer_cnt; ++i) {
+        status = pj_thread_create(pool, "mpqcons", consumer,
+                                  (void*)(pj_ssize_t)i, 0, 0,
+                                  &threads[cnt]);
+        if (status != PJ_SUCCESS) {
+            rc = -300;
+            break;
+        }
+        ++cnt;
+    }
+
+    for (i=0; rc==0 && i<PRODUCER_CNT; ++i) {
+        status = pj_thread_create(pool, "mpqprod", producer,
+                                  (void*)(pj_ssize_t)i, 0, 0,
+                                  &threads[cnt]);
+        if (status != PJ_SUCCESS) {
+            rc = -310;
+            break;
+        }
+        ++cnt;
+    }
+
+    /* On failure, let the consumers finish */
+    if (rc != 0)
+        pj_atomic_set(st.popped, PRODUCER_CNT * ITEM_CNT);
+
+    for (i=0; i<cnt; ++i) {
+        pj_thread_join(threads[i]);
+        pj_thread_destroy(threads[i]);
+    }
+
+    return rc;
+}
+
+static int stress_test(pj_pool_t *pool)
+{
+    pj_timestamp t1, t2;
+    unsigned i;
+    int rc;
+
+    pj_bzero(&st, sizeof(st));
+    if (pj_atomic_create(pool, 0, &st.popped) != PJ_SUCCESS ||
+        pj_atomic_create(pool, 0, &st.errors) != PJ_SUCCESS)
+    {
+        return -400;
+    }
+
+    /* MPMC with a small queue so that producers often find it full */
+    if (pj_mpmc_queue_create(pool, 64, &st.mpmc) != PJ_SUCCESS)
+        return -410;
+
+    pj_get_timestamp(&t1);
+    rc = run_threads(pool, &mpmc_producer, &mpmc_consumer, CONSUMER_CNT);
+    pj_get_timestamp(&t2);
+    if (rc != 0)
+        return rc;
+
+    if (pj_atomic_get(st.errors) != 0)
+        return -420;
+    if (pj_atomic_get(st.popped) != PRODUCER_CNT * ITEM_CNT)
+        return -430;
+
+    PJ_LOG(3,(THIS_FILE, "  mpmc: %d producers, %d consumers, %d items: "
+              "%u usec", PRODUCER_CNT, CONSUMER_CNT, PRODUCER_CNT * ITEM_CNT,
+              pj_elapsed_usec(&t1, &t2)));
+
+    pj_mpmc_queue_destroy(st.mpmc);
+
+    /* MPSC */
+    pj_atomic_set(st.popped, 0);
+    if (pj_mpsc_queue_create(pool, &st.mpsc) != PJ_SUCCESS)
+        return -440;
+
+    for (i=0; i<PRODUCER_CNT; ++i) {
+        st.items[i] = (mpsc_item*)
+                      pj_pool_calloc(pool, ITEM_CNT, sizeof(mpsc_item));
+    }
+
+    pj_get_timestamp(&t1);
+    rc = run_threads(pool, &mpsc_producer, &mpsc_consumer, 1);
+    pj_get_timestamp(&t2);
+    if (rc != 0)
+        return rc;
+
+    if (pj_atomic_get(st.errors) != 0)
+        return -450;
+    if (!pj_mpsc_queue_is_empty(st.mpsc) || mpsc_pop(st.mpsc))
+        return -460;
+
+    PJ_LOG(3,(THIS_FILE, "  mpsc: %d producers, 1 consumer, %d items: "
+              "%u usec", PRODUCER_CNT, PRODUCER_CNT * ITEM_CNT,
+              pj_elapsed_usec(&t1, &t2)));
+
+    pj_mpsc_queue_destroy(st.mpsc);
+
+    /* Unbounded MPMC, with the trashed nodes of the MPSC run reused */
+    pj_atomic_set(st.popped, 0);
+    if (pj_mpmc_uqueue_create(pool, &st.umpmc) != PJ_SUCCESS)
+        return -470;
+
+    pj_get_timestamp(&t1);
+    rc = run_threads(pool, &umpmc_producer, &umpmc_consumer, CONSUMER_CNT);
+    pj_get_timestamp(&t2);
+    if (rc != 0)
+        return rc;
+
+    if (pj_atomic_get(st.errors) != 0)
+        return -480;
+    if (pj_atomic_get(st.popped) != PRODUCER_CNT * ITEM_CNT ||
+        !pj_mpmc_uqueue_is_empty(st.umpmc))
+    {
+        return -490;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "  unbounded mpmc: %d producers, %d consumers, "
+              "%d items: %u usec", PRODUCER_CNT, CONSUMER_CNT,
+              PRODUCER_CNT * ITEM_CNT, pj_elapsed_usec(&t1, &t2)));
+
+    pj_mpmc_uqueue_destroy(st.umpmc);
+    pj_atomic_destroy(st.popped);
+    pj_atomic_destroy(st.errors);
+
+    return 0;
+}
+
+
+#if WITH_BENCHMARK
+/*
+ * Compare the MPSC queue with the mutex protected list hand-off which is
+ * commonly used between threads.
+ */
+typedef struct list_item
+{
+    PJ_DECL_LIST_MEMBER(struct list_item);
+} list_item;
+
+static struct bench_state
+{
+    pj_lock_t          *lock;
+    list_item           list;
+    pj_mpsc_queue_t    *mpsc;
+    unsigned            producer_cnt;
+    pj_bool_t           use_list;
+    void               *items;
+} bench;
+
+#define BENCH_ITEM_CNT  200000
+
+static int bench_producer(void *arg)
+{
+    unsigned id = (unsigned)(pj_ssize_t)arg;
+    unsigned i;
+
+    for (i=0; i<BENCH_ITEM_CNT; ++i) {
+        if (bench.use_list) {
+            list_item *it = (list_item*)bench.items + id*BENCH_ITEM_CNT + i;
+
+            pj_lock_acquire(bench.lock);
+            pj_list_push_back(&bench.list, it);
+            pj_lock_release(bench.lock);
+        } else {
+            pj_mpsc_queue_node *it = (pj_mpsc_queue_node*)bench.items +
+                                     id*BENCH_ITEM_CNT + i;
+
+            pj_mpsc_queue_push(bench.mpsc, it);
+        }
+    }
+    return 0;
+}
+
+static int bench_consumer(void *arg)
+{
+    unsigned count = 0;
+
+    PJ_UNUSED_ARG(arg);
+
+    while (count < bench.producer_cnt * BENCH_ITEM_CNT) {
+        if (bench.use_list) {
+            list_item *it = NULL;
+
+            pj_lock_acquire(bench.lock);
+            if (!pj_list_empty(&bench.list)) {
+                it = bench.list.next;
+                pj_list_erase(it);
+            }
+            pj_lock_release(bench.lock);
+
+            if (it)
+                ++count;
+        } else {
+            pj_mpsc_queue_node *node;
+
+            if (pj_mpsc_queue_pop(bench.mpsc, &node) == PJ_SUCCESS)
+                ++count;
+        }
+    }
+    return 0;
+}
+
+static int mpsc_bench(pj_pool_t *pool, unsigned producer_cnt)
+{
+    pj_thread_t *threads[PRODUCER_CNT + 1];
+    pj_timestamp t1, t2;
+    pj_uint32_t usec[2];
+    unsigned i, mode;
+    pj_status_t status;
+
+    bench.producer_cnt = producer_cnt;
+
+    for (mode=0; mode<2; ++mode) {
+        bench.use_list = (mode == 0);
+        bench.items = pj_pool_calloc(pool, producer_cnt * BENCH_ITEM_CNT,
+                                     sizeof(list_item));
+
+        pj_get_timestamp(&t1);
+        for (i=0; i<=producer_cnt; ++i) {
+            status = pj_thread_create(pool, "mpqbench",
+                                      (i==0? &bench_consumer : &bench_producer),
+                                      (void*)(pj_ssize_t)(i-1), 0, 0,
+                                      &threads[i]);
+            if (status != PJ_SUCCESS)
+                return -500;
+        }
+        for (i=0; i<=producer_cnt; ++i) {
+            pj_thread_join(threads[i]);
+            pj_thread_destroy(threads[i]);
+        }
+        pj_get_timestamp(&t2);
+
+        usec[mode] = pj_elapsed_usec(&t1, &t2);
+    }
+
+    PJ_LOG(3,(THIS_FILE, "    %u producer(s), %u items: mutex+list %7u usec, "
+              "mpsc %7u usec", producer_cnt, producer_cnt * BENCH_ITEM_CNT,
+              usec[0], usec[1]));
+    return 0;
+}
+#endif  /* WITH_BENCHMARK */
+
+
+int mpqueue_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    pool = pj_pool_create(mem, "mpqueue", 4000, 4000, NULL);
+    if (!pool)
+        return -1;
+
+    rc = mpmc_basic_test(pool);
+    if (rc == 0)
+        rc = mpsc_basic_test(pool);
+    if (rc == 0)
+        rc = mpmc_uqueue_basic_test(pool);
+    if (rc == 0)
+        rc = stress_test(pool);
+
+#if WITH_BENCHMARK
+    if (rc == 0) {
+        static const unsigned counts[] = { 1, 2, 4 };
+        unsigned i;
+
+        if (pj_lock_create_simple_mutex(pool, "mpqbench", &bench.lock) !=
+            PJ_SUCCESS)
+        {
+            rc = -600;
+        }
+        pj_list_init(&bench.list);
+        if (rc == 0 && pj_mpsc_queue_create(pool, &bench.mpsc) != PJ_SUCCESS)
+            rc = -610;
+
+        PJ_LOG(3,(THIS_FILE, "  Benchmarking mutex+list vs pj_mpsc_queue:"));
+        for (i=0; rc==0 && i<PJ_ARRAY_SIZE(counts); ++i)
+            rc = mpsc_bench(pool, counts[i]);
+
+        if (bench.mpsc)
+            pj_mpsc_queue_destroy(bench.mpsc);
+        if (bench.lock)
+            pj_lock_destroy(bench.lock);
+    }
+#endif
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_mpqueue_test;
+#endif  /* INCLUDE_MPQUEUE_TEST */
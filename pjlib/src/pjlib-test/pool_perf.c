@@ -117,6 +117,78 @@ static int pool_test_malloc_free()
 
 #endif /* PJ_SYMBIAN */
 
+#if PJ_HAS_THREADS && PJ_CACHING_POOL_THREAD_CACHE_MAX > 0
+/*
+ * Multithreaded benchmark: each thread repeatedly creates a pool from the
+ * shared pool factory, allocates from it, and releases it. This measures
+ * how the per-thread caches of the caching pool scale, so it only runs
+ * when they are enabled.
+ */
+#define MT_LOOP         20000
+#define MT_MAX_THREADS  32
+
+static int mt_thread(void *arg)
+{
+    int i;
+
+    PJ_UNUSED_ARG(arg);
+
+    for (i=0; i<MT_LOOP; ++i) {
+        pj_pool_t *pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+        char *ptr;
+
+        if (!pool)
+            return -1;
+        ptr = (char*)pj_pool_alloc(pool, sizes[i % COUNT]);
+        *ptr = '\0';
+        pj_pool_release(pool);
+    }
+    return 0;
+}
+
+static int pool_test_mt(unsigned thread_cnt)
+{
+    pj_pool_t *pool;
+    pj_thread_t *threads[MT_MAX_THREADS];
+    pj_timestamp start, end;
+    pj_uint32_t msec;
+    unsigned i;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+        return -10;
+
+    pj_get_timestamp(&start);
+    for (i=0; i<thread_cnt; ++i) {
+        status = pj_thread_create(pool, "pooltest", &mt_thread, NULL, 0, 0,
+                                  &threads[i]);
+        if (status != PJ_SUCCESS) {
+            thread_cnt = i;
+            break;
+        }
+    }
+    for (i=0; i<thread_cnt; ++i) {
+        pj_thread_join(threads[i]);
+        pj_thread_destroy(threads[i]);
+    }
+    pj_get_timestamp(&end);
+
+    pj_pool_release(pool);
+
+    if (status != PJ_SUCCESS)
+        return -20;
+
+    msec = pj_elapsed_msec(&start, &end);
+    if (msec == 0) msec = 1;
+
+    PJ_LOG(3, (THIS_FILE, "..%2u threads: %5u msec, %8u create/release/sec",
+               thread_cnt, msec,
+               (unsigned)((pj_uint64_t)thread_cnt * MT_LOOP * 1000 / msec)));
+    return 0;
+}
+#endif  /* PJ_HAS_THREADS && PJ_CACHING_POOL_THREAD_CACHE_MAX > 0 */
+
 int pool_perf_test()
 {
     unsigned i;
@@ -185,6 +257,22 @@ int pool_perf_test()
     PJ_LOG(3, (THIS_FILE, "..pool speedup over malloc best=%dx, worst=%dx", 
                           (int)(malloc_time/best),
                           (int)(malloc_time/worst)));
+
+#if PJ_HAS_THREADS && PJ_CACHING_POOL_THREAD_CACHE_MAX > 0
+    PJ_LOG(3, (THIS_FILE, "Benchmarking pool with multiple threads "
+                          "(up to %d thread caches)..",
+                          PJ_CACHING_POOL_THREAD_CACHE_MAX));
+    for (i=1; i<=MT_MAX_THREADS; i*=2) {
+        int rc = pool_test_mt(i);
+        if (rc != 0)
+            return rc;
+    }
+#elif PJ_HAS_THREADS
+    PJ_LOG(3, (THIS_FILE, "Skipping multithreaded pool benchmark, thread "
+                          "caches are disabled "
+                          "(PJ_CACHING_POOL_THREAD_CACHE_MAX is 0)"));
+#endif
+
     return 0;
 }
 
@@ -47,6 +47,7 @@
  *  - pj_sock_close()
  *  - pj_sock_send()
  *  - pj_sock_sendto()
+ *  - pj_sock_sendmmsg()
  *  - pj_sock_recv()
  *  - pj_sock_recvfrom()
  *  - pj_sock_bind()
@@ -948,6 +949,80 @@ static int socketpair_test()
     return 0;
 }
 
+static int sendmmsg_test(void)
+{
+    enum { CNT = 8 };
+    pj_sock_t cs = PJ_INVALID_SOCKET, ss = PJ_INVALID_SOCKET;
+    pj_sockaddr_in addr;
+    int addr_len;
+    pj_sock_mmsg msg[CNT];
+    char buf[CNT][32];
+    char rbuf[64];
+    unsigned i, cnt;
+    pj_str_t s;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,("test", "...sendmmsg_test()"));
+
+    if (pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &ss) != 0 ||
+        pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &cs) != 0)
+    {
+        rc = -10; goto on_error;
+    }
+
+    pj_sockaddr_in_init(&addr, pj_cstr(&s, ADDRESS), 0);
+    if (pj_sock_bind(ss, &addr, sizeof(addr)) != 0) {
+        rc = -20; goto on_error;
+    }
+    addr_len = sizeof(addr);
+    if (pj_sock_getsockname(ss, &addr, &addr_len) != 0) {
+        rc = -30; goto on_error;
+    }
+
+    /* Datagrams of different sizes */
+    for (i = 0; i < CNT; ++i) {
+        msg[i].buf = buf[i];
+        msg[i].len = pj_ansi_snprintf(buf[i], sizeof(buf[i]), "mmsg %u %.*s",
+                                      i, (int)i, "xxxxxxxx");
+        msg[i].addr = &addr;
+        msg[i].addr_len = sizeof(addr);
+    }
+
+    /* The batch may be split, send until all datagrams are out */
+    for (i = 0; i < CNT; i += cnt) {
+        cnt = CNT - i;
+        status = pj_sock_sendmmsg(cs, &msg[i], &cnt, 0);
+        if (status != PJ_SUCCESS || cnt == 0) {
+            app_perror("...sendmmsg error", status);
+            rc = -40; goto on_error;
+        }
+    }
+
+    /* Datagrams must arrive as they were sent, in order */
+    for (i = 0; i < CNT; ++i) {
+        pj_ssize_t len = sizeof(rbuf);
+
+        status = pj_sock_recv(ss, rbuf, &len, 0);
+        if (status != PJ_SUCCESS) {
+            app_perror("...recv error", status);
+            rc = -50; goto on_error;
+        }
+        if (len != msg[i].len || pj_memcmp(rbuf, buf[i], len) != 0) {
+            PJ_LOG(3,("test", "...error: datagram %u mismatch", i));
+            rc = -60; goto on_error;
+        }
+    }
+
+on_error:
+    if (cs != PJ_INVALID_SOCKET)
+        pj_sock_close(cs);
+    if (ss != PJ_INVALID_SOCKET)
+        pj_sock_close(ss);
+
+    return rc;
+}
+
 int sock_test()
 {
     int rc;
@@ -997,6 +1072,10 @@ int sock_test()
     if (rc != 0)
         return rc;
 
+    rc = sendmmsg_test();
+    if (rc != 0)
+        return rc;
+
     return 0;
 }
 
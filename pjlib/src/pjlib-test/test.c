@@ -93,6 +93,10 @@ int test_inner(void)
     DO_TEST( os_test() );
 #endif
 
+#if INCLUDE_LOG_ASYNC_TEST
+    DO_TEST( log_async_test() );
+#endif
+
 #if INCLUDE_RAND_TEST
     DO_TEST( rand_test() );
 #endif
@@ -143,6 +147,10 @@ int test_inner(void)
     DO_TEST( mutex_test() );
 #endif
 
+#if INCLUDE_MPQUEUE_TEST
+    DO_TEST( mpqueue_test() );
+#endif
+
 #if INCLUDE_TIMER_TEST
     DO_TEST( timer_test() );
 #endif
@@ -54,9 +54,11 @@
 #define INCLUDE_UNITTEST_TEST       GROUP_DATA_STRUCTUREc
 #define INCLUDE_ATOMIC_TEST         GROUP_OS
 #define INCLUDE_MUTEX_TEST          (PJ_HAS_THREADS && GROUP_OS)
+#define INCLUDE_MPQUEUE_TEST        (PJ_HAS_THREADS && GROUP_DATA_STRUCTURE)
 #define INCLUDE_SLEEP_TEST          GROUP_OS
 #define INCLUDE_OS_TEST             GROUP_OS
 #define INCLUDE_THREAD_TEST         (PJ_HAS_THREADS && GROUP_OS)
+#define INCLUDE_LOG_ASYNC_TEST      (PJ_HAS_THREADS && GROUP_OS)
 #define INCLUDE_SOCK_TEST           GROUP_NETWORK
 #define INCLUDE_SOCK_PERF_TEST      (GROUP_NETWORK && WITH_BENCHMARK)
 #define INCLUDE_SELECT_TEST         GROUP_NETWORK
@@ -89,6 +91,7 @@ extern int rand_test(void);
 extern int list_test(void);
 extern int hash_test(void);
 extern int log_test(void);
+extern int log_async_test(void);
 extern int os_test(void);
 extern int pool_test(void);
 extern int pool_perf_test(void);
@@ -101,6 +104,7 @@ extern int timer_test(void);
 extern int rbtree_test(void);
 extern int atomic_test(void);
 extern int mutex_test(void);
+extern int mpqueue_test(void);
 extern int sleep_test(void);
 extern int thread_test(void);
 extern int sock_test(void);
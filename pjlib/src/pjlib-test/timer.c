@@ -953,6 +953,133 @@ static int timer_bench_test(void)
     return err;
 }
 
+/* Schedule/cancel/poll throughput at a given number of entries, to
+ * compare the binary heap and the timing wheel (PJ_TIMER_USE_WHEEL).
+ */
+static int timer_throughput(unsigned count)
+{
+    pj_pool_t *pool;
+    pj_timer_heap_t *timer = NULL;
+    pj_timer_entry *entries;
+    pj_lock_t *lock;
+    pj_timestamp t1, t2;
+    pj_uint32_t rate[3];
+    char cnt_str[64], rate_str[3][64];
+    unsigned i, n;
+    pj_status_t status;
+    int err = 0;
+
+    pool = pj_pool_create(mem, NULL, pj_timer_heap_mem_size(count), 4000,
+                          NULL);
+    if (!pool)
+        return -10;
+
+    status = pj_timer_heap_create(pool, count, &timer);
+    if (status != PJ_SUCCESS) {
+        app_perror("...error: unable to create timer heap", status);
+        err = -20;
+        goto on_return;
+    }
+
+    status = pj_lock_create_simple_mutex(pool, NULL, &lock);
+    if (status != PJ_SUCCESS) {
+        err = -30;
+        goto on_return;
+    }
+    pj_timer_heap_set_lock(timer, lock, PJ_TRUE);
+    pj_timer_heap_set_max_timed_out_per_poll(timer, count);
+
+    entries = (pj_timer_entry*)pj_pool_calloc(pool, count, sizeof(*entries));
+    if (!entries) {
+        err = -40;
+        goto on_return;
+    }
+    for (i = 0; i < count; ++i)
+        pj_timer_entry_init(&entries[i], 0, NULL, &timer_callback);
+
+    /* Schedule with delays in the range of SIP transaction timers */
+    pj_get_timestamp(&t1);
+    for (i = 0; i < count; ++i) {
+        pj_time_val delay;
+
+        delay.sec = 0;
+        delay.msec = 500 + (pj_rand() % 32000);
+        pj_time_val_normalize(&delay);
+        status = pj_timer_heap_schedule(timer, &entries[i], &delay);
+        if (status != PJ_SUCCESS) {
+            app_perror("...error: unable to schedule timer entry", status);
+            err = -50;
+            goto on_return;
+        }
+    }
+    pj_get_timestamp(&t2);
+    rate[0] = pj_elapsed_usec(&t1, &t2)? (pj_uint32_t)
+              (count * 1000000.0 / pj_elapsed_usec(&t1, &t2)) : 0;
+
+    /* Cancel them all, as most SIP timers never fire */
+    pj_get_timestamp(&t1);
+    for (i = 0; i < count; ++i) {
+        if (pj_timer_heap_cancel(timer, &entries[i]) != 1) {
+            PJ_LOG(3,("test", "...error: unable to cancel timer entry"));
+            err = -60;
+            goto on_return;
+        }
+    }
+    pj_get_timestamp(&t2);
+    rate[1] = pj_elapsed_usec(&t1, &t2)? (pj_uint32_t)
+              (count * 1000000.0 / pj_elapsed_usec(&t1, &t2)) : 0;
+
+    /* Expire them all */
+    for (i = 0; i < count; ++i) {
+        pj_time_val delay = {0, 0};
+        pj_timer_heap_schedule(timer, &entries[i], &delay);
+    }
+    pj_thread_sleep(10);
+    pj_get_timestamp(&t1);
+    for (n = 0; n < count; )
+        n += pj_timer_heap_poll(timer, NULL);
+    pj_get_timestamp(&t2);
+    rate[2] = pj_elapsed_usec(&t1, &t2)? (pj_uint32_t)
+              (count * 1000000.0 / pj_elapsed_usec(&t1, &t2)) : 0;
+
+    if (pj_timer_heap_count(timer) != 0) {
+        PJ_LOG(3,("test", "...error: timer heap is not empty"));
+        err = -70;
+        goto on_return;
+    }
+
+    get_format_num(count, cnt_str);
+    for (i = 0; i < 3; ++i)
+        get_format_num(rate[i], rate_str[i]);
+    PJ_LOG(3,(THIS_FILE, "    %s entries: schedule %s, cancel %s, "
+                         "poll %s ent/sec",
+                         cnt_str, rate_str[0], rate_str[1], rate_str[2]));
+
+on_return:
+    if (timer)
+        pj_timer_heap_destroy(timer);
+    pj_pool_safe_release(&pool);
+    return err;
+}
+
+static int timer_throughput_test(void)
+{
+    static const unsigned counts[] = { 10000, 100000, 1000000 };
+    unsigned i;
+    int rc;
+
+    PJ_LOG(3,("test", "...Throughput test (%s)",
+              (PJ_TIMER_USE_WHEEL? "timing wheel" : "binary heap")));
+
+    for (i = 0; i < PJ_ARRAY_SIZE(counts); ++i) {
+        rc = timer_throughput(counts[i]);
+        if (rc != 0)
+            return rc;
+    }
+
+    return 0;
+}
+
 int timer_test()
 {
     int rc;
@@ -969,9 +1096,14 @@ int timer_test()
     rc = timer_bench_test();
     if (rc != 0)
         return rc;
+
+    rc = timer_throughput_test();
+    if (rc != 0)
+        return rc;
 #else
     /* Avoid unused warning */
     PJ_UNUSED_ARG(timer_bench_test);
+    PJ_UNUSED_ARG(timer_throughput_test);
 #endif
 
     return 0;
@@ -94,6 +94,10 @@ ifeq ($(AC_PJMEDIA_RESAMPLE),speex)
 export CFLAGS += -DPJMEDIA_RESAMPLE_IMP=PJMEDIA_RESAMPLE_SPEEX
 endif
 
+ifeq ($(AC_PJMEDIA_RESAMPLE),polyphase)
+export CFLAGS += -DPJMEDIA_RESAMPLE_IMP=PJMEDIA_RESAMPLE_POLYPHASE
+endif
+
 #
 # SRTP
 #
@@ -24,6 +24,7 @@
  * @brief PJMEDIA main header file.
  */
 #include <pjmedia/alaw_ulaw.h>
+#include <pjmedia/audio_mix.h>
 #include <pjmedia/avi_stream.h>
 #include <pjmedia/bidirectional.h>
 #include <pjmedia/circbuf.h>
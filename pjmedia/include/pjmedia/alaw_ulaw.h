@@ -29,6 +29,8 @@ extern const pj_uint8_t pjmedia_linear2ulaw_tab[16384];
 extern const pj_uint8_t pjmedia_linear2alaw_tab[16384];
 extern const pj_int16_t pjmedia_ulaw2linear_tab[256];
 extern const pj_int16_t pjmedia_alaw2linear_tab[256];
+extern const pj_uint8_t pjmedia_alaw2ulaw_tab[256];
+extern const pj_uint8_t pjmedia_ulaw2alaw_tab[256];
 
 
 /**
@@ -74,7 +76,7 @@ extern const pj_int16_t pjmedia_alaw2linear_tab[256];
  * @return          8-bit U-Law value.
  */
 #define pjmedia_alaw2ulaw(aval)         \
-            pjmedia_linear2ulaw(pjmedia_alaw2linear(aval))
+            pjmedia_alaw2ulaw_tab[aval]
 
 /**
  * Convert 8-bit U-Law value to 8-bit A-Law value.
@@ -83,7 +85,7 @@ extern const pj_int16_t pjmedia_alaw2linear_tab[256];
  * @return          8-bit A-Law value.
  */
 #define pjmedia_ulaw2alaw(uval)         \
-            pjmedia_linear2alaw(pjmedia_ulaw2linear(uval))
+            pjmedia_ulaw2alaw_tab[uval]
 
 
 #else
@@ -139,21 +141,17 @@ PJ_DECL(unsigned char) pjmedia_ulaw2alaw(unsigned char uval);
 #endif
 
 /**
- * Encode 16-bit linear PCM data to 8-bit U-Law data.
+ * Encode 16-bit linear PCM data to 8-bit U-Law data. When the conversion
+ * tables are used (PJMEDIA_HAS_ALAW_ULAW_TABLE), the bulk conversion
+ * functions below are vectorized on platforms with SSE2 or NEON, giving
+ * the same result as the per-sample macros.
  *
  * @param dst       Destination buffer for 8-bit U-Law data.
  * @param src       Source, 16-bit linear PCM data.
  * @param count     Number of samples.
  */
-PJ_INLINE(void) pjmedia_ulaw_encode(pj_uint8_t *dst, const pj_int16_t *src, 
-                                    pj_size_t count)
-{
-    const pj_int16_t *end = src + count;
-    
-    while (src < end) {
-        *dst++ = pjmedia_linear2ulaw(*src++);
-    }
-}
+PJ_DECL(void) pjmedia_ulaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
+                                  pj_size_t count);
 
 /**
  * Encode 16-bit linear PCM data to 8-bit A-Law data.
@@ -162,15 +160,8 @@ PJ_INLINE(void) pjmedia_ulaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
  * @param src       Source, 16-bit linear PCM data.
  * @param count     Number of samples.
  */
-PJ_INLINE(void) pjmedia_alaw_encode(pj_uint8_t *dst, const pj_int16_t *src, 
-                                    pj_size_t count)
-{
-    const pj_int16_t *end = src + count;
-    
-    while (src < end) {
-        *dst++ = pjmedia_linear2alaw(*src++);
-    }
-}
+PJ_DECL(void) pjmedia_alaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
+                                  pj_size_t count);
 
 /**
  * Decode 8-bit U-Law data to 16-bit linear PCM data.
@@ -179,15 +170,8 @@ PJ_INLINE(void) pjmedia_alaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
  * @param src       Source, 8-bit U-Law data.
  * @param len       Encoded frame/source length in bytes.
  */
-PJ_INLINE(void) pjmedia_ulaw_decode(pj_int16_t *dst, const pj_uint8_t *src, 
-                                    pj_size_t len)
-{
-    const pj_uint8_t *end = src + len;
-    
-    while (src < end) {
-        *dst++ = pjmedia_ulaw2linear(*src++);
-    }
-}
+PJ_DECL(void) pjmedia_ulaw_decode(pj_int16_t *dst, const pj_uint8_t *src,
+                                  pj_size_t len);
 
 /**
  * Decode 8-bit A-Law data to 16-bit linear PCM data.
@@ -196,15 +180,32 @@ PJ_INLINE(void) pjmedia_ulaw_decode(pj_int16_t *dst, const pj_uint8_t *src,
  * @param src       Source, 8-bit A-Law data.
  * @param len       Encoded frame/source length in bytes.
  */
-PJ_INLINE(void) pjmedia_alaw_decode(pj_int16_t *dst, const pj_uint8_t *src, 
-                                    pj_size_t len)
-{
-    const pj_uint8_t *end = src + len;
-    
-    while (src < end) {
-        *dst++ = pjmedia_alaw2linear(*src++);
-    }
-}
+PJ_DECL(void) pjmedia_alaw_decode(pj_int16_t *dst, const pj_uint8_t *src,
+                                  pj_size_t len);
+
+/**
+ * Transcode 8-bit A-Law data to 8-bit U-Law data directly, without
+ * converting to linear PCM. The destination may be the same buffer as
+ * the source.
+ *
+ * @param dst       Destination buffer for 8-bit U-Law data.
+ * @param src       Source, 8-bit A-Law data.
+ * @param len       Number of bytes.
+ */
+PJ_DECL(void) pjmedia_alaw_to_ulaw(pj_uint8_t *dst, const pj_uint8_t *src,
+                                   pj_size_t len);
+
+/**
+ * Transcode 8-bit U-Law data to 8-bit A-Law data directly, without
+ * converting to linear PCM. The destination may be the same buffer as
+ * the source.
+ *
+ * @param dst       Destination buffer for 8-bit A-Law data.
+ * @param src       Source, 8-bit U-Law data.
+ * @param len       Number of bytes.
+ */
+PJ_DECL(void) pjmedia_ulaw_to_alaw(pj_uint8_t *dst, const pj_uint8_t *src,
+                                   pj_size_t len);
 
 PJ_END_DECL
 
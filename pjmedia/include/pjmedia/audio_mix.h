@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJMEDIA_AUDIO_MIX_H__
+#define __PJMEDIA_AUDIO_MIX_H__
+
+/**
+ * @file audio_mix.h
+ * @brief Audio mixing and level adjustment kernels.
+ */
+
+#include <pjmedia/types.h>
+
+
+/**
+ * @defgroup PJMEDIA_AUDIO_MIX Audio mixing kernels
+ * @ingroup PJMEDIA_FRAME_OP
+ * @brief Sample loops used by the conference bridge to mix signals
+ * @{
+ *
+ * These functions implement the per-sample loops of the conference bridge:
+ * signal level adjustment, accumulation into the 32bit mixing buffer and
+ * conversion of the mixed signal back to 16bit samples. Besides the
+ * portable (scalar) implementation, SSE2, AVX2 and NEON implementations
+ * are provided, and the best one supported by the CPU is selected at
+ * runtime. All implementations produce bit-exact results.
+ *
+ * Level values use the conference bridge convention: 128 means no
+ * adjustment, 64 halves the signal and 256 doubles it.
+ */
+
+PJ_BEGIN_DECL
+
+
+/**
+ * Audio mixing kernel implementations.
+ */
+typedef enum pjmedia_mix_impl
+{
+    /** Select the best implementation supported by the CPU. */
+    PJMEDIA_MIX_IMPL_AUTO,
+
+    /** Portable implementation, the reference for the others. */
+    PJMEDIA_MIX_IMPL_SCALAR,
+
+    /** x86 SSE2 implementation. */
+    PJMEDIA_MIX_IMPL_SSE2,
+
+    /** x86 AVX2 implementation. */
+    PJMEDIA_MIX_IMPL_AVX2,
+
+    /** ARM NEON implementation. */
+    PJMEDIA_MIX_IMPL_NEON
+
+} pjmedia_mix_impl;
+
+
+/**
+ * Check whether the specified implementation is available in this build
+ * and supported by the CPU.
+ *
+ * @param impl          The implementation.
+ *
+ * @return              PJ_TRUE if the implementation can be used.
+ */
+PJ_DECL(pj_bool_t) pjmedia_mix_has_impl(pjmedia_mix_impl impl);
+
+
+/**
+ * Select the implementation used by the mixing functions. This is mostly
+ * useful for testing and benchmarking, as by default the best available
+ * implementation is used. This function is not thread safe with respect
+ * to the mixing functions.
+ *
+ * @param impl          The implementation, or PJMEDIA_MIX_IMPL_AUTO.
+ *
+ * @return              PJ_SUCCESS, or PJ_ENOTSUP if the implementation is
+ *                      not available.
+ */
+PJ_DECL(pj_status_t) pjmedia_mix_set_impl(pjmedia_mix_impl impl);
+
+
+/**
+ * Get the implementation currently used by the mixing functions.
+ *
+ * @return              The implementation, never PJMEDIA_MIX_IMPL_AUTO.
+ */
+PJ_DECL(pjmedia_mix_impl) pjmedia_mix_get_impl(void);
+
+
+/**
+ * Get the name of an implementation.
+ *
+ * @param impl          The implementation.
+ *
+ * @return              The name, e.g. "avx2".
+ */
+PJ_DECL(const char*) pjmedia_mix_impl_name(pjmedia_mix_impl impl);
+
+
+/**
+ * Calculate the sum of the absolute values of the samples.
+ *
+ * @param src           The samples.
+ * @param count         Number of samples, less than 65536.
+ *
+ * @return              The sum of absolute sample values.
+ */
+PJ_DECL(pj_int32_t) pjmedia_mix_sum_abs(const pj_int16_t *src,
+                                        unsigned count);
+
+
+/**
+ * Adjust the level of the samples, clipping the result to 16bit, i.e.
+ * dst[i] = clip((src[i] * level) >> 7). The destination may be the same
+ * buffer as the source.
+ *
+ * @param dst           Destination buffer.
+ * @param src           Source samples.
+ * @param count         Number of samples, less than 65536.
+ * @param level         Level adjustment, 128 means no adjustment.
+ *
+ * @return              The sum of absolute values of the adjusted samples.
+ */
+PJ_DECL(pj_int32_t) pjmedia_mix_adjust_level(pj_int16_t *dst,
+                                             const pj_int16_t *src,
+                                             unsigned count,
+                                             unsigned level);
+
+
+/**
+ * Add the samples to a mixing buffer, i.e. mix[i] += src[i], and track
+ * the minimum and maximum value of the mixing buffer after the addition.
+ *
+ * @param mix           The 32bit mixing buffer.
+ * @param src           The samples to add.
+ * @param count         Number of samples.
+ * @param p_min         On input, the current minimum (normally zero). On
+ *                      output, the minimum of the mixing buffer if it is
+ *                      lower.
+ * @param p_max         On input, the current maximum (normally zero). On
+ *                      output, the maximum of the mixing buffer if it is
+ *                      higher.
+ */
+PJ_DECL(void) pjmedia_mix_accumulate(pj_int32_t *mix,
+                                     const pj_int16_t *src,
+                                     unsigned count,
+                                     pj_int32_t *p_min,
+                                     pj_int32_t *p_max);
+
+
+/**
+ * Convert a 32bit mixing buffer to 16bit samples. When level is 128 the
+ * samples are truncated to 16bit, otherwise the level is applied and the
+ * result is clipped, i.e. dst[i] = clip((mix[i] * level) >> 7). The
+ * destination may point to the start of the mixing buffer (in place
+ * conversion).
+ *
+ * @param dst           Destination buffer.
+ * @param mix           The 32bit mixing buffer.
+ * @param count         Number of samples, less than 65536.
+ * @param level         Level adjustment, 128 means no adjustment.
+ *
+ * @return              The sum of absolute values of the output samples.
+ */
+PJ_DECL(pj_int32_t) pjmedia_mix_to_pcm(pj_int16_t *dst,
+                                       const pj_int32_t *mix,
+                                       unsigned count,
+                                       pj_int32_t level);
+
+
+PJ_END_DECL
+
+/**
+ * @}
+ */
+
+
+#endif  /* __PJMEDIA_AUDIO_MIX_H__ */
@@ -100,8 +100,14 @@ enum pjmedia_conf_option
                                      microphone device.                     */
     PJMEDIA_CONF_NO_DEVICE = 2, /**< Do not create sound device.            */
     PJMEDIA_CONF_SMALL_FILTER=4,/**< Use small filter table when resampling */
-    PJMEDIA_CONF_USE_LINEAR=8   /**< Use linear resampling instead of filter
+    PJMEDIA_CONF_USE_LINEAR=8,  /**< Use linear resampling instead of filter
                                      based.                                 */
+    PJMEDIA_CONF_INCREMENTAL_MIX=16 /**< Only mix the ports that have active
+                                     signal in the clock tick, as detected
+                                     by a silence detector on each port, and
+                                     share one mix among the listeners that
+                                     hear the same set of active ports. See
+                                     #pjmedia_conf_create() for more info.  */
 };
 
 
@@ -134,7 +140,19 @@ enum pjmedia_conf_option
  * frames periodically. Internally, the bridge runs when get_frame() to 
  * port zero is called.
  *
- * @param pool              Pool to use to allocate the bridge and 
+ * By default every port that has listeners is mixed to all of its listeners
+ * on every clock tick, so the mixing cost grows with the number of
+ * connections. With PJMEDIA_CONF_INCREMENTAL_MIX option, a silence detector
+ * is run on the signal of each port and only the ports with voice activity
+ * are mixed. Ports whose listeners are all muted or disabled are not read
+ * at all, as if they had no listeners. Listeners hearing the same set of
+ * active ports (with normal connection levels) share a single mix, so for
+ * a typical conference with a few talkers the mixing cost grows with the
+ * number of talkers rather than the number of connections. Note that low
+ * level signals (e.g. background noise) are then not heard by the
+ * listeners.
+ *
+ * @param pool              Pool to use to allocate the bridge and
  *                          additional buffers for the sound device.
  * @param max_slots         Maximum number of slots/ports to be created in
  *                          the bridge. Note that the bridge internally uses
@@ -171,6 +189,94 @@ PJ_DECL(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
                                           pjmedia_conf **p_conf );
 
 
+/**
+ * Conference bridge creation parameters, see #pjmedia_conf_create2().
+ */
+typedef struct pjmedia_conf_param
+{
+    /**
+     * Maximum number of slots/ports, see #pjmedia_conf_create().
+     *
+     * Default: 254
+     */
+    unsigned            max_slots;
+
+    /**
+     * Sampling rate of the bridge.
+     *
+     * Default: 16000
+     */
+    unsigned            sampling_rate;
+
+    /**
+     * Number of channels.
+     *
+     * Default: 1
+     */
+    unsigned            channel_count;
+
+    /**
+     * Number of samples per frame.
+     *
+     * Default: 320 (20ms at 16kHz)
+     */
+    unsigned            samples_per_frame;
+
+    /**
+     * Number of bits per sample, only 16 is supported.
+     *
+     * Default: 16
+     */
+    unsigned            bits_per_sample;
+
+    /**
+     * Bitmask options from #pjmedia_conf_option.
+     *
+     * Default: 0
+     */
+    unsigned            options;
+
+    /**
+     * Number of worker threads that help the clock thread to process the
+     * bridge. On every clock tick the ports are read (and decoded) in
+     * parallel, the signals are mixed, and then the ports are written (and
+     * encoded) in parallel, with the clock thread waiting for all workers
+     * at the end of each phase. Zero means the clock thread processes all
+     * ports by itself.
+     *
+     * Note that with worker threads, get_frame() and put_frame() of
+     * different ports may be called concurrently.
+     *
+     * Default: PJMEDIA_CONF_WORKER_THREADS
+     */
+    unsigned            worker_threads;
+
+} pjmedia_conf_param;
+
+
+/**
+ * Initialize conference bridge parameters with default values.
+ *
+ * @param param             The parameters to be initialized.
+ */
+PJ_DECL(void) pjmedia_conf_param_default(pjmedia_conf_param *param);
+
+
+/**
+ * Create conference bridge with the specified parameters. See
+ * #pjmedia_conf_create() for more info.
+ *
+ * @param pool              Pool to use to allocate the bridge.
+ * @param param             The bridge parameters.
+ * @param p_conf            Pointer to receive the conference bridge instance.
+ *
+ * @return                  PJ_SUCCESS if conference bridge can be created.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_create2(pj_pool_t *pool,
+                                          const pjmedia_conf_param *param,
+                                          pjmedia_conf **p_conf);
+
+
 /**
  * Destroy conference bridge.
  *
@@ -602,6 +708,58 @@ PJ_DECL(pj_status_t) pjmedia_conf_adjust_conn_level( pjmedia_conf *conf,
                                                      int adj_level );
 
 
+/**
+ * Conference bridge clock tick timing statistics. All durations are in
+ * microseconds. The slack of a tick is the frame duration minus the time
+ * spent processing the tick.
+ */
+typedef struct pjmedia_conf_tick_stat
+{
+    unsigned            thread_cnt;     /**< Threads processing each tick,
+                                             including the clock thread.    */
+    unsigned            frame_usec;     /**< Frame duration (tick budget).  */
+    pj_uint32_t         tick_cnt;       /**< Number of ticks.               */
+    pj_uint32_t         overrun_cnt;    /**< Ticks longer than frame_usec.  */
+    unsigned            last_usec;      /**< Last tick duration.            */
+    unsigned            min_usec;       /**< Shortest tick duration.        */
+    unsigned            max_usec;       /**< Longest tick duration.         */
+    unsigned            avg_usec;       /**< Average tick duration.         */
+    unsigned            read_avg_usec;  /**< Average read phase duration.   */
+    unsigned            mix_avg_usec;   /**< Average mix phase duration.    */
+    unsigned            write_avg_usec; /**< Average write phase duration.  */
+    int                 min_slack_usec; /**< Smallest slack (negative when
+                                             a tick has overrun).           */
+    unsigned            last_src_cnt;   /**< Ports mixed in the last tick.  */
+    unsigned            last_mix_cnt;   /**< Mixes calculated in the last
+                                             tick. With
+                                             PJMEDIA_CONF_INCREMENTAL_MIX a
+                                             mix may be shared by several
+                                             listeners.                     */
+} pjmedia_conf_tick_stat;
+
+
+/**
+ * Get the clock tick timing statistics of the conference bridge.
+ *
+ * @param conf              The conference bridge.
+ * @param stat              Pointer to receive the statistics.
+ *
+ * @return                  PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_get_tick_stat(pjmedia_conf *conf,
+                                                pjmedia_conf_tick_stat *stat);
+
+
+/**
+ * Reset the clock tick timing statistics of the conference bridge.
+ *
+ * @param conf              The conference bridge.
+ *
+ * @return                  PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_reset_tick_stat(pjmedia_conf *conf);
+
+
 
 PJ_END_DECL
 
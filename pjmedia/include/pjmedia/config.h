@@ -120,6 +120,50 @@
 #   define PJMEDIA_CONF_USE_AGC             1
 #endif
 
+/**
+ * Default number of worker threads used by the conference bridge to read
+ * (decode) and write (encode) its ports in parallel with the clock thread,
+ * see #pjmedia_conf_param. Zero means all ports are processed by the clock
+ * thread.
+ *
+ * Default: 0
+ */
+#ifndef PJMEDIA_CONF_WORKER_THREADS
+#   define PJMEDIA_CONF_WORKER_THREADS      0
+#endif
+
+/**
+ * Maximum number of worker threads of a conference bridge.
+ *
+ * Default: 32
+ */
+#ifndef PJMEDIA_CONF_MAX_WORKER_THREADS
+#   define PJMEDIA_CONF_MAX_WORKER_THREADS  32
+#endif
+
+/**
+ * Maximum number of mixes shared among listeners in a clock tick, when
+ * the conference bridge is created with PJMEDIA_CONF_INCREMENTAL_MIX
+ * option. Listeners hearing a set of active ports that is not among the
+ * shared mixes get their own mix.
+ *
+ * Default: 16
+ */
+#ifndef PJMEDIA_CONF_MAX_SHARED_MIX
+#   define PJMEDIA_CONF_MAX_SHARED_MIX      16
+#endif
+
+/**
+ * Enable the SSE2, AVX2 and NEON implementations of the audio mixing
+ * kernels used by the conference bridge (see @ref PJMEDIA_AUDIO_MIX).
+ * When disabled, only the portable implementation is built.
+ *
+ * Default: 1
+ */
+#ifndef PJMEDIA_AUDIO_MIX_USE_SIMD
+#   define PJMEDIA_AUDIO_MIX_USE_SIMD       1
+#endif
+
 
 /*
  * Types of sound stream backends.
@@ -321,6 +365,18 @@
 #   define PJMEDIA_HAS_ALAW_ULAW_TABLE      1
 #endif
 
+/**
+ * Use SSE2 or NEON for the bulk A-law/U-law encode and decode functions,
+ * such as #pjmedia_ulaw_encode(), when the conversion tables are used
+ * (PJMEDIA_HAS_ALAW_ULAW_TABLE). The vectorized conversion gives the
+ * same result as the tables.
+ *
+ * Default: 1
+ */
+#ifndef PJMEDIA_ALAW_ULAW_USE_SIMD
+#   define PJMEDIA_ALAW_ULAW_USE_SIMD       1
+#endif
+
 
 /**
  * Unless specified otherwise, G711 codec is included by default.
@@ -390,6 +446,9 @@
 /** Sample rate conversion using libsamplerate (a.k.a Secret Rabbit Code) */
 #define PJMEDIA_RESAMPLE_LIBSAMPLERATE      4
 
+/** Sample rate conversion using the built-in polyphase FIR resampler */
+#define PJMEDIA_RESAMPLE_POLYPHASE          5
+
 /**
  * Select which resample implementation to use. Currently pjmedia supports:
  *  - #PJMEDIA_RESAMPLE_LIBRESAMPLE, to use libresample-1.7, this is the default
@@ -397,6 +456,9 @@
  *  - #PJMEDIA_RESAMPLE_LIBSAMPLERATE, to use libsamplerate implementation
  *    (a.k.a. Secret Rabbit Code).
  *  - #PJMEDIA_RESAMPLE_SPEEX, to use sample rate conversion in Speex library.
+ *  - #PJMEDIA_RESAMPLE_POLYPHASE, to use the built-in polyphase FIR
+ *    resampler, with filter tables computed when the resampler is created
+ *    and SIMD inner products (see #PJMEDIA_RESAMPLE_USE_SIMD).
  *  - #PJMEDIA_RESAMPLE_NONE, to disable sample rate conversion. Any calls to
  *    resample function will return error.
  *
@@ -407,6 +469,31 @@
 #endif
 
 
+/**
+ * Maximum number of filter phases of the polyphase resampler. The number
+ * of phases equals the output rate divided by the greatest common divisor
+ * of the input and output rates (e.g. 3 for 16KHz to 48KHz, 160 for
+ * 44.1KHz to 48KHz). Ratios needing more phases use the nearest phase of
+ * this many.
+ *
+ * Default: 256
+ */
+#ifndef PJMEDIA_RESAMPLE_MAX_PHASES
+#   define PJMEDIA_RESAMPLE_MAX_PHASES      256
+#endif
+
+
+/**
+ * Enable the SSE2 and NEON inner product of the polyphase resampler.
+ * When disabled, only the portable implementation is built.
+ *
+ * Default: 1
+ */
+#ifndef PJMEDIA_RESAMPLE_USE_SIMD
+#   define PJMEDIA_RESAMPLE_USE_SIMD        1
+#endif
+
+
 /**
  * Specify whether libsamplerate, when used, should be linked statically
  * into the application. This option is only useful for Visual Studio
@@ -660,6 +747,89 @@
 #   define PJMEDIA_STREAM_RESV_PAYLOAD_LEN      20
 #endif
 
+/**
+ * Extra space allocated after the stream's outgoing RTP packet buffer, so
+ * media transports can extend the packet in place instead of copying it,
+ * see #pjmedia_transport_send_rtp_buf(). The default value fits the
+ * largest SRTP trailer (auth tag and MKI). Set to zero to disable.
+ *
+ * Default: 144
+ */
+#ifndef PJMEDIA_STREAM_TX_TAILROOM
+#   define PJMEDIA_STREAM_TX_TAILROOM           144
+#endif
+
+/**
+ * Enable per-stream latency histograms of the audio stream hot path
+ * (RTP receive, jitter buffer wait, decode, conference/upstream and
+ * encode-to-send). When enabled, each stage is timed with
+ * #pj_get_timestamp() and the results can be retrieved with
+ * #pjmedia_stream_get_stat_lat(). This adds a few timestamp reads per
+ * frame, so it is disabled by default.
+ *
+ * Default: 0
+ */
+#ifndef PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+#   define PJMEDIA_STREAM_ENABLE_LATENCY_STAT   0
+#endif
+
+/**
+ * Number of received frames whose arrival time is remembered by the
+ * stream to measure the jitter buffer wait when
+ * #PJMEDIA_STREAM_ENABLE_LATENCY_STAT is enabled. Must be a power of two
+ * and should cover the maximum jitter buffer length in frames.
+ *
+ * Default: 128
+ */
+#ifndef PJMEDIA_STREAM_LATENCY_RX_HIST
+#   define PJMEDIA_STREAM_LATENCY_RX_HIST       128
+#endif
+
+/**
+ * Maximum number of decoded frames that a decode worker pool (see
+ * #pjmedia_stream_dec_pool_create()) stages for each attached stream.
+ * The workers only pull a frame from the jitter buffer once its playout
+ * time has come, so staging adds one frame of playout latency; larger
+ * values let a worker that fell behind catch up without underruns.
+ *
+ * Default: 2
+ */
+#ifndef PJMEDIA_STREAM_DEC_AHEAD
+#   define PJMEDIA_STREAM_DEC_AHEAD             2
+#endif
+
+/**
+ * Default number of decode worker threads created by applications that
+ * use #pjmedia_stream_dec_pool_create() (e.g. PJSUA-LIB). Zero disables
+ * the decode pool, so streams decode in their get_frame() callback.
+ *
+ * Default: 0
+ */
+#ifndef PJMEDIA_STREAM_DEC_THREADS
+#   define PJMEDIA_STREAM_DEC_THREADS           0
+#endif
+
+/**
+ * Maximum number of outgoing RTP packets held by the UDP transport before
+ * they are sent in one batch, see #PJMEDIA_UDP_TX_BATCH.
+ *
+ * Default: 16
+ */
+#ifndef PJMEDIA_TRANSPORT_UDP_TX_BATCH_MAX
+#   define PJMEDIA_TRANSPORT_UDP_TX_BATCH_MAX   16
+#endif
+
+/**
+ * Maximum number of incoming RTP packets read by the UDP transport with
+ * one system call, see #PJMEDIA_UDP_RX_BATCH. Each entry needs a receive
+ * buffer of PJMEDIA_MAX_MRU bytes in the transport.
+ *
+ * Default: 16
+ */
+#ifndef PJMEDIA_TRANSPORT_UDP_RX_BATCH_MAX
+#   define PJMEDIA_TRANSPORT_UDP_RX_BATCH_MAX   16
+#endif
+
 
 /**
  * Specify the maximum duration of silence period in the codec, in msec. 
@@ -1091,6 +1261,30 @@
 #endif
 
 
+/**
+ * Maximum number of outgoing RTP packets queued on an SRTP transport that
+ * is attached to a crypto worker pool (see #pjmedia_srtp_tx_pool_create()).
+ * Each entry needs a buffer of PJMEDIA_MAX_MTU bytes in the transport.
+ *
+ * Default: 16
+ */
+#ifndef PJMEDIA_SRTP_TX_QUEUE_LEN
+#   define PJMEDIA_SRTP_TX_QUEUE_LEN                16
+#endif
+
+
+/**
+ * Default number of crypto worker threads created by applications that
+ * use #pjmedia_srtp_tx_pool_create() (e.g. PJSUA-LIB). Zero disables the
+ * crypto pool, so SRTP packets are protected by the sending thread.
+ *
+ * Default: 0
+ */
+#ifndef PJMEDIA_SRTP_TX_THREADS
+#   define PJMEDIA_SRTP_TX_THREADS                  0
+#endif
+
+
 /**
  * Set OpenSSL ciphers for DTLS-SRTP.
  *
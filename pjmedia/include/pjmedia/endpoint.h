@@ -241,6 +241,73 @@ PJ_DECL(pj_thread_t*) pjmedia_endpt_get_thread(pjmedia_endpt *endpt,
 PJ_DECL(pj_status_t) pjmedia_endpt_stop_threads(pjmedia_endpt *endpt);
 
 
+/**
+ * Split the media transport load of the media endpoint into several
+ * ioqueue shards. Each shard has its own ioqueue, polled by a dedicated
+ * worker thread, so that the media sockets are spread over several poll
+ * sets and threads instead of contending on the single ioqueue of the
+ * endpoint. Media transports created afterwards are placed on the least
+ * loaded shard (see #pjmedia_endpt_acquire_ioqueue()).
+ *
+ * This function must be called before any media transport is created,
+ * and only once.
+ *
+ * @param endpt         The media endpoint instance.
+ * @param shard_cnt     Number of shards, between 1 and 16.
+ * @param pin_cpu       If non-zero, the thread of shard N is bound to
+ *                      CPU N. Binding failures, e.g. when there are fewer
+ *                      CPUs than shards, are logged and ignored.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_endpt_create_shards(pjmedia_endpt *endpt,
+                                                 unsigned shard_cnt,
+                                                 pj_bool_t pin_cpu);
+
+/**
+ * Get the number of ioqueue shards of the media endpoint.
+ *
+ * @param endpt         The media endpoint instance.
+ *
+ * @return              The number of shards, zero if the endpoint is not
+ *                      sharded.
+ */
+PJ_DECL(unsigned) pjmedia_endpt_get_shard_count(pjmedia_endpt *endpt);
+
+/**
+ * Get the number of media transports currently placed on a shard.
+ *
+ * @param endpt         The media endpoint instance.
+ * @param index         The index of the shard: 0<= index < shard_cnt
+ *
+ * @return              The number of transports on the shard.
+ */
+PJ_DECL(unsigned) pjmedia_endpt_get_shard_load(pjmedia_endpt *endpt,
+                                               unsigned index);
+
+/**
+ * Get the ioqueue for a new media transport. When the endpoint is
+ * sharded, this returns the ioqueue of the least loaded shard and counts
+ * the transport in its load, otherwise it returns the ioqueue of the
+ * endpoint. Each call must be balanced with
+ * #pjmedia_endpt_release_ioqueue() when the transport is destroyed.
+ *
+ * @param endpt         The media endpoint instance.
+ *
+ * @return              The ioqueue instance.
+ */
+PJ_DECL(pj_ioqueue_t*) pjmedia_endpt_acquire_ioqueue(pjmedia_endpt *endpt);
+
+/**
+ * Release an ioqueue returned by #pjmedia_endpt_acquire_ioqueue().
+ *
+ * @param endpt         The media endpoint instance.
+ * @param ioqueue       The ioqueue instance.
+ */
+PJ_DECL(void) pjmedia_endpt_release_ioqueue(pjmedia_endpt *endpt,
+                                            pj_ioqueue_t *ioqueue);
+
+
 /**
  * Request the media endpoint to create pool.
  *
@@ -413,6 +413,37 @@ PJ_DECL(void) pjmedia_jbuf_get_frame3(pjmedia_jbuf *jb,
                                       int *seq);
 
 
+/**
+ * Get a frame from the jitter buffer without copying the frame payload.
+ * This is similar to #pjmedia_jbuf_get_frame3(), except that instead of
+ * being copied to application buffer, the payload is returned as a pointer
+ * to the jitter buffer internal storage. The payload remains valid and
+ * unchanged until the next call to get a frame from the jitter buffer, or
+ * until the jitter buffer is reset or destroyed.
+ *
+ * @param jb            The jitter buffer.
+ * @param frame         Pointer to receive the payload pointer, or NULL
+ *                      when the jitter buffer doesn't return a frame with
+ *                      payload (e.g: missing or empty frame).
+ * @param size          Pointer to receive the frame size.
+ * @param p_frm_type    Pointer to receive frame type.
+ *                      @see pjmedia_jbuf_get_frame().
+ * @param bit_info      Bit precise info of the frame, e.g: a frame may not
+ *                      exactly start and end at the octet boundary, so this
+ *                      field may be used for specifying start & end bit
+ *                      offset.
+ * @param ts            Frame timestamp.
+ * @param seq           Frame sequence number.
+ */
+PJ_DECL(void) pjmedia_jbuf_get_frame_ref(pjmedia_jbuf *jb,
+                                         const void **frame,
+                                         pj_size_t *size,
+                                         char *p_frm_type,
+                                         pj_uint32_t *bit_info,
+                                         pj_uint32_t *ts,
+                                         int *seq);
+
+
 /**
  * Peek a frame from the jitter buffer. The jitter buffer state will not be
  * modified.
@@ -267,6 +267,13 @@ typedef struct pjmedia_rtcp_session
     
     pjmedia_rtcp_stat       stat;       /**< Bidirectional stream stat.     */
 
+    /**
+     * Sequence counters of the statistics updates, one for each function
+     * updating them. Use #pjmedia_rtcp_get_stat() to read the statistics
+     * while the session is in use.
+     */
+    volatile pj_uint32_t    stat_seq[5];
+
 #if defined(PJMEDIA_HAS_RTCP_XR) && (PJMEDIA_HAS_RTCP_XR != 0)
     /**
      * Specify whether RTCP XR processing is enabled on this session.
@@ -448,6 +455,39 @@ PJ_DECL(void) pjmedia_rtcp_build_rtcp( pjmedia_rtcp_session *session,
                                        void **rtcp_pkt, int *len);
 
 
+/**
+ * Get a consistent copy of the session statistics. The copy is taken
+ * without locking: it is retried if the media threads updated the
+ * statistics while it was being made, so this function may be called
+ * from any thread, e.g. by a monitoring thread polling many streams,
+ * without slowing down RTP processing. The media threads never wait for
+ * the readers. If the statistics keep changing, or when called from a
+ * callback of the thread updating them, this function gives up rather
+ * than return an inconsistent copy.
+ *
+ * The peer SDES items in the copy point to the copy's own buffer.
+ *
+ * @param session   The RTCP session.
+ * @param stat      Upon return, it will contain the statistics.
+ *
+ * @return          PJ_SUCCESS, or PJ_EBUSY if no consistent copy could
+ *                  be made, in which case \a stat is undefined and the
+ *                  call may be retried later.
+ */
+PJ_DECL(pj_status_t) pjmedia_rtcp_get_stat(const pjmedia_rtcp_session *session,
+                                           pjmedia_rtcp_stat *stat);
+
+
+/**
+ * Reset the session statistics while the session is in use. The readers
+ * of #pjmedia_rtcp_get_stat() never see a partly reset copy. This must
+ * not be called concurrently with itself for the same session.
+ *
+ * @param session   The RTCP session.
+ */
+PJ_DECL(void) pjmedia_rtcp_reset_stat(pjmedia_rtcp_session *session);
+
+
 /**
  * Build an RTCP SDES (source description) packet. This packet can be
  * appended to other RTCP packets, e.g: RTCP RR/SR, to compose a compound
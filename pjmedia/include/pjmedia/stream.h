@@ -185,6 +185,69 @@ typedef struct pjmedia_stream_dtmf_event {
 } pjmedia_stream_dtmf_event;
 
 
+/**
+ * Number of buckets in a #pjmedia_stream_lat_hist. Buckets 0 to 7 count
+ * exact microsecond values, after that each power of two is split into
+ * four buckets, and the last bucket also counts every latency above its
+ * lower bound (about 1.8 seconds).
+ */
+#define PJMEDIA_STREAM_LAT_BUCKET_CNT   80
+
+/**
+ * Stages of the audio stream hot path measured by the stream latency
+ * statistics, see #pjmedia_stream_get_stat_lat().
+ */
+typedef enum pjmedia_stream_lat_stage
+{
+    /** Processing of an incoming RTP packet, up to the jitter buffer. */
+    PJMEDIA_STREAM_LAT_RX,
+
+    /** Time a received frame waited in the jitter buffer. */
+    PJMEDIA_STREAM_LAT_JBUF,
+
+    /** Jitter buffer retrieval and decoding of one audio frame. */
+    PJMEDIA_STREAM_LAT_DECODE,
+
+    /** Time between handing a decoded frame to the upstream port (e.g.
+     *  the conference bridge) and receiving the next frame to encode. */
+    PJMEDIA_STREAM_LAT_CONF,
+
+    /** Encoding of one audio frame up to sending the RTP packet. */
+    PJMEDIA_STREAM_LAT_ENCODE,
+
+    /** Number of stages. */
+    PJMEDIA_STREAM_LAT_STAGE_CNT
+
+} pjmedia_stream_lat_stage;
+
+/**
+ * Latency histogram of one stream stage. Use
+ * #pjmedia_stream_lat_bucket_usec() to get the range of each bucket and
+ * #pjmedia_stream_lat_percentile() to estimate percentiles.
+ */
+typedef struct pjmedia_stream_lat_hist
+{
+    pj_uint32_t     count;      /**< Number of samples.                     */
+    pj_uint32_t     min_usec;   /**< Minimum latency, in usec.              */
+    pj_uint32_t     max_usec;   /**< Maximum latency, in usec.              */
+    pj_uint64_t     sum_usec;   /**< Sum of all latencies, in usec.         */
+
+    /** Number of samples in each bucket. */
+    pj_uint32_t     bucket[PJMEDIA_STREAM_LAT_BUCKET_CNT];
+
+} pjmedia_stream_lat_hist;
+
+/**
+ * Stream latency statistics, indexed by #pjmedia_stream_lat_stage.
+ */
+typedef struct pjmedia_stream_lat_stat
+{
+    /** Histogram of each stage. */
+    pjmedia_stream_lat_hist stage[PJMEDIA_STREAM_LAT_STAGE_CNT];
+
+} pjmedia_stream_lat_stat;
+
+
 /**
  * This function will initialize the stream info based on information
  * in both SDP session descriptors for the specified stream index. 
@@ -331,7 +394,9 @@ PJ_DECL(pj_status_t) pjmedia_stream_get_info( const pjmedia_stream *stream,
  * @param stream        The media stream.
  * @param stat          Media stream statistics.
  *
- * @return              PJ_SUCCESS on success.
+ * @return              PJ_SUCCESS on success, or PJ_EBUSY if the
+ *                      statistics kept being updated, see
+ *                      #pjmedia_rtcp_get_stat().
  */
 PJ_DECL(pj_status_t) pjmedia_stream_get_stat( const pjmedia_stream *stream,
                                               pjmedia_rtcp_stat *stat);
@@ -373,6 +438,49 @@ PJ_DECL(pj_status_t) pjmedia_stream_get_stat_jbuf(const pjmedia_stream *stream,
                                                   pjmedia_jb_state *state);
 
 
+/**
+ * Get the per-stage latency histograms of the stream. The histograms are
+ * only collected when #PJMEDIA_STREAM_ENABLE_LATENCY_STAT is enabled, and
+ * are cleared by #pjmedia_stream_reset_stat().
+ *
+ * @param stream        The media stream.
+ * @param stat          Latency statistics.
+ *
+ * @return              PJ_SUCCESS on success, or PJ_ENOTSUP if latency
+ *                      statistics are disabled in this build.
+ */
+PJ_DECL(pj_status_t) pjmedia_stream_get_stat_lat(const pjmedia_stream *stream,
+                                                 pjmedia_stream_lat_stat *stat);
+
+
+/**
+ * Get the lower bound, in microseconds, of the specified latency histogram
+ * bucket.
+ *
+ * @param idx           Bucket index, less than
+ *                      #PJMEDIA_STREAM_LAT_BUCKET_CNT.
+ *
+ * @return              Lowest latency counted in the bucket.
+ */
+PJ_DECL(pj_uint32_t) pjmedia_stream_lat_bucket_usec(unsigned idx);
+
+
+/**
+ * Estimate a latency percentile from a histogram. The result is the lower
+ * bound of the bucket containing the percentile, clamped to the observed
+ * minimum and maximum.
+ *
+ * @param hist          The histogram.
+ * @param pct           Percentile, 0 to 100.
+ *
+ * @return              Latency in microseconds, or zero if the histogram
+ *                      is empty.
+ */
+PJ_DECL(pj_uint32_t)
+pjmedia_stream_lat_percentile(const pjmedia_stream_lat_hist *hist,
+                              unsigned pct);
+
+
 /**
  * Pause the individual channel in the stream.
  *
@@ -551,6 +659,69 @@ pjmedia_stream_get_rtp_session_info(pjmedia_stream *stream,
                                    pjmedia_stream_rtp_sess_info *session_info);
 
 
+/**
+ * Opaque declaration of a decode worker pool, shared by several audio
+ * streams to decode their received frames ahead of playout.
+ */
+typedef struct pjmedia_stream_dec_pool pjmedia_stream_dec_pool;
+
+
+/**
+ * Create a decode worker pool. Each stream attached to the pool with
+ * #pjmedia_stream_set_dec_pool() is pinned to one of the worker threads,
+ * which pulls frames from the stream's jitter buffer as their playout
+ * time comes and decodes them. The stream's get_frame() then only copies
+ * the PCM staged on the previous call, so codec processing is moved off the
+ * thread that clocks the stream (e.g. the conference bridge) and is
+ * spread over the workers.
+ *
+ * @param pool          Pool to allocate the decode pool from.
+ * @param worker_cnt    Number of worker threads, must be at least one.
+ * @param p_dec_pool    Pointer to receive the decode pool.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_stream_dec_pool_create(pj_pool_t *pool,
+                               unsigned worker_cnt,
+                               pjmedia_stream_dec_pool **p_dec_pool);
+
+
+/**
+ * Stop the worker threads and destroy the decode pool. All streams must
+ * have been detached from the pool (or destroyed) beforehand.
+ *
+ * @param dec_pool      The decode pool.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_stream_dec_pool_destroy(pjmedia_stream_dec_pool *dec_pool);
+
+
+/**
+ * Attach the stream to a decode pool, or detach it when \a dec_pool is
+ * NULL, in which case the stream goes back to decoding in its get_frame()
+ * callback. Frames that were decoded ahead but not played yet are
+ * discarded on detach. A stream is detached automatically when it is
+ * destroyed.
+ *
+ * Decoding in the pool adds one frame of playout latency, and is only
+ * supported for streams whose port format is linear PCM. While attached,
+ * encoding and decoding are serialized with a codec mutex, as the codec is
+ * then used by both the worker and the thread that clocks the stream.
+ *
+ * @param stream        The media stream.
+ * @param dec_pool      The decode pool, or NULL to detach.
+ *
+ * @return              PJ_SUCCESS on success, or PJ_ENOTSUP if the stream
+ *                      does not decode to PCM.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_stream_set_dec_pool(pjmedia_stream *stream,
+                            pjmedia_stream_dec_pool *dec_pool);
+
+
 /**
  * @}
  */
@@ -297,6 +297,61 @@ typedef struct pjmedia_sock_info
 } pjmedia_sock_info;
 
 
+/**
+ * Flags of #pjmedia_transport_tx_buf.
+ */
+typedef enum pjmedia_transport_tx_flag
+{
+    /**
+     * More packets will follow right away, e.g: the other packets of the
+     * same video frame. A transport may hold the packet and send it with
+     * the next ones in one batch. The batch is sent when a packet without
+     * this flag is sent, so the last packet must never have it.
+     */
+    PJMEDIA_TRANSPORT_TX_MORE = 1
+
+} pjmedia_transport_tx_flag;
+
+
+/**
+ * This structure describes a writable buffer holding an outgoing RTP
+ * packet, see #pjmedia_transport_send_rtp_buf(). The packet lies somewhere
+ * between \a buf and \a buf + \a buf_size, so the space before it
+ * (headroom) and after it (tailroom) may be used by the transports to
+ * grow the packet without copying it, e.g: to append SRTP auth tag.
+ */
+typedef struct pjmedia_transport_tx_buf
+{
+    /**
+     * Start of the buffer.
+     */
+    void                *buf;
+
+    /**
+     * Total size of the buffer.
+     */
+    pj_size_t            buf_size;
+
+    /**
+     * Start of the packet, inside the buffer. A transport may move it
+     * into the headroom.
+     */
+    void                *pkt;
+
+    /**
+     * Size of the packet. A transport may update it, as long as the
+     * packet stays inside the buffer.
+     */
+    pj_size_t            size;
+
+    /**
+     * Bitmask of #pjmedia_transport_tx_flag.
+     */
+    unsigned             flags;
+
+} pjmedia_transport_tx_buf;
+
+
 /**
  * This structure describes the operations for the stream transport.
  */
@@ -457,6 +512,23 @@ struct pjmedia_transport_op
      */
     pj_status_t (*attach2)(pjmedia_transport *tp,
                            pjmedia_transport_attach_param *att_param);
+
+    /**
+     * This function is called by the stream to send RTP packet in a
+     * writable buffer. The transport owns the buffer content only until
+     * the function returns: it may rewrite the packet in place (e.g:
+     * encrypt it) or grow it into the headroom and tailroom, but it must
+     * not keep any reference to the buffer after returning. Transports
+     * which send the packet asynchronously must copy it first.
+     *
+     * This member is optional, when it is NULL, the stream will use
+     * #send_rtp() instead.
+     *
+     * Application should call #pjmedia_transport_send_rtp_buf() instead
+     * of calling this function directly.
+     */
+    pj_status_t (*send_rtp_buf)(pjmedia_transport *tp,
+                                pjmedia_transport_tx_buf *tx_buf);
 };
 
 
@@ -873,6 +945,45 @@ PJ_INLINE(pj_status_t) pjmedia_transport_send_rtp(pjmedia_transport *tp,
 }
 
 
+/**
+ * Get the number of bytes available after the packet in the buffer.
+ *
+ * @param tx_buf    The transmit buffer.
+ *
+ * @return          The tailroom size, in bytes.
+ */
+PJ_INLINE(pj_size_t)
+pjmedia_transport_tx_buf_tailroom(const pjmedia_transport_tx_buf *tx_buf)
+{
+    return ((const pj_uint8_t*)tx_buf->buf + tx_buf->buf_size) -
+           ((const pj_uint8_t*)tx_buf->pkt + tx_buf->size);
+}
+
+
+/**
+ * Send RTP packet held in a writable buffer with the specified media
+ * transport. Unlike #pjmedia_transport_send_rtp(), the transport may
+ * modify the packet in place instead of copying it, so the content of
+ * the buffer is undefined when this function returns, and the caller
+ * must rebuild the packet before sending it again. If the transport
+ * does not implement <tt>send_rtp_buf()</tt>, the packet is sent with
+ * <tt>send_rtp()</tt>.
+ *
+ * @param tp        The media transport.
+ * @param tx_buf    The buffer containing the packet to send.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_INLINE(pj_status_t)
+pjmedia_transport_send_rtp_buf(pjmedia_transport *tp,
+                               pjmedia_transport_tx_buf *tx_buf)
+{
+    if (tp->op->send_rtp_buf)
+        return (*tp->op->send_rtp_buf)(tp, tx_buf);
+    return (*tp->op->send_rtp)(tp, tx_buf->pkt, tx_buf->size);
+}
+
+
 /**
  * Send RTCP packet with the specified media transport. This is just a simple
  * wrapper which calls <tt>send_rtcp()</tt> member of the transport. The 
@@ -570,6 +570,68 @@ PJ_DECL(pjmedia_transport*) pjmedia_transport_srtp_get_member(
                                                     pjmedia_transport *srtp);
 
 
+/**
+ * Opaque declaration of a crypto worker pool, shared by several SRTP
+ * transports to protect their outgoing RTP packets.
+ */
+typedef struct pjmedia_srtp_tx_pool pjmedia_srtp_tx_pool;
+
+
+/**
+ * Create a crypto worker pool. Each SRTP transport attached to the pool
+ * with #pjmedia_transport_srtp_set_tx_pool() is pinned to one of the
+ * worker threads. Outgoing RTP packets are then only copied into a queue
+ * of the transport by the sender, and the worker protects all packets
+ * queued so far in one pass, then sends them to the member transport
+ * with #PJMEDIA_TRANSPORT_TX_MORE set on all but the last one. This moves
+ * the encryption off the thread that clocks the streams (e.g. the
+ * conference bridge) and spreads it over the workers.
+ *
+ * @param pool          Pool to allocate the crypto pool from.
+ * @param worker_cnt    Number of worker threads, must be at least one.
+ * @param p_pool        Pointer to receive the crypto pool.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_srtp_tx_pool_create(pj_pool_t *pool,
+                                                 unsigned worker_cnt,
+                                                 pjmedia_srtp_tx_pool **p_pool);
+
+
+/**
+ * Stop the worker threads and destroy the crypto pool. All SRTP
+ * transports must have been detached from the pool (or destroyed)
+ * beforehand.
+ *
+ * @param tx_pool       The crypto pool.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_srtp_tx_pool_destroy(
+                                            pjmedia_srtp_tx_pool *tx_pool);
+
+
+/**
+ * Attach the SRTP transport to a crypto worker pool, or detach it when
+ * \a tx_pool is NULL, in which case outgoing RTP packets are protected
+ * and sent by the caller of send_rtp() again. Packets that were queued
+ * but not sent yet are discarded on detach. A transport is detached
+ * automatically when it is destroyed.
+ *
+ * While attached, send_rtp() returns as soon as the packet is queued, and
+ * returns PJ_ETOOMANY when #PJMEDIA_SRTP_TX_QUEUE_LEN packets are already
+ * waiting for the worker. RTCP is always protected by the caller.
+ *
+ * @param srtp          The SRTP media transport.
+ * @param tx_pool       The crypto pool, or NULL to detach.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_transport_srtp_set_tx_pool(
+                                            pjmedia_transport *srtp,
+                                            pjmedia_srtp_tx_pool *tx_pool);
+
+
 PJ_END_DECL
 
 /**
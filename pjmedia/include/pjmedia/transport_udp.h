@@ -55,10 +55,87 @@ enum pjmedia_transport_udp_options
      * received.
      * Specifying this option will disable this feature.
      */
-    PJMEDIA_UDP_NO_SRC_ADDR_CHECKING = 1
+    PJMEDIA_UDP_NO_SRC_ADDR_CHECKING = 1,
+
+    /**
+     * Hold outgoing RTP packets sent with #PJMEDIA_TRANSPORT_TX_MORE flag
+     * and send them together with the next packet, with one system call
+     * when the platform has sendmmsg(). The batch is limited to
+     * PJMEDIA_TRANSPORT_UDP_TX_BATCH_MAX packets. Without the flag, this
+     * option has no effect.
+     */
+    PJMEDIA_UDP_TX_BATCH = 2,
+
+    /**
+     * Read incoming RTP packets in batches of up to
+     * PJMEDIA_TRANSPORT_UDP_RX_BATCH_MAX datagrams with one system call,
+     * using pj_ioqueue_recvmmsg(). The packets are still delivered to the
+     * stream one by one. When the ioqueue backend does not support batched
+     * reading, the transport silently reads one packet at a time.
+     */
+    PJMEDIA_UDP_RX_BATCH = 4
 };
 
 
+/**
+ * Statistics of the batched RTP transmission, see #PJMEDIA_UDP_TX_BATCH.
+ * The average batch size is \a pkt_cnt / \a batch_cnt.
+ */
+typedef struct pjmedia_transport_udp_tx_batch_stat
+{
+    /**
+     * Number of batches sent.
+     */
+    unsigned    batch_cnt;
+
+    /**
+     * Number of packets sent in the batches.
+     */
+    unsigned    pkt_cnt;
+
+    /**
+     * Number of system calls used to send the batches.
+     */
+    unsigned    syscall_cnt;
+
+    /**
+     * Number of batched packets which could not be sent at once and were
+     * queued to the ioqueue instead, because the socket would block.
+     */
+    unsigned    queued_cnt;
+
+    /**
+     * Size of the largest batch.
+     */
+    unsigned    max_size;
+
+} pjmedia_transport_udp_tx_batch_stat;
+
+
+/**
+ * Statistics of the batched RTP reception, see #PJMEDIA_UDP_RX_BATCH.
+ * The average batch size is \a pkt_cnt / \a batch_cnt.
+ */
+typedef struct pjmedia_transport_udp_rx_batch_stat
+{
+    /**
+     * Number of completed batched reads.
+     */
+    unsigned    batch_cnt;
+
+    /**
+     * Number of packets received in the batches.
+     */
+    unsigned    pkt_cnt;
+
+    /**
+     * Size of the largest batch.
+     */
+    unsigned    max_size;
+
+} pjmedia_transport_udp_rx_batch_stat;
+
+
 /**
  * Create an RTP and RTCP sockets and bind the sockets to the specified
  * port to create media transport.
@@ -106,6 +183,10 @@ PJ_DECL(pj_status_t) pjmedia_transport_udp_create2(pjmedia_endpt *endpt,
  * Another variant of #pjmedia_transport_udp_create() which allows
  * the creation of IPv6 transport.
  *
+ * As with all UDP transport constructors, the sockets are registered to
+ * the least loaded ioqueue shard when the media endpoint is sharded (see
+ * #pjmedia_endpt_create_shards()).
+ *
  * @param endpt     The media endpoint instance.
  * @param af        Address family, which can be pj_AF_INET() for IPv4 or
  *                  pj_AF_INET6() for IPv6.
@@ -148,6 +229,37 @@ PJ_DECL(pj_status_t) pjmedia_transport_udp_attach(pjmedia_endpt *endpt,
                                                   pjmedia_transport **p_tp);
 
 
+/**
+ * Get the statistics of the batched RTP transmission of the UDP transport.
+ * The statistics are all zero when the transport was not created with
+ * #PJMEDIA_UDP_TX_BATCH option.
+ *
+ * @param tp        The UDP media transport.
+ * @param stat      Pointer to receive the statistics.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_transport_udp_get_tx_batch_stat(
+                                pjmedia_transport *tp,
+                                pjmedia_transport_udp_tx_batch_stat *stat);
+
+
+/**
+ * Get the statistics of the batched RTP reception of the UDP transport.
+ * The statistics are all zero when the transport was not created with
+ * #PJMEDIA_UDP_RX_BATCH option, or when the ioqueue does not support
+ * batched reading.
+ *
+ * @param tp        The UDP media transport.
+ * @param stat      Pointer to receive the statistics.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_transport_udp_get_rx_batch_stat(
+                                pjmedia_transport *tp,
+                                pjmedia_transport_udp_rx_batch_stat *stat);
+
+
 PJ_END_DECL
 
 
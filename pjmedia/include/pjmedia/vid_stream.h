@@ -336,7 +336,9 @@ PJ_DECL(pjmedia_transport*) pjmedia_vid_stream_get_transport(
  * @param stream        The video stream.
  * @param stat          Media stream statistics.
  *
- * @return              PJ_SUCCESS on success.
+ * @return              PJ_SUCCESS on success, or PJ_EBUSY if the
+ *                      statistics kept being updated, see
+ *                      #pjmedia_rtcp_get_stat().
  */
 PJ_DECL(pj_status_t) pjmedia_vid_stream_get_stat(
                                             const pjmedia_vid_stream *stream,
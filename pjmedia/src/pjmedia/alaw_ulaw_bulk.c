@@ -0,0 +1,388 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/alaw_ulaw.h>
+
+/*
+ * Bulk A-law/U-law conversion.
+ *
+ * The vectorized versions compute the G.711 companding arithmetically on
+ * the input sample with the two least significant bits cleared, which is
+ * the precision of the conversion tables in alaw_ulaw_table.c, so the
+ * result is identical to the table lookup.
+ */
+#if defined(PJMEDIA_HAS_ALAW_ULAW_TABLE) && PJMEDIA_HAS_ALAW_ULAW_TABLE!=0 && \
+    PJMEDIA_ALAW_ULAW_USE_SIMD
+#   if defined(__SSE2__) || defined(_M_X64) || \
+       (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       define G711_HAS_SSE2    1
+#       include <emmintrin.h>
+#   elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#       define G711_HAS_NEON    1
+#       include <arm_neon.h>
+#   endif
+#endif
+
+#ifndef G711_HAS_SSE2
+#   define G711_HAS_SSE2        0
+#endif
+#ifndef G711_HAS_NEON
+#   define G711_HAS_NEON        0
+#endif
+
+#define BIAS                    (0x84)  /* Bias for linear code. */
+
+
+#if G711_HAS_SSE2
+
+/*
+ * The segment number and quantization bits are taken from the exponent
+ * and mantissa of the magnitude converted to float: for a magnitude
+ * with the leading one at bit e, the float bits shifted right by 19 are
+ * ((e + 127) << 4) | wxyz, where wxyz are the four bits following the
+ * leading one.
+ */
+#define FLOAT_SEG_OFS   ((127 + 7) << 4)
+
+/* Select b where mask is set, otherwise a. */
+static __m128i sse2_blend(__m128i a, __m128i b, __m128i mask)
+{
+    return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a));
+}
+
+/* Get ((seg << 4) | wxyz) of 8 unsigned magnitudes with the leading one
+ * at bit 7 or above, i.e. of magnitudes in segment 1 to 7, or more than
+ * 0x7F if the magnitude is out of range.
+ */
+static __m128i sse2_seg_quant(__m128i mag)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo, hi;
+
+    lo = _mm_castps_si128(_mm_cvtepi32_ps(_mm_unpacklo_epi16(mag, zero)));
+    hi = _mm_castps_si128(_mm_cvtepi32_ps(_mm_unpackhi_epi16(mag, zero)));
+    lo = _mm_sub_epi32(_mm_srli_epi32(lo, 19), _mm_set1_epi32(FLOAT_SEG_OFS));
+    hi = _mm_sub_epi32(_mm_srli_epi32(hi, 19), _mm_set1_epi32(FLOAT_SEG_OFS));
+
+    return _mm_packs_epi32(lo, hi);
+}
+
+/* Encode 8 samples to U-law (in the low byte of each lane). */
+static __m128i sse2_linear2ulaw(__m128i x)
+{
+    __m128i neg, mag, uval;
+
+    x = _mm_and_si128(x, _mm_set1_epi16(~3));
+    neg = _mm_srai_epi16(x, 15);
+
+    /* BIAS - x for negative, x + BIAS otherwise, as unsigned. With the
+     * bias the leading one is at bit 7 or above.
+     */
+    mag = _mm_sub_epi16(_mm_xor_si128(x, neg), neg);
+    mag = _mm_add_epi16(mag, _mm_set1_epi16(BIAS));
+
+    /* Out of range values get the maximum value */
+    uval = _mm_min_epi16(sse2_seg_quant(mag), _mm_set1_epi16(0x7F));
+
+    /* Complement, except for the sign bit of negative values */
+    return _mm_xor_si128(uval, _mm_xor_si128(_mm_set1_epi16(0xFF),
+                                   _mm_and_si128(neg, _mm_set1_epi16(0x80))));
+}
+
+/* Encode 8 samples to A-law (in the low byte of each lane). */
+static __m128i sse2_linear2alaw(__m128i x)
+{
+    __m128i neg, mag, aval, seg0;
+
+    x = _mm_and_si128(x, _mm_set1_epi16(~3));
+    neg = _mm_srai_epi16(x, 15);
+
+    /* Magnitude, as unsigned */
+    mag = _mm_sub_epi16(_mm_xor_si128(x, neg), neg);
+
+    /* Segment 0 is linear (magnitude >> 4), and out of range values get
+     * the maximum value.
+     */
+    aval = _mm_min_epi16(sse2_seg_quant(mag), _mm_set1_epi16(0x7F));
+    seg0 = _mm_cmpeq_epi16(_mm_srli_epi16(mag, 8), _mm_setzero_si128());
+    aval = sse2_blend(aval, _mm_srli_epi16(mag, 4), seg0);
+
+    return _mm_xor_si128(aval, _mm_xor_si128(_mm_set1_epi16(0xD5),
+                                   _mm_and_si128(neg, _mm_set1_epi16(0x80))));
+}
+
+/* Decode 4 U-law values (zero extended to 32bit lanes). The biased
+ * linear code is built directly as float, with the segment as exponent
+ * and the quantization bits (and the half step) as mantissa.
+ */
+static __m128i sse2_ulaw2linear(__m128i u)
+{
+    __m128i t, sign;
+
+    /* Complement to obtain normal u-law value */
+    u = _mm_xor_si128(u, _mm_set1_epi32(0xFF));
+    sign = _mm_srai_epi32(_mm_slli_epi32(u, 24), 31);
+
+    t = _mm_slli_epi32(_mm_and_si128(u, _mm_set1_epi32(0x7F)), 19);
+    t = _mm_add_epi32(t, _mm_set1_epi32(((127 + 7) << 23) | (1 << 18)));
+    t = _mm_cvttps_epi32(_mm_castsi128_ps(t));
+
+    /* t - BIAS, or BIAS - t for negative values */
+    t = _mm_sub_epi32(t, _mm_set1_epi32(BIAS));
+    return _mm_sub_epi32(_mm_xor_si128(t, sign), sign);
+}
+
+/* Decode 4 A-law values (zero extended to 32bit lanes). Segment 0 is
+ * linear, the others are built as float like U-law.
+ */
+static __m128i sse2_alaw2linear(__m128i a)
+{
+    __m128i t, t0, sign;
+
+    /* Remove the even bit inversion, and invert the sign bit so that it
+     * is set for negative values.
+     */
+    a = _mm_xor_si128(a, _mm_set1_epi32(0xD5));
+    sign = _mm_srai_epi32(_mm_slli_epi32(a, 24), 31);
+    a = _mm_and_si128(a, _mm_set1_epi32(0x7F));
+
+    t = _mm_add_epi32(_mm_slli_epi32(a, 19),
+                      _mm_set1_epi32(((127 + 7) << 23) | (1 << 18)));
+    t = _mm_cvttps_epi32(_mm_castsi128_ps(t));
+    t0 = _mm_add_epi32(_mm_slli_epi32(a, 4), _mm_set1_epi32(8));
+    t = sse2_blend(t, t0, _mm_cmplt_epi32(a, _mm_set1_epi32(0x10)));
+
+    return _mm_sub_epi32(_mm_xor_si128(t, sign), sign);
+}
+
+#define ENCODE_LOOP(dst, src, count, enc)                               \
+    for (; count >= 16; count -= 16, src += 16, dst += 16) {            \
+        __m128i lo = enc(_mm_loadu_si128((const __m128i*)src));         \
+        __m128i hi = enc(_mm_loadu_si128((const __m128i*)(src + 8)));  \
+        _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(lo, hi));      \
+    }
+
+#define DECODE_LOOP(dst, src, len, dec)                                 \
+    for (; len >= 16; len -= 16, src += 16, dst += 16) {                \
+        __m128i zero = _mm_setzero_si128();                             \
+        __m128i v = _mm_loadu_si128((const __m128i*)src);               \
+        __m128i lo = _mm_unpacklo_epi8(v, zero);                        \
+        __m128i hi = _mm_unpackhi_epi8(v, zero);                        \
+        _mm_storeu_si128((__m128i*)dst,                                 \
+               _mm_packs_epi32(dec(_mm_unpacklo_epi16(lo, zero)),       \
+                               dec(_mm_unpackhi_epi16(lo, zero))));     \
+        _mm_storeu_si128((__m128i*)(dst + 8),                           \
+               _mm_packs_epi32(dec(_mm_unpacklo_epi16(hi, zero)),       \
+                               dec(_mm_unpackhi_epi16(hi, zero))));     \
+    }
+
+#elif G711_HAS_NEON
+
+/* Encode 8 samples to U-law. */
+static uint8x8_t neon_linear2ulaw(int16x8_t x)
+{
+    uint16x8_t neg, mag, seg, uval;
+    int16x8_t shift;
+
+    x = vandq_s16(x, vdupq_n_s16(~3));
+    neg = vreinterpretq_u16_s16(vshrq_n_s16(x, 15));
+
+    /* BIAS - x for negative, x + BIAS otherwise, as unsigned */
+    mag = vreinterpretq_u16_s16(vabsq_s16(x));
+    mag = vaddq_u16(mag, vdupq_n_u16(BIAS));
+
+    /* Segment is 8 - number of leading zeros, shift is seg + 3 */
+    seg = vqsubq_u16(vdupq_n_u16(8), vclzq_u16(mag));
+    shift = vnegq_s16(vreinterpretq_s16_u16(vaddq_u16(seg, vdupq_n_u16(3))));
+
+    uval = vorrq_u16(vshlq_n_u16(seg, 4),
+                     vandq_u16(vshlq_u16(mag, shift), vdupq_n_u16(0x0F)));
+    uval = vbslq_u16(vcgeq_u16(seg, vdupq_n_u16(8)), vdupq_n_u16(0x7F), uval);
+
+    uval = veorq_u16(uval, veorq_u16(vdupq_n_u16(0xFF),
+                                     vandq_u16(neg, vdupq_n_u16(0x80))));
+    return vmovn_u16(uval);
+}
+
+/* Encode 8 samples to A-law. */
+static uint8x8_t neon_linear2alaw(int16x8_t x)
+{
+    uint16x8_t neg, mag, seg, aval;
+    int16x8_t shift;
+
+    x = vandq_s16(x, vdupq_n_s16(~3));
+    neg = vreinterpretq_u16_s16(vshrq_n_s16(x, 15));
+
+    /* Magnitude, as unsigned */
+    mag = vreinterpretq_u16_s16(vabsq_s16(x));
+
+    /* Shift is 4 for segment 0 and 1, seg + 3 otherwise */
+    seg = vqsubq_u16(vdupq_n_u16(8), vclzq_u16(mag));
+    shift = vnegq_s16(vreinterpretq_s16_u16(
+                vaddq_u16(vmaxq_u16(seg, vdupq_n_u16(1)), vdupq_n_u16(3))));
+
+    aval = vorrq_u16(vshlq_n_u16(seg, 4),
+                     vandq_u16(vshlq_u16(mag, shift), vdupq_n_u16(0x0F)));
+    aval = vbslq_u16(vcgeq_u16(seg, vdupq_n_u16(8)), vdupq_n_u16(0x7F), aval);
+
+    aval = veorq_u16(aval, veorq_u16(vdupq_n_u16(0xD5),
+                                     vandq_u16(neg, vdupq_n_u16(0x80))));
+    return vmovn_u16(aval);
+}
+
+/* Decode 8 U-law values. */
+static int16x8_t neon_ulaw2linear(uint8x8_t v)
+{
+    uint16x8_t u = vmovl_u8(vmvn_u8(v));
+    int16x8_t t, seg;
+
+    t = vreinterpretq_s16_u16(
+            vaddq_u16(vshlq_n_u16(vandq_u16(u, vdupq_n_u16(0x0F)), 3),
+                      vdupq_n_u16(BIAS)));
+    seg = vreinterpretq_s16_u16(vandq_u16(vshrq_n_u16(u, 4),
+                                          vdupq_n_u16(7)));
+    t = vshlq_s16(t, seg);
+
+    return vbslq_s16(vtstq_u16(u, vdupq_n_u16(0x80)),
+                     vsubq_s16(vdupq_n_s16(BIAS), t),
+                     vsubq_s16(t, vdupq_n_s16(BIAS)));
+}
+
+/* Decode 8 A-law values. */
+static int16x8_t neon_alaw2linear(uint8x8_t v)
+{
+    uint16x8_t a = vmovl_u8(veor_u8(v, vdup_n_u8(0x55)));
+    uint16x8_t seg, t;
+
+    t = vshlq_n_u16(vandq_u16(a, vdupq_n_u16(0x0F)), 4);
+    seg = vandq_u16(vshrq_n_u16(a, 4), vdupq_n_u16(7));
+
+    /* Add 8 for segment 0, 0x108 otherwise, then shift by seg - 1 */
+    t = vaddq_u16(t, vbslq_u16(vceqq_u16(seg, vdupq_n_u16(0)),
+                               vdupq_n_u16(8), vdupq_n_u16(0x108)));
+    t = vshlq_u16(t, vreinterpretq_s16_u16(vqsubq_u16(seg, vdupq_n_u16(1))));
+
+    return vbslq_s16(vtstq_u16(a, vdupq_n_u16(0x80)),
+                     vreinterpretq_s16_u16(t),
+                     vnegq_s16(vreinterpretq_s16_u16(t)));
+}
+
+#define ENCODE_LOOP(dst, src, count, enc)                               \
+    for (; count >= 8; count -= 8, src += 8, dst += 8) {                \
+        vst1_u8(dst, enc(vld1q_s16(src)));                              \
+    }
+
+#define DECODE_LOOP(dst, src, len, dec)                                 \
+    for (; len >= 8; len -= 8, src += 8, dst += 8) {                    \
+        vst1q_s16(dst, dec(vld1_u8(src)));                              \
+    }
+
+#endif  /* G711_HAS_NEON */
+
+
+PJ_DEF(void) pjmedia_ulaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
+                                 pj_size_t count)
+{
+#if G711_HAS_SSE2
+    ENCODE_LOOP(dst, src, count, sse2_linear2ulaw)
+#elif G711_HAS_NEON
+    ENCODE_LOOP(dst, src, count, neon_linear2ulaw)
+#endif
+
+    while (count--) {
+        *dst++ = pjmedia_linear2ulaw(*src++);
+    }
+}
+
+PJ_DEF(void) pjmedia_alaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
+                                 pj_size_t count)
+{
+#if G711_HAS_SSE2
+    ENCODE_LOOP(dst, src, count, sse2_linear2alaw)
+#elif G711_HAS_NEON
+    ENCODE_LOOP(dst, src, count, neon_linear2alaw)
+#endif
+
+    while (count--) {
+        *dst++ = pjmedia_linear2alaw(*src++);
+    }
+}
+
+PJ_DEF(void) pjmedia_ulaw_decode(pj_int16_t *dst, const pj_uint8_t *src,
+                                 pj_size_t len)
+{
+#if G711_HAS_SSE2
+    DECODE_LOOP(dst, src, len, sse2_ulaw2linear)
+#elif G711_HAS_NEON
+    DECODE_LOOP(dst, src, len, neon_ulaw2linear)
+#endif
+
+    while (len--) {
+        *dst++ = (pj_int16_t)pjmedia_ulaw2linear(*src++);
+    }
+}
+
+PJ_DEF(void) pjmedia_alaw_decode(pj_int16_t *dst, const pj_uint8_t *src,
+                                 pj_size_t len)
+{
+#if G711_HAS_SSE2
+    DECODE_LOOP(dst, src, len, sse2_alaw2linear)
+#elif G711_HAS_NEON
+    DECODE_LOOP(dst, src, len, neon_alaw2linear)
+#endif
+
+    while (len--) {
+        *dst++ = (pj_int16_t)pjmedia_alaw2linear(*src++);
+    }
+}
+
+PJ_DEF(void) pjmedia_alaw_to_ulaw(pj_uint8_t *dst, const pj_uint8_t *src,
+                                  pj_size_t len)
+{
+    pj_size_t i;
+
+    for (i = 0; i + 4 <= len; i += 4) {
+        pj_uint8_t s0 = src[i], s1 = src[i+1], s2 = src[i+2], s3 = src[i+3];
+
+        dst[i]   = pjmedia_alaw2ulaw(s0);
+        dst[i+1] = pjmedia_alaw2ulaw(s1);
+        dst[i+2] = pjmedia_alaw2ulaw(s2);
+        dst[i+3] = pjmedia_alaw2ulaw(s3);
+    }
+    for (; i < len; ++i) {
+        dst[i] = pjmedia_alaw2ulaw(src[i]);
+    }
+}
+
+PJ_DEF(void) pjmedia_ulaw_to_alaw(pj_uint8_t *dst, const pj_uint8_t *src,
+                                  pj_size_t len)
+{
+    pj_size_t i;
+
+    for (i = 0; i + 4 <= len; i += 4) {
+        pj_uint8_t s0 = src[i], s1 = src[i+1], s2 = src[i+2], s3 = src[i+3];
+
+        dst[i]   = pjmedia_ulaw2alaw(s0);
+        dst[i+1] = pjmedia_ulaw2alaw(s1);
+        dst[i+2] = pjmedia_ulaw2alaw(s2);
+        dst[i+3] = pjmedia_ulaw2alaw(s3);
+    }
+    for (; i < len; ++i) {
+        dst[i] = pjmedia_ulaw2alaw(src[i]);
+    }
+}
@@ -0,0 +1,761 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/audio_mix.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+
+/*
+ * SIMD implementations available in this build. SSE2 and NEON are
+ * selected at compile time, AVX2 is compiled with function target
+ * attributes and selected at runtime.
+ */
+#if PJMEDIA_AUDIO_MIX_USE_SIMD
+#   if defined(__SSE2__) || defined(_M_X64) || \
+       (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       define MIX_HAS_SSE2     1
+#       include <emmintrin.h>
+#   endif
+#   if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+       (defined(__clang__) || __GNUC__ >= 5)
+#       define MIX_HAS_AVX2     1
+#       include <immintrin.h>
+#   endif
+#   if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#       define MIX_HAS_NEON     1
+#       include <arm_neon.h>
+#   endif
+#endif
+
+#ifndef MIX_HAS_SSE2
+#   define MIX_HAS_SSE2         0
+#endif
+#ifndef MIX_HAS_AVX2
+#   define MIX_HAS_AVX2         0
+#endif
+#ifndef MIX_HAS_NEON
+#   define MIX_HAS_NEON         0
+#endif
+
+#define NORMAL_LEVEL            128
+#define MAX_LEVEL               (32767)
+#define MIN_LEVEL               (-32768)
+
+
+/* Kernel table of an implementation. */
+typedef struct mix_ops
+{
+    pjmedia_mix_impl    impl;
+    pj_int32_t        (*sum_abs)(const pj_int16_t*, unsigned);
+    pj_int32_t        (*adjust_level)(pj_int16_t*, const pj_int16_t*,
+                                      unsigned, unsigned);
+    void              (*accumulate)(pj_int32_t*, const pj_int16_t*,
+                                    unsigned, pj_int32_t*, pj_int32_t*);
+    pj_int32_t        (*to_pcm)(pj_int16_t*, const pj_int32_t*, unsigned,
+                                pj_int32_t);
+} mix_ops;
+
+
+/*
+ * Scalar (reference) implementation. The multiplications are done in
+ * unsigned arithmetic to get the defined wrap-around behavior the SIMD
+ * versions have, the shifts are arithmetic.
+ */
+static pj_int32_t sum_abs_scalar(const pj_int16_t *src, unsigned count)
+{
+    pj_int32_t sum = 0;
+    unsigned i;
+
+    for (i = 0; i < count; ++i)
+        sum += (src[i] >= 0 ? src[i] : -src[i]);
+
+    return sum;
+}
+
+static pj_int32_t adjust_level_scalar(pj_int16_t *dst, const pj_int16_t *src,
+                                      unsigned count, unsigned level)
+{
+    pj_int32_t sum = 0;
+    unsigned i;
+
+    for (i = 0; i < count; ++i) {
+        pj_int32_t itemp;
+
+        itemp = (pj_int32_t)((pj_uint32_t)(pj_int32_t)src[i] * level);
+        itemp >>= 7;
+
+        /* Clip the signal if it's too loud */
+        if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
+        else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
+
+        dst[i] = (pj_int16_t)itemp;
+        sum += (itemp >= 0 ? itemp : -itemp);
+    }
+
+    return sum;
+}
+
+static void accumulate_scalar(pj_int32_t *mix, const pj_int16_t *src,
+                              unsigned count, pj_int32_t *p_min,
+                              pj_int32_t *p_max)
+{
+    pj_int32_t mix_min = *p_min, mix_max = *p_max;
+    unsigned i;
+
+    for (i = 0; i < count; ++i) {
+        mix[i] += src[i];
+        if (mix[i] < mix_min)
+            mix_min = mix[i];
+        if (mix[i] > mix_max)
+            mix_max = mix[i];
+    }
+
+    *p_min = mix_min;
+    *p_max = mix_max;
+}
+
+static pj_int32_t to_pcm_scalar(pj_int16_t *dst, const pj_int32_t *mix,
+                                unsigned count, pj_int32_t level)
+{
+    pj_int32_t sum = 0;
+    unsigned i;
+
+    if (level != NORMAL_LEVEL) {
+        for (i = 0; i < count; ++i) {
+            pj_int32_t itemp;
+
+            itemp = (pj_int32_t)((pj_uint32_t)mix[i] * (pj_uint32_t)level);
+            itemp >>= 7;
+
+            /* Clip the signal if it's too loud */
+            if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
+            else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
+
+            dst[i] = (pj_int16_t)itemp;
+            sum += (itemp >= 0 ? itemp : -itemp);
+        }
+    } else {
+        for (i = 0; i < count; ++i) {
+            pj_int16_t s = (pj_int16_t)mix[i];
+
+            dst[i] = s;
+            sum += (s >= 0 ? s : -s);
+        }
+    }
+
+    return sum;
+}
+
+static const mix_ops scalar_ops =
+{
+    PJMEDIA_MIX_IMPL_SCALAR,
+    &sum_abs_scalar,
+    &adjust_level_scalar,
+    &accumulate_scalar,
+    &to_pcm_scalar
+};
+
+
+#if MIX_HAS_SSE2
+/*
+ * SSE2 implementation, 8 samples per iteration.
+ */
+
+/* Low 32 bits of 32x32 bit products (SSE4.1 _mm_mullo_epi32). */
+static __m128i sse2_mullo32(__m128i a, __m128i b)
+{
+    __m128i p02 = _mm_mul_epu32(a, b);
+    __m128i p13 = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(p02, _MM_SHUFFLE(0,0,2,0)),
+                              _mm_shuffle_epi32(p13, _MM_SHUFFLE(0,0,2,0)));
+}
+
+/* Absolute values of 32bit lanes. */
+static __m128i sse2_abs32(__m128i v)
+{
+    __m128i sign = _mm_srai_epi32(v, 31);
+    return _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+}
+
+/* Select the lower/higher of 32bit lanes. */
+static __m128i sse2_min32(__m128i a, __m128i b)
+{
+    __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+static __m128i sse2_max32(__m128i a, __m128i b)
+{
+    __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+/* Add the sign extended 16bit samples of v to the 32bit sum. */
+static __m128i sse2_add_abs16(__m128i sum, __m128i v)
+{
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+    sum = _mm_add_epi32(sum, sse2_abs32(lo));
+    return _mm_add_epi32(sum, sse2_abs32(hi));
+}
+
+static pj_int32_t sse2_hsum32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+static pj_int32_t sum_abs_sse2(const pj_int16_t *src, unsigned count)
+{
+    __m128i vsum = _mm_setzero_si128();
+    unsigned i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        vsum = sse2_add_abs16(vsum, v);
+    }
+
+    return sse2_hsum32(vsum) + sum_abs_scalar(src + i, count - i);
+}
+
+static pj_int32_t adjust_level_sse2(pj_int16_t *dst, const pj_int16_t *src,
+                                    unsigned count, unsigned level)
+{
+    __m128i vlevel = _mm_set1_epi32((int)level);
+    __m128i vsum = _mm_setzero_si128();
+    unsigned i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+        lo = _mm_srai_epi32(sse2_mullo32(lo, vlevel), 7);
+        hi = _mm_srai_epi32(sse2_mullo32(hi, vlevel), 7);
+        v = _mm_packs_epi32(lo, hi);
+
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+        vsum = sse2_add_abs16(vsum, v);
+    }
+
+    return sse2_hsum32(vsum) +
+           adjust_level_scalar(dst + i, src + i, count - i, level);
+}
+
+static void accumulate_sse2(pj_int32_t *mix, const pj_int16_t *src,
+                            unsigned count, pj_int32_t *p_min,
+                            pj_int32_t *p_max)
+{
+    __m128i vmin = _mm_set1_epi32(*p_min);
+    __m128i vmax = _mm_set1_epi32(*p_max);
+    PJ_ALIGN_DATA(pj_int32_t tmp[4], 16);
+    unsigned i, k;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        __m128i m0 = _mm_loadu_si128((const __m128i*)(mix + i));
+        __m128i m1 = _mm_loadu_si128((const __m128i*)(mix + i + 4));
+
+        m0 = _mm_add_epi32(m0, lo);
+        m1 = _mm_add_epi32(m1, hi);
+        _mm_storeu_si128((__m128i*)(mix + i), m0);
+        _mm_storeu_si128((__m128i*)(mix + i + 4), m1);
+
+        vmin = sse2_min32(vmin, sse2_min32(m0, m1));
+        vmax = sse2_max32(vmax, sse2_max32(m0, m1));
+    }
+
+    _mm_store_si128((__m128i*)tmp, vmin);
+    for (k = 0; k < 4; ++k) {
+        if (tmp[k] < *p_min)
+            *p_min = tmp[k];
+    }
+    _mm_store_si128((__m128i*)tmp, vmax);
+    for (k = 0; k < 4; ++k) {
+        if (tmp[k] > *p_max)
+            *p_max = tmp[k];
+    }
+
+    accumulate_scalar(mix + i, src + i, count - i, p_min, p_max);
+}
+
+static pj_int32_t to_pcm_sse2(pj_int16_t *dst, const pj_int32_t *mix,
+                              unsigned count, pj_int32_t level)
+{
+    __m128i vlevel = _mm_set1_epi32(level);
+    __m128i vsum = _mm_setzero_si128();
+    unsigned i;
+
+    /* Both input vectors are loaded before the output is stored, so
+     * the conversion works in place.
+     */
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m128i m0 = _mm_loadu_si128((const __m128i*)(mix + i));
+        __m128i m1 = _mm_loadu_si128((const __m128i*)(mix + i + 4));
+        __m128i v;
+
+        if (level != NORMAL_LEVEL) {
+            m0 = _mm_srai_epi32(sse2_mullo32(m0, vlevel), 7);
+            m1 = _mm_srai_epi32(sse2_mullo32(m1, vlevel), 7);
+        } else {
+            /* Truncate, so that packing does not saturate */
+            m0 = _mm_srai_epi32(_mm_slli_epi32(m0, 16), 16);
+            m1 = _mm_srai_epi32(_mm_slli_epi32(m1, 16), 16);
+        }
+        v = _mm_packs_epi32(m0, m1);
+
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+        vsum = sse2_add_abs16(vsum, v);
+    }
+
+    return sse2_hsum32(vsum) +
+           to_pcm_scalar(dst + i, mix + i, count - i, level);
+}
+
+static const mix_ops sse2_ops =
+{
+    PJMEDIA_MIX_IMPL_SSE2,
+    &sum_abs_sse2,
+    &adjust_level_sse2,
+    &accumulate_sse2,
+    &to_pcm_sse2
+};
+#endif  /* MIX_HAS_SSE2 */
+
+
+#if MIX_HAS_AVX2
+/*
+ * AVX2 implementation, 16 samples per iteration.
+ */
+#define AVX2_FUNC   __attribute__((target("avx2")))
+
+/* Pack two vectors of 8 32bit lanes to 16 saturated 16bit samples. */
+AVX2_FUNC static __m256i avx2_packs32(__m256i a, __m256i b)
+{
+    /* _mm256_packs_epi32() packs within 128bit lanes */
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+                                    _MM_SHUFFLE(3,1,2,0));
+}
+
+/* Add the absolute values of 16 samples to the 32bit sum. */
+AVX2_FUNC static __m256i avx2_add_abs16(__m256i sum, __m256i v)
+{
+    __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+
+    sum = _mm256_add_epi32(sum, _mm256_abs_epi32(lo));
+    return _mm256_add_epi32(sum, _mm256_abs_epi32(hi));
+}
+
+AVX2_FUNC static pj_int32_t avx2_hsum32(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1,0,3,2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+AVX2_FUNC static pj_int32_t sum_abs_avx2(const pj_int16_t *src,
+                                         unsigned count)
+{
+    __m256i vsum = _mm256_setzero_si256();
+    unsigned i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        vsum = avx2_add_abs16(vsum, v);
+    }
+
+    return avx2_hsum32(vsum) + sum_abs_scalar(src + i, count - i);
+}
+
+AVX2_FUNC static pj_int32_t adjust_level_avx2(pj_int16_t *dst,
+                                              const pj_int16_t *src,
+                                              unsigned count,
+                                              unsigned level)
+{
+    __m256i vlevel = _mm256_set1_epi32((int)level);
+    __m256i vsum = _mm256_setzero_si256();
+    unsigned i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m256i lo, hi, v;
+
+        lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)
+                                                   (src + i)));
+        hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)
+                                                   (src + i + 8)));
+        lo = _mm256_srai_epi32(_mm256_mullo_epi32(lo, vlevel), 7);
+        hi = _mm256_srai_epi32(_mm256_mullo_epi32(hi, vlevel), 7);
+        v = avx2_packs32(lo, hi);
+
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+        vsum = avx2_add_abs16(vsum, v);
+    }
+
+    return avx2_hsum32(vsum) +
+           adjust_level_scalar(dst + i, src + i, count - i, level);
+}
+
+AVX2_FUNC static void accumulate_avx2(pj_int32_t *mix, const pj_int16_t *src,
+                                      unsigned count, pj_int32_t *p_min,
+                                      pj_int32_t *p_max)
+{
+    __m256i vmin = _mm256_set1_epi32(*p_min);
+    __m256i vmax = _mm256_set1_epi32(*p_max);
+    __m128i m;
+    unsigned i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m256i lo, hi, m0, m1;
+
+        lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)
+                                                   (src + i)));
+        hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)
+                                                   (src + i + 8)));
+        m0 = _mm256_loadu_si256((const __m256i*)(mix + i));
+        m1 = _mm256_loadu_si256((const __m256i*)(mix + i + 8));
+
+        m0 = _mm256_add_epi32(m0, lo);
+        m1 = _mm256_add_epi32(m1, hi);
+        _mm256_storeu_si256((__m256i*)(mix + i), m0);
+        _mm256_storeu_si256((__m256i*)(mix + i + 8), m1);
+
+        vmin = _mm256_min_epi32(vmin, _mm256_min_epi32(m0, m1));
+        vmax = _mm256_max_epi32(vmax, _mm256_max_epi32(m0, m1));
+    }
+
+    m = _mm_min_epi32(_mm256_castsi256_si128(vmin),
+                      _mm256_extracti128_si256(vmin, 1));
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1,0,3,2)));
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2,3,0,1)));
+    *p_min = _mm_cvtsi128_si32(m);
+
+    m = _mm_max_epi32(_mm256_castsi256_si128(vmax),
+                      _mm256_extracti128_si256(vmax, 1));
+    m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1,0,3,2)));
+    m = _mm_max_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2,3,0,1)));
+    *p_max = _mm_cvtsi128_si32(m);
+
+    accumulate_scalar(mix + i, src + i, count - i, p_min, p_max);
+}
+
+AVX2_FUNC static pj_int32_t to_pcm_avx2(pj_int16_t *dst,
+                                        const pj_int32_t *mix,
+                                        unsigned count, pj_int32_t level)
+{
+    __m256i vlevel = _mm256_set1_epi32(level);
+    __m256i vsum = _mm256_setzero_si256();
+    unsigned i;
+
+    /* Both input vectors are loaded before the output is stored, so
+     * the conversion works in place.
+     */
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m256i m0 = _mm256_loadu_si256((const __m256i*)(mix + i));
+        __m256i m1 = _mm256_loadu_si256((const __m256i*)(mix + i + 8));
+        __m256i v;
+
+        if (level != NORMAL_LEVEL) {
+            m0 = _mm256_srai_epi32(_mm256_mullo_epi32(m0, vlevel), 7);
+            m1 = _mm256_srai_epi32(_mm256_mullo_epi32(m1, vlevel), 7);
+        } else {
+            /* Truncate, so that packing does not saturate */
+            m0 = _mm256_srai_epi32(_mm256_slli_epi32(m0, 16), 16);
+            m1 = _mm256_srai_epi32(_mm256_slli_epi32(m1, 16), 16);
+        }
+        v = avx2_packs32(m0, m1);
+
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+        vsum = avx2_add_abs16(vsum, v);
+    }
+
+    return avx2_hsum32(vsum) +
+           to_pcm_scalar(dst + i, mix + i, count - i, level);
+}
+
+static const mix_ops avx2_ops =
+{
+    PJMEDIA_MIX_IMPL_AVX2,
+    &sum_abs_avx2,
+    &adjust_level_avx2,
+    &accumulate_avx2,
+    &to_pcm_avx2
+};
+#endif  /* MIX_HAS_AVX2 */
+
+
+#if MIX_HAS_NEON
+/*
+ * NEON implementation, 8 samples per iteration.
+ */
+static pj_int32_t neon_hsum32(int32x4_t v)
+{
+    return vgetq_lane_s32(v, 0) + vgetq_lane_s32(v, 1) +
+           vgetq_lane_s32(v, 2) + vgetq_lane_s32(v, 3);
+}
+
+static int32x4_t neon_add_abs16(int32x4_t sum, int16x8_t v)
+{
+    sum = vaddq_s32(sum, vabsq_s32(vmovl_s16(vget_low_s16(v))));
+    return vaddq_s32(sum, vabsq_s32(vmovl_s16(vget_high_s16(v))));
+}
+
+static pj_int32_t sum_abs_neon(const pj_int16_t *src, unsigned count)
+{
+    int32x4_t vsum = vdupq_n_s32(0);
+    unsigned i;
+
+    for (i = 0; i + 8 <= count; i += 8)
+        vsum = neon_add_abs16(vsum, vld1q_s16(src + i));
+
+    return neon_hsum32(vsum) + sum_abs_scalar(src + i, count - i);
+}
+
+static pj_int32_t adjust_level_neon(pj_int16_t *dst, const pj_int16_t *src,
+                                    unsigned count, unsigned level)
+{
+    int32x4_t vlevel = vdupq_n_s32((pj_int32_t)level);
+    int32x4_t vsum = vdupq_n_s32(0);
+    unsigned i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        int32x4_t lo = vmulq_s32(vmovl_s16(vget_low_s16(v)), vlevel);
+        int32x4_t hi = vmulq_s32(vmovl_s16(vget_high_s16(v)), vlevel);
+
+        v = vcombine_s16(vqmovn_s32(vshrq_n_s32(lo, 7)),
+                         vqmovn_s32(vshrq_n_s32(hi, 7)));
+        vst1q_s16(dst + i, v);
+        vsum = neon_add_abs16(vsum, v);
+    }
+
+    return neon_hsum32(vsum) +
+           adjust_level_scalar(dst + i, src + i, count - i, level);
+}
+
+static void accumulate_neon(pj_int32_t *mix, const pj_int16_t *src,
+                            unsigned count, pj_int32_t *p_min,
+                            pj_int32_t *p_max)
+{
+    int32x4_t vmin = vdupq_n_s32(*p_min);
+    int32x4_t vmax = vdupq_n_s32(*p_max);
+    pj_int32_t tmp[4];
+    unsigned i, k;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        int32x4_t m0 = vaddq_s32(vld1q_s32(mix + i),
+                                 vmovl_s16(vget_low_s16(v)));
+        int32x4_t m1 = vaddq_s32(vld1q_s32(mix + i + 4),
+                                 vmovl_s16(vget_high_s16(v)));
+
+        vst1q_s32(mix + i, m0);
+        vst1q_s32(mix + i + 4, m1);
+        vmin = vminq_s32(vmin, vminq_s32(m0, m1));
+        vmax = vmaxq_s32(vmax, vmaxq_s32(m0, m1));
+    }
+
+    vst1q_s32(tmp, vmin);
+    for (k = 0; k < 4; ++k) {
+        if (tmp[k] < *p_min)
+            *p_min = tmp[k];
+    }
+    vst1q_s32(tmp, vmax);
+    for (k = 0; k < 4; ++k) {
+        if (tmp[k] > *p_max)
+            *p_max = tmp[k];
+    }
+
+    accumulate_scalar(mix + i, src + i, count - i, p_min, p_max);
+}
+
+static pj_int32_t to_pcm_neon(pj_int16_t *dst, const pj_int32_t *mix,
+                              unsigned count, pj_int32_t level)
+{
+    int32x4_t vlevel = vdupq_n_s32(level);
+    int32x4_t vsum = vdupq_n_s32(0);
+    unsigned i;
+
+    /* Both input vectors are loaded before the output is stored, so
+     * the conversion works in place.
+     */
+    for (i = 0; i + 8 <= count; i += 8) {
+        int32x4_t m0 = vld1q_s32(mix + i);
+        int32x4_t m1 = vld1q_s32(mix + i + 4);
+        int16x8_t v;
+
+        if (level != NORMAL_LEVEL) {
+            v = vcombine_s16(vqmovn_s32(vshrq_n_s32(vmulq_s32(m0, vlevel),7)),
+                             vqmovn_s32(vshrq_n_s32(vmulq_s32(m1, vlevel),7)));
+        } else {
+            /* Truncate */
+            v = vcombine_s16(vmovn_s32(m0), vmovn_s32(m1));
+        }
+
+        vst1q_s16(dst + i, v);
+        vsum = neon_add_abs16(vsum, v);
+    }
+
+    return neon_hsum32(vsum) +
+           to_pcm_scalar(dst + i, mix + i, count - i, level);
+}
+
+static const mix_ops neon_ops =
+{
+    PJMEDIA_MIX_IMPL_NEON,
+    &sum_abs_neon,
+    &adjust_level_neon,
+    &accumulate_neon,
+    &to_pcm_neon
+};
+#endif  /* MIX_HAS_NEON */
+
+
+/* Currently selected implementation */
+static const mix_ops *cur_ops;
+
+
+static const mix_ops *get_impl_ops(pjmedia_mix_impl impl)
+{
+    switch (impl) {
+    case PJMEDIA_MIX_IMPL_SCALAR:
+        return &scalar_ops;
+#if MIX_HAS_SSE2
+    case PJMEDIA_MIX_IMPL_SSE2:
+        return &sse2_ops;
+#endif
+#if MIX_HAS_AVX2
+    case PJMEDIA_MIX_IMPL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? &avx2_ops : NULL;
+#endif
+#if MIX_HAS_NEON
+    case PJMEDIA_MIX_IMPL_NEON:
+        return &neon_ops;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+static const mix_ops *get_best_ops(void)
+{
+    static const pjmedia_mix_impl pref[] =
+    {
+        PJMEDIA_MIX_IMPL_AVX2,
+        PJMEDIA_MIX_IMPL_SSE2,
+        PJMEDIA_MIX_IMPL_NEON,
+        PJMEDIA_MIX_IMPL_SCALAR
+    };
+    unsigned i;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(pref); ++i) {
+        const mix_ops *ops = get_impl_ops(pref[i]);
+        if (ops)
+            return ops;
+    }
+
+    return &scalar_ops;
+}
+
+/* Get the current implementation, selecting the best one on first use. */
+PJ_INLINE(const mix_ops*) ops(void)
+{
+    if (!cur_ops)
+        cur_ops = get_best_ops();
+    return cur_ops;
+}
+
+
+PJ_DEF(pj_bool_t) pjmedia_mix_has_impl(pjmedia_mix_impl impl)
+{
+    if (impl == PJMEDIA_MIX_IMPL_AUTO)
+        return PJ_TRUE;
+    return get_impl_ops(impl) != NULL;
+}
+
+PJ_DEF(pj_status_t) pjmedia_mix_set_impl(pjmedia_mix_impl impl)
+{
+    const mix_ops *new_ops;
+
+    if (impl == PJMEDIA_MIX_IMPL_AUTO)
+        new_ops = get_best_ops();
+    else
+        new_ops = get_impl_ops(impl);
+
+    if (!new_ops)
+        return PJ_ENOTSUP;
+
+    cur_ops = new_ops;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pjmedia_mix_impl) pjmedia_mix_get_impl(void)
+{
+    return ops()->impl;
+}
+
+PJ_DEF(const char*) pjmedia_mix_impl_name(pjmedia_mix_impl impl)
+{
+    static const char *names[] =
+    {
+        "auto", "scalar", "sse2", "avx2", "neon"
+    };
+
+    PJ_ASSERT_RETURN((unsigned)impl < PJ_ARRAY_SIZE(names), "?");
+    return names[impl];
+}
+
+PJ_DEF(pj_int32_t) pjmedia_mix_sum_abs(const pj_int16_t *src,
+                                       unsigned count)
+{
+    return (*ops()->sum_abs)(src, count);
+}
+
+PJ_DEF(pj_int32_t) pjmedia_mix_adjust_level(pj_int16_t *dst,
+                                            const pj_int16_t *src,
+                                            unsigned count,
+                                            unsigned level)
+{
+    return (*ops()->adjust_level)(dst, src, count, level);
+}
+
+PJ_DEF(void) pjmedia_mix_accumulate(pj_int32_t *mix,
+                                    const pj_int16_t *src,
+                                    unsigned count,
+                                    pj_int32_t *p_min,
+                                    pj_int32_t *p_max)
+{
+    (*ops()->accumulate)(mix, src, count, p_min, p_max);
+}
+
+PJ_DEF(pj_int32_t) pjmedia_mix_to_pcm(pj_int16_t *dst,
+                                      const pj_int32_t *mix,
+                                      unsigned count,
+                                      pj_int32_t level)
+{
+    return (*ops()->to_pcm)(dst, mix, count, level);
+}
@@ -276,6 +276,60 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
 }
 
 
+/*
+ * Initialize conference bridge parameters.
+ */
+PJ_DEF(void) pjmedia_conf_param_default(pjmedia_conf_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->max_slots = 254;
+    param->sampling_rate = 16000;
+    param->channel_count = 1;
+    param->samples_per_frame = 320;
+    param->bits_per_sample = 16;
+    param->worker_threads = PJMEDIA_CONF_WORKER_THREADS;
+}
+
+
+/*
+ * Create conference bridge with parameters. The switch board does not mix
+ * audio, so worker threads are not used.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_create2(pj_pool_t *pool,
+                                         const pjmedia_conf_param *param,
+                                         pjmedia_conf **p_conf)
+{
+    PJ_ASSERT_RETURN(pool && param && p_conf, PJ_EINVAL);
+
+    return pjmedia_conf_create(pool, param->max_slots, param->sampling_rate,
+                               param->channel_count, param->samples_per_frame,
+                               param->bits_per_sample, param->options,
+                               p_conf);
+}
+
+
+/*
+ * Get clock tick statistics, not supported by the switch board.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_get_tick_stat(pjmedia_conf *conf,
+                                               pjmedia_conf_tick_stat *stat)
+{
+    PJ_ASSERT_RETURN(conf && stat, PJ_EINVAL);
+    pj_bzero(stat, sizeof(*stat));
+    return PJ_ENOTSUP;
+}
+
+
+/*
+ * Reset clock tick statistics, not supported by the switch board.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_reset_tick_stat(pjmedia_conf *conf)
+{
+    PJ_ASSERT_RETURN(conf, PJ_EINVAL);
+    return PJ_ENOTSUP;
+}
+
+
 /*
  * Pause sound device.
  */
@@ -18,6 +18,7 @@
  */
 #include <pjmedia/conference.h>
 #include <pjmedia/alaw_ulaw.h>
+#include <pjmedia/audio_mix.h>
 #include <pjmedia/delaybuf.h>
 #include <pjmedia/errno.h>
 #include <pjmedia/port.h>
@@ -28,6 +29,7 @@
 #include <pj/array.h>
 #include <pj/assert.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/string.h>
 
@@ -138,6 +140,12 @@ struct conf_port
     unsigned             rx_adj_level;  /**< Adjustment for RX.             */
     pj_int16_t          *adj_level_buf; /**< The adjustment buffer.         */
 
+    /* Frame read from this port in the current clock tick, at bridge's
+     * clock rate, ready to be mixed to the listeners.
+     */
+    pj_int16_t          *rx_frame;      /**< Frame read in this tick.       */
+    pj_bool_t            rx_frame_valid;/**< rx_frame has audio.            */
+
     /* Resample, for converting clock rate, if they're different. */
     pjmedia_resample    *rx_resample;
     pjmedia_resample    *tx_resample;
@@ -223,6 +231,19 @@ struct conf_port
      */
     pjmedia_delay_buf   *delay_buf;
 
+    /* Incremental mixing (PJMEDIA_CONF_INCREMENTAL_MIX option). The silence
+     * detector decides whether the signal read from the port is mixed. As
+     * a listener, the port records the active sources it hears in the
+     * current tick, to find the listeners that can share a mix.
+     */
+    pjmedia_silence_det *vad;           /**< RX silence detector.           */
+    unsigned             src_cnt;       /**< # of active sources heard.     */
+    pj_uint64_t          src_mask;      /**< Active sources heard (index in
+                                             active_src).                   */
+    pj_bool_t            own_mix;       /**< Can't share a mix.             */
+    int                  shared_mix;    /**< Index in shared_mix, or -1.    */
+    pj_bool_t            mix_silent;    /**< Nothing was mixed in mix_buf.  */
+
     pj_bool_t            is_new;        /**< Newly added port, avoid read/write
                                              data from/to.                  */
 };
@@ -231,6 +252,38 @@ struct conf_port
 /* Forward declarations */
 typedef struct op_entry op_entry;
 
+/* Maximum number of active sources to find the listeners sharing a mix. */
+#define MAX_SHARED_SRC  64
+
+/*
+ * Mix shared by the listeners hearing the same set of active sources.
+ */
+struct conf_shared_mix
+{
+    pj_uint64_t          src_mask;      /**< Active sources in the mix.     */
+    unsigned             last_src;      /**< Last source mixed.             */
+    int                  mix_adj;       /**< Adjustment level for mix_buf.  */
+    pj_int32_t          *mix_buf;       /**< Total sum of signal.           */
+};
+
+/* Phase of the clock tick processed by the worker threads. */
+typedef enum conf_phase
+{
+    PHASE_READ,
+    PHASE_WRITE
+} conf_phase;
+
+/*
+ * Worker thread, processing a share of the ports on every clock tick.
+ */
+struct conf_worker
+{
+    pjmedia_conf        *conf;          /**< The bridge.                    */
+    unsigned             idx;           /**< Index, the clock thread is 0.  */
+    pj_thread_t         *thread;        /**< The thread.                    */
+    pj_sem_t            *sem;           /**< Signalled to run a phase.      */
+};
+
 
 /*
  * Conference bridge.
@@ -254,6 +307,38 @@ struct pjmedia_conf
 
     op_entry             *op_queue;     /**< Queue of operations.           */
     op_entry             *op_queue_free;/**< Queue of free entries.         */
+
+    /* Parallel processing */
+    unsigned              worker_cnt;   /**< Number of worker threads.      */
+    struct conf_worker   *workers;      /**< Worker threads.                */
+    pj_sem_t             *done_sem;     /**< Signalled by finished workers. */
+    pj_bool_t             quit;         /**< Worker threads must quit.      */
+    conf_phase            phase;        /**< Phase being processed.         */
+    unsigned              phase_threads;/**< Threads processing the phase.  */
+    unsigned             *active_slots; /**< Ports processed in this tick.  */
+    unsigned              active_cnt;   /**< Number of active_slots.        */
+    pj_timestamp          tick_ts;      /**< Timestamp of this tick.        */
+    pjmedia_frame_type    speaker_frame_type; /**< Port 0 frame type.       */
+
+    /* Incremental mixing */
+    unsigned             *active_src;   /**< Sources mixed in this tick.    */
+    unsigned              src_cnt;      /**< Number of active_src.          */
+    struct conf_shared_mix *shared_mix; /**< Shared mixes.                  */
+    unsigned              mix_cnt;      /**< Mixes calculated in this tick. */
+
+    /* Clock tick statistics, protected by mutex */
+    pj_uint32_t           tick_cnt;     /**< Number of ticks.               */
+    pj_uint32_t           overrun_cnt;  /**< Ticks exceeding the frame time.*/
+    unsigned              frame_usec;   /**< Frame duration.                */
+    unsigned              last_usec;    /**< Last tick duration.            */
+    unsigned              min_usec;     /**< Shortest tick.                 */
+    unsigned              max_usec;     /**< Longest tick.                  */
+    pj_uint64_t           total_usec;   /**< Sum of tick durations.         */
+    pj_uint64_t           read_usec;    /**< Sum of read phase durations.   */
+    pj_uint64_t           mix_usec;     /**< Sum of mix phase durations.    */
+    pj_uint64_t           write_usec;   /**< Sum of write phase durations.  */
+    unsigned              last_src_cnt; /**< Sources mixed in last tick.    */
+    unsigned              last_mix_cnt; /**< Mixes calculated in last tick. */
 };
 
 
@@ -474,6 +559,12 @@ static pj_status_t create_conf_port( pj_pool_t *parent_pool,
     PJ_ASSERT_ON_FAIL(conf_port->adj_level_buf,
                       {status = PJ_ENOMEM; goto on_return;});
 
+    /* Create buffer for the frame read in each clock tick. */
+    conf_port->rx_frame = (pj_int16_t*) pj_pool_zalloc(pool,
+                          conf->samples_per_frame * sizeof(pj_int16_t));
+    PJ_ASSERT_ON_FAIL(conf_port->rx_frame,
+                      {status = PJ_ENOMEM; goto on_return;});
+
     /* If port's clock rate is different than conference's clock rate,
      * create a resample sessions.
      */
@@ -583,6 +674,17 @@ static pj_status_t create_conf_port( pj_pool_t *parent_pool,
                       {status = PJ_ENOMEM; goto on_return;});
     conf_port->last_mix_adj = NORMAL_LEVEL;
 
+    /* Create silence detector for incremental mixing. */
+    if (conf->options & PJMEDIA_CONF_INCREMENTAL_MIX) {
+        status = pjmedia_silence_det_create(pool, conf->clock_rate,
+                                            conf->samples_per_frame /
+                                                conf->channel_count,
+                                            &conf_port->vad);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+    }
+    conf_port->shared_mix = -1;
+
 
     /* Done */
     *p_conf_port = conf_port;
@@ -703,6 +805,27 @@ static pj_status_t create_sound_port( pj_pool_t *pool,
     return PJ_SUCCESS;
 }
 
+/*
+ * Worker thread.
+ */
+static int conf_worker_thread(void *arg);
+
+
+/*
+ * Initialize conference bridge parameters.
+ */
+PJ_DEF(void) pjmedia_conf_param_default(pjmedia_conf_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->max_slots = 254;
+    param->sampling_rate = 16000;
+    param->channel_count = 1;
+    param->samples_per_frame = 320;
+    param->bits_per_sample = 16;
+    param->worker_threads = PJMEDIA_CONF_WORKER_THREADS;
+}
+
+
 /*
  * Create conference bridge.
  */
@@ -714,15 +837,46 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool_,
                                          unsigned bits_per_sample,
                                          unsigned options,
                                          pjmedia_conf **p_conf )
+{
+    pjmedia_conf_param param;
+
+    pjmedia_conf_param_default(&param);
+    param.max_slots = max_ports;
+    param.sampling_rate = clock_rate;
+    param.channel_count = channel_count;
+    param.samples_per_frame = samples_per_frame;
+    param.bits_per_sample = bits_per_sample;
+    param.options = options;
+
+    return pjmedia_conf_create2(pool_, &param, p_conf);
+}
+
+
+/*
+ * Create conference bridge with parameters.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_create2(pj_pool_t *pool_,
+                                         const pjmedia_conf_param *param,
+                                         pjmedia_conf **p_conf)
 {
     pj_pool_t *pool;
     pjmedia_conf *conf;
     const pj_str_t name = { "Conf", 4 };
+    unsigned max_ports = param->max_slots;
+    unsigned clock_rate = param->sampling_rate;
+    unsigned channel_count = param->channel_count;
+    unsigned samples_per_frame = param->samples_per_frame;
+    unsigned bits_per_sample = param->bits_per_sample;
+    unsigned options = param->options;
+    unsigned i;
     pj_status_t status;
 
+    PJ_ASSERT_RETURN(pool_ && param && p_conf, PJ_EINVAL);
     PJ_ASSERT_RETURN(samples_per_frame > 0, PJ_EINVAL);
     /* Can only accept 16bits per sample, for now.. */
     PJ_ASSERT_RETURN(bits_per_sample == 16, PJ_EINVAL);
+    PJ_ASSERT_RETURN(param->worker_threads <= PJMEDIA_CONF_MAX_WORKER_THREADS,
+                     PJ_ETOOMANY);
 
     PJ_LOG(5,(THIS_FILE, "Creating conference bridge with %d ports",
               max_ports));
@@ -749,7 +903,27 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool_,
     conf->channel_count = channel_count;
     conf->samples_per_frame = samples_per_frame;
     conf->bits_per_sample = bits_per_sample;
-
+    conf->frame_usec = (unsigned)((pj_uint64_t)samples_per_frame * 1000000 /
+                                  channel_count / clock_rate);
+    conf->min_usec = (unsigned)-1;
+
+    conf->active_slots = (unsigned*)
+                         pj_pool_calloc(pool, max_ports, sizeof(unsigned));
+    PJ_ASSERT_RETURN(conf->active_slots, PJ_ENOMEM);
+
+    if (options & PJMEDIA_CONF_INCREMENTAL_MIX) {
+        conf->active_src = (unsigned*)
+                           pj_pool_calloc(pool, max_ports, sizeof(unsigned));
+        conf->shared_mix = (struct conf_shared_mix*)
+                           pj_pool_calloc(pool, PJMEDIA_CONF_MAX_SHARED_MIX,
+                                          sizeof(struct conf_shared_mix));
+        PJ_ASSERT_RETURN(conf->active_src && conf->shared_mix, PJ_ENOMEM);
+        for (i = 0; i < PJMEDIA_CONF_MAX_SHARED_MIX; ++i) {
+            conf->shared_mix[i].mix_buf = (pj_int32_t*)
+                pj_pool_calloc(pool, samples_per_frame, sizeof(pj_int32_t));
+            PJ_ASSERT_RETURN(conf->shared_mix[i].mix_buf, PJ_ENOMEM);
+        }
+    }
     
     /* Create and initialize the master port interface. */
     conf->master_port = PJ_POOL_ZALLOC_T(pool, pjmedia_port);
@@ -805,6 +979,44 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool_,
     pj_list_init(conf->op_queue);
     pj_list_init(conf->op_queue_free);
 
+    /* Start worker threads */
+    if (param->worker_threads) {
+        status = pj_sem_create(pool, "confdone", 0, param->worker_threads,
+                               &conf->done_sem);
+        if (status != PJ_SUCCESS) {
+            pjmedia_conf_destroy(conf);
+            return status;
+        }
+
+        conf->workers = (struct conf_worker*)
+                        pj_pool_calloc(pool, param->worker_threads,
+                                       sizeof(struct conf_worker));
+        for (i = 0; i < param->worker_threads; ++i) {
+            struct conf_worker *w = &conf->workers[i];
+
+            w->conf = conf;
+            w->idx = i + 1;
+            status = pj_sem_create(pool, "confwork", 0, 1, &w->sem);
+            if (status == PJ_SUCCESS) {
+                status = pj_thread_create(pool, "confwork%p",
+                                          &conf_worker_thread, w, 0, 0,
+                                          &w->thread);
+            }
+            if (status != PJ_SUCCESS) {
+                if (w->sem) {
+                    pj_sem_destroy(w->sem);
+                    w->sem = NULL;
+                }
+                pjmedia_conf_destroy(conf);
+                return status;
+            }
+            ++conf->worker_cnt;
+        }
+
+        PJ_LOG(4,(THIS_FILE, "Conference bridge uses %d worker threads",
+                  conf->worker_cnt));
+    }
+
     /* Done */
 
     *p_conf = conf;
@@ -851,6 +1063,22 @@ PJ_DEF(pj_status_t) pjmedia_conf_destroy( pjmedia_conf *conf )
         conf->snd_dev_port = NULL;
     }
 
+    /* Stop worker threads */
+    conf->quit = PJ_TRUE;
+    for (i=0; i<conf->worker_cnt; ++i) {
+        struct conf_worker *w = &conf->workers[i];
+
+        pj_sem_post(w->sem);
+        pj_thread_join(w->thread);
+        pj_thread_destroy(w->thread);
+        pj_sem_destroy(w->sem);
+    }
+    conf->worker_cnt = 0;
+    if (conf->done_sem) {
+        pj_sem_destroy(conf->done_sem);
+        conf->done_sem = NULL;
+    }
+
     /* Flush any pending operation (connect, disconnect, etc) */
     handle_op_queue(conf);
 
@@ -2004,6 +2232,62 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_conn_level( pjmedia_conf *conf,
 }
 
 
+/*
+ * Get clock tick statistics.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_get_tick_stat(pjmedia_conf *conf,
+                                               pjmedia_conf_tick_stat *stat)
+{
+    PJ_ASSERT_RETURN(conf && stat, PJ_EINVAL);
+
+    pj_bzero(stat, sizeof(*stat));
+
+    pj_mutex_lock(conf->mutex);
+
+    stat->thread_cnt = conf->worker_cnt + 1;
+    stat->frame_usec = conf->frame_usec;
+    stat->tick_cnt = conf->tick_cnt;
+    stat->overrun_cnt = conf->overrun_cnt;
+    if (conf->tick_cnt) {
+        stat->last_usec = conf->last_usec;
+        stat->min_usec = conf->min_usec;
+        stat->max_usec = conf->max_usec;
+        stat->avg_usec = (unsigned)(conf->total_usec / conf->tick_cnt);
+        stat->read_avg_usec = (unsigned)(conf->read_usec / conf->tick_cnt);
+        stat->mix_avg_usec = (unsigned)(conf->mix_usec / conf->tick_cnt);
+        stat->write_avg_usec = (unsigned)(conf->write_usec / conf->tick_cnt);
+        stat->min_slack_usec = (int)conf->frame_usec - (int)conf->max_usec;
+        stat->last_src_cnt = conf->last_src_cnt;
+        stat->last_mix_cnt = conf->last_mix_cnt;
+    }
+
+    pj_mutex_unlock(conf->mutex);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Reset clock tick statistics.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_reset_tick_stat(pjmedia_conf *conf)
+{
+    PJ_ASSERT_RETURN(conf, PJ_EINVAL);
+
+    pj_mutex_lock(conf->mutex);
+
+    conf->tick_cnt = conf->overrun_cnt = 0;
+    conf->last_usec = conf->max_usec = 0;
+    conf->min_usec = (unsigned)-1;
+    conf->total_usec = conf->read_usec = 0;
+    conf->mix_usec = conf->write_usec = 0;
+
+    pj_mutex_unlock(conf->mutex);
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Read from port.
  */
@@ -2163,7 +2447,7 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
                               pjmedia_frame_type *frm_type)
 {
     pj_int16_t *buf;
-    unsigned j, ts;
+    unsigned ts;
     pj_status_t status;
     pj_int32_t adj_level;
     pj_int32_t tx_level;
@@ -2249,30 +2533,15 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
     adj_level = cport->tx_adj_level * cport->mix_adj;
     adj_level >>= 7;
 
-    tx_level = 0;
-
-    if (adj_level != NORMAL_LEVEL) {
-        for (j=0; j<conf->samples_per_frame; ++j) {
-            pj_int32_t itemp = cport->mix_buf[j];
-
-            /* Adjust the level */
-            /*itemp = itemp * adj_level / NORMAL_LEVEL;*/
-            itemp = (itemp * adj_level) >> 7;
-
-            /* Clip the signal if it's too loud */
-            if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
-            else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
-
-            /* Put back in the buffer. */
-            buf[j] = (pj_int16_t) itemp;
-
-            tx_level += (buf[j]>=0? buf[j] : -buf[j]);
-        }
+    /* Adjust the level (or just truncate if the level is normal), put
+     * the samples back in the buffer and calculate the TX level.
+     */
+    if (cport->mix_silent) {
+        /* Nothing was mixed, the cleared mix_buf is already silent PCM */
+        tx_level = 0;
     } else {
-        for (j=0; j<conf->samples_per_frame; ++j) {
-            buf[j] = (pj_int16_t) cport->mix_buf[j];
-            tx_level += (buf[j]>=0? buf[j] : -buf[j]);
-        }
+        tx_level = pjmedia_mix_to_pcm(buf, cport->mix_buf,
+                                      conf->samples_per_frame, adj_level);
     }
 
     tx_level /= conf->samples_per_frame;
@@ -2397,197 +2666,324 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
 
 
 /*
- * Player callback.
+ * Read a frame from a port to its rx_frame, adjust the RX level and
+ * calculate the port's signal level.
  */
-static pj_status_t get_frame(pjmedia_port *this_port, 
-                             pjmedia_frame *frame)
+static void read_one_port(pjmedia_conf *conf, unsigned slot)
 {
-    pjmedia_conf *conf = (pjmedia_conf*) this_port->port_data.pdata;
-    pjmedia_frame_type speaker_frame_type = PJMEDIA_FRAME_TYPE_NONE;
-    unsigned ci, cj, i, j;
-    pj_int16_t *p_in;
-    
-    TRACE_((THIS_FILE, "- clock -"));
+    struct conf_port *conf_port = conf->ports[slot];
+    pj_int16_t *p_in = conf_port->rx_frame;
+    pj_int32_t level = 0;
 
-    /* Check that correct size is specified. */
-    pj_assert(frame->size == conf->samples_per_frame *
-                             conf->bits_per_sample / 8);
+    conf_port->rx_frame_valid = PJ_FALSE;
 
-    /* Perform any queued operations that need to be synchronized with
-     * the clock such as connect, disonnect, remove.
-     */
-    if (!pj_list_empty(conf->op_queue)) {
-        pj_log_push_indent();
-        pj_mutex_lock(conf->mutex);
-        handle_op_queue(conf);
-        pj_mutex_unlock(conf->mutex);
-        pj_log_pop_indent();
+    /* Skip if we're not allowed to receive from this port. */
+    if (conf_port->rx_setting == PJMEDIA_PORT_DISABLE) {
+        conf_port->rx_level = 0;
+        return;
     }
 
-    /* No mutex from this point! Otherwise it may cause deadlock as
-     * put_frame()/get_frame() may invoke callback.
-     *
-     * Note that any changes on the conference connections must be
-     * synchronized.
-     */
+    /* Also skip if this port doesn't have listeners. */
+    if (conf_port->listener_cnt == 0) {
+        conf_port->rx_level = 0;
+        return;
+    }
 
-    /* Reset port source count. We will only reset port's mix
-     * buffer when we have someone transmitting to it.
+    /* With incremental mixing, a port that has no listener receiving
+     * audio is treated as having no listeners.
      */
-    for (i=0, ci=0; i<conf->max_ports && ci < conf->port_cnt; ++i) {
-        struct conf_port *conf_port = conf->ports[i];
+    if (conf_port->vad) {
+        unsigned i;
 
-        /* Skip empty or new port. */
-        if (!conf_port || conf_port->is_new)
-            continue;
-
-        /* Var "ci" is to count how many ports have been visited so far. */
-        ++ci;
-
-        /* Skip if we're not allowed to transmit to this port. */
-        if (conf_port->tx_setting != PJMEDIA_PORT_ENABLE)
-            continue;
+        for (i = 0; i < conf_port->listener_cnt; ++i) {
+            struct conf_port *listener;
 
-        /* Reset buffer (only necessary if the port has transmitter) and
-         * reset auto adjustment level for mixed signal.
-         */
-        conf_port->mix_adj = NORMAL_LEVEL;
-        if (conf_port->transmitter_cnt) {
-            pj_bzero(conf_port->mix_buf,
-                     conf->samples_per_frame*sizeof(conf_port->mix_buf[0]));
+            listener = conf->ports[conf_port->listener_slots[i]];
+            if (listener && listener->tx_setting == PJMEDIA_PORT_ENABLE)
+                break;
+        }
+        if (i == conf_port->listener_cnt) {
+            conf_port->rx_level = 0;
+            return;
         }
     }
 
-    /* Get frames from all ports, and "mix" the signal 
-     * to mix_buf of all listeners of the port.
+    /* Get frame from this port.
+     * For passive ports, get the frame from the delay_buf.
+     * For other ports, get the frame from the port. 
      */
-    for (i=0, ci=0; i < conf->max_ports && ci < conf->port_cnt; ++i) {
-        struct conf_port *conf_port = conf->ports[i];
-        pj_int32_t level = 0;
+    if (conf_port->delay_buf != NULL) {
+        pj_status_t status;
+    
+        status = pjmedia_delay_buf_get(conf_port->delay_buf, p_in);
+        if (status != PJ_SUCCESS) {
+            conf_port->rx_level = 0;
+            return;
+        }           
 
-        /* Skip empty or new port. */
-        if (!conf_port || conf_port->is_new)
-            continue;
+    } else {
 
-        /* Var "ci" is to count how many ports have been visited so far. */
-        ++ci;
+        pj_status_t status;
+        pjmedia_frame_type frame_type;
 
-        /* Skip if we're not allowed to receive from this port. */
-        if (conf_port->rx_setting == PJMEDIA_PORT_DISABLE) {
+        status = read_port(conf, conf_port, p_in, 
+                           conf->samples_per_frame, &frame_type);
+        
+        if (status != PJ_SUCCESS) {
+            /* bennylp: why do we need this????
+             * Also see comments on similar issue with write_port().
+            PJ_LOG(4,(THIS_FILE, "Port %.*s get_frame() returned %d. "
+                                 "Port is now disabled",
+                                 (int)conf_port->name.slen,
+                                 conf_port->name.ptr,
+                                 status));
+            conf_port->rx_setting = PJMEDIA_PORT_DISABLE;
+             */
             conf_port->rx_level = 0;
-            continue;
+            return;
         }
 
-        /* Also skip if this port doesn't have listeners. */
-        if (conf_port->listener_cnt == 0) {
+        /* Check that the port is not removed when we call get_frame() */
+        if (conf->ports[slot] == NULL) {
             conf_port->rx_level = 0;
-            continue;
+            return;
         }
+            
 
-        /* Get frame from this port.
-         * For passive ports, get the frame from the delay_buf.
-         * For other ports, get the frame from the port. 
-         */
-        if (conf_port->delay_buf != NULL) {
-            pj_status_t status;
-        
-            status = pjmedia_delay_buf_get(conf_port->delay_buf,
-                                  (pj_int16_t*)frame->buf);
-            if (status != PJ_SUCCESS) {
-                conf_port->rx_level = 0;
-                continue;
-            }           
+        /* Ignore if we didn't get any frame */
+        if (frame_type != PJMEDIA_FRAME_TYPE_AUDIO) {
+            conf_port->rx_level = 0;
+            return;
+        }           
+    }
 
-        } else {
+    /* Adjust the RX level from this port
+     * and calculate the average level at the same time.
+     */
+    if (conf_port->rx_adj_level != NORMAL_LEVEL) {
+        level = pjmedia_mix_adjust_level(p_in, p_in, conf->samples_per_frame,
+                                         conf_port->rx_adj_level);
+    } else {
+        level = pjmedia_mix_sum_abs(p_in, conf->samples_per_frame);
+    }
 
-            pj_status_t status;
-            pjmedia_frame_type frame_type;
+    level /= conf->samples_per_frame;
 
-            status = read_port(conf, conf_port, (pj_int16_t*)frame->buf, 
-                               conf->samples_per_frame, &frame_type);
-            
-            if (status != PJ_SUCCESS) {
-                /* bennylp: why do we need this????
-                 * Also see comments on similar issue with write_port().
-                PJ_LOG(4,(THIS_FILE, "Port %.*s get_frame() returned %d. "
-                                     "Port is now disabled",
-                                     (int)conf_port->name.slen,
-                                     conf_port->name.ptr,
-                                     status));
-                conf_port->rx_setting = PJMEDIA_PORT_DISABLE;
-                 */
-                conf_port->rx_level = 0;
-                continue;
-            }
+    /* Convert level to 8bit complement ulaw and put this level to port's
+     * last RX level.
+     */
+    conf_port->rx_level = pjmedia_linear2ulaw(level) ^ 0xff;
 
-            /* Check that the port is not removed when we call get_frame() */
-            if (conf->ports[i] == NULL) {
-                conf_port->rx_level = 0;
-                continue;
-            }
-                
+    /* With incremental mixing, don't mix the port when it is silent. */
+    if (conf_port->vad && pjmedia_silence_det_apply(conf_port->vad, level))
+        return;
 
-            /* Ignore if we didn't get any frame */
-            if (frame_type != PJMEDIA_FRAME_TYPE_AUDIO) {
-                conf_port->rx_level = 0;
-                continue;
-            }           
-        }
+    // Ticket #671: Skipping very low audio signal may cause noise 
+    // to be generated in the remote end by some hardphones.
+    /* Skip processing frame if level is zero */
+    //if (level == 0)
+    //    return;
 
-        p_in = (pj_int16_t*) frame->buf;
+    conf_port->rx_frame_valid = PJ_TRUE;
+}
 
-        /* Adjust the RX level from this port
-         * and calculate the average level at the same time.
-         */
-        if (conf_port->rx_adj_level != NORMAL_LEVEL) {
-            for (j=0; j<conf->samples_per_frame; ++j) {
-                /* For the level adjustment, we need to store the sample to
-                 * a temporary 32bit integer value to avoid overflowing the
-                 * 16bit sample storage.
-                 */
-                pj_int32_t itemp;
 
-                itemp = p_in[j];
-                /*itemp = itemp * adj / NORMAL_LEVEL;*/
-                /* bad code (signed/unsigned badness):
-                 *  itemp = (itemp * conf_port->rx_adj_level) >> 7;
-                 */
-                itemp *= conf_port->rx_adj_level;
-                itemp >>= 7;
+/*
+ * Transmit whatever the port has in its mix buffer.
+ */
+static void write_one_port(pjmedia_conf *conf, unsigned slot)
+{
+    struct conf_port *conf_port = conf->ports[slot];
+    pjmedia_frame_type frm_type;
+    pj_status_t status;
+
+    status = write_port( conf, conf_port, &conf->tick_ts, &frm_type);
+    if (status != PJ_SUCCESS) {
+        /* bennylp: why do we need this????
+           One thing for sure, put_frame()/write_port() may return
+           non-successfull status on Win32 if there's temporary glitch
+           on network interface, so disabling the port here does not
+           sound like a good idea.
+
+        PJ_LOG(4,(THIS_FILE, "Port %.*s put_frame() returned %d. "
+                             "Port is now disabled",
+                             (int)conf_port->name.slen,
+                             conf_port->name.ptr,
+                             status));
+        conf_port->tx_setting = PJMEDIA_PORT_DISABLE;
+        */
+        return;
+    }
 
-                /* Clip the signal if it's too loud */
-                if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
-                else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
+    /* Set the type of frame to be returned to sound playback
+     * device.
+     */
+    if (slot == 0)
+        conf->speaker_frame_type = frm_type;
+}
 
-                p_in[j] = (pj_int16_t) itemp;
-                level += (p_in[j]>=0? p_in[j] : -p_in[j]);
-            }
-        } else {
-            for (j=0; j<conf->samples_per_frame; ++j) {
-                level += (p_in[j]>=0? p_in[j] : -p_in[j]);
-            }
-        }
 
-        level /= conf->samples_per_frame;
+/*
+ * Process this thread's share of the active ports in the current phase.
+ * Thread "idx" handles every phase_threads-th port starting at idx, so
+ * port zero (the sound device) always stays in the clock thread.
+ */
+static void run_phase(pjmedia_conf *conf, unsigned idx)
+{
+    unsigned k;
+
+    for (k = idx; k < conf->active_cnt; k += conf->phase_threads) {
+        if (conf->phase == PHASE_READ)
+            read_one_port(conf, conf->active_slots[k]);
+        else
+            write_one_port(conf, conf->active_slots[k]);
+    }
+}
+
+
+/*
+ * Run a phase on all active ports, using the worker threads if there are
+ * enough ports, and wait until every port has been processed.
+ */
+static void process_phase(pjmedia_conf *conf, conf_phase phase)
+{
+    unsigned i;
+
+    conf->phase = phase;
+    conf->phase_threads = PJ_MIN(conf->worker_cnt + 1, conf->active_cnt);
+    if (conf->phase_threads == 0)
+        return;
+
+    /* Wake up the workers */
+    for (i = 1; i < conf->phase_threads; ++i)
+        pj_sem_post(conf->workers[i-1].sem);
+
+    run_phase(conf, 0);
+
+    /* Barrier: wait for the workers */
+    for (i = 1; i < conf->phase_threads; ++i)
+        pj_sem_wait(conf->done_sem);
+}
+
+
+/*
+ * Worker thread.
+ */
+static int conf_worker_thread(void *arg)
+{
+    struct conf_worker *w = (struct conf_worker*) arg;
+    pjmedia_conf *conf = w->conf;
+
+    for (;;) {
+        pj_sem_wait(w->sem);
+        if (conf->quit)
+            break;
+
+        run_phase(conf, w->idx);
+        pj_sem_post(conf->done_sem);
+    }
+
+    return 0;
+}
+
+
+/*
+ * Update clock tick statistics.
+ */
+static void update_tick_stat(pjmedia_conf *conf, const pj_timestamp *t_start,
+                             const pj_timestamp *t_read,
+                             const pj_timestamp *t_mix,
+                             const pj_timestamp *t_end)
+{
+    unsigned usec = pj_elapsed_usec(t_start, t_end);
+
+    pj_mutex_lock(conf->mutex);
+
+    ++conf->tick_cnt;
+    if (usec > conf->frame_usec)
+        ++conf->overrun_cnt;
+    conf->last_usec = usec;
+    if (usec < conf->min_usec)
+        conf->min_usec = usec;
+    if (usec > conf->max_usec)
+        conf->max_usec = usec;
+    conf->total_usec += usec;
+    conf->read_usec += pj_elapsed_usec(t_start, t_read);
+    conf->mix_usec += pj_elapsed_usec(t_read, t_mix);
+    conf->write_usec += pj_elapsed_usec(t_mix, t_end);
+    conf->last_src_cnt = conf->src_cnt;
+    conf->last_mix_cnt = conf->mix_cnt;
+
+    pj_mutex_unlock(conf->mutex);
+}
+
+
+/*
+ * Add a frame to a mix buffer, and calculate appropriate level adjustment
+ * if there is any overflowed level in the mixed signal.
+ */
+static void mix_frame(pjmedia_conf *conf, pj_int32_t *mix_buf, int *mix_adj,
+                      const pj_int16_t *frame)
+{
+    pj_int32_t mix_buf_min = 0;
+    pj_int32_t mix_buf_max = 0;
 
-        /* Convert level to 8bit complement ulaw */
-        level = pjmedia_linear2ulaw(level) ^ 0xff;
+    pjmedia_mix_accumulate(mix_buf, frame, conf->samples_per_frame,
+                           &mix_buf_min, &mix_buf_max);
 
-        /* Put this level to port's last RX level. */
-        conf_port->rx_level = level;
+    /* Check if normalization adjustment needed. */
+    if (mix_buf_min < MIN_LEVEL || mix_buf_max > MAX_LEVEL) {
+        int tmp_adj;
 
-        // Ticket #671: Skipping very low audio signal may cause noise 
-        // to be generated in the remote end by some hardphones.
-        /* Skip processing frame if level is zero */
-        //if (level == 0)
-        //    continue;
+        if (-mix_buf_min > mix_buf_max)
+            mix_buf_max = -mix_buf_min;
+
+        /* NORMAL_LEVEL * MAX_LEVEL / mix_buf_max; */
+        tmp_adj = (MAX_LEVEL<<7) / mix_buf_max;
+        if (tmp_adj < *mix_adj)
+            *mix_adj = tmp_adj;
+    }
+}
+
+
+/*
+ * Apply the connection level to the frame of a port, if not normal.
+ */
+static const pj_int16_t* conn_leveled_frame(pjmedia_conf *conf,
+                                            struct conf_port *conf_port,
+                                            unsigned listener_idx)
+{
+    if (conf_port->listener_adj_level[listener_idx] == NORMAL_LEVEL)
+        return conf_port->rx_frame;
+
+    pjmedia_mix_adjust_level(conf_port->adj_level_buf, conf_port->rx_frame,
+                             conf->samples_per_frame,
+                             conf_port->listener_adj_level[listener_idx]);
+    return conf_port->adj_level_buf;
+}
+
+
+/*
+ * Mix the frame of every port to the mix_buf of all of its listeners.
+ */
+static void mix_ports(pjmedia_conf *conf)
+{
+    unsigned ci, cj;
+
+    for (ci=0; ci < conf->active_cnt; ++ci) {
+        struct conf_port *conf_port = conf->ports[conf->active_slots[ci]];
+
+        /* Skip removed port or port without frame */
+        if (!conf_port || !conf_port->rx_frame_valid)
+            continue;
+
+        ++conf->src_cnt;
 
         /* Add the signal to all listeners. */
         for (cj=0; cj < conf_port->listener_cnt; ++cj) 
         {
             struct conf_port *listener;
-            pj_int32_t *mix_buf;            
-            pj_int16_t *p_in_conn_leveled;
+            const pj_int16_t *p_in_conn_leveled;
 
             listener = conf->ports[conf_port->listener_slots[cj]];
 
@@ -2595,74 +2991,18 @@ static pj_status_t get_frame(pjmedia_port *this_port,
             if (listener->tx_setting != PJMEDIA_PORT_ENABLE)
                 continue;
 
-            mix_buf = listener->mix_buf;
-
-            /* apply connection level, if not normal */
-            if (conf_port->listener_adj_level[cj] != NORMAL_LEVEL) {
-                unsigned k = 0;
-                for (; k < conf->samples_per_frame; ++k) {
-                    /* For the level adjustment, we need to store the sample to
-                     * a temporary 32bit integer value to avoid overflowing the
-                     * 16bit sample storage.
-                     */
-                    pj_int32_t itemp;
-
-                    itemp = p_in[k];
-                    /*itemp = itemp * adj / NORMAL_LEVEL;*/
-                    /* bad code (signed/unsigned badness):
-                     *  itemp = (itemp * conf_port->listsener_adj_level) >> 7;
-                     */
-                    itemp *= conf_port->listener_adj_level[cj];
-                    itemp >>= 7;
-
-                    /* Clip the signal if it's too loud */
-                    if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
-                    else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
-
-                    conf_port->adj_level_buf[k] = (pj_int16_t)itemp;
-                }
-
-                /* take the leveled frame */
-                p_in_conn_leveled = conf_port->adj_level_buf;
-            } else {
-                /* take the frame as-is */
-                p_in_conn_leveled = p_in;
-            }
+            p_in_conn_leveled = conn_leveled_frame(conf, conf_port, cj);
 
             if (listener->transmitter_cnt > 1) {
-                /* Mixing signals,
-                 * and calculate appropriate level adjustment if there is
-                 * any overflowed level in the mixed signal.
-                 */
-                unsigned k, samples_per_frame = conf->samples_per_frame;
-                pj_int32_t mix_buf_min = 0;
-                pj_int32_t mix_buf_max = 0;
-
-                for (k = 0; k < samples_per_frame; ++k) {
-                    mix_buf[k] += p_in_conn_leveled[k];
-                    if (mix_buf[k] < mix_buf_min)
-                        mix_buf_min = mix_buf[k];
-                    if (mix_buf[k] > mix_buf_max)
-                        mix_buf_max = mix_buf[k];
-                }
-
-                /* Check if normalization adjustment needed. */
-                if (mix_buf_min < MIN_LEVEL || mix_buf_max > MAX_LEVEL) {
-                    int tmp_adj;
-
-                    if (-mix_buf_min > mix_buf_max)
-                        mix_buf_max = -mix_buf_min;
-
-                    /* NORMAL_LEVEL * MAX_LEVEL / mix_buf_max; */
-                    tmp_adj = (MAX_LEVEL<<7) / mix_buf_max;
-                    if (tmp_adj < listener->mix_adj)
-                        listener->mix_adj = tmp_adj;
-                }
+                /* Mixing signals */
+                mix_frame(conf, listener->mix_buf, &listener->mix_adj,
+                          p_in_conn_leveled);
             } else {
                 /* Only 1 transmitter:
                  * just copy the samples to the mix buffer
                  * no mixing and level adjustment needed
                  */
+                pj_int32_t *mix_buf = listener->mix_buf;
                 unsigned k, samples_per_frame = conf->samples_per_frame;
 
                 for (k = 0; k < samples_per_frame; ++k) {
@@ -2671,47 +3011,242 @@ static pj_status_t get_frame(pjmedia_port *this_port,
             }
         } /* loop the listeners of conf port */
     } /* loop of all conf ports */
+}
 
-    /* Time for all ports to transmit whetever they have in their
-     * buffer. 
+
+/*
+ * Incremental mixing: only the ports with active signal in this tick are
+ * mixed. The set of active sources heard by each listener is recorded as
+ * a bitmask of indexes in active_src, and the listeners hearing the same
+ * set at normal connection level get a copy of one shared mix instead of
+ * mixing the sources by themselves. Listeners hearing nothing are only
+ * cleared, and write_port() doesn't need to convert their mix.
+ */
+static void mix_incremental(pjmedia_conf *conf)
+{
+    unsigned samples_per_frame = conf->samples_per_frame;
+    unsigned shared_cnt = 0;
+    unsigned ci, cj, i;
+
+    /* Collect the ports that are mixed in this tick, and reset the
+     * listeners.
      */
-    for (i=0, ci=0; i<conf->max_ports && ci<conf->port_cnt; ++i) {
+    for (ci=0; ci < conf->active_cnt; ++ci) {
+        struct conf_port *conf_port = conf->ports[conf->active_slots[ci]];
+
+        if (!conf_port)
+            continue;
+
+        if (conf_port->rx_frame_valid)
+            conf->active_src[conf->src_cnt++] = conf->active_slots[ci];
+
+        conf_port->src_cnt = 0;
+        conf_port->src_mask = 0;
+        conf_port->own_mix = PJ_FALSE;
+        conf_port->shared_mix = -1;
+    }
+
+    /* Record the active sources heard by each listener. Too many active
+     * sources to fit in the mask, or a non-normal connection level, means
+     * the listener gets its own mix.
+     */
+    for (i=0; i < conf->src_cnt; ++i) {
+        struct conf_port *conf_port = conf->ports[conf->active_src[i]];
+
+        for (cj=0; cj < conf_port->listener_cnt; ++cj) {
+            struct conf_port *listener;
+
+            listener = conf->ports[conf_port->listener_slots[cj]];
+            if (listener->tx_setting != PJMEDIA_PORT_ENABLE)
+                continue;
+
+            ++listener->src_cnt;
+            if (i >= MAX_SHARED_SRC ||
+                conf_port->listener_adj_level[cj] != NORMAL_LEVEL)
+            {
+                listener->own_mix = PJ_TRUE;
+            } else {
+                listener->src_mask |= ((pj_uint64_t)1 << i);
+            }
+        }
+    }
+
+    /* Find or allocate the shared mix of each listener. */
+    for (ci=0; ci < conf->active_cnt; ++ci) {
+        struct conf_port *listener = conf->ports[conf->active_slots[ci]];
+
+        if (!listener || listener->tx_setting != PJMEDIA_PORT_ENABLE ||
+            listener->transmitter_cnt == 0)
+        {
+            continue;
+        }
+
+        listener->mix_silent = (listener->src_cnt == 0);
+        if (!listener->mix_silent && !listener->own_mix) {
+            for (i=0; i < shared_cnt; ++i) {
+                if (conf->shared_mix[i].src_mask == listener->src_mask)
+                    break;
+            }
+            if (i == shared_cnt && shared_cnt < PJMEDIA_CONF_MAX_SHARED_MIX) {
+                struct conf_shared_mix *mix = &conf->shared_mix[i];
+
+                mix->src_mask = listener->src_mask;
+                mix->last_src = (unsigned)-1;
+                mix->mix_adj = NORMAL_LEVEL;
+                pj_bzero(mix->mix_buf,
+                         samples_per_frame * sizeof(mix->mix_buf[0]));
+                ++shared_cnt;
+            }
+            if (i < shared_cnt) {
+                listener->shared_mix = i;
+                continue;
+            }
+        }
+
+        pj_bzero(listener->mix_buf,
+                 samples_per_frame * sizeof(listener->mix_buf[0]));
+        if (!listener->mix_silent)
+            ++conf->mix_cnt;
+    }
+    conf->mix_cnt += shared_cnt;
+
+    /* Mix the active sources, once for each shared mix. */
+    for (i=0; i < conf->src_cnt; ++i) {
+        struct conf_port *conf_port = conf->ports[conf->active_src[i]];
+
+        for (cj=0; cj < conf_port->listener_cnt; ++cj) {
+            struct conf_port *listener;
+
+            listener = conf->ports[conf_port->listener_slots[cj]];
+            if (listener->tx_setting != PJMEDIA_PORT_ENABLE)
+                continue;
+
+            if (listener->shared_mix >= 0) {
+                struct conf_shared_mix *mix;
+
+                mix = &conf->shared_mix[listener->shared_mix];
+                if (mix->last_src == i)
+                    continue;
+
+                mix->last_src = i;
+                mix_frame(conf, mix->mix_buf, &mix->mix_adj,
+                          conf_port->rx_frame);
+            } else {
+                mix_frame(conf, listener->mix_buf, &listener->mix_adj,
+                          conn_leveled_frame(conf, conf_port, cj));
+            }
+        }
+    }
+
+    /* Copy the shared mixes to the listeners. */
+    for (ci=0; ci < conf->active_cnt; ++ci) {
+        struct conf_port *listener = conf->ports[conf->active_slots[ci]];
+        struct conf_shared_mix *mix;
+
+        if (!listener || listener->shared_mix < 0)
+            continue;
+
+        mix = &conf->shared_mix[listener->shared_mix];
+        pj_memcpy(listener->mix_buf, mix->mix_buf,
+                  samples_per_frame * sizeof(mix->mix_buf[0]));
+        listener->mix_adj = mix->mix_adj;
+    }
+}
+
+
+/*
+ * Player callback.
+ */
+static pj_status_t get_frame(pjmedia_port *this_port, 
+                             pjmedia_frame *frame)
+{
+    pjmedia_conf *conf = (pjmedia_conf*) this_port->port_data.pdata;
+    pjmedia_frame_type speaker_frame_type;
+    pj_timestamp t_start, t_read, t_mix, t_end;
+    unsigned ci, i;
+    
+    TRACE_((THIS_FILE, "- clock -"));
+
+    pj_get_timestamp(&t_start);
+
+    /* Check that correct size is specified. */
+    pj_assert(frame->size == conf->samples_per_frame *
+                             conf->bits_per_sample / 8);
+
+    /* Perform any queued operations that need to be synchronized with
+     * the clock such as connect, disonnect, remove.
+     */
+    if (!pj_list_empty(conf->op_queue)) {
+        pj_log_push_indent();
+        pj_mutex_lock(conf->mutex);
+        handle_op_queue(conf);
+        pj_mutex_unlock(conf->mutex);
+        pj_log_pop_indent();
+    }
+
+    /* No mutex from this point! Otherwise it may cause deadlock as
+     * put_frame()/get_frame() may invoke callback.
+     *
+     * Note that any changes on the conference connections must be
+     * synchronized.
+     */
+
+    /* Reset port source count. We will only reset port's mix
+     * buffer when we have someone transmitting to it. Also collect
+     * the ports to be processed in this tick.
+     */
+    conf->active_cnt = 0;
+    conf->src_cnt = conf->mix_cnt = 0;
+    for (i=0, ci=0; i<conf->max_ports && ci < conf->port_cnt; ++i) {
         struct conf_port *conf_port = conf->ports[i];
-        pjmedia_frame_type frm_type;
-        pj_status_t status;
 
+        /* Skip empty or new port. */
         if (!conf_port || conf_port->is_new)
             continue;
 
-        /* Var "ci" is to count how many ports have been visited. */
+        /* Var "ci" is to count how many ports have been visited so far. */
         ++ci;
 
-        status = write_port( conf, conf_port, &frame->timestamp,
-                             &frm_type);
-        if (status != PJ_SUCCESS) {
-            /* bennylp: why do we need this????
-               One thing for sure, put_frame()/write_port() may return
-               non-successfull status on Win32 if there's temporary glitch
-               on network interface, so disabling the port here does not
-               sound like a good idea.
+        conf->active_slots[conf->active_cnt++] = i;
 
-            PJ_LOG(4,(THIS_FILE, "Port %.*s put_frame() returned %d. "
-                                 "Port is now disabled",
-                                 (int)conf_port->name.slen,
-                                 conf_port->name.ptr,
-                                 status));
-            conf_port->tx_setting = PJMEDIA_PORT_DISABLE;
-            */
+        /* Skip if we're not allowed to transmit to this port. */
+        if (conf_port->tx_setting != PJMEDIA_PORT_ENABLE)
             continue;
-        }
 
-        /* Set the type of frame to be returned to sound playback
-         * device.
+        /* Reset buffer (only necessary if the port has transmitter) and
+         * reset auto adjustment level for mixed signal.
          */
-        if (i == 0)
-            speaker_frame_type = frm_type;
+        conf_port->mix_adj = NORMAL_LEVEL;
+        if (conf_port->transmitter_cnt && !conf->shared_mix) {
+            pj_bzero(conf_port->mix_buf,
+                     conf->samples_per_frame*sizeof(conf_port->mix_buf[0]));
+            ++conf->mix_cnt;
+        }
     }
 
+    conf->tick_ts = frame->timestamp;
+    conf->speaker_frame_type = PJMEDIA_FRAME_TYPE_NONE;
+
+    /* Get frames from all ports, in parallel when there are worker
+     * threads.
+     */
+    process_phase(conf, PHASE_READ);
+    pj_get_timestamp(&t_read);
+
+    /* "Mix" the signal to mix_buf of all listeners of the ports. */
+    if (conf->shared_mix)
+        mix_incremental(conf);
+    else
+        mix_ports(conf);
+
+    pj_get_timestamp(&t_mix);
+
+    /* Time for all ports to transmit whetever they have in their
+     * buffer. 
+     */
+    process_phase(conf, PHASE_WRITE);
+    speaker_frame_type = conf->speaker_frame_type;
+
     /* Return sound playback frame. */
     if (conf->ports[0]->tx_level) {
         TRACE_((THIS_FILE, "write to audio, count=%d", 
@@ -2734,6 +3269,9 @@ static pj_status_t get_frame(pjmedia_port *this_port,
         fwrite(frame->buf, frame->size, 1, fhnd_rec);
 #endif
 
+    pj_get_timestamp(&t_end);
+    update_tick_stat(conf, &t_start, &t_read, &t_mix, &t_end);
+
     return PJ_SUCCESS;
 }
 
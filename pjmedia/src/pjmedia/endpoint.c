@@ -56,9 +56,11 @@ pj_bool_t pjmedia_add_bandwidth_tias_in_sdp =
 
 /* Worker thread proc. */
 static int PJ_THREAD_FUNC worker_proc(void*);
+static int PJ_THREAD_FUNC shard_worker_proc(void*);
 
 
 #define MAX_THREADS     16
+#define MAX_SHARDS      16
 
 
 /* List of media endpoint exit callback. */
@@ -69,6 +71,17 @@ typedef struct exit_cb
 } exit_cb;
 
 
+/** Ioqueue shard, see pjmedia_endpt_create_shards(). */
+typedef struct endpt_shard
+{
+    pjmedia_endpt        *endpt;        /**< Owner.                     */
+    pj_ioqueue_t         *ioqueue;      /**< Shard ioqueue.             */
+    pj_thread_t          *thread;       /**< Polling thread.            */
+    unsigned              load;         /**< Transports on the shard.   */
+    pj_bool_t             quit_flag;    /**< Signal the thread to quit. */
+} endpt_shard;
+
+
 /** Concrete declaration of media endpoint. */
 struct pjmedia_endpt
 {
@@ -96,6 +109,15 @@ struct pjmedia_endpt
     /** To signal polling thread to quit. */
     pj_bool_t             quit_flag;
 
+    /** Number of ioqueue shards. */
+    unsigned              shard_cnt;
+
+    /** Ioqueue shards. */
+    endpt_shard           shard[MAX_SHARDS];
+
+    /** Protects the shard load. */
+    pj_mutex_t           *shard_mutex;
+
     /** Is telephone-event enable */
     pj_bool_t             has_telephone_event;
 
@@ -221,6 +243,7 @@ PJ_DEF(pjmedia_codec_mgr*) pjmedia_endpt_get_codec_mgr(pjmedia_endpt *endpt)
 PJ_DEF(pj_status_t) pjmedia_endpt_destroy2 (pjmedia_endpt *endpt)
 {
     exit_cb *ecb;
+    unsigned i;
 
     pjmedia_endpt_stop_threads(endpt);
 
@@ -230,6 +253,19 @@ PJ_DEF(pj_status_t) pjmedia_endpt_destroy2 (pjmedia_endpt *endpt)
         endpt->ioqueue = NULL;
     }
 
+    /* Destroy shards */
+    for (i=0; i<endpt->shard_cnt; ++i) {
+        if (endpt->shard[i].ioqueue) {
+            pj_ioqueue_destroy(endpt->shard[i].ioqueue);
+            endpt->shard[i].ioqueue = NULL;
+        }
+    }
+    endpt->shard_cnt = 0;
+    if (endpt->shard_mutex) {
+        pj_mutex_destroy(endpt->shard_mutex);
+        endpt->shard_mutex = NULL;
+    }
+
     endpt->pf = NULL;
 
     pjmedia_codec_mgr_destroy(&endpt->codec_mgr);
@@ -333,9 +369,171 @@ PJ_DEF(pj_status_t) pjmedia_endpt_stop_threads(pjmedia_endpt *endpt)
         }
     }
 
+    /* Destroy shard threads */
+    for (i=0; i<endpt->shard_cnt; ++i)
+        endpt->shard[i].quit_flag = 1;
+    for (i=0; i<endpt->shard_cnt; ++i) {
+        if (endpt->shard[i].thread) {
+            pj_thread_join(endpt->shard[i].thread);
+            pj_thread_destroy(endpt->shard[i].thread);
+            endpt->shard[i].thread = NULL;
+        }
+    }
+
     return PJ_SUCCESS;
 }
 
+/**
+ * Create ioqueue shards.
+ */
+PJ_DEF(pj_status_t) pjmedia_endpt_create_shards(pjmedia_endpt *endpt,
+                                                unsigned shard_cnt,
+                                                pj_bool_t pin_cpu)
+{
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt && shard_cnt && shard_cnt <= MAX_SHARDS,
+                     PJ_EINVAL);
+    PJ_ASSERT_RETURN(endpt->shard_cnt == 0, PJ_EINVALIDOP);
+
+    status = pj_mutex_create_simple(endpt->pool, "med-shard",
+                                    &endpt->shard_mutex);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    for (i=0; i<shard_cnt; ++i) {
+        endpt_shard *shard = &endpt->shard[i];
+        char name[PJ_MAX_OBJ_NAME];
+
+        shard->endpt = endpt;
+        shard->load = 0;
+        shard->quit_flag = 0;
+
+        status = pj_ioqueue_create(endpt->pool, PJ_IOQUEUE_MAX_HANDLES,
+                                   &shard->ioqueue);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+
+        /* Count the shard now, so that it's cleaned up on error */
+        endpt->shard_cnt = i + 1;
+
+        pj_ansi_snprintf(name, sizeof(name), "media-shd%u", i);
+        status = pj_thread_create(endpt->pool, name, &shard_worker_proc,
+                                  shard, 0, 0, &shard->thread);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+
+        if (pin_cpu) {
+            status = pj_thread_set_cpu_affinity(shard->thread, i);
+            if (status != PJ_SUCCESS) {
+                PJ_PERROR(4,(THIS_FILE, status, "Unable to bind media "
+                             "shard %u thread to CPU %u", i, i));
+            }
+        }
+    }
+
+    PJ_LOG(4,(THIS_FILE, "Media endpoint sharded into %u ioqueues",
+              shard_cnt));
+    return PJ_SUCCESS;
+
+on_error:
+    /* Stop the threads that were started */
+    for (i=0; i<endpt->shard_cnt; ++i)
+        endpt->shard[i].quit_flag = 1;
+    for (i=0; i<endpt->shard_cnt; ++i) {
+        endpt_shard *shard = &endpt->shard[i];
+
+        if (shard->thread) {
+            pj_thread_join(shard->thread);
+            pj_thread_destroy(shard->thread);
+            shard->thread = NULL;
+        }
+        pj_ioqueue_destroy(shard->ioqueue);
+        shard->ioqueue = NULL;
+    }
+    endpt->shard_cnt = 0;
+    pj_mutex_destroy(endpt->shard_mutex);
+    endpt->shard_mutex = NULL;
+    return status;
+}
+
+/**
+ * Get the number of ioqueue shards.
+ */
+PJ_DEF(unsigned) pjmedia_endpt_get_shard_count(pjmedia_endpt *endpt)
+{
+    PJ_ASSERT_RETURN(endpt, 0);
+    return endpt->shard_cnt;
+}
+
+/**
+ * Get the number of transports on a shard.
+ */
+PJ_DEF(unsigned) pjmedia_endpt_get_shard_load(pjmedia_endpt *endpt,
+                                              unsigned index)
+{
+    unsigned load;
+
+    PJ_ASSERT_RETURN(endpt && index < endpt->shard_cnt, 0);
+
+    pj_mutex_lock(endpt->shard_mutex);
+    load = endpt->shard[index].load;
+    pj_mutex_unlock(endpt->shard_mutex);
+
+    return load;
+}
+
+/**
+ * Get the ioqueue for a new media transport.
+ */
+PJ_DEF(pj_ioqueue_t*) pjmedia_endpt_acquire_ioqueue(pjmedia_endpt *endpt)
+{
+    endpt_shard *best;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(endpt, NULL);
+
+    if (endpt->shard_cnt == 0)
+        return endpt->ioqueue;
+
+    pj_mutex_lock(endpt->shard_mutex);
+    best = &endpt->shard[0];
+    for (i=1; i<endpt->shard_cnt; ++i) {
+        if (endpt->shard[i].load < best->load)
+            best = &endpt->shard[i];
+    }
+    ++best->load;
+    pj_mutex_unlock(endpt->shard_mutex);
+
+    return best->ioqueue;
+}
+
+/**
+ * Release the ioqueue of a media transport.
+ */
+PJ_DEF(void) pjmedia_endpt_release_ioqueue(pjmedia_endpt *endpt,
+                                           pj_ioqueue_t *ioqueue)
+{
+    unsigned i;
+
+    PJ_ASSERT_ON_FAIL(endpt && ioqueue, return);
+
+    if (endpt->shard_cnt == 0)
+        return;
+
+    pj_mutex_lock(endpt->shard_mutex);
+    for (i=0; i<endpt->shard_cnt; ++i) {
+        if (endpt->shard[i].ioqueue == ioqueue) {
+            pj_assert(endpt->shard[i].load > 0);
+            if (endpt->shard[i].load)
+                --endpt->shard[i].load;
+            break;
+        }
+    }
+    pj_mutex_unlock(endpt->shard_mutex);
+}
+
 /**
  * Worker thread proc.
  */
@@ -351,6 +549,21 @@ static int PJ_THREAD_FUNC worker_proc(void *arg)
     return 0;
 }
 
+/**
+ * Shard worker thread proc.
+ */
+static int PJ_THREAD_FUNC shard_worker_proc(void *arg)
+{
+    endpt_shard *shard = (endpt_shard*) arg;
+
+    while (!shard->quit_flag) {
+        pj_time_val timeout = { 0, 10 };
+        pj_ioqueue_poll(shard->ioqueue, &timeout);
+    }
+
+    return 0;
+}
+
 /**
  * Create pool.
  */
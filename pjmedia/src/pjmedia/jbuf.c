@@ -59,21 +59,37 @@
 #define STA_DISC_SAFE_SHRINKING_DIFF    1
 
 
-/* Struct of JB internal buffer, represented in a circular buffer containing
- * frame content, frame type, frame length, and frame bit info.
+/* Slot of JB internal buffer. The frame content follows the slot in the
+ * same record, so putting or getting a frame touches one contiguous
+ * memory region instead of an entry in each of several arrays.
+ */
+typedef struct jb_slot
+{
+    int              frame_type;        /**< frame type                     */
+    unsigned         content_len;       /**< frame length                   */
+    pj_uint32_t      bit_info;          /**< frame bit info                 */
+    pj_uint32_t      ts;                /**< timestamp                      */
+} jb_slot;
+
+/* Get the slot record at the specified position, and its frame content. */
+#define JB_SLOT(fl, pos)    ((jb_slot*)((fl)->slots + \
+                                        (pj_size_t)(pos) * (fl)->slot_size))
+#define JB_CONTENT(slot)    ((char*)(slot) + sizeof(jb_slot))
+
+/* Struct of JB internal buffer, represented in a circular buffer of slots,
+ * each containing frame type, frame length, frame bit info, timestamp and
+ * frame content.
  */
 typedef struct jb_framelist_t
 {
     /* Settings */
     unsigned         frame_size;        /**< maximum size of frame          */
     unsigned         max_count;         /**< maximum number of frames       */
+    unsigned         slot_size;         /**< size of slot record, including
+                                             frame content                  */
 
     /* Buffers */
-    char            *content;           /**< frame content array            */
-    int             *frame_type;        /**< frame type array               */
-    pj_size_t       *content_len;       /**< frame length array             */
-    pj_uint32_t     *bit_info;          /**< frame bit info array           */
-    pj_uint32_t     *ts;                /**< timestamp array                */
+    char            *slots;             /**< slot record array              */
 
     /* States */
     unsigned         head;              /**< index of head, pointed frame
@@ -83,6 +99,10 @@ typedef struct jb_framelist_t
     unsigned         discarded_num;     /**< current number of discarded
                                              frames.                        */
     int              origin;            /**< original index of flist_head   */
+    int              lent;              /**< position of slot whose content
+                                             was returned by reference and
+                                             must not be overwritten until
+                                             the next get, or -1            */
 
 } jb_framelist_t;
 
@@ -182,6 +202,8 @@ struct pjmedia_jbuf
 #endif
 
 static pj_status_t jb_framelist_reset(jb_framelist_t *framelist);
+static void jb_framelist_clear(jb_framelist_t *framelist,
+                               unsigned pos, unsigned count);
 static unsigned jb_framelist_remove_head(jb_framelist_t *framelist,
                                          unsigned count);
 
@@ -196,25 +218,11 @@ static pj_status_t jb_framelist_init( pj_pool_t *pool,
 
     framelist->frame_size   = frame_size;
     framelist->max_count    = max_count;
-    framelist->content      = (char*)
-                              pj_pool_alloc(pool,
-                                            (pj_size_t)framelist->frame_size*
-                                            framelist->max_count);
-    framelist->frame_type   = (int*)
+    framelist->slot_size    = (unsigned)
+                              ((sizeof(jb_slot) + frame_size + 7) & ~7);
+    framelist->slots        = (char*)
                               pj_pool_alloc(pool,
-                                            sizeof(framelist->frame_type[0])*
-                                            framelist->max_count);
-    framelist->content_len  = (pj_size_t*)
-                              pj_pool_alloc(pool,
-                                            sizeof(framelist->content_len[0])*
-                                            framelist->max_count);
-    framelist->bit_info     = (pj_uint32_t*)
-                              pj_pool_alloc(pool,
-                                            sizeof(framelist->bit_info[0])*
-                                            framelist->max_count);
-    framelist->ts           = (pj_uint32_t*)
-                              pj_pool_alloc(pool,
-                                            sizeof(framelist->ts[0])*
+                                            (pj_size_t)framelist->slot_size*
                                             framelist->max_count);
 
     return jb_framelist_reset(framelist);
@@ -227,30 +235,40 @@ static pj_status_t jb_framelist_destroy(jb_framelist_t *framelist)
     return PJ_SUCCESS;
 }
 
+/* Mark slots as missing frames, and update the discarded frames count. */
+static void jb_framelist_clear(jb_framelist_t *framelist,
+                               unsigned pos, unsigned count)
+{
+    unsigned i;
+
+    for (i = 0; i < count; ++i) {
+        jb_slot *slot = JB_SLOT(framelist, pos + i);
+
+        if (slot->frame_type == PJMEDIA_JB_DISCARDED_FRAME) {
+            pj_assert(framelist->discarded_num > 0);
+            framelist->discarded_num--;
+        }
+        slot->frame_type = PJMEDIA_JB_MISSING_FRAME;
+        slot->content_len = 0;
+    }
+}
+
 static pj_status_t jb_framelist_reset(jb_framelist_t *framelist)
 {
+    unsigned i;
+
     framelist->head = 0;
     framelist->origin = INVALID_OFFSET;
     framelist->size = 0;
     framelist->discarded_num = 0;
+    framelist->lent = -1;
 
+    for (i = 0; i < framelist->max_count; ++i) {
+        jb_slot *slot = JB_SLOT(framelist, i);
 
-    //pj_bzero(framelist->content,
-    //       framelist->frame_size *
-    //       framelist->max_count);
-
-    pj_memset(framelist->frame_type,
-              PJMEDIA_JB_MISSING_FRAME,
-              sizeof(framelist->frame_type[0]) *
-              framelist->max_count);
-
-    pj_bzero(framelist->content_len,
-             sizeof(framelist->content_len[0]) *
-             framelist->max_count);
-
-    //pj_bzero(framelist->bit_info,
-    //       sizeof(framelist->bit_info[0]) *
-    //       framelist->max_count);
+        slot->frame_type = PJMEDIA_JB_MISSING_FRAME;
+        slot->content_len = 0;
+    }
 
     return PJ_SUCCESS;
 }
@@ -273,22 +291,30 @@ static int jb_framelist_origin(const jb_framelist_t *framelist)
 }
 
 
+/* Get the head frame. The frame content is copied to the frame buffer,
+ * or when frame_ref is specified, the content is returned by reference and
+ * the slot is kept until the next get.
+ */
 static pj_bool_t jb_framelist_get(jb_framelist_t *framelist,
-                                  void *frame, pj_size_t *size,
+                                  void *frame, const void **frame_ref,
+                                  pj_size_t *size,
                                   pjmedia_jb_frame_type *p_type,
                                   pj_uint32_t *bit_info,
                                   pj_uint32_t *ts,
                                   int *seq)
 {
+    /* Previously lent slot can be reused now */
+    framelist->lent = -1;
+
     if (framelist->size) {
         pj_bool_t prev_discarded = PJ_FALSE;
+        jb_slot *slot = JB_SLOT(framelist, framelist->head);
 
         /* Skip discarded frames */
-        while (framelist->frame_type[framelist->head] ==
-               PJMEDIA_JB_DISCARDED_FRAME)
-        {
+        while (slot->frame_type == PJMEDIA_JB_DISCARDED_FRAME) {
             jb_framelist_remove_head(framelist, 1);
             prev_discarded = PJ_TRUE;
+            slot = JB_SLOT(framelist, framelist->head);
         }
 
         /* Return the head frame if any */
@@ -302,8 +328,18 @@ static pj_bool_t jb_framelist_get(jb_framelist_t *framelist,
                     *size = 0;
                 if (bit_info)
                     *bit_info = 0;
+                if (frame_ref)
+                    *frame_ref = NULL;
+            } else if (frame_ref) {
+                *frame_ref = JB_CONTENT(slot);
+                *p_type = (pjmedia_jb_frame_type)slot->frame_type;
+                if (size)
+                    *size = slot->content_len;
+                if (bit_info)
+                    *bit_info = slot->bit_info;
+                framelist->lent = framelist->head;
             } else {
-                pj_size_t frm_size = framelist->content_len[framelist->head];
+                pj_size_t frm_size = slot->content_len;
                 pj_size_t max_size = size? *size : frm_size;
                 pj_size_t copy_size = PJ_MIN(max_size, frm_size);
 
@@ -314,29 +350,22 @@ static pj_bool_t jb_framelist_get(jb_framelist_t *framelist,
                                           "retrieved frame!"));
                 }
 
-                pj_memcpy(frame,
-                          framelist->content +
-                          framelist->head * framelist->frame_size,
-                          copy_size);
-                *p_type = (pjmedia_jb_frame_type)
-                          framelist->frame_type[framelist->head];
+                pj_memcpy(frame, JB_CONTENT(slot), copy_size);
+                *p_type = (pjmedia_jb_frame_type)slot->frame_type;
                 if (size)
                     *size = copy_size;
                 if (bit_info)
-                    *bit_info = framelist->bit_info[framelist->head];
+                    *bit_info = slot->bit_info;
             }
             if (ts)
-                *ts = framelist->ts[framelist->head];
+                *ts = slot->ts;
             if (seq)
                 *seq = framelist->origin;
 
-            //pj_bzero(framelist->content +
-            //   framelist->head * framelist->frame_size,
-            //   framelist->frame_size);
-            framelist->frame_type[framelist->head] = PJMEDIA_JB_MISSING_FRAME;
-            framelist->content_len[framelist->head] = 0;
-            framelist->bit_info[framelist->head] = 0;
-            framelist->ts[framelist->head] = 0;
+            slot->frame_type = PJMEDIA_JB_MISSING_FRAME;
+            slot->content_len = 0;
+            slot->bit_info = 0;
+            slot->ts = 0;
 
             framelist->origin++;
             framelist->head = (framelist->head + 1) % framelist->max_count;
@@ -347,7 +376,10 @@ static pj_bool_t jb_framelist_get(jb_framelist_t *framelist,
     }
 
     /* No frame available */
-    pj_bzero(frame, framelist->frame_size);
+    if (frame_ref)
+        *frame_ref = NULL;
+    else
+        pj_bzero(frame, framelist->frame_size);
 
     return PJ_FALSE;
 }
@@ -362,6 +394,7 @@ static pj_bool_t jb_framelist_peek(jb_framelist_t *framelist,
                                    pj_uint32_t *ts,
                                    int *seq)
 {
+    jb_slot *slot;
     unsigned pos, idx;
 
     if (offset >= jb_framelist_eff_size(framelist))
@@ -372,7 +405,8 @@ static pj_bool_t jb_framelist_peek(jb_framelist_t *framelist,
 
     /* Find actual peek position, note there may be discarded frames */
     while (1) {
-        if (framelist->frame_type[pos] != PJMEDIA_JB_DISCARDED_FRAME) {
+        slot = JB_SLOT(framelist, pos);
+        if (slot->frame_type != PJMEDIA_JB_DISCARDED_FRAME) {
             if (idx == 0)
                 break;
             else
@@ -383,16 +417,15 @@ static pj_bool_t jb_framelist_peek(jb_framelist_t *framelist,
 
     /* Return the frame pointer */
     if (frame)
-        *frame = framelist->content + pos*framelist->frame_size;
+        *frame = JB_CONTENT(slot);
     if (type)
-        *type = (pjmedia_jb_frame_type)
-                framelist->frame_type[pos];
+        *type = (pjmedia_jb_frame_type)slot->frame_type;
     if (size)
-        *size = framelist->content_len[pos];
+        *size = slot->content_len;
     if (bit_info)
-        *bit_info = framelist->bit_info[pos];
+        *bit_info = slot->bit_info;
     if (ts)
-        *ts = framelist->ts[pos];
+        *ts = slot->ts;
     if (seq)
         *seq = framelist->origin + offset;
 
@@ -411,7 +444,6 @@ static unsigned jb_framelist_remove_head(jb_framelist_t *framelist,
         /* may be done in two steps if overlapping */
         unsigned step1,step2;
         unsigned tmp = framelist->head+count;
-        unsigned i;
 
         if (tmp > framelist->max_count) {
             step1 = framelist->max_count - framelist->head;
@@ -421,37 +453,9 @@ static unsigned jb_framelist_remove_head(jb_framelist_t *framelist,
             step2 = 0;
         }
 
-        for (i = framelist->head; i < (framelist->head + step1); ++i) {
-            if (framelist->frame_type[i] == PJMEDIA_JB_DISCARDED_FRAME) {
-                pj_assert(framelist->discarded_num > 0);
-                framelist->discarded_num--;
-            }
-        }
-
-        //pj_bzero(framelist->content +
-        //          framelist->head * framelist->frame_size,
-        //          step1*framelist->frame_size);
-        pj_memset(framelist->frame_type+framelist->head,
-                  PJMEDIA_JB_MISSING_FRAME,
-                  step1*sizeof(framelist->frame_type[0]));
-        pj_bzero(framelist->content_len+framelist->head,
-                 step1*sizeof(framelist->content_len[0]));
-
-        if (step2) {
-            for (i = 0; i < step2; ++i) {
-                if (framelist->frame_type[i] == PJMEDIA_JB_DISCARDED_FRAME) {
-                    pj_assert(framelist->discarded_num > 0);
-                    framelist->discarded_num--;
-                }
-            }
-            //pj_bzero( framelist->content,
-            //        step2*framelist->frame_size);
-            pj_memset(framelist->frame_type,
-                      PJMEDIA_JB_MISSING_FRAME,
-                      step2*sizeof(framelist->frame_type[0]));
-            pj_bzero (framelist->content_len,
-                      step2*sizeof(framelist->content_len[0]));
-        }
+        jb_framelist_clear(framelist, framelist->head, step1);
+        if (step2)
+            jb_framelist_clear(framelist, 0, step2);
 
         /* update states */
         framelist->origin += count;
@@ -471,6 +475,7 @@ static pj_status_t jb_framelist_put_at(jb_framelist_t *framelist,
                                        pj_uint32_t ts,
                                        unsigned frame_type)
 {
+    jb_slot *slot;
     int distance;
     unsigned pos;
     enum { MAX_MISORDER = 100 };
@@ -535,17 +540,28 @@ static pj_status_t jb_framelist_put_at(jb_framelist_t *framelist,
     /* get the slot position */
     pos = (framelist->head + distance) % framelist->max_count;
 
+    /* the content of the slot may still be used by the application (the
+     * slot of the last frame got by reference), reject the frame.
+     */
+    if ((int)pos == framelist->lent) {
+        TRACE__((THIS_FILE,"Put frame #%d: rejected, slot is in use",
+                           index));
+        return PJ_EBUSY;
+    }
+
+    slot = JB_SLOT(framelist, pos);
+
     /* if the slot is occupied, it must be duplicated frame, ignore it. */
-    if (framelist->frame_type[pos] != PJMEDIA_JB_MISSING_FRAME) {
+    if (slot->frame_type != PJMEDIA_JB_MISSING_FRAME) {
         TRACE__((THIS_FILE,"Put frame #%d maybe a duplicate, ignored", index));
         return PJ_EEXISTS;
     }
 
     /* put the frame into the slot */
-    framelist->frame_type[pos] = frame_type;
-    framelist->content_len[pos] = frame_size;
-    framelist->bit_info[pos] = bit_info;
-    framelist->ts[pos] = ts;
+    slot->frame_type = frame_type;
+    slot->content_len = frame_size;
+    slot->bit_info = bit_info;
+    slot->ts = ts;
 
     /* update framelist size */
     if (framelist->origin + (int)framelist->size <= index)
@@ -553,8 +569,7 @@ static pj_status_t jb_framelist_put_at(jb_framelist_t *framelist,
 
     if(PJMEDIA_JB_NORMAL_FRAME == frame_type) {
         /* copy frame content */
-        pj_memcpy(framelist->content + pos * framelist->frame_size,
-                  frame, frame_size);
+        pj_memcpy(JB_CONTENT(slot), frame, frame_size);
     }
 
     return PJ_SUCCESS;
@@ -575,7 +590,7 @@ static pj_status_t jb_framelist_discard(jb_framelist_t *framelist,
           framelist->max_count;
 
     /* Discard the frame */
-    framelist->frame_type[pos] = PJMEDIA_JB_DISCARDED_FRAME;
+    JB_SLOT(framelist, pos)->frame_type = PJMEDIA_JB_DISCARDED_FRAME;
     framelist->discarded_num++;
 
     return PJ_SUCCESS;
@@ -1095,6 +1110,10 @@ PJ_DEF(void) pjmedia_jbuf_put_frame3(pjmedia_jbuf *jb,
         jb->jb_discard++;
 }
 
+static void jbuf_get(pjmedia_jbuf *jb, void *frame, const void **frame_ref,
+                     pj_size_t *size, char *p_frame_type,
+                     pj_uint32_t *bit_info, pj_uint32_t *ts, int *seq);
+
 /*
  * Get frame from jitter buffer.
  */
@@ -1129,6 +1148,38 @@ PJ_DEF(void) pjmedia_jbuf_get_frame3(pjmedia_jbuf *jb,
                                      pj_uint32_t *bit_info,
                                      pj_uint32_t *ts,
                                      int *seq)
+{
+    jbuf_get(jb, frame, NULL, size, p_frame_type, bit_info, ts, seq);
+}
+
+/*
+ * Get frame from jitter buffer, without copying the frame content.
+ */
+PJ_DEF(void) pjmedia_jbuf_get_frame_ref(pjmedia_jbuf *jb,
+                                        const void **frame,
+                                        pj_size_t *size,
+                                        char *p_frame_type,
+                                        pj_uint32_t *bit_info,
+                                        pj_uint32_t *ts,
+                                        int *seq)
+{
+    PJ_ASSERT_ON_FAIL(frame, return);
+
+    jbuf_get(jb, NULL, frame, size, p_frame_type, bit_info, ts, seq);
+}
+
+/*
+ * Get frame from jitter buffer, copy the frame content to frame or return
+ * it by reference in frame_ref.
+ */
+static void jbuf_get(pjmedia_jbuf *jb,
+                     void *frame,
+                     const void **frame_ref,
+                     pj_size_t *size,
+                     char *p_frame_type,
+                     pj_uint32_t *bit_info,
+                     pj_uint32_t *ts,
+                     int *seq)
 {
     if (jb->jb_prefetching) {
 
@@ -1140,6 +1191,8 @@ PJ_DEF(void) pjmedia_jbuf_get_frame3(pjmedia_jbuf *jb,
         *p_frame_type = PJMEDIA_JB_ZERO_PREFETCH_FRAME;
         if (size)
             *size = 0;
+        if (frame_ref)
+            *frame_ref = NULL;
 
         TRACE__((jb->jb_name.ptr, "GET prefetch_cnt=%d/%d",
                  jb_framelist_eff_size(&jb->jb_framelist), jb->jb_prefetch));
@@ -1152,8 +1205,8 @@ PJ_DEF(void) pjmedia_jbuf_get_frame3(pjmedia_jbuf *jb,
         pj_bool_t res;
 
         /* Try to retrieve a frame from frame list */
-        res = jb_framelist_get(&jb->jb_framelist, frame, size, &ftype,
-                               bit_info, ts, seq);
+        res = jb_framelist_get(&jb->jb_framelist, frame, frame_ref, size,
+                               &ftype, bit_info, ts, seq);
         if (res) {
             /* We've successfully retrieved a frame from the frame list, but
              * the frame could be a blank frame!
@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/resample.h>
+#include <pjmedia/errno.h>
+#include <pj/assert.h>
+#include <pj/log.h>
+#include <pj/pool.h>
+
+#if PJMEDIA_RESAMPLE_IMP==PJMEDIA_RESAMPLE_POLYPHASE
+
+#include <math.h>
+
+#define THIS_FILE   "resample_polyphase.c"
+
+/*
+ * Polyphase FIR resampler.
+ *
+ * The conversion ratio is reduced to rate_out/rate_in = L/M. A windowed
+ * sinc lowpass filter is designed at L times the input rate, and split
+ * into L phases of K taps each. Output sample j is then the inner product
+ * of the K input samples ending at floor(j*M/L) with phase (j*M) mod L.
+ * The phases are stored time reversed in Q14, so the inner product runs
+ * over contiguous samples and maps directly to 16bit multiply-add
+ * instructions.
+ *
+ * The taps per phase are selected from the quality flags of
+ * pjmedia_resample_create(), and multiplied by M/L when downsampling so
+ * that the filter covers the same time span of the (narrower) passband.
+ * K is rounded up to a multiple of 16 for the SIMD loops.
+ */
+
+/* Taps per phase for the quality presets. */
+#define TAPS_LINEAR         8       /* !high_quality                        */
+#define TAPS_SMALL          16      /* high_quality && !large_filter        */
+#define TAPS_LARGE          32      /* high_quality && large_filter         */
+
+/* Kaiser window beta for the presets. */
+#define BETA_LINEAR         5.0
+#define BETA_SMALL          7.0
+#define BETA_LARGE          9.0
+
+/* Coefficient precision. Q14 leaves headroom for the filter's ripple in
+ * the 32bit accumulator.
+ */
+#define COEF_SHIFT          14
+
+/* Passband edge, relative to the Nyquist frequency of the lower rate. */
+#define CUTOFF              0.92
+
+#if PJMEDIA_RESAMPLE_USE_SIMD
+#   if defined(__SSE2__) || defined(_M_X64) || \
+       (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       define RES_HAS_SSE2     1
+#       include <emmintrin.h>
+#   elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#       define RES_HAS_NEON     1
+#       include <arm_neon.h>
+#   endif
+#endif
+
+#ifndef RES_HAS_SSE2
+#   define RES_HAS_SSE2         0
+#endif
+#ifndef RES_HAS_NEON
+#   define RES_HAS_NEON         0
+#endif
+
+
+struct pjmedia_resample
+{
+    unsigned     l;             /* Interpolation factor.                    */
+    unsigned     m;             /* Decimation factor.                       */
+    unsigned     m_int;         /* M / L, input step per output sample.     */
+    unsigned     m_frac;        /* M % L, phase step per output sample.     */
+    unsigned     phase_cnt;     /* Number of phases in the table.           */
+    unsigned     taps;          /* Taps per phase (K).                      */
+    pj_int16_t  *coef;          /* phase_cnt * taps coefficients.           */
+    unsigned     frame_size;    /* Input samples per frame, all channels.   */
+    unsigned     channel_cnt;   /* Channel count.                           */
+    unsigned     in_cnt;        /* Input samples per channel.               */
+    unsigned     out_cnt;       /* Output samples per channel.              */
+    pj_int16_t **buffer;        /* Per channel history and input.           */
+};
+
+
+static unsigned gcd(unsigned a, unsigned b)
+{
+    while (b) {
+        unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Zeroth order modified Bessel function of the first kind. */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    unsigned k;
+
+    for (k = 1; k < 64; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+/* Design the prototype filter and store it as the polyphase table. */
+static void design_filter(pjmedia_resample *resample, double beta)
+{
+    const double pi = 3.14159265358979323846;
+    unsigned n_total = resample->l * resample->taps;
+    double center = (n_total - 1) / 2.0;
+    double fc, i0_beta;
+    unsigned p, k;
+
+    /* Cutoff, in cycles per sample of the upsampled rate */
+    fc = CUTOFF * 0.5 / (resample->l > resample->m ? resample->l :
+                                                     resample->m);
+    i0_beta = bessel_i0(beta);
+
+    for (p = 0; p < resample->phase_cnt; ++p) {
+        pj_int16_t *coef = resample->coef + p * resample->taps;
+        /* Phase offset in units of the upsampled rate. With fewer table
+         * phases than L, the nearest phases are used.
+         */
+        double ofs = (double)p * resample->l / resample->phase_cnt;
+
+        for (k = 0; k < resample->taps; ++k) {
+            /* coef[k] multiplies x[i - (taps-1) + k], i.e. tap
+             * (taps-1-k) of the phase, at n = (taps-1-k)*L + ofs.
+             */
+            double n = (resample->taps - 1 - k) * (double)resample->l + ofs;
+            double t = n - center;
+            double r = t / (center + 1);
+            double h, w;
+
+            if (t == 0.0)
+                h = 2.0 * fc;
+            else
+                h = sin(2.0 * pi * fc * t) / (pi * t);
+
+            w = (r > -1.0 && r < 1.0) ?
+                    bessel_i0(beta * sqrt(1.0 - r * r)) / i0_beta : 0.0;
+
+            h *= w * resample->l * (1 << COEF_SHIFT);
+            h = (h >= 0) ? h + 0.5 : h - 0.5;
+            if (h > 32767) h = 32767;
+            else if (h < -32768) h = -32768;
+
+            coef[k] = (pj_int16_t)h;
+        }
+    }
+}
+
+
+/*
+ * Inner product of count samples with count coefficients, count being a
+ * multiple of 16.
+ */
+#if RES_HAS_SSE2
+
+static pj_int32_t dot_product(const pj_int16_t *x, const pj_int16_t *h,
+                              unsigned count)
+{
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    unsigned i;
+
+    for (i = 0; i < count; i += 16) {
+        __m128i x0 = _mm_loadu_si128((const __m128i*)(x + i));
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(x + i + 8));
+        __m128i h0 = _mm_loadu_si128((const __m128i*)(h + i));
+        __m128i h1 = _mm_loadu_si128((const __m128i*)(h + i + 8));
+
+        acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(x0, h0));
+        acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(x1, h1));
+    }
+
+    acc0 = _mm_add_epi32(acc0, acc1);
+    acc0 = _mm_add_epi32(acc0, _mm_shuffle_epi32(acc0, 0x4E));
+    acc0 = _mm_add_epi32(acc0, _mm_shuffle_epi32(acc0, 0xB1));
+    return _mm_cvtsi128_si32(acc0);
+}
+
+#elif RES_HAS_NEON
+
+static pj_int32_t dot_product(const pj_int16_t *x, const pj_int16_t *h,
+                              unsigned count)
+{
+    int32x4_t acc0 = vdupq_n_s32(0);
+    int32x4_t acc1 = vdupq_n_s32(0);
+    unsigned i;
+
+    for (i = 0; i < count; i += 8) {
+        int16x8_t x0 = vld1q_s16(x + i);
+        int16x8_t h0 = vld1q_s16(h + i);
+
+        acc0 = vmlal_s16(acc0, vget_low_s16(x0), vget_low_s16(h0));
+        acc1 = vmlal_s16(acc1, vget_high_s16(x0), vget_high_s16(h0));
+    }
+
+    acc0 = vaddq_s32(acc0, acc1);
+    return vgetq_lane_s32(acc0, 0) + vgetq_lane_s32(acc0, 1) +
+           vgetq_lane_s32(acc0, 2) + vgetq_lane_s32(acc0, 3);
+}
+
+#else
+
+static pj_int32_t dot_product(const pj_int16_t *x, const pj_int16_t *h,
+                              unsigned count)
+{
+    pj_int32_t acc = 0;
+    unsigned i;
+
+    for (i = 0; i < count; ++i)
+        acc += (pj_int32_t)x[i] * h[i];
+
+    return acc;
+}
+
+#endif
+
+
+PJ_DEF(pj_status_t) pjmedia_resample_create( pj_pool_t *pool,
+                                             pj_bool_t high_quality,
+                                             pj_bool_t large_filter,
+                                             unsigned channel_count,
+                                             unsigned rate_in,
+                                             unsigned rate_out,
+                                             unsigned samples_per_frame,
+                                             pjmedia_resample **p_resample)
+{
+    pjmedia_resample *resample;
+    unsigned g, taps, i;
+    double beta;
+
+    PJ_ASSERT_RETURN(pool && p_resample && rate_in &&
+                     rate_out && samples_per_frame, PJ_EINVAL);
+    PJ_ASSERT_RETURN(channel_count && samples_per_frame % channel_count == 0,
+                     PJ_EINVAL);
+
+    resample = PJ_POOL_ZALLOC_T(pool, pjmedia_resample);
+    PJ_ASSERT_RETURN(resample, PJ_ENOMEM);
+
+    g = gcd(rate_in, rate_out);
+    resample->l = rate_out / g;
+    resample->m = rate_in / g;
+    resample->m_int = resample->m / resample->l;
+    resample->m_frac = resample->m % resample->l;
+    resample->phase_cnt = PJ_MIN(resample->l, PJMEDIA_RESAMPLE_MAX_PHASES);
+    resample->channel_cnt = channel_count;
+    resample->frame_size = samples_per_frame;
+    resample->in_cnt = samples_per_frame / channel_count;
+    resample->out_cnt = (unsigned)((pj_uint64_t)resample->in_cnt *
+                                   resample->l / resample->m);
+
+    if (!high_quality) {
+        taps = TAPS_LINEAR;
+        beta = BETA_LINEAR;
+    } else if (!large_filter) {
+        taps = TAPS_SMALL;
+        beta = BETA_SMALL;
+    } else {
+        taps = TAPS_LARGE;
+        beta = BETA_LARGE;
+    }
+    if (resample->m > resample->l)
+        taps = (taps * resample->m + resample->l - 1) / resample->l;
+    resample->taps = (taps + 15) & ~15;
+
+    resample->coef = (pj_int16_t*)
+                     pj_pool_alloc(pool, resample->phase_cnt *
+                                         resample->taps * sizeof(pj_int16_t));
+    PJ_ASSERT_RETURN(resample->coef, PJ_ENOMEM);
+    design_filter(resample, beta);
+
+    /* History of taps-1 samples, followed by the input frame */
+    resample->buffer = (pj_int16_t**)
+                       pj_pool_calloc(pool, channel_count,
+                                      sizeof(pj_int16_t*));
+    for (i = 0; i < channel_count; ++i) {
+        resample->buffer[i] = (pj_int16_t*)
+                              pj_pool_calloc(pool, resample->taps - 1 +
+                                                   resample->in_cnt,
+                                             sizeof(pj_int16_t));
+        PJ_ASSERT_RETURN(resample->buffer[i], PJ_ENOMEM);
+    }
+
+    *p_resample = resample;
+
+    PJ_LOG(5,(THIS_FILE, "resample created: %s quality, %s filter, in/out "
+                         "rate=%d/%d, %d phases of %d taps",
+                         (high_quality?"high":"low"),
+                         (large_filter?"large":"small"),
+                         rate_in, rate_out, resample->phase_cnt,
+                         resample->taps));
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(void) pjmedia_resample_run( pjmedia_resample *resample,
+                                   const pj_int16_t *input,
+                                   pj_int16_t *output )
+{
+    unsigned hist, ch;
+
+    PJ_ASSERT_ON_FAIL(resample, return);
+
+    hist = resample->taps - 1;
+
+    for (ch = 0; ch < resample->channel_cnt; ++ch) {
+        pj_int16_t *buf = resample->buffer[ch];
+        pj_int16_t *out = output + ch;
+        unsigned j, idx, phase;
+
+        /* Append (deinterleave) the input frame after the history */
+        if (resample->channel_cnt == 1) {
+            pjmedia_copy_samples(buf + hist, input, resample->in_cnt);
+        } else {
+            const pj_int16_t *src = input + ch;
+
+            for (j = 0; j < resample->in_cnt; ++j) {
+                buf[hist + j] = *src;
+                src += resample->channel_cnt;
+            }
+        }
+
+        /* Output j uses the taps samples ending at input (j*M)/L, with
+         * phase (j*M) mod L. Both are stepped instead of divided.
+         */
+        for (j = 0, idx = 0, phase = 0; j < resample->out_cnt; ++j) {
+            const pj_int16_t *h;
+            pj_int32_t y;
+
+            if (resample->phase_cnt == resample->l)
+                h = resample->coef + phase * resample->taps;
+            else
+                h = resample->coef + (phase * resample->phase_cnt /
+                                      resample->l) * resample->taps;
+
+            y = dot_product(buf + idx, h, resample->taps);
+            y = (y + (1 << (COEF_SHIFT - 1))) >> COEF_SHIFT;
+            if (y > 32767) y = 32767;
+            else if (y < -32768) y = -32768;
+
+            *out = (pj_int16_t)y;
+            out += resample->channel_cnt;
+
+            idx += resample->m_int;
+            phase += resample->m_frac;
+            if (phase >= resample->l) {
+                phase -= resample->l;
+                ++idx;
+            }
+        }
+
+        /* Keep the last taps-1 samples as history */
+        pjmedia_move_samples(buf, buf + resample->in_cnt, hist);
+    }
+}
+
+
+PJ_DEF(unsigned) pjmedia_resample_get_input_size(pjmedia_resample *resample)
+{
+    PJ_ASSERT_RETURN(resample != NULL, 0);
+    return resample->frame_size;
+}
+
+
+PJ_DEF(void) pjmedia_resample_destroy(pjmedia_resample *resample)
+{
+    PJ_UNUSED_ARG(resample);
+}
+
+#else /* PJMEDIA_RESAMPLE_IMP==PJMEDIA_RESAMPLE_POLYPHASE */
+
+int pjmedia_resample_polyphase_excluded;
+
+#endif  /* PJMEDIA_RESAMPLE_IMP==PJMEDIA_RESAMPLE_POLYPHASE */
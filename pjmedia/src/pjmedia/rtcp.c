@@ -61,6 +61,65 @@ enum {
 #   define TRACE_(x)    ;
 #endif
 
+/*
+ * The statistics are guarded by sequence counters (seqlocks), one for each
+ * function updating them: pjmedia_rtcp_rx_rtp2(), pjmedia_rtcp_rx_rtcp(),
+ * pjmedia_rtcp_tx_rtp(), pjmedia_rtcp_build_rtcp() and
+ * pjmedia_rtcp_reset_stat(). A counter is odd while its function is
+ * updating the statistics. Each function is never run concurrently with
+ * itself on a session, the session state it updates besides the statistics
+ * (e.g. the RTCP packet being built) already requires that, so a counter
+ * has a single writer and the writers never wait. Readers copy the
+ * statistics and retry if any counter was odd or has moved, and give up
+ * after a while rather than return a torn copy.
+ */
+enum stat_seq_id
+{
+    STAT_SEQ_RX_RTP,
+    STAT_SEQ_RX_RTCP,
+    STAT_SEQ_TX_RTP,
+    STAT_SEQ_TX_RTCP,
+    STAT_SEQ_RESET,
+    STAT_SEQ_CNT
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#   define STAT_FENCE_REL()     __atomic_thread_fence(__ATOMIC_RELEASE)
+#   define STAT_FENCE_ACQ()     __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#elif defined(_MSC_VER)
+#   include <intrin.h>
+#   if defined(_M_ARM) || defined(_M_ARM64)
+#       define STAT_FENCE_REL() __dmb(0xB)
+#       define STAT_FENCE_ACQ() __dmb(0xB)
+#   else
+#       define STAT_FENCE_REL() _ReadWriteBarrier()
+#       define STAT_FENCE_ACQ() _ReadWriteBarrier()
+#   endif
+#else
+#   define STAT_FENCE_REL()
+#   define STAT_FENCE_ACQ()
+#endif
+
+/* Number of attempts pjmedia_rtcp_get_stat() makes to copy the statistics
+ * before giving up.
+ */
+#define STAT_READ_RETRY         64
+
+/* Start updating the statistics guarded by the counter. The caller is
+ * the only writer of the counter, so this never waits.
+ */
+static void stat_write_begin(pjmedia_rtcp_session *sess, unsigned id)
+{
+    sess->stat_seq[id] = sess->stat_seq[id] + 1;
+    STAT_FENCE_REL();
+}
+
+static void stat_write_end(pjmedia_rtcp_session *sess, unsigned id)
+{
+    STAT_FENCE_REL();
+    sess->stat_seq[id] = sess->stat_seq[id] + 1;
+}
+
 
 /*
  * Get NTP time.
@@ -258,6 +317,7 @@ PJ_DEF(void) pjmedia_rtcp_init2( pjmedia_rtcp_session *sess,
 
     /* Initialize statistics states */
     pjmedia_rtcp_init_stat(&sess->stat);
+    pj_assert(PJ_ARRAY_SIZE(sess->stat_seq) == STAT_SEQ_CNT);
 
     /* RR will be initialized on receipt of the first RTP packet. */
 }
@@ -313,11 +373,11 @@ PJ_DEF(void) pjmedia_rtcp_rx_rtp( pjmedia_rtcp_session *sess,
     pjmedia_rtcp_rx_rtp2(sess, seq, rtp_ts, payload, PJ_FALSE);
 }
 
-PJ_DEF(void) pjmedia_rtcp_rx_rtp2(pjmedia_rtcp_session *sess, 
-                                  unsigned seq, 
-                                  unsigned rtp_ts,
-                                  unsigned payload,
-                                  pj_bool_t discarded)
+static void rx_rtp(pjmedia_rtcp_session *sess, 
+                   unsigned seq, 
+                   unsigned rtp_ts,
+                   unsigned payload,
+                   pj_bool_t discarded)
 {   
     pj_timestamp ts;
     pj_uint32_t arrival;
@@ -522,12 +582,25 @@ PJ_DEF(void) pjmedia_rtcp_rx_rtp2(pjmedia_rtcp_session *sess,
     sess->rtp_last_ts = rtp_ts;
 }
 
+PJ_DEF(void) pjmedia_rtcp_rx_rtp2(pjmedia_rtcp_session *sess, 
+                                  unsigned seq, 
+                                  unsigned rtp_ts,
+                                  unsigned payload,
+                                  pj_bool_t discarded)
+{
+    stat_write_begin(sess, STAT_SEQ_RX_RTP);
+    rx_rtp(sess, seq, rtp_ts, payload, discarded);
+    stat_write_end(sess, STAT_SEQ_RX_RTP);
+}
+
 PJ_DEF(void) pjmedia_rtcp_tx_rtp(pjmedia_rtcp_session *sess, 
                                  unsigned bytes_payload_size)
 {
     /* Update statistics */
+    stat_write_begin(sess, STAT_SEQ_TX_RTP);
     sess->stat.tx.pkt++;
     sess->stat.tx.bytes += bytes_payload_size;
+    stat_write_end(sess, STAT_SEQ_TX_RTP);
 }
 
 
@@ -879,6 +952,8 @@ PJ_DEF(void) pjmedia_rtcp_rx_rtcp( pjmedia_rtcp_session *sess,
 {
     pj_uint8_t *p, *p_end;
 
+    stat_write_begin(sess, STAT_SEQ_RX_RTCP);
+
     p = (pj_uint8_t*)pkt;
     p_end = p + size;
     while (p < p_end) {
@@ -922,11 +997,13 @@ PJ_DEF(void) pjmedia_rtcp_rx_rtcp( pjmedia_rtcp_session *sess,
 
         p += len;
     }
+
+    stat_write_end(sess, STAT_SEQ_RX_RTCP);
 }
 
 
-PJ_DEF(void) pjmedia_rtcp_build_rtcp(pjmedia_rtcp_session *sess, 
-                                     void **ret_p_pkt, int *len)
+static void build_rtcp(pjmedia_rtcp_session *sess, 
+                       void **ret_p_pkt, int *len)
 {
     pj_uint32_t expected, expected_interval, received_interval, lost_interval;
     pjmedia_rtcp_sr *sr;
@@ -1075,6 +1152,93 @@ PJ_DEF(void) pjmedia_rtcp_build_rtcp(pjmedia_rtcp_session *sess,
 }
 
 
+PJ_DEF(void) pjmedia_rtcp_build_rtcp(pjmedia_rtcp_session *sess, 
+                                     void **ret_p_pkt, int *len)
+{
+    stat_write_begin(sess, STAT_SEQ_TX_RTCP);
+    build_rtcp(sess, ret_p_pkt, len);
+    stat_write_end(sess, STAT_SEQ_TX_RTCP);
+}
+
+
+/* Make a SDES item of the copied statistics point to its own buffer. */
+static void rebase_sdes_item(pj_str_t *item, const char *old_buf,
+                             char *new_buf)
+{
+    if (item->slen && item->ptr >= old_buf &&
+        item->ptr < old_buf + PJMEDIA_RTCP_RX_SDES_BUF_LEN)
+    {
+        item->ptr = new_buf + (item->ptr - old_buf);
+    }
+}
+
+
+/*
+ * Get a consistent copy of the statistics.
+ */
+PJ_DEF(pj_status_t) pjmedia_rtcp_get_stat(const pjmedia_rtcp_session *sess,
+                                          pjmedia_rtcp_stat *stat)
+{
+    const char *old_buf = sess->stat.peer_sdes_buf_;
+    pj_uint32_t seq[STAT_SEQ_CNT];
+    unsigned i, j;
+
+    PJ_ASSERT_RETURN(sess && stat, PJ_EINVAL);
+
+    for (i = 0; i < STAT_READ_RETRY; ++i) {
+        pj_bool_t busy = PJ_FALSE;
+
+        for (j = 0; j < STAT_SEQ_CNT; ++j) {
+            seq[j] = sess->stat_seq[j];
+            busy |= (seq[j] & 1);
+        }
+        if (busy) {
+            /* An update is in progress */
+            pj_thread_sleep(0);
+            continue;
+        }
+        STAT_FENCE_ACQ();
+
+        pj_memcpy(stat, &sess->stat, sizeof(pjmedia_rtcp_stat));
+
+        STAT_FENCE_ACQ();
+        for (j = 0; j < STAT_SEQ_CNT; ++j) {
+            if (seq[j] != sess->stat_seq[j])
+                break;
+        }
+        if (j == STAT_SEQ_CNT)
+            break;
+    }
+
+    /* The statistics keep being updated, or this thread is the one
+     * updating them (e.g. when called from an RTCP event callback).
+     */
+    if (i == STAT_READ_RETRY)
+        return PJ_EBUSY;
+
+    rebase_sdes_item(&stat->peer_sdes.cname, old_buf, stat->peer_sdes_buf_);
+    rebase_sdes_item(&stat->peer_sdes.name, old_buf, stat->peer_sdes_buf_);
+    rebase_sdes_item(&stat->peer_sdes.email, old_buf, stat->peer_sdes_buf_);
+    rebase_sdes_item(&stat->peer_sdes.phone, old_buf, stat->peer_sdes_buf_);
+    rebase_sdes_item(&stat->peer_sdes.loc, old_buf, stat->peer_sdes_buf_);
+    rebase_sdes_item(&stat->peer_sdes.tool, old_buf, stat->peer_sdes_buf_);
+    rebase_sdes_item(&stat->peer_sdes.note, old_buf, stat->peer_sdes_buf_);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Reset the statistics while the session is in use.
+ */
+PJ_DEF(void) pjmedia_rtcp_reset_stat(pjmedia_rtcp_session *sess)
+{
+    stat_write_begin(sess, STAT_SEQ_RESET);
+    pjmedia_rtcp_init_stat(&sess->stat);
+    stat_write_end(sess, STAT_SEQ_RESET);
+}
+
+
 PJ_DEF(pj_status_t) pjmedia_rtcp_build_rtcp_sdes(
                                             pjmedia_rtcp_session *session, 
                                             void *buf,
@@ -27,6 +27,7 @@
 #include <pj/compat/socket.h>
 #include <pj/errno.h>
 #include <pj/ioqueue.h>
+#include <pj/list.h>
 #include <pj/log.h>
 #include <pj/os.h>
 #include <pj/pool.h>
@@ -101,6 +102,41 @@ struct dtmf
 };
 
 
+/* Node of a stream in the queue of its decode worker. */
+struct dec_node
+{
+    PJ_DECL_LIST_MEMBER(struct dec_node);
+    pjmedia_stream          *stream;        /**< The stream.                */
+    pj_bool_t                queued;        /**< In the worker queue?       */
+};
+
+/*
+ * Decode worker thread. Streams are pinned to one worker, so their frames
+ * are decoded in order.
+ */
+struct dec_worker
+{
+    pjmedia_stream_dec_pool *dec_pool;      /**< The owning pool.           */
+    pj_thread_t             *thread;        /**< The thread.                */
+    pj_sem_t                *sem;           /**< Signalled on new work.     */
+    pj_mutex_t              *mutex;         /**< Protects queue and busy.   */
+    struct dec_node          queue;         /**< Streams needing decode.    */
+    pjmedia_stream          *busy;          /**< Stream being decoded.      */
+    unsigned                 stream_cnt;    /**< Streams pinned to worker.  */
+};
+
+/*
+ * Decode worker pool.
+ */
+struct pjmedia_stream_dec_pool
+{
+    pj_bool_t                quit;          /**< Stop the workers.          */
+    unsigned                 worker_cnt;    /**< Number of workers.         */
+    pj_mutex_t              *mutex;         /**< Protects assignment.       */
+    struct dec_worker       *workers;       /**< The workers.               */
+};
+
+
 /**
  * This structure describes media stream.
  * A media stream is bidirectional media transmission between two endpoints.
@@ -276,7 +312,41 @@ struct pjmedia_stream
     pjmedia_rtcp_fb_nack     rtcp_fb_nack;          /**< TX NACK state.     */
     int                      rtcp_fb_nack_cap_idx;  /**< RX NACK cap idx.   */
 
+#if PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+    /* Latency statistics, protected by jb_mutex */
+    pjmedia_stream_lat_stat  lat;                   /**< Stage histograms.  */
+    pj_timestamp             lat_rx_ts[PJMEDIA_STREAM_LATENCY_RX_HIST];
+                                                    /**< Arrival time of
+                                                         recent frames.     */
+    int                      lat_rx_seq[PJMEDIA_STREAM_LATENCY_RX_HIST];
+                                                    /**< Their ext seq.     */
+    pj_timestamp             lat_dec_done;          /**< Last get_frame()
+                                                         return time.       */
+    pj_status_t            (*lat_get_frame)(pjmedia_port*, pjmedia_frame*);
+                                                    /**< Timed get_frame(). */
+    pj_status_t            (*lat_put_frame)(pjmedia_port*, pjmedia_frame*);
+                                                    /**< Timed put_frame(). */
+#endif
 
+    /* Decode pool, the staged frames are protected by dec_mutex */
+    pj_mutex_t              *dec_mutex;             /**< Staging mutex.     */
+    pj_mutex_t              *codec_mutex;           /**< Serializes decode
+                                                         and encode, once
+                                                         attached to a
+                                                         decode pool.       */
+    struct dec_worker       *dec_worker;            /**< Pinned worker, or
+                                                         NULL if detached.  */
+    struct dec_node          dec_node;              /**< Worker queue node. */
+    pjmedia_frame           *dec_staged;            /**< Ring of decoded
+                                                         frames.            */
+    unsigned                 dec_staged_head;       /**< Oldest frame.      */
+    unsigned                 dec_staged_cnt;        /**< Frames in ring.    */
+    unsigned                 dec_due;               /**< Frames whose
+                                                         playout time has
+                                                         come, not decoded
+                                                         yet.               */
+    unsigned                 dec_underrun;          /**< get_frame() calls
+                                                         with empty ring.   */
 };
 
 
@@ -515,44 +585,139 @@ static void send_keep_alive_packet(pjmedia_stream *stream)
 }
 #endif  /* defined(PJMEDIA_STREAM_ENABLE_KA) */
 
-/*
- * play_callback()
- *
- * This callback is called by sound device's player thread when it
- * needs to feed the player with some frames.
+
+#if PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+
+/* Map a latency to its histogram bucket (see PJMEDIA_STREAM_LAT_BUCKET_CNT):
+ * exact values below 8 usec, then four buckets per power of two.
  */
-static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
+static unsigned lat_bucket_idx(pj_uint32_t usec)
+{
+    unsigned msb, idx;
+
+    if (usec < 8)
+        return usec;
+
+#if defined(__GNUC__)
+    msb = 31 - __builtin_clz(usec);
+#else
+    for (msb = 3; (usec >> (msb + 1)) != 0; ++msb)
+        ;
+#endif
+
+    idx = (msb - 1) * 4 + ((usec >> (msb - 2)) & 3);
+    return PJ_MIN(idx, PJMEDIA_STREAM_LAT_BUCKET_CNT - 1);
+}
+
+/* Add a sample to a stage histogram. Caller holds jb_mutex. */
+static void lat_add(pjmedia_stream *stream, pjmedia_stream_lat_stage stage,
+                    const pj_timestamp *start, const pj_timestamp *stop)
+{
+    pjmedia_stream_lat_hist *h = &stream->lat.stage[stage];
+    pj_uint32_t usec = pj_elapsed_usec(start, stop);
+
+    if (h->count == 0 || usec < h->min_usec)
+        h->min_usec = usec;
+    if (usec > h->max_usec)
+        h->max_usec = usec;
+    h->sum_usec += usec;
+    ++h->count;
+    ++h->bucket[lat_bucket_idx(usec)];
+}
+
+/* Remember the arrival time of a frame put to the jitter buffer. */
+static void lat_rx_frame(pjmedia_stream *stream, int ext_seq,
+                         const pj_timestamp *arrival)
+{
+    unsigned i = (unsigned)ext_seq & (PJMEDIA_STREAM_LATENCY_RX_HIST - 1);
+
+    stream->lat_rx_seq[i] = ext_seq;
+    stream->lat_rx_ts[i] = *arrival;
+}
+
+/* Update the jitter buffer wait of a frame taken from the jitter buffer. */
+static void lat_jbuf_frame(pjmedia_stream *stream, int ext_seq)
+{
+    unsigned i = (unsigned)ext_seq & (PJMEDIA_STREAM_LATENCY_RX_HIST - 1);
+    pj_timestamp now;
+
+    if (stream->lat_rx_seq[i] != ext_seq || stream->lat_rx_ts[i].u64 == 0)
+        return;
+
+    pj_get_timestamp(&now);
+    lat_add(stream, PJMEDIA_STREAM_LAT_JBUF, &stream->lat_rx_ts[i], &now);
+    stream->lat_rx_ts[i].u64 = 0;
+}
+
+/* Timed wrapper of get_frame()/get_frame_ext(). */
+static pj_status_t lat_get_frame(pjmedia_port *port, pjmedia_frame *frame)
 {
     pjmedia_stream *stream = (pjmedia_stream*) port->port_data.pdata;
-    pjmedia_channel *channel = stream->dec;
-    unsigned samples_count, samples_per_frame, samples_required;
-    pj_int16_t *p_out_samp;
+    pj_timestamp t0, t1;
     pj_status_t status;
 
+    pj_get_timestamp(&t0);
+    status = (*stream->lat_get_frame)(port, frame);
+    pj_get_timestamp(&t1);
 
-    /* Return no frame is channel is paused */
-    if (channel->paused) {
-        frame->type = PJMEDIA_FRAME_TYPE_NONE;
-        return PJ_SUCCESS;
+    if (frame->type != PJMEDIA_FRAME_TYPE_NONE) {
+        pj_mutex_lock(stream->jb_mutex);
+        lat_add(stream, PJMEDIA_STREAM_LAT_DECODE, &t0, &t1);
+        stream->lat_dec_done = t1;
+        pj_mutex_unlock(stream->jb_mutex);
     }
 
-    if (stream->soft_start_cnt) {
-        if (stream->soft_start_cnt == PJMEDIA_STREAM_SOFT_START) {
-            PJ_LOG(4,(stream->port.info.name.ptr,
-                      "Resetting jitter buffer in stream playback start"));
-            pj_mutex_lock( stream->jb_mutex );
-            pjmedia_jbuf_reset(stream->jb);
-            pj_mutex_unlock( stream->jb_mutex );
-        }
-        --stream->soft_start_cnt;
-        frame->type = PJMEDIA_FRAME_TYPE_NONE;
-        return PJ_SUCCESS;
+    return status;
+}
+
+/* Timed wrapper of put_frame(). */
+static pj_status_t lat_put_frame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    pjmedia_stream *stream = (pjmedia_stream*) port->port_data.pdata;
+    pj_timestamp t0, t1;
+    pj_status_t status;
+
+    pj_get_timestamp(&t0);
+    status = (*stream->lat_put_frame)(port, frame);
+    pj_get_timestamp(&t1);
+
+    pj_mutex_lock(stream->jb_mutex);
+    if (stream->lat_dec_done.u64 && stream->lat_dec_done.u64 <= t0.u64) {
+        lat_add(stream, PJMEDIA_STREAM_LAT_CONF, &stream->lat_dec_done, &t0);
+        stream->lat_dec_done.u64 = 0;
     }
+    lat_add(stream, PJMEDIA_STREAM_LAT_ENCODE, &t0, &t1);
+    pj_mutex_unlock(stream->jb_mutex);
+
+    return status;
+}
+
+#endif  /* PJMEDIA_STREAM_ENABLE_LATENCY_STAT */
+
+/*
+ * Get frames from the jitter buffer and decode them until the frame is
+ * filled. This is called by get_frame(), or by the decode worker when the
+ * stream is attached to a decode pool.
+ */
+static void decode_frame(pjmedia_stream *stream, pjmedia_frame *frame)
+{
+    pjmedia_port *port = &stream->port;
+    unsigned samples_count, samples_per_frame, samples_required;
+    pj_int16_t *p_out_samp;
+    pj_mutex_t *codec_mutex = stream->codec_mutex;
+    pj_status_t status;
 
     /* Repeat get frame from the jitter buffer and decode the frame
      * until we have enough frames according to codec's ptime.
      */
 
+    /* The encoder may be running in the clock thread meanwhile, when the
+     * decode worker calls this. The lock order is the codec mutex, then
+     * the jitter buffer mutex.
+     */
+    if (codec_mutex)
+        pj_mutex_lock(codec_mutex);
+
     /* Lock jitter buffer mutex first */
     pj_mutex_lock( stream->jb_mutex );
 
@@ -566,8 +731,10 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
 
     for (samples_count=0; samples_count < samples_required;) {
         char frame_type;
-        pj_size_t frame_size = channel->out_pkt_size;
+        const void *frame_buf;
+        pj_size_t frame_size;
         pj_uint32_t bit_info;
+        int frame_seq;
 
         if (stream->dec_buf && stream->dec_buf_pos < stream->dec_buf_count) {
             unsigned nsamples_req = samples_required - samples_count;
@@ -583,9 +750,16 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
             continue;
         }
 
-        /* Get frame from jitter buffer. */
-        pjmedia_jbuf_get_frame2(stream->jb, channel->out_pkt, &frame_size,
-                                &frame_type, &bit_info);
+        /* Get frame from jitter buffer. The frame is decoded while the
+         * jitter buffer mutex is held, so it doesn't need to be copied.
+         */
+        pjmedia_jbuf_get_frame_ref(stream->jb, &frame_buf, &frame_size,
+                                   &frame_type, &bit_info, NULL, &frame_seq);
+
+#if PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+        if (frame_type == PJMEDIA_JB_NORMAL_FRAME)
+            lat_jbuf_frame(stream, frame_seq);
+#endif
 
 #if TRACE_JB
         trace_jb_get(stream, frame_type, frame_size);
@@ -752,7 +926,7 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
             stream->plc_cnt = 0;
 
             /* Decode */
-            frame_in.buf = channel->out_pkt;
+            frame_in.buf = (void*)frame_buf;
             frame_in.size = frame_size;
             frame_in.bit_info = bit_info;
             frame_in.type = PJMEDIA_FRAME_TYPE_AUDIO;  /* ignored */
@@ -810,6 +984,9 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
     /* Unlock jitter buffer mutex. */
     pj_mutex_unlock( stream->jb_mutex );
 
+    if (codec_mutex)
+        pj_mutex_unlock(codec_mutex);
+
     /* Return PJMEDIA_FRAME_TYPE_NONE if we have no frames at all
      * (it can happen when jitter buffer returns PJMEDIA_JB_ZERO_EMPTY_FRAME).
      */
@@ -821,6 +998,186 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
         frame->size = samples_count * BYTES_PER_SAMPLE;
         frame->timestamp.u64 = 0;
     }
+}
+
+
+/* Queue the stream to its decode worker, if it is not queued already. */
+static void dec_schedule(pjmedia_stream *stream, struct dec_worker *w)
+{
+    pj_bool_t post = PJ_FALSE;
+
+    pj_mutex_lock(w->mutex);
+    if (!stream->dec_node.queued) {
+        pj_list_push_back(&w->queue, &stream->dec_node);
+        stream->dec_node.queued = PJ_TRUE;
+        post = PJ_TRUE;
+    }
+    pj_mutex_unlock(w->mutex);
+
+    if (post)
+        pj_sem_post(w->sem);
+}
+
+
+/* Take the oldest frame decoded by the worker, and let the worker decode
+ * the frame whose playout time has now come. The worker only pulls from
+ * the jitter buffer at the pace of this clock, as get_frame() does when
+ * decoding by itself, so the jitter buffer keeps its full depth and late
+ * packets still make it in time. The frame is played on the next call.
+ */
+static void get_staged_frame(pjmedia_stream *stream, pjmedia_frame *frame)
+{
+    pj_mutex_lock(stream->dec_mutex);
+
+    if (stream->dec_staged_cnt) {
+        pjmedia_frame *f = &stream->dec_staged[stream->dec_staged_head];
+
+        frame->type = f->type;
+        frame->size = f->size;
+        frame->timestamp.u64 = 0;
+        if (f->type == PJMEDIA_FRAME_TYPE_AUDIO)
+            pj_memcpy(frame->buf, f->buf, f->size);
+
+        stream->dec_staged_head = (stream->dec_staged_head + 1) %
+                                  PJMEDIA_STREAM_DEC_AHEAD;
+        --stream->dec_staged_cnt;
+    } else {
+        /* Nothing decoded yet, e.g. on the first call after attaching,
+         * or the worker is lagging behind.
+         */
+        frame->type = PJMEDIA_FRAME_TYPE_NONE;
+        frame->size = 0;
+        if (stream->dec_due)
+            ++stream->dec_underrun;
+    }
+
+    /* If the worker lags behind by the whole ring, the frame is left in
+     * the jitter buffer, which then drops frames as it does for a slow
+     * clock.
+     */
+    if (stream->dec_staged_cnt + stream->dec_due < PJMEDIA_STREAM_DEC_AHEAD)
+        ++stream->dec_due;
+
+    /* Queue the stream while still holding the staging mutex, so that
+     * pjmedia_stream_set_dec_pool() can not detach it in between and
+     * have it queued again afterwards. The lock order is the staging
+     * mutex, then the worker mutex.
+     */
+    if (stream->dec_worker)
+        dec_schedule(stream, stream->dec_worker);
+
+    pj_mutex_unlock(stream->dec_mutex);
+}
+
+
+/* Decode the frames of the stream whose playout time has come. */
+static void dec_fill_staged(pjmedia_stream *stream, struct dec_worker *w)
+{
+    for (;;) {
+        pjmedia_frame *f;
+
+        pj_mutex_lock(stream->dec_mutex);
+        if (stream->dec_worker != w || stream->dec_due == 0 ||
+            stream->dec_staged_cnt == PJMEDIA_STREAM_DEC_AHEAD)
+        {
+            pj_mutex_unlock(stream->dec_mutex);
+            break;
+        }
+        f = &stream->dec_staged[(stream->dec_staged_head +
+                                 stream->dec_staged_cnt) %
+                                PJMEDIA_STREAM_DEC_AHEAD];
+        --stream->dec_due;
+        pj_mutex_unlock(stream->dec_mutex);
+
+        /* The slot is not visible to get_frame() until it is counted, so
+         * it can be filled without holding the staging mutex.
+         */
+        f->size = PJMEDIA_PIA_SPF(&stream->port.info) * BYTES_PER_SAMPLE;
+        decode_frame(stream, f);
+
+        pj_mutex_lock(stream->dec_mutex);
+        if (stream->dec_worker == w)
+            ++stream->dec_staged_cnt;
+        pj_mutex_unlock(stream->dec_mutex);
+    }
+}
+
+
+/*
+ * Decode worker thread.
+ */
+static int dec_worker_thread(void *arg)
+{
+    struct dec_worker *w = (struct dec_worker*) arg;
+
+    for (;;) {
+        struct dec_node *node;
+
+        pj_sem_wait(w->sem);
+        if (w->dec_pool->quit)
+            break;
+
+        pj_mutex_lock(w->mutex);
+        if (pj_list_empty(&w->queue)) {
+            pj_mutex_unlock(w->mutex);
+            continue;
+        }
+        node = w->queue.next;
+        pj_list_erase(node);
+        node->queued = PJ_FALSE;
+        w->busy = node->stream;
+        pj_mutex_unlock(w->mutex);
+
+        dec_fill_staged(node->stream, w);
+
+        pj_mutex_lock(w->mutex);
+        w->busy = NULL;
+        pj_mutex_unlock(w->mutex);
+    }
+
+    return 0;
+}
+
+
+/*
+ * play_callback()
+ *
+ * This callback is called by sound device's player thread when it
+ * needs to feed the player with some frames.
+ */
+static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
+{
+    pjmedia_stream *stream = (pjmedia_stream*) port->port_data.pdata;
+    pjmedia_channel *channel = stream->dec;
+
+    /* Return no frame is channel is paused */
+    if (channel->paused) {
+        frame->type = PJMEDIA_FRAME_TYPE_NONE;
+        return PJ_SUCCESS;
+    }
+
+    if (stream->soft_start_cnt) {
+        if (stream->soft_start_cnt == PJMEDIA_STREAM_SOFT_START) {
+            PJ_LOG(4,(stream->port.info.name.ptr,
+                      "Resetting jitter buffer in stream playback start"));
+            pj_mutex_lock( stream->jb_mutex );
+            pjmedia_jbuf_reset(stream->jb);
+            pj_mutex_unlock( stream->jb_mutex );
+        }
+        --stream->soft_start_cnt;
+        frame->type = PJMEDIA_FRAME_TYPE_NONE;
+        return PJ_SUCCESS;
+    }
+
+    /* Frames are decoded by the decode pool, if the stream is
+     * attached to one.
+     */
+    if (stream->dec_worker) {
+        get_staged_frame(stream, frame);
+        return PJ_SUCCESS;
+    }
+
+    decode_frame(stream, frame);
 
     return PJ_SUCCESS;
 }
@@ -861,13 +1218,19 @@ static pj_status_t get_frame_ext( pjmedia_port *port, pjmedia_frame *frame)
         char frame_type;
         pj_size_t frame_size = channel->out_pkt_size;
         pj_uint32_t bit_info;
+        int frame_seq;
 
         /* Lock jitter buffer mutex first */
         pj_mutex_lock( stream->jb_mutex );
 
         /* Get frame from jitter buffer. */
-        pjmedia_jbuf_get_frame2(stream->jb, channel->out_pkt, &frame_size,
-                                &frame_type, &bit_info);
+        pjmedia_jbuf_get_frame3(stream->jb, channel->out_pkt, &frame_size,
+                                &frame_type, &bit_info, NULL, &frame_seq);
+
+#if PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+        if (frame_type == PJMEDIA_JB_NORMAL_FRAME)
+            lat_jbuf_frame(stream, frame_seq);
+#endif
 
 #if TRACE_JB
         trace_jb_get(stream, frame_type, frame_size);
@@ -1347,6 +1710,29 @@ static void rebuffer(pjmedia_stream *stream,
 }
 
 
+/* Encode a frame. The codec is shared with the decode worker once the
+ * stream is attached to a decode pool.
+ */
+static pj_status_t encode_frame( pjmedia_stream *stream,
+                                 const struct pjmedia_frame *input,
+                                 unsigned out_size,
+                                 struct pjmedia_frame *output)
+{
+    pj_mutex_t *codec_mutex = stream->codec_mutex;
+    pj_status_t status;
+
+    if (codec_mutex)
+        pj_mutex_lock(codec_mutex);
+
+    status = pjmedia_codec_encode(stream->codec, input, out_size, output);
+
+    if (codec_mutex)
+        pj_mutex_unlock(codec_mutex);
+
+    return status;
+}
+
+
 /**
  * put_frame_imp()
  */
@@ -1357,6 +1743,7 @@ static pj_status_t put_frame_imp( pjmedia_port *port,
     pjmedia_channel *channel = stream->enc;
     pj_status_t status = 0;
     pjmedia_frame frame_out;
+    pjmedia_transport_tx_buf tx_buf;
     unsigned ts_len, rtp_ts_len;
     void *rtphdr;
     int rtphdrlen;
@@ -1497,10 +1884,10 @@ static pj_status_t put_frame_imp( pjmedia_port *port,
         silence_frame.timestamp.u32.lo = pj_ntohl(stream->enc->rtp.out_hdr.ts);
 
         /* Encode! */
-        status = pjmedia_codec_encode( stream->codec, &silence_frame,
-                                       channel->out_pkt_size -
-                                       sizeof(pjmedia_rtp_hdr),
-                                       &frame_out);
+        status = encode_frame( stream, &silence_frame,
+                               channel->out_pkt_size -
+                               sizeof(pjmedia_rtp_hdr),
+                               &frame_out);
         if (status != PJ_SUCCESS) {
             LOGERR_((stream->port.info.name.ptr, status,
                     "Codec encode() error"));
@@ -1520,10 +1907,10 @@ static pj_status_t put_frame_imp( pjmedia_port *port,
                (frame->type == PJMEDIA_FRAME_TYPE_EXTENDED))
     {
         /* Encode! */
-        status = pjmedia_codec_encode( stream->codec, frame,
-                                       channel->out_pkt_size -
-                                       sizeof(pjmedia_rtp_hdr),
-                                       &frame_out);
+        status = encode_frame( stream, frame,
+                               channel->out_pkt_size -
+                               sizeof(pjmedia_rtp_hdr),
+                               &frame_out);
         if (status != PJ_SUCCESS) {
             LOGERR_((stream->port.info.name.ptr, status,
                     "Codec encode() error"));
@@ -1595,10 +1982,15 @@ static pj_status_t put_frame_imp( pjmedia_port *port,
 
     stream->is_streaming = PJ_TRUE;
 
-    /* Send the RTP packet to the transport. */
-    status = pjmedia_transport_send_rtp(stream->transport, channel->out_pkt,
-                                        frame_out.size +
-                                            sizeof(pjmedia_rtp_hdr));
+    /* Send the RTP packet to the transport. The packet is rebuilt on
+     * every frame, so the transports may rewrite it in place.
+     */
+    tx_buf.buf = channel->out_pkt;
+    tx_buf.buf_size = channel->out_pkt_size + PJMEDIA_STREAM_TX_TAILROOM;
+    tx_buf.pkt = channel->out_pkt;
+    tx_buf.size = frame_out.size + sizeof(pjmedia_rtp_hdr);
+    tx_buf.flags = 0;
+    status = pjmedia_transport_send_rtp_buf(stream->transport, &tx_buf);
 
     if (status != PJ_SUCCESS) {
         if (stream->rtp_tx_err_cnt++ == 0) {
@@ -1904,6 +2296,11 @@ static void on_rx_rtp( pjmedia_tp_cb_param *param)
     pj_bool_t check_pt;
     pj_status_t status;
     pj_bool_t pkt_discarded = PJ_FALSE;
+#if PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+    pj_timestamp lat_t0;
+
+    pj_get_timestamp(&lat_t0);
+#endif
 
     /* Check for errors */
     if (bytes_read < 0) {
@@ -2250,7 +2647,20 @@ static void on_rx_rtp( pjmedia_tp_cb_param *param)
                                     frames[i].bit_info, ext_seq, &discarded);
             if (discarded)
                 pkt_discarded = PJ_TRUE;
+#if PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+            else
+                lat_rx_frame(stream, (int)ext_seq, &lat_t0);
+#endif
+        }
+
+#if PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+        if (count) {
+            pj_timestamp now;
+
+            pj_get_timestamp(&now);
+            lat_add(stream, PJMEDIA_STREAM_LAT_RX, &lat_t0, &now);
         }
+#endif
 
 #if TRACE_JB
         trace_jb_put(stream, hdr, payloadlen, count);
@@ -2415,7 +2825,9 @@ static pj_status_t create_channel( pj_pool_t *pool,
         return PJ_ENOTSUP;
     }
 
-    channel->out_pkt = pj_pool_alloc(pool, channel->out_pkt_size);
+    /* Tailroom lets the transports extend outgoing packets in place. */
+    channel->out_pkt = pj_pool_alloc(pool, channel->out_pkt_size +
+                                           PJMEDIA_STREAM_TX_TAILROOM);
     PJ_ASSERT_RETURN(channel->out_pkt != NULL, PJ_ENOMEM);
 
 
@@ -2676,6 +3088,14 @@ PJ_DEF(pj_status_t) pjmedia_stream_create( pjmedia_endpt *endpt,
         stream->port.get_frame = &get_frame_ext;
     }
 
+#if PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+    /* Time the port callbacks */
+    stream->lat_get_frame = stream->port.get_frame;
+    stream->lat_put_frame = stream->port.put_frame;
+    stream->port.get_frame = &lat_get_frame;
+    stream->port.put_frame = &lat_put_frame;
+#endif
+
     /* If encoder and decoder's ptime are asymmetric, then we need to
      * create buffer on the encoder side. This could happen for example
      * with iLBC
@@ -3141,6 +3561,15 @@ static void stream_on_destroy(void *arg)
         stream->jb_mutex = NULL;
     }
 
+    if (stream->codec_mutex) {
+        pj_mutex_destroy(stream->codec_mutex);
+        stream->codec_mutex = NULL;
+    }
+    if (stream->dec_mutex) {
+        pj_mutex_destroy(stream->dec_mutex);
+        stream->dec_mutex = NULL;
+    }
+
     /* Destroy jitter buffer */
     if (stream->jb)
         pjmedia_jbuf_destroy(stream->jb);
@@ -3168,6 +3597,9 @@ PJ_DEF(pj_status_t) pjmedia_stream_destroy( pjmedia_stream *stream )
 
     PJ_LOG(4,(stream->port.info.name.ptr, "Stream destroying"));
 
+    /* Stop decoding in the decode pool */
+    pjmedia_stream_set_dec_pool(stream, NULL);
+
     /* Send RTCP BYE (also SDES & XR) */
     if (stream->transport && !stream->rtcp_sdes_bye_disabled) {
 #if defined(PJMEDIA_HAS_RTCP_XR) && (PJMEDIA_HAS_RTCP_XR != 0)
@@ -3330,8 +3762,7 @@ PJ_DEF(pj_status_t) pjmedia_stream_get_stat( const pjmedia_stream *stream,
 {
     PJ_ASSERT_RETURN(stream && stat, PJ_EINVAL);
 
-    pj_memcpy(stat, &stream->rtcp.stat, sizeof(pjmedia_rtcp_stat));
-    return PJ_SUCCESS;
+    return pjmedia_rtcp_get_stat(&stream->rtcp, stat);
 }
 
 
@@ -3342,7 +3773,13 @@ PJ_DEF(pj_status_t) pjmedia_stream_reset_stat(pjmedia_stream *stream)
 {
     PJ_ASSERT_RETURN(stream, PJ_EINVAL);
 
-    pjmedia_rtcp_init_stat(&stream->rtcp.stat);
+    /* The mutex keeps concurrent resets apart */
+    pj_mutex_lock(stream->jb_mutex);
+    pjmedia_rtcp_reset_stat(&stream->rtcp);
+#if PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+    pj_bzero(&stream->lat, sizeof(stream->lat));
+#endif
+    pj_mutex_unlock(stream->jb_mutex);
 
     return PJ_SUCCESS;
 }
@@ -3375,6 +3812,77 @@ PJ_DEF(pj_status_t) pjmedia_stream_get_stat_jbuf(const pjmedia_stream *stream,
     return pjmedia_jbuf_get_state(stream->jb, state);
 }
 
+/*
+ * Get stream latency statistics.
+ */
+PJ_DEF(pj_status_t) pjmedia_stream_get_stat_lat(const pjmedia_stream *stream,
+                                                pjmedia_stream_lat_stat *stat)
+{
+    PJ_ASSERT_RETURN(stream && stat, PJ_EINVAL);
+
+#if PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+    pj_mutex_lock(stream->jb_mutex);
+    pj_memcpy(stat, &stream->lat, sizeof(pjmedia_stream_lat_stat));
+    pj_mutex_unlock(stream->jb_mutex);
+    return PJ_SUCCESS;
+#else
+    pj_bzero(stat, sizeof(pjmedia_stream_lat_stat));
+    return PJ_ENOTSUP;
+#endif
+}
+
+/*
+ * Get the lower bound of a latency histogram bucket.
+ */
+PJ_DEF(pj_uint32_t) pjmedia_stream_lat_bucket_usec(unsigned idx)
+{
+    unsigned msb;
+
+    PJ_ASSERT_RETURN(idx < PJMEDIA_STREAM_LAT_BUCKET_CNT, 0);
+
+    if (idx < 8)
+        return idx;
+
+    msb = idx / 4 + 1;
+    return (pj_uint32_t)(4 + (idx & 3)) << (msb - 2);
+}
+
+/*
+ * Estimate a latency percentile.
+ */
+PJ_DEF(pj_uint32_t)
+pjmedia_stream_lat_percentile(const pjmedia_stream_lat_hist *hist,
+                              unsigned pct)
+{
+    pj_uint64_t target, seen = 0;
+    pj_uint32_t usec;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(hist, 0);
+
+    if (hist->count == 0)
+        return 0;
+
+    if (pct > 100)
+        pct = 100;
+    target = ((pj_uint64_t)hist->count * pct + 99) / 100;
+    if (target == 0)
+        target = 1;
+
+    for (i = 0; i < PJMEDIA_STREAM_LAT_BUCKET_CNT - 1; ++i) {
+        seen += hist->bucket[i];
+        if (seen >= target)
+            break;
+    }
+
+    usec = pjmedia_stream_lat_bucket_usec(i);
+    if (usec < hist->min_usec)
+        usec = hist->min_usec;
+    if (usec > hist->max_usec)
+        usec = hist->max_usec;
+    return usec;
+}
+
 /*
  * Pause stream.
  */
@@ -3640,3 +4148,195 @@ pjmedia_stream_get_rtp_session_info(pjmedia_stream *stream,
     session_info->rtcp = &stream->rtcp;
     return PJ_SUCCESS;
 }
+
+
+/*
+ * Create decode worker pool.
+ */
+PJ_DEF(pj_status_t)
+pjmedia_stream_dec_pool_create(pj_pool_t *pool,
+                               unsigned worker_cnt,
+                               pjmedia_stream_dec_pool **p_dec_pool)
+{
+    pjmedia_stream_dec_pool *dec_pool;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && worker_cnt && p_dec_pool, PJ_EINVAL);
+
+    dec_pool = PJ_POOL_ZALLOC_T(pool, pjmedia_stream_dec_pool);
+    dec_pool->workers = (struct dec_worker*)
+                        pj_pool_calloc(pool, worker_cnt,
+                                       sizeof(struct dec_worker));
+
+    status = pj_mutex_create_simple(pool, "decpool", &dec_pool->mutex);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    for (i = 0; i < worker_cnt; ++i) {
+        struct dec_worker *w = &dec_pool->workers[i];
+
+        w->dec_pool = dec_pool;
+        pj_list_init(&w->queue);
+        status = pj_mutex_create_simple(pool, "decwork", &w->mutex);
+        if (status == PJ_SUCCESS) {
+            status = pj_sem_create(pool, "decwork", 0, PJ_MAXINT32,
+                                   &w->sem);
+        }
+        if (status == PJ_SUCCESS) {
+            status = pj_thread_create(pool, "decwork%p",
+                                      &dec_worker_thread, w, 0, 0,
+                                      &w->thread);
+        }
+        if (status != PJ_SUCCESS) {
+            if (w->sem)
+                pj_sem_destroy(w->sem);
+            if (w->mutex)
+                pj_mutex_destroy(w->mutex);
+            pjmedia_stream_dec_pool_destroy(dec_pool);
+            return status;
+        }
+        ++dec_pool->worker_cnt;
+    }
+
+    PJ_LOG(4,(THIS_FILE, "Stream decode pool created with %d workers",
+              dec_pool->worker_cnt));
+
+    *p_dec_pool = dec_pool;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Destroy decode worker pool.
+ */
+PJ_DEF(pj_status_t)
+pjmedia_stream_dec_pool_destroy(pjmedia_stream_dec_pool *dec_pool)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(dec_pool, PJ_EINVAL);
+
+    dec_pool->quit = PJ_TRUE;
+    for (i = 0; i < dec_pool->worker_cnt; ++i) {
+        struct dec_worker *w = &dec_pool->workers[i];
+
+        pj_assert(w->stream_cnt == 0);
+
+        pj_sem_post(w->sem);
+        pj_thread_join(w->thread);
+        pj_thread_destroy(w->thread);
+        pj_sem_destroy(w->sem);
+        pj_mutex_destroy(w->mutex);
+    }
+    dec_pool->worker_cnt = 0;
+
+    if (dec_pool->mutex) {
+        pj_mutex_destroy(dec_pool->mutex);
+        dec_pool->mutex = NULL;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Attach the stream to, or detach it from, a decode pool.
+ */
+PJ_DEF(pj_status_t)
+pjmedia_stream_set_dec_pool(pjmedia_stream *stream,
+                            pjmedia_stream_dec_pool *dec_pool)
+{
+    struct dec_worker *w;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(stream, PJ_EINVAL);
+
+    if (dec_pool && stream->port.info.fmt.id != PJMEDIA_FORMAT_L16)
+        return PJ_ENOTSUP;
+
+    /* Detach from the current worker, discarding the staged frames. Once
+     * dec_worker is cleared under the staging mutex, get_staged_frame()
+     * no longer queues the stream to the worker.
+     */
+    if (stream->dec_mutex) {
+        pj_mutex_lock(stream->dec_mutex);
+        w = stream->dec_worker;
+        stream->dec_worker = NULL;
+        stream->dec_staged_head = stream->dec_staged_cnt = 0;
+        stream->dec_due = 0;
+        pj_mutex_unlock(stream->dec_mutex);
+
+        if (w) {
+            /* Wait until the worker is done with the stream */
+            pj_mutex_lock(w->mutex);
+            if (stream->dec_node.queued) {
+                pj_list_erase(&stream->dec_node);
+                stream->dec_node.queued = PJ_FALSE;
+            }
+            while (w->busy == stream) {
+                pj_mutex_unlock(w->mutex);
+                pj_thread_sleep(0);
+                pj_mutex_lock(w->mutex);
+            }
+            pj_mutex_unlock(w->mutex);
+
+            pj_mutex_lock(w->dec_pool->mutex);
+            --w->stream_cnt;
+            pj_mutex_unlock(w->dec_pool->mutex);
+
+            PJ_LOG(4,(stream->port.info.name.ptr,
+                      "Stream detached from decode pool (%d underruns)",
+                      stream->dec_underrun));
+        }
+    }
+
+    if (!dec_pool)
+        return PJ_SUCCESS;
+
+    if (!stream->dec_mutex) {
+        unsigned size = PJMEDIA_PIA_SPF(&stream->port.info) *
+                        BYTES_PER_SAMPLE;
+
+        status = pj_mutex_create_simple(stream->own_pool, "deccodec",
+                                        &stream->codec_mutex);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        status = pj_mutex_create_simple(stream->own_pool, "decstage",
+                                        &stream->dec_mutex);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        stream->dec_node.stream = stream;
+        stream->dec_staged = (pjmedia_frame*)
+                             pj_pool_calloc(stream->own_pool,
+                                            PJMEDIA_STREAM_DEC_AHEAD,
+                                            sizeof(pjmedia_frame));
+        for (i = 0; i < PJMEDIA_STREAM_DEC_AHEAD; ++i)
+            stream->dec_staged[i].buf = pj_pool_alloc(stream->own_pool,
+                                                      size);
+    }
+
+    /* Pin the stream to the least loaded worker */
+    pj_mutex_lock(dec_pool->mutex);
+    w = &dec_pool->workers[0];
+    for (i = 1; i < dec_pool->worker_cnt; ++i) {
+        if (dec_pool->workers[i].stream_cnt < w->stream_cnt)
+            w = &dec_pool->workers[i];
+    }
+    ++w->stream_cnt;
+    pj_mutex_unlock(dec_pool->mutex);
+
+    pj_mutex_lock(stream->dec_mutex);
+    stream->dec_underrun = 0;
+    stream->dec_worker = w;
+    pj_mutex_unlock(stream->dec_mutex);
+
+    PJ_LOG(4,(stream->port.info.name.ptr,
+              "Stream attached to decode worker %d",
+              (int)(w - dec_pool->workers)));
+
+    return PJ_SUCCESS;
+}
@@ -24,6 +24,7 @@
 #include <pj/array.h>
 #include <pj/assert.h>
 #include <pj/ctype.h>
+#include <pj/list.h>
 #include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/os.h>
@@ -251,6 +252,52 @@ typedef struct srtp_context
     srtp_t               srtp_rx_ctx;
 } srtp_context;
 
+/* An outgoing RTP packet queued for a crypto worker. */
+struct tx_pkt
+{
+    int                  len;               /**< Packet length.             */
+    char                 buf[MAX_RTP_BUFFER_LEN];   /**< Packet.            */
+};
+
+/* Node of an SRTP transport in the queue of its crypto worker. */
+struct tx_node
+{
+    PJ_DECL_LIST_MEMBER(struct tx_node);
+    struct transport_srtp   *srtp;          /**< The transport.             */
+    pj_bool_t                queued;        /**< In the worker queue?       */
+};
+
+/*
+ * Crypto worker thread. Transports are pinned to one worker, so their
+ * packets are protected and sent in order.
+ */
+struct tx_worker
+{
+    pjmedia_srtp_tx_pool    *tx_pool;       /**< The owning pool.           */
+    pj_thread_t             *thread;        /**< The thread.                */
+    pj_sem_t                *sem;           /**< Signalled on new work.     */
+    pj_mutex_t              *mutex;         /**< Protects queue, busy and
+                                                 done_wait.                 */
+    struct tx_node           queue;         /**< Transports with packets.   */
+    struct transport_srtp   *busy;          /**< Transport being served.    */
+    pj_sem_t                *done_sem;      /**< Signalled when done with
+                                                 busy.                      */
+    unsigned                 done_wait;     /**< Threads waiting for it.    */
+    unsigned                 srtp_cnt;      /**< Transports pinned to
+                                                 worker.                    */
+};
+
+/*
+ * Crypto worker pool.
+ */
+struct pjmedia_srtp_tx_pool
+{
+    pj_bool_t                quit;          /**< Stop the workers.          */
+    unsigned                 worker_cnt;    /**< Number of workers.         */
+    pj_mutex_t              *mutex;         /**< Protects assignment.       */
+    struct tx_worker        *workers;       /**< The workers.               */
+};
+
 /* SRTP transport */
 typedef struct transport_srtp
 {
@@ -328,6 +375,20 @@ typedef struct transport_srtp
 
     pj_uint32_t          tx_ssrc;
 
+    /* Protection on a crypto worker, the queue is protected by tx_mutex */
+    pj_mutex_t          *tx_mutex;          /**< Queue mutex.               */
+    struct tx_worker    *tx_worker;         /**< Pinned worker, or NULL if
+                                                 detached.                  */
+    pj_bool_t            tx_detaching;      /**< Being detached from it.    */
+    struct tx_node       tx_node;           /**< Worker queue node.         */
+    struct tx_pkt       *tx_queue;          /**< Ring of queued packets.    */
+    unsigned             tx_head;           /**< Oldest packet.             */
+    unsigned             tx_cnt;            /**< Packets in ring.           */
+    unsigned             tx_pass;           /**< Protect passes done.       */
+    unsigned             tx_pass_pkt;       /**< Packets sent by passes.    */
+    unsigned             tx_drop;           /**< Packets dropped on full
+                                                 ring.                      */
+
 } transport_srtp;
 
 
@@ -363,6 +424,8 @@ static void        transport_detach   (pjmedia_transport *tp,
 static pj_status_t transport_send_rtp( pjmedia_transport *tp,
                                        const void *pkt,
                                        pj_size_t size);
+static pj_status_t transport_send_rtp_buf(pjmedia_transport *tp,
+                                          pjmedia_transport_tx_buf *tx_buf);
 static pj_status_t transport_send_rtcp(pjmedia_transport *tp,
                                        const void *pkt,
                                        pj_size_t size);
@@ -410,7 +473,8 @@ static pjmedia_transport_op transport_srtp_op =
     &transport_media_stop,
     &transport_simulate_lost,
     &transport_destroy,
-    &transport_attach2
+    &transport_attach2,
+    &transport_send_rtp_buf
 };
 
 /* Get crypto index from crypto name */
@@ -1356,28 +1420,16 @@ static void transport_detach(pjmedia_transport *tp, void *strm)
     srtp->member_tp_attached = PJ_FALSE;
 }
 
-static pj_status_t transport_send_rtp( pjmedia_transport *tp,
-                                       const void *pkt,
-                                       pj_size_t size)
+/* Protect RTP packet in place, the buffer must have MAX_TRAILER_LEN
+ * bytes of tailroom. The caller must hold the mutex.
+ */
+static pj_status_t protect_rtp_locked(transport_srtp *srtp, void *pkt,
+                                      int *len)
 {
-    pj_status_t status;
-    transport_srtp *srtp = (transport_srtp*) tp;
-    int len = (int)size;
     srtp_err_status_t err;
 
-    if (srtp->bypass_srtp)
-        return pjmedia_transport_send_rtp(srtp->member_tp, pkt, size);
-
-    if (size > sizeof(srtp->rtp_tx_buffer) - MAX_TRAILER_LEN)
-        return PJ_ETOOBIG;
-
-    pj_memcpy(srtp->rtp_tx_buffer, pkt, size);
-
-    pj_lock_acquire(srtp->mutex);
-    if (!srtp->session_inited) {
-        pj_lock_release(srtp->mutex);
+    if (!srtp->session_inited)
         return PJMEDIA_SRTP_EKEYNOTREADY;
-    }
 
     /* Save outgoing SSRC */
     srtp->tx_ssrc = ntohl(((pjmedia_rtp_hdr*)pkt)->ssrc);
@@ -1396,17 +1448,263 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
     }
 #endif
 
-    err = srtp_protect(srtp->srtp_ctx.srtp_tx_ctx, srtp->rtp_tx_buffer, &len);
+    err = srtp_protect(srtp->srtp_ctx.srtp_tx_ctx, pkt, len);
+
+    return (err == srtp_err_status_ok)? PJ_SUCCESS :
+                                         PJMEDIA_ERRNO_FROM_LIBSRTP(err);
+}
+
+/* Protect RTP packet in place, see protect_rtp_locked(). */
+static pj_status_t protect_rtp(transport_srtp *srtp, void *pkt, int *len)
+{
+    pj_status_t status;
+
+    pj_lock_acquire(srtp->mutex);
+    status = protect_rtp_locked(srtp, pkt, len);
     pj_lock_release(srtp->mutex);
 
-    if (err == srtp_err_status_ok) {
-        status = pjmedia_transport_send_rtp(srtp->member_tp,
-                                            srtp->rtp_tx_buffer, len);
-    } else {
-        status = PJMEDIA_ERRNO_FROM_LIBSRTP(err);
+    return status;
+}
+
+
+/* Queue the transport to its crypto worker, if it is not queued already. */
+static void tx_schedule(transport_srtp *srtp, struct tx_worker *w)
+{
+    pj_bool_t post = PJ_FALSE;
+
+    pj_mutex_lock(w->mutex);
+    if (!srtp->tx_node.queued) {
+        pj_list_push_back(&w->queue, &srtp->tx_node);
+        srtp->tx_node.queued = PJ_TRUE;
+        post = PJ_TRUE;
     }
+    pj_mutex_unlock(w->mutex);
 
-    return status;
+    if (post)
+        pj_sem_post(w->sem);
+}
+
+
+/* Queue an outgoing RTP packet for the crypto worker. Returns PJ_EIGNORED
+ * if the transport is not attached to a crypto pool (anymore), in which
+ * case the caller protects and sends the packet itself.
+ */
+static pj_status_t tx_queue_rtp(transport_srtp *srtp, const void *pkt,
+                                pj_size_t size)
+{
+    struct tx_worker *w;
+    struct tx_pkt *p;
+
+    if (size > sizeof(p->buf) - MAX_TRAILER_LEN)
+        return PJ_ETOOBIG;
+
+    pj_mutex_lock(srtp->tx_mutex);
+
+    w = srtp->tx_worker;
+    if (!w) {
+        pj_mutex_unlock(srtp->tx_mutex);
+        return PJ_EIGNORED;
+    }
+
+    if (srtp->tx_cnt == PJMEDIA_SRTP_TX_QUEUE_LEN) {
+        /* The worker is lagging behind */
+        ++srtp->tx_drop;
+        pj_mutex_unlock(srtp->tx_mutex);
+        return PJ_ETOOMANY;
+    }
+
+    p = &srtp->tx_queue[(srtp->tx_head + srtp->tx_cnt) %
+                        PJMEDIA_SRTP_TX_QUEUE_LEN];
+    pj_memcpy(p->buf, pkt, size);
+    p->len = (int)size;
+    ++srtp->tx_cnt;
+
+    /* Queue the transport while still holding the queue mutex, so that
+     * pjmedia_transport_srtp_set_tx_pool() can not detach it in between
+     * and have it queued again afterwards, possibly after the transport
+     * is destroyed. The lock order is the queue mutex, then the worker
+     * mutex. While being detached, the packet is left for the detach to
+     * discard.
+     */
+    if (!srtp->tx_detaching)
+        tx_schedule(srtp, w);
+
+    pj_mutex_unlock(srtp->tx_mutex);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Protect and send the packets queued on the transport, until the queue
+ * is empty or the transport is being detached.
+ */
+static void tx_flush(transport_srtp *srtp, struct tx_worker *w)
+{
+    for (;;) {
+        unsigned head, cnt, last, i;
+
+        pj_mutex_lock(srtp->tx_mutex);
+        if (srtp->tx_worker != w || srtp->tx_detaching ||
+            srtp->tx_cnt == 0)
+        {
+            pj_mutex_unlock(srtp->tx_mutex);
+            break;
+        }
+        head = srtp->tx_head;
+        cnt = srtp->tx_cnt;
+        pj_mutex_unlock(srtp->tx_mutex);
+
+        /* The queued slots are not touched by the senders until they are
+         * released below, so they can be used without the queue mutex.
+         * Protect all of them with one acquisition of the contexts.
+         */
+        last = cnt;
+        pj_lock_acquire(srtp->mutex);
+        for (i = 0; i < cnt; ++i) {
+            struct tx_pkt *p = &srtp->tx_queue[(head + i) %
+                                               PJMEDIA_SRTP_TX_QUEUE_LEN];
+
+            if (protect_rtp_locked(srtp, p->buf, &p->len) == PJ_SUCCESS)
+                last = i;
+            else
+                p->len = 0;
+        }
+        pj_lock_release(srtp->mutex);
+
+        /* Send them, all but the last one flagged so that the member
+         * transport may send them in one batch.
+         */
+        for (i = 0; last != cnt && i <= last; ++i) {
+            struct tx_pkt *p = &srtp->tx_queue[(head + i) %
+                                               PJMEDIA_SRTP_TX_QUEUE_LEN];
+            pjmedia_transport_tx_buf tx_buf;
+
+            if (p->len == 0)
+                continue;
+
+            tx_buf.buf = tx_buf.pkt = p->buf;
+            tx_buf.buf_size = sizeof(p->buf);
+            tx_buf.size = p->len;
+            tx_buf.flags = (i < last)? PJMEDIA_TRANSPORT_TX_MORE : 0;
+            pjmedia_transport_send_rtp_buf(srtp->member_tp, &tx_buf);
+            ++srtp->tx_pass_pkt;
+        }
+
+        pj_mutex_lock(srtp->tx_mutex);
+        if (srtp->tx_worker == w) {
+            srtp->tx_head = (srtp->tx_head + cnt) % PJMEDIA_SRTP_TX_QUEUE_LEN;
+            srtp->tx_cnt -= cnt;
+            ++srtp->tx_pass;
+        }
+        pj_mutex_unlock(srtp->tx_mutex);
+    }
+}
+
+
+/*
+ * Crypto worker thread.
+ */
+static int tx_worker_thread(void *arg)
+{
+    struct tx_worker *w = (struct tx_worker*) arg;
+
+    for (;;) {
+        struct tx_node *node;
+        unsigned done_wait;
+
+        pj_sem_wait(w->sem);
+        if (w->tx_pool->quit)
+            break;
+
+        pj_mutex_lock(w->mutex);
+        if (pj_list_empty(&w->queue)) {
+            pj_mutex_unlock(w->mutex);
+            continue;
+        }
+        node = w->queue.next;
+        pj_list_erase(node);
+        node->queued = PJ_FALSE;
+        w->busy = node->srtp;
+        pj_mutex_unlock(w->mutex);
+
+        tx_flush(node->srtp, w);
+
+        /* Wake up the threads detaching the transport */
+        pj_mutex_lock(w->mutex);
+        w->busy = NULL;
+        done_wait = w->done_wait;
+        w->done_wait = 0;
+        pj_mutex_unlock(w->mutex);
+
+        while (done_wait--)
+            pj_sem_post(w->done_sem);
+    }
+
+    return 0;
+}
+
+static pj_status_t transport_send_rtp( pjmedia_transport *tp,
+                                       const void *pkt,
+                                       pj_size_t size)
+{
+    pj_status_t status;
+    transport_srtp *srtp = (transport_srtp*) tp;
+    int len = (int)size;
+
+    if (srtp->bypass_srtp)
+        return pjmedia_transport_send_rtp(srtp->member_tp, pkt, size);
+
+    /* Protect and send on the crypto worker, if attached to one. This is
+     * decided under the queue mutex, so a packet is never protected here
+     * while the worker is still protecting the queued ones, see
+     * pjmedia_transport_srtp_set_tx_pool().
+     */
+    if (srtp->tx_mutex) {
+        status = tx_queue_rtp(srtp, pkt, size);
+        if (status != PJ_EIGNORED)
+            return status;
+    }
+
+    if (size > sizeof(srtp->rtp_tx_buffer) - MAX_TRAILER_LEN)
+        return PJ_ETOOBIG;
+
+    pj_memcpy(srtp->rtp_tx_buffer, pkt, size);
+
+    status = protect_rtp(srtp, srtp->rtp_tx_buffer, &len);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    return pjmedia_transport_send_rtp(srtp->member_tp,
+                                      srtp->rtp_tx_buffer, len);
+}
+
+static pj_status_t transport_send_rtp_buf(pjmedia_transport *tp,
+                                          pjmedia_transport_tx_buf *tx_buf)
+{
+    pj_status_t status;
+    transport_srtp *srtp = (transport_srtp*) tp;
+    int len = (int)tx_buf->size;
+
+    if (srtp->bypass_srtp)
+        return pjmedia_transport_send_rtp_buf(srtp->member_tp, tx_buf);
+
+    /* Protect and send on the crypto worker, if attached to one */
+    if (srtp->tx_mutex) {
+        status = tx_queue_rtp(srtp, tx_buf->pkt, tx_buf->size);
+        if (status != PJ_EIGNORED)
+            return status;
+    }
+
+    /* Not enough room for the auth tag, encrypt a copy. */
+    if (pjmedia_transport_tx_buf_tailroom(tx_buf) < MAX_TRAILER_LEN)
+        return transport_send_rtp(tp, tx_buf->pkt, tx_buf->size);
+
+    status = protect_rtp(srtp, tx_buf->pkt, &len);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    tx_buf->size = len;
+    return pjmedia_transport_send_rtp_buf(srtp->member_tp, tx_buf);
 }
 
 static pj_status_t transport_send_rtcp(pjmedia_transport *tp,
@@ -1478,6 +1776,8 @@ static void srtp_on_destroy(void *arg)
 
     PJ_LOG(4, (srtp->pool->obj_name, "SRTP transport destroyed"));
 
+    if (srtp->tx_mutex)
+        pj_mutex_destroy(srtp->tx_mutex);
     pj_lock_destroy(srtp->mutex);
     pj_pool_safe_release(&srtp->pool);
 }
@@ -1493,6 +1793,9 @@ static pj_status_t transport_destroy  (pjmedia_transport *tp)
 
     PJ_LOG(4, (srtp->pool->obj_name, "Destroying SRTP transport"));
 
+    /* Stop protecting on the crypto worker */
+    pjmedia_transport_srtp_set_tx_pool(tp, NULL);
+
     /* Close all keying. Note that any keying should not be destroyed before
      * SRTP transport is destroyed as re-INVITE may initiate new keying method
      * without destroying SRTP transport.
@@ -2124,4 +2427,198 @@ PJ_DEF(pj_status_t) pjmedia_transport_srtp_decrypt_pkt(pjmedia_transport *tp,
                                        PJMEDIA_ERRNO_FROM_LIBSRTP(err);
 }
 
+
+/*
+ * Create crypto worker pool.
+ */
+PJ_DEF(pj_status_t) pjmedia_srtp_tx_pool_create(pj_pool_t *pool,
+                                                unsigned worker_cnt,
+                                                pjmedia_srtp_tx_pool **p_pool)
+{
+    pjmedia_srtp_tx_pool *tx_pool;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && worker_cnt && p_pool, PJ_EINVAL);
+
+    tx_pool = PJ_POOL_ZALLOC_T(pool, pjmedia_srtp_tx_pool);
+    tx_pool->workers = (struct tx_worker*)
+                       pj_pool_calloc(pool, worker_cnt,
+                                      sizeof(struct tx_worker));
+
+    status = pj_mutex_create_simple(pool, "srtptxpool", &tx_pool->mutex);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    for (i = 0; i < worker_cnt; ++i) {
+        struct tx_worker *w = &tx_pool->workers[i];
+
+        w->tx_pool = tx_pool;
+        pj_list_init(&w->queue);
+        status = pj_mutex_create_simple(pool, "srtptx", &w->mutex);
+        if (status == PJ_SUCCESS) {
+            status = pj_sem_create(pool, "srtptx", 0, PJ_MAXINT32,
+                                   &w->sem);
+        }
+        if (status == PJ_SUCCESS) {
+            status = pj_sem_create(pool, "srtptxdone", 0, PJ_MAXINT32,
+                                   &w->done_sem);
+        }
+        if (status == PJ_SUCCESS) {
+            status = pj_thread_create(pool, "srtptx%p",
+                                      &tx_worker_thread, w, 0, 0,
+                                      &w->thread);
+        }
+        if (status != PJ_SUCCESS) {
+            if (w->done_sem)
+                pj_sem_destroy(w->done_sem);
+            if (w->sem)
+                pj_sem_destroy(w->sem);
+            if (w->mutex)
+                pj_mutex_destroy(w->mutex);
+            pjmedia_srtp_tx_pool_destroy(tx_pool);
+            return status;
+        }
+        ++tx_pool->worker_cnt;
+    }
+
+    PJ_LOG(4,(THIS_FILE, "SRTP crypto pool created with %d workers",
+              tx_pool->worker_cnt));
+
+    *p_pool = tx_pool;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Destroy crypto worker pool.
+ */
+PJ_DEF(pj_status_t) pjmedia_srtp_tx_pool_destroy(
+                                            pjmedia_srtp_tx_pool *tx_pool)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(tx_pool, PJ_EINVAL);
+
+    tx_pool->quit = PJ_TRUE;
+    for (i = 0; i < tx_pool->worker_cnt; ++i) {
+        struct tx_worker *w = &tx_pool->workers[i];
+
+        pj_assert(w->srtp_cnt == 0);
+
+        pj_sem_post(w->sem);
+        pj_thread_join(w->thread);
+        pj_thread_destroy(w->thread);
+        pj_sem_destroy(w->sem);
+        pj_sem_destroy(w->done_sem);
+        pj_mutex_destroy(w->mutex);
+    }
+    tx_pool->worker_cnt = 0;
+
+    if (tx_pool->mutex) {
+        pj_mutex_destroy(tx_pool->mutex);
+        tx_pool->mutex = NULL;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Attach the SRTP transport to, or detach it from, a crypto worker pool.
+ */
+PJ_DEF(pj_status_t) pjmedia_transport_srtp_set_tx_pool(
+                                            pjmedia_transport *tp,
+                                            pjmedia_srtp_tx_pool *tx_pool)
+{
+    transport_srtp *srtp = (transport_srtp*) tp;
+    struct tx_worker *w;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(tp, PJ_EINVAL);
+
+    /* Detach from the current worker, discarding the queued packets.
+     * Once tx_detaching is set, tx_queue_rtp() no longer queues the
+     * transport to the worker, and the worker stops after its current
+     * pass. tx_worker is only cleared once that pass is over, so the
+     * senders, which check it under the queue mutex, do not protect and
+     * send directly while the worker is still at it.
+     */
+    if (srtp->tx_mutex) {
+        pj_mutex_lock(srtp->tx_mutex);
+        w = srtp->tx_worker;
+        srtp->tx_detaching = (w != NULL);
+        pj_mutex_unlock(srtp->tx_mutex);
+
+        if (w) {
+            /* Wait until the worker is done with the transport */
+            pj_mutex_lock(w->mutex);
+            if (srtp->tx_node.queued) {
+                pj_list_erase(&srtp->tx_node);
+                srtp->tx_node.queued = PJ_FALSE;
+            }
+            if (w->busy == srtp) {
+                ++w->done_wait;
+                pj_mutex_unlock(w->mutex);
+                pj_sem_wait(w->done_sem);
+            } else {
+                pj_mutex_unlock(w->mutex);
+            }
+
+            pj_mutex_lock(srtp->tx_mutex);
+            srtp->tx_worker = NULL;
+            srtp->tx_detaching = PJ_FALSE;
+            srtp->tx_head = srtp->tx_cnt = 0;
+            pj_mutex_unlock(srtp->tx_mutex);
+
+            pj_mutex_lock(w->tx_pool->mutex);
+            --w->srtp_cnt;
+            pj_mutex_unlock(w->tx_pool->mutex);
+
+            PJ_LOG(4,(srtp->pool->obj_name,
+                      "SRTP transport detached from crypto pool (%d packets "
+                      "in %d passes, %d dropped)",
+                      srtp->tx_pass_pkt, srtp->tx_pass, srtp->tx_drop));
+        }
+    }
+
+    if (!tx_pool)
+        return PJ_SUCCESS;
+
+    if (!srtp->tx_mutex) {
+        status = pj_mutex_create_simple(srtp->pool, "srtptxq",
+                                        &srtp->tx_mutex);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        srtp->tx_node.srtp = srtp;
+        srtp->tx_queue = (struct tx_pkt*)
+                         pj_pool_calloc(srtp->pool,
+                                        PJMEDIA_SRTP_TX_QUEUE_LEN,
+                                        sizeof(struct tx_pkt));
+    }
+
+    /* Pin the transport to the least loaded worker */
+    pj_mutex_lock(tx_pool->mutex);
+    w = &tx_pool->workers[0];
+    for (i = 1; i < tx_pool->worker_cnt; ++i) {
+        if (tx_pool->workers[i].srtp_cnt < w->srtp_cnt)
+            w = &tx_pool->workers[i];
+    }
+    ++w->srtp_cnt;
+    pj_mutex_unlock(tx_pool->mutex);
+
+    pj_mutex_lock(srtp->tx_mutex);
+    srtp->tx_pass = srtp->tx_pass_pkt = srtp->tx_drop = 0;
+    srtp->tx_worker = w;
+    pj_mutex_unlock(srtp->tx_mutex);
+
+    PJ_LOG(4,(srtp->pool->obj_name,
+              "SRTP transport attached to crypto worker %d",
+              (int)(w - tx_pool->workers)));
+
+    return PJ_SUCCESS;
+}
+
 #endif
@@ -80,6 +80,7 @@ struct transport_udp
     unsigned            tx_drop_pct;    /**< Percent of tx pkts to drop.    */
     unsigned            rx_drop_pct;    /**< Percent of rx pkts to drop.    */
     pj_ioqueue_t        *ioqueue;       /**< Ioqueue instance.              */
+    pjmedia_endpt       *endpt;         /**< Endpoint owning the ioqueue    */
 
     pj_sock_t           rtp_sock;       /**< RTP socket                     */
     pj_sockaddr         rtp_addr_name;  /**< Published RTP address.         */
@@ -87,9 +88,18 @@ struct transport_udp
     pj_ioqueue_op_key_t rtp_read_op;    /**< Pending read operation         */
     unsigned            rtp_write_op_id;/**< Next write_op to use           */
     pending_write       rtp_pending_write[MAX_PENDING];  /**< Pending write */
+    pj_sock_mmsg       *tx_batch;       /**< Batched RTP packets            */
+    char              (*tx_batch_buf)[PJMEDIA_MAX_MTU]; /**< Their copies   */
+    unsigned            tx_batch_cnt;   /**< Packets in the batch           */
+    pj_lock_t          *tx_lock;        /**< Protects tx_batch_cnt, stat    */
+    pjmedia_transport_udp_tx_batch_stat tx_batch_stat; /**< Batch stat     */
     pj_sockaddr         rtp_src_addr;   /**< Actual packet src addr.        */
     int                 rtp_addrlen;    /**< Address length.                */
     char                rtp_pkt[RTP_LEN];/**< Incoming RTP packet buffer    */
+    pj_sock_mmsg       *rx_batch;       /**< Batched read, NULL if disabled */
+    char              (*rx_batch_buf)[RTP_LEN]; /**< Their buffers         */
+    pj_sockaddr        *rx_batch_addr;  /**< Their source addresses        */
+    pjmedia_transport_udp_rx_batch_stat rx_batch_stat; /**< Batch stat     */
 
     pj_bool_t           enable_rtcp_mux;/**< Enable RTP & RTCP multiplexing?*/
     pj_bool_t           use_rtcp_mux;   /**< Use RTP & RTCP multiplexing?   */
@@ -141,6 +151,8 @@ static void        transport_detach   (pjmedia_transport *tp,
 static pj_status_t transport_send_rtp( pjmedia_transport *tp,
                                        const void *pkt,
                                        pj_size_t size);
+static pj_status_t transport_send_rtp_buf(pjmedia_transport *tp,
+                                          pjmedia_transport_tx_buf *tx_buf);
 static pj_status_t transport_send_rtcp(pjmedia_transport *tp,
                                        const void *pkt,
                                        pj_size_t size);
@@ -171,6 +183,7 @@ static pj_status_t transport_simulate_lost(pjmedia_transport *tp,
 static pj_status_t transport_destroy  (pjmedia_transport *tp);
 static pj_status_t transport_restart  (pj_bool_t is_rtp, 
                                        struct transport_udp *udp);
+static void reset_tx_batch(struct transport_udp *udp);
 
 static pjmedia_transport_op transport_udp_op = 
 {
@@ -186,7 +199,8 @@ static pjmedia_transport_op transport_udp_op =
     &transport_media_stop,
     &transport_simulate_lost,
     &transport_destroy,
-    &transport_attach2
+    &transport_attach2,
+    &transport_send_rtp_buf
 };
 
 static const pj_str_t STR_RTCP_MUX      = { "rtcp-mux", 8 };
@@ -306,9 +320,6 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
     /* Sanity check */
     PJ_ASSERT_RETURN(endpt && si && p_tp, PJ_EINVAL);
 
-    /* Get ioqueue instance */
-    ioqueue = pjmedia_endpt_get_ioqueue(endpt);
-
     if (name==NULL)
         name = "udp%p";
 
@@ -321,6 +332,41 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
     tp->pool = pool;
     tp->options = options;
     pj_memcpy(tp->base.name, pool->obj_name, PJ_MAX_OBJ_NAME);
+
+    /* Get ioqueue instance, the least loaded one if the endpoint is
+     * sharded. It is released when the transport is destroyed.
+     */
+    ioqueue = pjmedia_endpt_acquire_ioqueue(endpt);
+    tp->ioqueue = ioqueue;
+    tp->endpt = endpt;
+
+    /* The batch has one more entry for the packet which triggers the
+     * flush, which is sent from the caller's buffer.
+     */
+    if (options & PJMEDIA_UDP_TX_BATCH) {
+        tp->tx_batch = (pj_sock_mmsg*)
+                       pj_pool_calloc(pool,
+                                      PJMEDIA_TRANSPORT_UDP_TX_BATCH_MAX + 1,
+                                      sizeof(pj_sock_mmsg));
+        tp->tx_batch_buf = (char(*)[PJMEDIA_MAX_MTU])
+                           pj_pool_alloc(pool,
+                                         PJMEDIA_TRANSPORT_UDP_TX_BATCH_MAX *
+                                         PJMEDIA_MAX_MTU);
+    }
+    if (options & PJMEDIA_UDP_RX_BATCH) {
+        tp->rx_batch = (pj_sock_mmsg*)
+                       pj_pool_calloc(pool,
+                                      PJMEDIA_TRANSPORT_UDP_RX_BATCH_MAX,
+                                      sizeof(pj_sock_mmsg));
+        tp->rx_batch_buf = (char(*)[RTP_LEN])
+                           pj_pool_alloc(pool,
+                                         PJMEDIA_TRANSPORT_UDP_RX_BATCH_MAX *
+                                         RTP_LEN);
+        tp->rx_batch_addr = (pj_sockaddr*)
+                            pj_pool_calloc(pool,
+                                           PJMEDIA_TRANSPORT_UDP_RX_BATCH_MAX,
+                                           sizeof(pj_sockaddr));
+    }
     tp->base.op = &transport_udp_op;
     tp->base.type = PJMEDIA_TRANSPORT_TYPE_UDP;
 
@@ -359,6 +405,16 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
     pj_grp_lock_add_handler(grp_lock, pool, tp, &transport_on_destroy);
     tp->base.grp_lock = grp_lock;
 
+    /* The batch has its own lock, which is never held over a syscall, so
+     * that the send path does not contend with the RX callbacks running
+     * under the group lock.
+     */
+    if (tp->tx_batch) {
+        status = pj_lock_create_simple_mutex(pool, "udptx", &tp->tx_lock);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+    }
+
     /* Setup RTP socket with the ioqueue */
     pj_bzero(&rtp_cb, sizeof(rtp_cb));
     rtp_cb.on_read_complete = &on_rx_rtp;
@@ -425,8 +481,6 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
         goto on_error;
 #endif  
 
-    tp->ioqueue = ioqueue;
-
     /* Done */
     *p_tp = &tp->base;
     return PJ_SUCCESS;
@@ -438,11 +492,52 @@ on_error:
 }
 
 
+/**
+ * Get the statistics of the batched RTP transmission.
+ */
+PJ_DEF(pj_status_t) pjmedia_transport_udp_get_tx_batch_stat(
+                                pjmedia_transport *tp,
+                                pjmedia_transport_udp_tx_batch_stat *stat)
+{
+    struct transport_udp *udp = (struct transport_udp*) tp;
+
+    PJ_ASSERT_RETURN(tp && stat, PJ_EINVAL);
+    PJ_ASSERT_RETURN(tp->type == PJMEDIA_TRANSPORT_TYPE_UDP, PJ_EINVAL);
+
+    if (udp->tx_lock)
+        pj_lock_acquire(udp->tx_lock);
+    pj_memcpy(stat, &udp->tx_batch_stat, sizeof(*stat));
+    if (udp->tx_lock)
+        pj_lock_release(udp->tx_lock);
+    return PJ_SUCCESS;
+}
+
+/**
+ * Get the statistics of the batched RTP reception.
+ */
+PJ_DEF(pj_status_t) pjmedia_transport_udp_get_rx_batch_stat(
+                                pjmedia_transport *tp,
+                                pjmedia_transport_udp_rx_batch_stat *stat)
+{
+    struct transport_udp *udp = (struct transport_udp*) tp;
+
+    PJ_ASSERT_RETURN(tp && stat, PJ_EINVAL);
+    PJ_ASSERT_RETURN(tp->type == PJMEDIA_TRANSPORT_TYPE_UDP, PJ_EINVAL);
+
+    pj_memcpy(stat, &udp->rx_batch_stat, sizeof(*stat));
+    return PJ_SUCCESS;
+}
+
+
 static void transport_on_destroy(void *arg)
 {
     struct transport_udp *udp = (struct transport_udp*) arg;
 
     PJ_LOG(4, (udp->base.name, "UDP media transport destroyed"));
+    if (udp->tx_lock) {
+        pj_lock_destroy(udp->tx_lock);
+        udp->tx_lock = NULL;
+    }
     pj_pool_safe_release(&udp->pool);
 }
 
@@ -462,6 +557,27 @@ static pj_status_t transport_destroy(pjmedia_transport *tp)
 
     PJ_LOG(4,(udp->base.name, "UDP media transport destroying"));
 
+    if (udp->tx_batch_stat.batch_cnt) {
+        const pjmedia_transport_udp_tx_batch_stat *stat = &udp->tx_batch_stat;
+
+        PJ_LOG(4,(udp->base.name, "TX batch: %u batches, %u packets "
+                  "(avg %u.%u, max %u), %u syscalls, %u queued",
+                  stat->batch_cnt, stat->pkt_cnt,
+                  stat->pkt_cnt / stat->batch_cnt,
+                  (stat->pkt_cnt * 10 / stat->batch_cnt) % 10,
+                  stat->max_size, stat->syscall_cnt, stat->queued_cnt));
+    }
+    if (udp->rx_batch_stat.batch_cnt) {
+        const pjmedia_transport_udp_rx_batch_stat *stat = &udp->rx_batch_stat;
+
+        PJ_LOG(4,(udp->base.name, "RX batch: %u batches, %u packets "
+                  "(avg %u.%u, max %u)",
+                  stat->batch_cnt, stat->pkt_cnt,
+                  stat->pkt_cnt / stat->batch_cnt,
+                  (stat->pkt_cnt * 10 / stat->batch_cnt) % 10,
+                  stat->max_size));
+    }
+
     /* The following calls to pj_ioqueue_unregister() will block the execution
      * if callback is still being called because allow_concurrent is false.
      * So it is safe to release the pool immediately after.
@@ -485,14 +601,19 @@ static pj_status_t transport_destroy(pjmedia_transport *tp)
         udp->rtcp_sock = PJ_INVALID_SOCKET;
     }
 
+    if (udp->endpt) {
+        pjmedia_endpt_release_ioqueue(udp->endpt, udp->ioqueue);
+        udp->endpt = NULL;
+    }
+
     pj_grp_lock_dec_ref(tp->grp_lock);
 
     return PJ_SUCCESS;
 }
 
 /* Call RTP cb. */
-static void call_rtp_cb(struct transport_udp *udp, pj_ssize_t bytes_read, 
-                        pj_bool_t *rem_switch)
+static void call_rtp_cb(struct transport_udp *udp, void *pkt,
+                        pj_ssize_t bytes_read, pj_bool_t *rem_switch)
 {
     void (*cb)(void*,void*,pj_ssize_t);
     void (*cb2)(pjmedia_tp_cb_param*);
@@ -506,7 +627,7 @@ static void call_rtp_cb(struct transport_udp *udp, pj_ssize_t bytes_read,
         pjmedia_tp_cb_param param;
 
         param.user_data = user_data;
-        param.pkt = udp->rtp_pkt;
+        param.pkt = pkt;
         param.size = bytes_read;
         param.src_addr = &udp->rtp_src_addr;
         param.rem_switch = PJ_FALSE;
@@ -514,7 +635,7 @@ static void call_rtp_cb(struct transport_udp *udp, pj_ssize_t bytes_read,
         if (rem_switch)
             *rem_switch = param.rem_switch;
     } else if (cb) {
-        (*cb)(user_data, udp->rtp_pkt, bytes_read);
+        (*cb)(user_data, pkt, bytes_read);
     }
 }
 
@@ -531,6 +652,118 @@ static void call_rtcp_cb(struct transport_udp *udp, pj_ssize_t bytes_read)
         (*cb)(user_data, udp->rtcp_pkt, bytes_read);
 }
 
+/* Post the next RTP read, batched when enabled and supported. On
+ * immediate completion, bytes_read is set like in on_rx_rtp().
+ */
+static pj_status_t start_rtp_read(struct transport_udp *udp,
+                                  pj_uint32_t flags,
+                                  pj_ssize_t *bytes_read)
+{
+    if (udp->rx_batch) {
+        unsigned i, count = PJMEDIA_TRANSPORT_UDP_RX_BATCH_MAX;
+        pj_status_t status;
+
+        for (i = 0; i < count; ++i) {
+            udp->rx_batch[i].buf = udp->rx_batch_buf[i];
+            udp->rx_batch[i].len = RTP_LEN;
+            udp->rx_batch[i].addr = &udp->rx_batch_addr[i];
+            udp->rx_batch[i].addr_len = sizeof(pj_sockaddr);
+        }
+
+        status = pj_ioqueue_recvmmsg(udp->rtp_key, &udp->rtp_read_op,
+                                     udp->rx_batch, &count, flags);
+        if (status != PJ_ENOTSUP) {
+            *bytes_read = count;
+            return status;
+        }
+
+        /* The ioqueue can't read in batches, read one packet at a time */
+        PJ_LOG(4,(udp->base.name, "Batched RTP reading is not supported "
+                  "by %s ioqueue", pj_ioqueue_name()));
+        udp->rx_batch = NULL;
+    }
+
+    *bytes_read = sizeof(udp->rtp_pkt);
+    udp->rtp_addrlen = sizeof(udp->rtp_src_addr);
+    return pj_ioqueue_recvfrom(udp->rtp_key, &udp->rtp_read_op,
+                               udp->rtp_pkt, bytes_read, flags,
+                               &udp->rtp_src_addr, &udp->rtp_addrlen);
+}
+
+/* Deliver one received RTP packet, or a read error, to the attached
+ * stream. Returns PJ_FALSE if the transport was stopped or destroyed
+ * by the callback.
+ */
+static pj_bool_t deliver_rtp(struct transport_udp *udp, void *pkt,
+                             pj_ssize_t bytes_read)
+{
+    pj_bool_t discard = PJ_FALSE;
+    pj_bool_t rem_switch = PJ_FALSE;
+
+    /* Simulate packet lost on RX direction */
+    if (udp->rx_drop_pct) {
+        if ((pj_rand() % 100) <= (int)udp->rx_drop_pct) {
+            PJ_LOG(5,(udp->base.name, 
+                      "RX RTP packet dropped because of pkt lost "
+                      "simulation"));
+            discard = PJ_TRUE;
+        }
+    }
+
+    //if (!discard && udp->attached && cb)
+    if (!discard && 
+        (-bytes_read != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))) 
+    {
+        call_rtp_cb(udp, pkt, bytes_read, &rem_switch);
+    }
+
+    /* Transport may be destroyed from the callback! */
+    if (!udp->rtp_key || !udp->started)
+        return PJ_FALSE;
+
+#if defined(PJMEDIA_TRANSPORT_SWITCH_REMOTE_ADDR) && \
+    (PJMEDIA_TRANSPORT_SWITCH_REMOTE_ADDR == 1)
+    if (rem_switch &&
+        (udp->options & PJMEDIA_UDP_NO_SRC_ADDR_CHECKING)==0)
+    {
+        char addr_text[PJ_INET6_ADDRSTRLEN+10];
+
+        /* Set remote RTP address to source address */
+        pj_sockaddr_cp(&udp->rem_rtp_addr, &udp->rtp_src_addr);
+
+        PJ_LOG(4,(udp->base.name,
+                  "Remote RTP address switched to %s",
+                  pj_sockaddr_print(&udp->rtp_src_addr, addr_text,
+                                    sizeof(addr_text), 3)));
+
+        if (udp->use_rtcp_mux) {
+            pj_sockaddr_cp(&udp->rem_rtcp_addr, &udp->rem_rtp_addr);
+            pj_sockaddr_cp(&udp->rtcp_src_addr, &udp->rem_rtcp_addr);
+        } else if (!pj_sockaddr_has_addr(&udp->rtcp_src_addr)) {
+            /* Also update remote RTCP address if actual RTCP source
+             * address is not heard yet.
+             */
+            pj_uint16_t port;
+
+            pj_sockaddr_cp(&udp->rem_rtcp_addr, &udp->rem_rtp_addr);
+            port = (pj_uint16_t)
+                   (pj_sockaddr_get_port(&udp->rem_rtp_addr)+1);
+            pj_sockaddr_set_port(&udp->rem_rtcp_addr, port);
+
+            pj_sockaddr_cp(&udp->rtcp_src_addr, &udp->rem_rtcp_addr);
+
+            PJ_LOG(4,(udp->base.name,
+                      "Remote RTCP address switched to predicted"
+                      " address %s",
+                      pj_sockaddr_print(&udp->rtcp_src_addr, addr_text,
+                                        sizeof(addr_text), 3)));
+        }
+    }
+#endif
+
+    return PJ_TRUE;
+}
+
 /* Notification from ioqueue about incoming RTP packet */
 static void on_rx_rtp(pj_ioqueue_key_t *key,
                       pj_ioqueue_op_key_t *op_key,
@@ -538,7 +771,6 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
 {
     struct transport_udp *udp;
     pj_status_t status;
-    pj_bool_t rem_switch = PJ_FALSE;
     pj_bool_t transport_restarted = PJ_FALSE;
     unsigned num_err = 0;
     pj_status_t last_err = PJ_SUCCESS;
@@ -559,87 +791,43 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
         status = transport_restart(PJ_TRUE, udp);
         if (status != PJ_SUCCESS) {
             bytes_read = -PJ_ESOCKETSTOP;
-            call_rtp_cb(udp, bytes_read, NULL);
+            call_rtp_cb(udp, udp->rtp_pkt, bytes_read, NULL);
         }
         return;
     }
 
     do {
-        pj_bool_t discard = PJ_FALSE;
-
-        /* Simulate packet lost on RX direction */
-        if (udp->rx_drop_pct) {
-            if ((pj_rand() % 100) <= (int)udp->rx_drop_pct) {
-                PJ_LOG(5,(udp->base.name, 
-                          "RX RTP packet dropped because of pkt lost "
-                          "simulation"));
-                discard = PJ_TRUE;
+        if (bytes_read > 0 && udp->rx_batch) {
+            pjmedia_transport_udp_rx_batch_stat *stat = &udp->rx_batch_stat;
+            unsigned i, cnt = (unsigned)bytes_read;
+
+            ++stat->batch_cnt;
+            stat->pkt_cnt += cnt;
+            if (cnt > stat->max_size)
+                stat->max_size = cnt;
+
+            /* bytes_read is the number of datagrams in the batch */
+            for (i = 0; i < cnt; ++i) {
+                pj_sock_mmsg *msg = &udp->rx_batch[i];
+
+                pj_sockaddr_cp(&udp->rtp_src_addr, msg->addr);
+                udp->rtp_addrlen = msg->addr_len;
+                if (!deliver_rtp(udp, msg->buf, (pj_ssize_t)msg->len))
+                    break;
             }
-        }
-
-        //if (!discard && udp->attached && cb)
-        if (!discard && 
-            (-bytes_read != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))) 
-        {
-            call_rtp_cb(udp, bytes_read, &rem_switch);
-        }
-
-        /* Transport may be destroyed from the callback! */
-        if (!udp->rtp_key || !udp->started)
+            if (i < cnt)
+                break;
+        } else if (!deliver_rtp(udp, udp->rtp_pkt, bytes_read)) {
             break;
-
-#if defined(PJMEDIA_TRANSPORT_SWITCH_REMOTE_ADDR) && \
-    (PJMEDIA_TRANSPORT_SWITCH_REMOTE_ADDR == 1)
-        if (rem_switch &&
-            (udp->options & PJMEDIA_UDP_NO_SRC_ADDR_CHECKING)==0)
-        {
-            char addr_text[PJ_INET6_ADDRSTRLEN+10];
-
-            /* Set remote RTP address to source address */
-            pj_sockaddr_cp(&udp->rem_rtp_addr, &udp->rtp_src_addr);
-
-            PJ_LOG(4,(udp->base.name,
-                      "Remote RTP address switched to %s",
-                      pj_sockaddr_print(&udp->rtp_src_addr, addr_text,
-                                        sizeof(addr_text), 3)));
-
-            if (udp->use_rtcp_mux) {
-                pj_sockaddr_cp(&udp->rem_rtcp_addr, &udp->rem_rtp_addr);
-                pj_sockaddr_cp(&udp->rtcp_src_addr, &udp->rem_rtcp_addr);
-            } else if (!pj_sockaddr_has_addr(&udp->rtcp_src_addr)) {
-                /* Also update remote RTCP address if actual RTCP source
-                 * address is not heard yet.
-                 */
-                pj_uint16_t port;
-
-                pj_sockaddr_cp(&udp->rem_rtcp_addr, &udp->rem_rtp_addr);
-                port = (pj_uint16_t)
-                       (pj_sockaddr_get_port(&udp->rem_rtp_addr)+1);
-                pj_sockaddr_set_port(&udp->rem_rtcp_addr, port);
-
-                pj_sockaddr_cp(&udp->rtcp_src_addr, &udp->rem_rtcp_addr);
-
-                PJ_LOG(4,(udp->base.name,
-                          "Remote RTCP address switched to predicted"
-                          " address %s",
-                          pj_sockaddr_print(&udp->rtcp_src_addr, addr_text,
-                                            sizeof(addr_text), 3)));
-            }
         }
-#endif
 
-        bytes_read = sizeof(udp->rtp_pkt);
-        udp->rtp_addrlen = sizeof(udp->rtp_src_addr);
-        status = pj_ioqueue_recvfrom(udp->rtp_key, &udp->rtp_read_op,
-                                     udp->rtp_pkt, &bytes_read, 0,
-                                     &udp->rtp_src_addr,
-                                     &udp->rtp_addrlen);
+        status = start_rtp_read(udp, 0, &bytes_read);
 
         if (status != PJ_EPENDING && status != PJ_SUCCESS) {        
             if (transport_restarted && last_err == status) {
                 /* Still the same error after restart */
                 bytes_read = -PJ_ESOCKETSTOP;
-                call_rtp_cb(udp, bytes_read, NULL);
+                call_rtp_cb(udp, udp->rtp_pkt, bytes_read, NULL);
                 break;
             } else if (PJMEDIA_IGNORE_RECV_ERR_CNT) {
                 if (last_err == status) {
@@ -655,7 +843,7 @@ static void on_rx_rtp(pj_ioqueue_key_t *key,
                     status = transport_restart(PJ_TRUE, udp);               
                     if (status != PJ_SUCCESS) {
                         bytes_read = -PJ_ESOCKETSTOP;
-                        call_rtp_cb(udp, bytes_read, NULL);
+                        call_rtp_cb(udp, udp->rtp_pkt, bytes_read, NULL);
                         break;
                     }
                     transport_restarted = PJ_TRUE;
@@ -680,6 +868,9 @@ static void on_rtp_data_sent(pj_ioqueue_key_t *key,
 
     udp = (struct transport_udp*) pj_ioqueue_get_user_data(key);
 
+    /* The write has left the socket, so the send path may bypass the
+     * ioqueue again once no other write is pending, see send_rtp_now().
+     */
     for (i = 0; i < PJ_ARRAY_SIZE(udp->rtp_pending_write); ++i) {
         if (&udp->rtp_pending_write[i].op_key == op_key) {
             udp->rtp_pending_write[i].is_pending = PJ_FALSE;
@@ -1049,6 +1240,9 @@ static void transport_detach( pjmedia_transport *tp,
         /* Set key status to 'stopped' as keys have been cleared */
         udp->started = PJ_FALSE;
 
+        /* Drop the packets held for a batch which was never completed */
+        reset_tx_batch(udp);
+
         /* Unlock keys */
         pj_ioqueue_unlock_key(udp->rtcp_key);
         pj_ioqueue_unlock_key(udp->rtp_key);
@@ -1058,25 +1252,14 @@ static void transport_detach( pjmedia_transport *tp,
 }
 
 
-/* Called by application to send RTP packet */
-static pj_status_t transport_send_rtp( pjmedia_transport *tp,
-                                       const void *pkt,
-                                       pj_size_t size)
+/* Check if an outgoing RTP packet should be silently dropped */
+static pj_bool_t tx_drop(struct transport_udp *udp)
 {
-    struct transport_udp *udp = (struct transport_udp*)tp;
-    pj_ssize_t sent;
-    unsigned id;
-    struct pending_write *pw;
-    pj_status_t status;
-
     /* Must be attached */
     //PJ_ASSERT_RETURN(udp->attached, PJ_EINVALIDOP);
 
-    /* Check that the size is supported */
-    PJ_ASSERT_RETURN(size <= PJMEDIA_MAX_MTU, PJ_ETOOBIG);
-
     if (!udp->started) {
-        return PJ_SUCCESS;
+        return PJ_TRUE;
     }
 
     /* Simulate packet lost on TX direction */
@@ -1085,10 +1268,38 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
             PJ_LOG(5,(udp->base.name, 
                       "TX RTP packet dropped because of pkt lost "
                       "simulation"));
-            return PJ_SUCCESS;
+            return PJ_TRUE;
         }
     }
 
+    return PJ_FALSE;
+}
+
+/* Check if there is a pending RTP write operation. The flags are only set
+ * by the send path and cleared by on_rtp_data_sent() once the write has
+ * left the socket, so a stale value only makes the caller queue a packet
+ * it could have sent directly.
+ */
+static pj_bool_t has_pending_write(struct transport_udp *udp)
+{
+    unsigned id;
+
+    for (id = 0; id < PJ_ARRAY_SIZE(udp->rtp_pending_write); ++id) {
+        if (udp->rtp_pending_write[id].is_pending)
+            return PJ_TRUE;
+    }
+    return PJ_FALSE;
+}
+
+/* Send RTP packet with the ioqueue, from a copy of the packet */
+static pj_status_t send_rtp_queued(struct transport_udp *udp,
+                                   const void *pkt,
+                                   pj_size_t size)
+{
+    pj_ssize_t sent;
+    unsigned id;
+    struct pending_write *pw;
+    pj_status_t status;
 
     id = udp->rtp_write_op_id;
     pw = &udp->rtp_pending_write[id];
@@ -1126,6 +1337,196 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
     return status;
 }
 
+/* Send RTP packet, directly from the caller's buffer when possible */
+static pj_status_t send_rtp_now(struct transport_udp *udp,
+                                const void *pkt,
+                                pj_size_t size)
+{
+    pj_ssize_t sent;
+    pj_status_t status;
+
+    /* When no write is pending, send directly from the caller's buffer,
+     * and only copy the packet when the socket would block. No lock is
+     * needed: as with rtp_write_op_id, the send path is not reentrant,
+     * and a write seen completed has already left the socket, so this
+     * packet can not go ahead of it. In particular the group lock must
+     * not be held here, the RX callbacks run under it.
+     */
+    if (!has_pending_write(udp)) {
+        sent = size;
+        status = pj_sock_sendto(udp->rtp_sock, pkt, &sent, 0,
+                                &udp->rem_rtp_addr, udp->addr_len);
+        if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))
+            return status;
+    }
+
+    return send_rtp_queued(udp, pkt, size);
+}
+
+/* Reset the batch, dropping the packets held in it. The send path only
+ * holds tx_lock while it updates the batch, so this never waits for a
+ * syscall.
+ */
+static void reset_tx_batch(struct transport_udp *udp)
+{
+    if (!udp->tx_lock)
+        return;
+
+    pj_lock_acquire(udp->tx_lock);
+    udp->tx_batch_cnt = 0;
+    pj_lock_release(udp->tx_lock);
+}
+
+/* Add RTP packet to the batch, must be called with tx_lock held */
+static void add_tx_batch(struct transport_udp *udp, void *pkt,
+                         pj_size_t size)
+{
+    pj_sock_mmsg *msg = &udp->tx_batch[udp->tx_batch_cnt++];
+
+    msg->buf = pkt;
+    msg->len = size;
+    msg->addr = &udp->rem_rtp_addr;
+    msg->addr_len = udp->addr_len;
+}
+
+/* End the batch with the packet and take it out for sending. Returns the
+ * number of packets taken, or zero when no packet was held, in which case
+ * the packet is not added.
+ */
+static unsigned take_tx_batch(struct transport_udp *udp, void *pkt,
+                              pj_size_t size)
+{
+    unsigned cnt;
+
+    pj_lock_acquire(udp->tx_lock);
+    cnt = udp->tx_batch_cnt;
+    if (cnt) {
+        add_tx_batch(udp, pkt, size);
+        cnt = udp->tx_batch_cnt;
+        udp->tx_batch_cnt = 0;
+    }
+    pj_lock_release(udp->tx_lock);
+
+    return cnt;
+}
+
+/* Send the first cnt packets of the batch, which have been taken out with
+ * take_tx_batch(). Runs without any lock: only the send path writes the
+ * batch entries, and it is not reentrant.
+ */
+static pj_status_t flush_tx_batch(struct transport_udp *udp, unsigned cnt)
+{
+    pjmedia_transport_udp_tx_batch_stat *stat = &udp->tx_batch_stat;
+    unsigned i = 0, n, syscall_cnt = 0, queued_cnt = 0;
+    pj_status_t status = PJ_SUCCESS, last_err = PJ_SUCCESS;
+
+    /* Keep the packets behind the pending writes, if any */
+    while (i < cnt && !has_pending_write(udp)) {
+        n = cnt - i;
+        status = pj_sock_sendmmsg(udp->rtp_sock, &udp->tx_batch[i], &n, 0);
+        ++syscall_cnt;
+        if (status == PJ_SUCCESS) {
+            i += n;
+        } else if (status == PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+            break;
+        } else {
+            /* Skip the packet which can not be sent */
+            last_err = status;
+            ++i;
+        }
+    }
+
+    /* The rest waits in the ioqueue */
+    for (; i < cnt; ++i) {
+        status = send_rtp_queued(udp, udp->tx_batch[i].buf,
+                                 udp->tx_batch[i].len);
+        if (status != PJ_SUCCESS)
+            last_err = status;
+        ++queued_cnt;
+    }
+
+    pj_lock_acquire(udp->tx_lock);
+    ++stat->batch_cnt;
+    stat->pkt_cnt += cnt;
+    if (cnt > stat->max_size)
+        stat->max_size = cnt;
+    stat->syscall_cnt += syscall_cnt;
+    stat->queued_cnt += queued_cnt;
+    pj_lock_release(udp->tx_lock);
+
+    return last_err;
+}
+
+/* Called by application to send RTP packet */
+static pj_status_t transport_send_rtp( pjmedia_transport *tp,
+                                       const void *pkt,
+                                       pj_size_t size)
+{
+    struct transport_udp *udp = (struct transport_udp*)tp;
+    unsigned cnt;
+
+    /* Check that the size is supported */
+    PJ_ASSERT_RETURN(size <= PJMEDIA_MAX_MTU, PJ_ETOOBIG);
+
+    if (tx_drop(udp))
+        return PJ_SUCCESS;
+
+    if (!udp->tx_batch)
+        return send_rtp_now(udp, pkt, size);
+
+    /* Send the held packets first, this one ends the batch. The packet
+     * is only read by the socket.
+     */
+    cnt = take_tx_batch(udp, (void*)pkt, size);
+    if (cnt)
+        return flush_tx_batch(udp, cnt);
+
+    return send_rtp_now(udp, pkt, size);
+}
+
+/* Called by application to send RTP packet in a writable buffer */
+static pj_status_t transport_send_rtp_buf(pjmedia_transport *tp,
+                                          pjmedia_transport_tx_buf *tx_buf)
+{
+    struct transport_udp *udp = (struct transport_udp*)tp;
+    unsigned cnt;
+
+    if (!udp->tx_batch)
+        return transport_send_rtp(tp, tx_buf->pkt, tx_buf->size);
+
+    /* Check that the size is supported */
+    PJ_ASSERT_RETURN(tx_buf->size <= PJMEDIA_MAX_MTU, PJ_ETOOBIG);
+
+    if (tx_drop(udp))
+        return PJ_SUCCESS;
+
+    /* Hold the packet until the last one of the batch. The caller may
+     * reuse its buffer for the next packet, so keep a copy.
+     */
+    if (tx_buf->flags & PJMEDIA_TRANSPORT_TX_MORE) {
+        pj_bool_t held = PJ_FALSE;
+
+        pj_lock_acquire(udp->tx_lock);
+        if (udp->tx_batch_cnt < PJMEDIA_TRANSPORT_UDP_TX_BATCH_MAX) {
+            char *buf = udp->tx_batch_buf[udp->tx_batch_cnt];
+
+            pj_memcpy(buf, tx_buf->pkt, tx_buf->size);
+            add_tx_batch(udp, buf, tx_buf->size);
+            held = PJ_TRUE;
+        }
+        pj_lock_release(udp->tx_lock);
+
+        if (held)
+            return PJ_SUCCESS;
+    }
+
+    cnt = take_tx_batch(udp, tx_buf->pkt, tx_buf->size);
+    if (cnt)
+        return flush_tx_batch(udp, cnt);
+
+    return send_rtp_now(udp, tx_buf->pkt, tx_buf->size);
+}
+
 /* Called by application to send RTCP packet */
 static pj_status_t transport_send_rtcp(pjmedia_transport *tp,
                                        const void *pkt,
@@ -1303,11 +1704,7 @@ static pj_status_t transport_media_start(pjmedia_transport *tp,
     TRACE_((udp->base.name, "media_start(): before recvfrom RTP"));
 
     /* Kick off pending RTP read from the ioqueue */
-    udp->rtp_addrlen = sizeof(udp->rtp_src_addr);
-    size = sizeof(udp->rtp_pkt);
-    status = pj_ioqueue_recvfrom(udp->rtp_key, &udp->rtp_read_op,
-                                 udp->rtp_pkt, &size, PJ_IOQUEUE_ALWAYS_ASYNC,
-                                 &udp->rtp_src_addr, &udp->rtp_addrlen);
+    status = start_rtp_read(udp, PJ_IOQUEUE_ALWAYS_ASYNC, &size);
     if (status != PJ_EPENDING) {
         PJ_PERROR(3, (udp->base.name, status,
                       "media_start(): recvfrom RTP failed"));
@@ -1354,6 +1751,9 @@ static pj_status_t transport_media_stop(pjmedia_transport *tp)
 
     udp->started = PJ_FALSE;
 
+    /* Drop the packets held for a batch which was never completed */
+    reset_tx_batch(udp);
+
     PJ_LOG(4, (udp->base.name, "UDP media transport stopped"));
 
     return PJ_SUCCESS;
@@ -1408,6 +1808,14 @@ static pj_status_t transport_restart(pj_bool_t is_rtp,
     PJ_LOG(4, (udp->base.name, "Restarting %s transport", 
               (is_rtp)?"RTP":"RTCP"));
 
+    /* This runs from the RX callbacks, which hold the group lock, so
+     * detach can not run meanwhile. Drop the packets held for a batch,
+     * they would go out of the new socket as soon as the batch is
+     * completed.
+     */
+    if (is_rtp)
+        reset_tx_batch(udp);
+
     udp->started = PJ_FALSE;
     /* Destroy existing socket, if any. */    
     if (key) {
@@ -1462,23 +1870,24 @@ static pj_status_t transport_restart(pj_bool_t is_rtp,
         cb.on_read_complete = &on_rx_rtcp;
     }
 
+    /* Register under the group lock, as attach does, so the callbacks
+     * of the new key are serialized with detach.
+     */
     if (is_rtp) {
-        status = pj_ioqueue_register_sock(udp->pool, udp->ioqueue, *sock, udp,
-                                          &cb, &udp->rtp_key);
+        status = pj_ioqueue_register_sock2(udp->pool, udp->ioqueue, *sock,
+                                           udp->base.grp_lock, udp,
+                                           &cb, &udp->rtp_key);
     } else {
-        status = pj_ioqueue_register_sock(udp->pool, udp->ioqueue, *sock, udp,
-                                          &cb, &udp->rtcp_key);    
+        status = pj_ioqueue_register_sock2(udp->pool, udp->ioqueue, *sock,
+                                           udp->base.grp_lock, udp,
+                                           &cb, &udp->rtcp_key);
     }
 
     if (status != PJ_SUCCESS)
         goto on_error;
 
     if (is_rtp) {
-        size = sizeof(udp->rtp_pkt);
-        status = pj_ioqueue_recvfrom(udp->rtp_key, &udp->rtp_read_op,
-                                     udp->rtp_pkt, &size, 
-                                     PJ_IOQUEUE_ALWAYS_ASYNC,
-                                     &udp->rtp_src_addr, &udp->rtp_addrlen);
+        status = start_rtp_read(udp, PJ_IOQUEUE_ALWAYS_ASYNC, &size);
     } else {
         size = sizeof(udp->rtcp_pkt);
         status = pj_ioqueue_recvfrom(udp->rtcp_key, &udp->rtcp_read_op,
@@ -1086,6 +1086,7 @@ static pj_status_t put_frame(pjmedia_port *port,
     pjmedia_vid_channel *channel = stream->enc;
     pj_status_t status = 0;
     pjmedia_frame frame_out;
+    pjmedia_transport_tx_buf tx_buf;
     unsigned rtp_ts_len;
     void *rtphdr;
     int rtphdrlen;
@@ -1229,11 +1230,22 @@ static pj_status_t put_frame(pjmedia_port *port,
             /* Copy RTP header to the beginning of packet */
             pj_memcpy(channel->buf, rtphdr, sizeof(pjmedia_rtp_hdr));
 
-            /* Send the RTP packet to the transport. */
-            status = pjmedia_transport_send_rtp(stream->transport,
-                                                (char*)channel->buf,
-                                                frame_out.size +
-                                                    sizeof(pjmedia_rtp_hdr));
+            /* Send the RTP packet to the transport. The transport may
+             * hold the packet and send the whole frame in one batch,
+             * unless the rate control paces the packets.
+             */
+            tx_buf.buf = channel->buf;
+            tx_buf.buf_size = channel->buf_size + PJMEDIA_STREAM_TX_TAILROOM;
+            tx_buf.pkt = channel->buf;
+            tx_buf.size = frame_out.size + sizeof(pjmedia_rtp_hdr);
+            tx_buf.flags = 0;
+            if (has_more_data && stream->info.rc_cfg.method ==
+                                 PJMEDIA_VID_STREAM_RC_NONE)
+            {
+                tx_buf.flags |= PJMEDIA_TRANSPORT_TX_MORE;
+            }
+            status = pjmedia_transport_send_rtp_buf(stream->transport,
+                                                    &tx_buf);
             if (status != PJ_SUCCESS) {
                 if (stream->rtp_tx_err_cnt++ == 0) {
                     LOGERR_((channel->port.info.name.ptr, status,
@@ -1697,7 +1709,9 @@ static pj_status_t create_channel( pj_pool_t *pool,
         if (channel->buf_size < min_out_pkt_size)
             channel->buf_size = min_out_pkt_size;
 
-        channel->buf = pj_pool_alloc(pool, channel->buf_size);
+        /* Tailroom lets the transports extend outgoing packets in place. */
+        channel->buf = pj_pool_alloc(pool, channel->buf_size +
+                                           PJMEDIA_STREAM_TX_TAILROOM);
         PJ_ASSERT_RETURN(channel->buf != NULL, PJ_ENOMEM);
     }
 
@@ -2311,8 +2325,7 @@ PJ_DEF(pj_status_t) pjmedia_vid_stream_get_stat(
 {
     PJ_ASSERT_RETURN(stream && stat, PJ_EINVAL);
 
-    pj_memcpy(stat, &stream->rtcp.stat, sizeof(pjmedia_rtcp_stat));
-    return PJ_SUCCESS;
+    return pjmedia_rtcp_get_stat(&stream->rtcp, stat);
 }
 
 
@@ -2323,7 +2336,10 @@ PJ_DEF(pj_status_t) pjmedia_vid_stream_reset_stat(pjmedia_vid_stream *stream)
 {
     PJ_ASSERT_RETURN(stream, PJ_EINVAL);
 
-    pjmedia_rtcp_init_stat(&stream->rtcp.stat);
+    /* The lock keeps concurrent resets apart */
+    pj_grp_lock_acquire(stream->grp_lock);
+    pjmedia_rtcp_reset_stat(&stream->rtcp);
+    pj_grp_lock_release(stream->grp_lock);
 
     return PJ_SUCCESS;
 }
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "alaw_ulaw_test.c"
+
+#define PCM_CNT     65536
+
+static pj_int16_t   pcm[PCM_CNT + 1];
+static pj_uint8_t   law[PCM_CNT + 1];
+static pj_int16_t   pcm_out[PCM_CNT + 1];
+static pj_uint8_t   all_codes[256 + 1];
+
+
+/* Check the bulk encoders against the per-sample conversion, for every
+ * 16bit value and with unaligned buffers and odd counts.
+ */
+static int encode_test(void)
+{
+    unsigned i, ofs;
+
+    for (i = 0; i < PCM_CNT; ++i)
+        pcm[i + 1] = (pj_int16_t)(i - 32768);
+
+    for (ofs = 0; ofs < 2; ++ofs) {
+        pjmedia_ulaw_encode(law + ofs, pcm + 1, PCM_CNT - ofs);
+        for (i = 0; i < PCM_CNT - ofs; ++i) {
+            if (law[i + ofs] != pjmedia_linear2ulaw(pcm[i + 1])) {
+                PJ_LOG(3,(THIS_FILE, "  ulaw encode mismatch for %d: "
+                          "got 0x%02x, expecting 0x%02x", pcm[i + 1],
+                          law[i + ofs], pjmedia_linear2ulaw(pcm[i + 1])));
+                return -10;
+            }
+        }
+
+        pjmedia_alaw_encode(law + ofs, pcm + 1, PCM_CNT - ofs);
+        for (i = 0; i < PCM_CNT - ofs; ++i) {
+            if (law[i + ofs] != pjmedia_linear2alaw(pcm[i + 1])) {
+                PJ_LOG(3,(THIS_FILE, "  alaw encode mismatch for %d: "
+                          "got 0x%02x, expecting 0x%02x", pcm[i + 1],
+                          law[i + ofs], pjmedia_linear2alaw(pcm[i + 1])));
+                return -20;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Check the bulk decoders and transcoders for every code. */
+static int decode_test(void)
+{
+    unsigned i, ofs;
+
+    for (i = 0; i < 256; ++i)
+        all_codes[i + 1] = (pj_uint8_t)i;
+
+    for (ofs = 0; ofs < 2; ++ofs) {
+        pjmedia_ulaw_decode(pcm_out + ofs, all_codes + 1, 256 - ofs);
+        for (i = 0; i < 256 - ofs; ++i) {
+            if (pcm_out[i + ofs] != pjmedia_ulaw2linear(i)) {
+                PJ_LOG(3,(THIS_FILE, "  ulaw decode mismatch for 0x%02x: "
+                          "got %d, expecting %d", i, pcm_out[i + ofs],
+                          pjmedia_ulaw2linear(i)));
+                return -30;
+            }
+        }
+
+        pjmedia_alaw_decode(pcm_out + ofs, all_codes + 1, 256 - ofs);
+        for (i = 0; i < 256 - ofs; ++i) {
+            if (pcm_out[i + ofs] != pjmedia_alaw2linear(i)) {
+                PJ_LOG(3,(THIS_FILE, "  alaw decode mismatch for 0x%02x: "
+                          "got %d, expecting %d", i, pcm_out[i + ofs],
+                          pjmedia_alaw2linear(i)));
+                return -40;
+            }
+        }
+    }
+
+    /* Transcoding must give the same result as the conversion through
+     * linear PCM (in place).
+     */
+    pj_memcpy(law, all_codes + 1, 256);
+    pjmedia_alaw_to_ulaw(law, law, 256);
+    for (i = 0; i < 256; ++i) {
+        if (law[i] != pjmedia_linear2ulaw(pjmedia_alaw2linear(i)))
+            return -50;
+    }
+
+    pj_memcpy(law, all_codes + 1, 256);
+    pjmedia_ulaw_to_alaw(law, law, 256);
+    for (i = 0; i < 256; ++i) {
+        if (law[i] != pjmedia_linear2alaw(pjmedia_ulaw2linear(i)))
+            return -60;
+    }
+
+    return 0;
+}
+
+#if WITH_BENCHMARK
+static void bench(void)
+{
+    enum { COUNT = 160, LOOP = 20000 };
+    pj_timestamp t0, t1, t2;
+    pj_uint8_t *p;
+    unsigned i, j;
+
+    for (i = 0; i < COUNT; ++i)
+        pcm[i] = (pj_int16_t)(pj_rand() & 0xFFFF);
+
+    /* Encode */
+    pj_get_timestamp(&t0);
+    for (i = 0; i < LOOP; ++i) {
+        for (j = 0, p = law; j < COUNT; ++j)
+            *p++ = pjmedia_linear2ulaw(pcm[j]);
+    }
+    pj_get_timestamp(&t1);
+    for (i = 0; i < LOOP; ++i)
+        pjmedia_ulaw_encode(law, pcm, COUNT);
+    pj_get_timestamp(&t2);
+
+    PJ_LOG(3,(THIS_FILE, "  ulaw encode: per-sample %.3f, bulk %.3f "
+              "ns/sample",
+              pj_elapsed_nanosec(&t0, &t1) * 1.0 / (COUNT * LOOP),
+              pj_elapsed_nanosec(&t1, &t2) * 1.0 / (COUNT * LOOP)));
+
+    /* Decode */
+    pj_get_timestamp(&t0);
+    for (i = 0; i < LOOP; ++i) {
+        for (j = 0; j < COUNT; ++j)
+            pcm_out[j] = (pj_int16_t)pjmedia_ulaw2linear(law[j]);
+    }
+    pj_get_timestamp(&t1);
+    for (i = 0; i < LOOP; ++i)
+        pjmedia_ulaw_decode(pcm_out, law, COUNT);
+    pj_get_timestamp(&t2);
+
+    PJ_LOG(3,(THIS_FILE, "  ulaw decode: per-sample %.3f, bulk %.3f "
+              "ns/sample",
+              pj_elapsed_nanosec(&t0, &t1) * 1.0 / (COUNT * LOOP),
+              pj_elapsed_nanosec(&t1, &t2) * 1.0 / (COUNT * LOOP)));
+
+    /* Transcode */
+    pj_get_timestamp(&t0);
+    for (i = 0; i < LOOP; ++i) {
+        pjmedia_ulaw_decode(pcm_out, law, COUNT);
+        pjmedia_alaw_encode(law + COUNT, pcm_out, COUNT);
+    }
+    pj_get_timestamp(&t1);
+    for (i = 0; i < LOOP; ++i)
+        pjmedia_ulaw_to_alaw(law + COUNT, law, COUNT);
+    pj_get_timestamp(&t2);
+
+    PJ_LOG(3,(THIS_FILE, "  ulaw->alaw: through linear %.3f, direct %.3f "
+              "ns/sample",
+              pj_elapsed_nanosec(&t0, &t1) * 1.0 / (COUNT * LOOP),
+              pj_elapsed_nanosec(&t1, &t2) * 1.0 / (COUNT * LOOP)));
+}
+#endif
+
+int alaw_ulaw_test(void)
+{
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "A-law/U-law bulk conversion test"));
+
+    rc = encode_test();
+    if (rc == 0)
+        rc = decode_test();
+
+#if WITH_BENCHMARK
+    if (rc == 0)
+        bench();
+#endif
+
+    return rc;
+}
@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "audio_mix_test.c"
+
+/* Maximum number of samples per test vector. The extra samples at the
+ * end of each buffer are guard samples, to detect writes past the end.
+ */
+#define MAX_COUNT   1000
+#define GUARD       16
+#define BUF_SIZE    (MAX_COUNT + GUARD)
+#define GUARD_VAL   0x5A5A
+
+/* Number of random test rounds */
+#define ROUNDS      200
+
+
+static pj_int16_t   src[BUF_SIZE];
+static pj_int32_t   mix_in[BUF_SIZE];
+
+static pj_int16_t   ref16[BUF_SIZE], out16[BUF_SIZE];
+static pj_int32_t   ref32[BUF_SIZE], out32[BUF_SIZE];
+
+
+/* Fill the source buffers. The mode selects the signal type to cover the
+ * clipping and wrapping edge cases.
+ */
+static void gen_input(unsigned mode)
+{
+    unsigned i;
+
+    for (i = 0; i < BUF_SIZE; ++i) {
+        switch (mode) {
+        case 0:
+            /* Full range random */
+            src[i] = (pj_int16_t)pj_rand();
+            mix_in[i] = (pj_int32_t)((pj_uint32_t)pj_rand() << 16) ^
+                        pj_rand();
+            break;
+        case 1:
+            /* Loud signal, mix of a few loud ports */
+            src[i] = (pj_int16_t)((i & 1) ? -32768 : 32767);
+            mix_in[i] = ((pj_rand() % 200001) - 100000);
+            break;
+        case 2:
+            /* Quiet signal */
+            src[i] = (pj_int16_t)((pj_rand() % 201) - 100);
+            mix_in[i] = ((pj_rand() % 2001) - 1000);
+            break;
+        default:
+            /* Values around the 16bit boundaries */
+            src[i] = (pj_int16_t)(32760 + (pj_rand() % 16));
+            mix_in[i] = (pj_int32_t)(32760 + (pj_rand() % 16)) *
+                        ((pj_rand() & 1) ? 1 : -1);
+            break;
+        }
+    }
+}
+
+static int check16(const char *what, pjmedia_mix_impl impl, unsigned count,
+                   unsigned level)
+{
+    unsigned i;
+
+    for (i = 0; i < BUF_SIZE; ++i) {
+        if (out16[i] != ref16[i]) {
+            PJ_LOG(3,(THIS_FILE, "  %s/%s mismatch at %u: count=%u, "
+                      "level=%u, got %d, expecting %d", what,
+                      pjmedia_mix_impl_name(impl), i, count, level,
+                      out16[i], ref16[i]));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int check32(const char *what, pjmedia_mix_impl impl, unsigned count)
+{
+    unsigned i;
+
+    for (i = 0; i < BUF_SIZE; ++i) {
+        if (out32[i] != ref32[i]) {
+            PJ_LOG(3,(THIS_FILE, "  %s/%s mismatch at %u: count=%u, "
+                      "got %d, expecting %d", what,
+                      pjmedia_mix_impl_name(impl), i, count,
+                      out32[i], ref32[i]));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void fill_guard(void)
+{
+    unsigned i;
+
+    for (i = 0; i < BUF_SIZE; ++i) {
+        ref16[i] = out16[i] = GUARD_VAL;
+        ref32[i] = out32[i] = GUARD_VAL;
+    }
+}
+
+/* Compare one implementation against the scalar implementation. */
+static int compare_impl(pjmedia_mix_impl impl, unsigned count,
+                        unsigned level)
+{
+    pj_int32_t ref_sum, sum;
+    pj_int32_t ref_min, ref_max, min, max;
+
+    /* Sum of absolute values */
+    pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+    ref_sum = pjmedia_mix_sum_abs(src, count);
+    pjmedia_mix_set_impl(impl);
+    sum = pjmedia_mix_sum_abs(src, count);
+    if (sum != ref_sum) {
+        PJ_LOG(3,(THIS_FILE, "  sum_abs/%s mismatch: count=%u, got %d, "
+                  "expecting %d", pjmedia_mix_impl_name(impl), count,
+                  sum, ref_sum));
+        return -10;
+    }
+
+    /* Level adjustment */
+    fill_guard();
+    pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+    ref_sum = pjmedia_mix_adjust_level(ref16, src, count, level);
+    pjmedia_mix_set_impl(impl);
+    sum = pjmedia_mix_adjust_level(out16, src, count, level);
+    if (check16("adjust_level", impl, count, level))
+        return -20;
+    if (sum != ref_sum) {
+        PJ_LOG(3,(THIS_FILE, "  adjust_level/%s sum mismatch: count=%u, "
+                  "level=%u", pjmedia_mix_impl_name(impl), count, level));
+        return -21;
+    }
+
+    /* Level adjustment, in place */
+    pj_memcpy(out16, src, count * sizeof(pj_int16_t));
+    sum = pjmedia_mix_adjust_level(out16, out16, count, level);
+    if (check16("adjust_level (in place)", impl, count, level))
+        return -22;
+    if (sum != ref_sum)
+        return -23;
+
+    /* Accumulation */
+    fill_guard();
+    pj_memcpy(ref32, mix_in, count * sizeof(pj_int32_t));
+    pj_memcpy(out32, mix_in, count * sizeof(pj_int32_t));
+    ref_min = ref_max = min = max = 0;
+    pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+    pjmedia_mix_accumulate(ref32, src, count, &ref_min, &ref_max);
+    pjmedia_mix_set_impl(impl);
+    pjmedia_mix_accumulate(out32, src, count, &min, &max);
+    if (check32("accumulate", impl, count))
+        return -30;
+    if (min != ref_min || max != ref_max) {
+        PJ_LOG(3,(THIS_FILE, "  accumulate/%s min/max mismatch: count=%u, "
+                  "got %d/%d, expecting %d/%d", pjmedia_mix_impl_name(impl),
+                  count, min, max, ref_min, ref_max));
+        return -31;
+    }
+
+    /* Conversion to PCM, with the level and with truncation */
+    fill_guard();
+    pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+    ref_sum = pjmedia_mix_to_pcm(ref16, mix_in, count, level);
+    pjmedia_mix_set_impl(impl);
+    sum = pjmedia_mix_to_pcm(out16, mix_in, count, level);
+    if (check16("to_pcm", impl, count, level))
+        return -40;
+    if (sum != ref_sum)
+        return -41;
+
+    fill_guard();
+    pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_SCALAR);
+    ref_sum = pjmedia_mix_to_pcm(ref16, mix_in, count, 128);
+    pjmedia_mix_set_impl(impl);
+    sum = pjmedia_mix_to_pcm(out16, mix_in, count, 128);
+    if (check16("to_pcm (truncate)", impl, count, 128))
+        return -42;
+    if (sum != ref_sum)
+        return -43;
+
+    /* Conversion to PCM in place, as done by the conference bridge */
+    pj_memcpy(out32, mix_in, count * sizeof(pj_int32_t));
+    sum = pjmedia_mix_to_pcm((pj_int16_t*)out32, out32, count, 128);
+    if (pj_memcmp(out32, ref16, count * sizeof(pj_int16_t)) != 0) {
+        PJ_LOG(3,(THIS_FILE, "  to_pcm/%s in place mismatch: count=%u",
+                  pjmedia_mix_impl_name(impl), count));
+        return -44;
+    }
+    if (sum != ref_sum)
+        return -45;
+
+    return 0;
+}
+
+#if WITH_BENCHMARK
+/* Time the kernels of one implementation, in nanoseconds per sample. */
+static void bench_impl(pjmedia_mix_impl impl)
+{
+    enum { COUNT = 960, LOOP = 2000 };
+    pj_timestamp t0, t1;
+    pj_int32_t min = 0, max = 0;
+    unsigned i;
+    pj_uint32_t usec[3];
+
+    pjmedia_mix_set_impl(impl);
+
+    pj_get_timestamp(&t0);
+    for (i = 0; i < LOOP; ++i)
+        pjmedia_mix_adjust_level(out16, src, COUNT, 100 + (i & 63));
+    pj_get_timestamp(&t1);
+    usec[0] = pj_elapsed_usec(&t0, &t1);
+
+    pj_get_timestamp(&t0);
+    for (i = 0; i < LOOP; ++i)
+        pjmedia_mix_accumulate(out32, src, COUNT, &min, &max);
+    pj_get_timestamp(&t1);
+    usec[1] = pj_elapsed_usec(&t0, &t1);
+
+    pj_get_timestamp(&t0);
+    for (i = 0; i < LOOP; ++i)
+        pjmedia_mix_to_pcm(out16, mix_in, COUNT, 100 + (i & 63));
+    pj_get_timestamp(&t1);
+    usec[2] = pj_elapsed_usec(&t0, &t1);
+
+    PJ_LOG(3,(THIS_FILE, "  %-6s: adjust_level=%.3f, accumulate=%.3f, "
+              "to_pcm=%.3f ns/sample", pjmedia_mix_impl_name(impl),
+              usec[0] * 1000.0 / (COUNT * LOOP),
+              usec[1] * 1000.0 / (COUNT * LOOP),
+              usec[2] * 1000.0 / (COUNT * LOOP)));
+}
+#endif
+
+int audio_mix_test(void)
+{
+    static const unsigned counts[] = { 0, 1, 7, 8, 9, 15, 16, 17, 31, 33,
+                                       80, 160, 320, 441, 960, MAX_COUNT };
+    static const unsigned levels[] = { 0, 1, 64, 127, 129, 200, 255, 256,
+                                       1000, 32767, 65535, 100000 };
+    pjmedia_mix_impl impl, orig_impl;
+    int rc = 0;
+
+    orig_impl = pjmedia_mix_get_impl();
+    PJ_LOG(3,(THIS_FILE, "Audio mix test, default implementation: %s",
+              pjmedia_mix_impl_name(orig_impl)));
+
+    for (impl = PJMEDIA_MIX_IMPL_SCALAR; impl <= PJMEDIA_MIX_IMPL_NEON;
+         ++impl)
+    {
+        unsigned mode, ci, li, r;
+
+        if (!pjmedia_mix_has_impl(impl)) {
+            PJ_LOG(3,(THIS_FILE, "  %s: not available",
+                      pjmedia_mix_impl_name(impl)));
+            continue;
+        }
+
+        /* Edge cases */
+        for (mode = 0; mode < 4 && rc == 0; ++mode) {
+            gen_input(mode);
+            for (ci = 0; ci < PJ_ARRAY_SIZE(counts) && rc == 0; ++ci) {
+                for (li = 0; li < PJ_ARRAY_SIZE(levels) && rc == 0; ++li)
+                    rc = compare_impl(impl, counts[ci], levels[li]);
+            }
+        }
+
+        /* Random counts and levels */
+        for (r = 0; r < ROUNDS && rc == 0; ++r) {
+            gen_input(r & 3);
+            rc = compare_impl(impl, pj_rand() % (MAX_COUNT + 1),
+                              pj_rand() % 512);
+        }
+
+        if (rc != 0)
+            break;
+
+        PJ_LOG(3,(THIS_FILE, "  %s: ok", pjmedia_mix_impl_name(impl)));
+    }
+
+#if WITH_BENCHMARK
+    if (rc == 0) {
+        gen_input(0);
+        for (impl = PJMEDIA_MIX_IMPL_SCALAR; impl <= PJMEDIA_MIX_IMPL_NEON;
+             ++impl)
+        {
+            if (pjmedia_mix_has_impl(impl))
+                bench_impl(impl);
+        }
+    }
+#endif
+
+    pjmedia_mix_set_impl(orig_impl);
+    return rc;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjmedia-codec.h>
+
+#define THIS_FILE   "dec_pool_test.c"
+
+/* Number of streams and decode workers */
+#define STREAM_CNT  4
+#define WORKER_CNT  2
+
+/* Number of attach/detach rounds done while the streams are running */
+#define ROUNDS      300
+
+#if PJMEDIA_HAS_G711_CODEC
+
+struct test_stream
+{
+    pjmedia_transport   *tp;
+    pjmedia_stream      *stream;
+    pjmedia_port        *port;
+    pj_thread_t         *thread;
+    pj_int16_t           buf[160];
+    unsigned             frames;
+};
+
+static pj_bool_t        thread_quit;
+
+
+/* Keep the stream busy: send a frame over the loop transport, so the
+ * jitter buffer has something to decode, and pull a frame from it.
+ */
+static int stream_thread(void *arg)
+{
+    struct test_stream *ts = (struct test_stream*) arg;
+    unsigned i;
+
+    while (!thread_quit) {
+        pjmedia_frame frame;
+
+        for (i = 0; i < PJ_ARRAY_SIZE(ts->buf); ++i)
+            ts->buf[i] = (pj_int16_t)(pj_rand() & 0x0FFF);
+
+        frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+        frame.buf = ts->buf;
+        frame.size = sizeof(ts->buf);
+        frame.timestamp.u64 = 0;
+        frame.bit_info = 0;
+        pjmedia_port_put_frame(ts->port, &frame);
+
+        frame.buf = ts->buf;
+        frame.size = sizeof(ts->buf);
+        pjmedia_port_get_frame(ts->port, &frame);
+
+        ++ts->frames;
+        if ((ts->frames & 7) == 0)
+            pj_thread_sleep(1);
+    }
+
+    return 0;
+}
+
+
+static int create_test_stream(pjmedia_endpt *endpt, pj_pool_t *pool,
+                              const pjmedia_codec_info *ci,
+                              struct test_stream *ts)
+{
+    pjmedia_stream_info si;
+    pj_status_t status;
+
+    pj_bzero(&si, sizeof(si));
+    si.type = PJMEDIA_TYPE_AUDIO;
+    si.proto = PJMEDIA_TP_PROTO_RTP_AVP;
+    si.dir = PJMEDIA_DIR_ENCODING_DECODING;
+    pj_sockaddr_in_init(&si.rem_addr.ipv4, NULL, 4000);
+    pj_sockaddr_in_init(&si.rem_rtcp.ipv4, NULL, 4001);
+    pj_memcpy(&si.fmt, ci, sizeof(pjmedia_codec_info));
+    si.tx_pt = si.rx_pt = ci->pt;
+    si.tx_event_pt = si.rx_event_pt = 101;
+    si.ssrc = pj_rand();
+    si.jb_init = si.jb_min_pre = si.jb_max_pre = si.jb_max = -1;
+    si.jb_discard_algo = PJMEDIA_JB_DISCARD_PROGRESSIVE;
+
+    status = pjmedia_transport_loop_create(endpt, &ts->tp);
+    if (status != PJ_SUCCESS)
+        return -10;
+
+    status = pjmedia_stream_create(endpt, pool, &si, ts->tp, NULL,
+                                   &ts->stream);
+    if (status != PJ_SUCCESS)
+        return -20;
+
+    status = pjmedia_stream_start(ts->stream);
+    if (status != PJ_SUCCESS)
+        return -30;
+
+    status = pjmedia_stream_get_port(ts->stream, &ts->port);
+    if (status != PJ_SUCCESS)
+        return -40;
+
+    return 0;
+}
+
+
+/*
+ * Attach and detach running streams to a decode pool in random order,
+ * then destroy the streams while they are still attached.
+ */
+int dec_pool_test(void)
+{
+    pjmedia_endpt *endpt;
+    pj_pool_t *pool;
+    pjmedia_stream_dec_pool *dec_pool = NULL;
+    struct test_stream ts[STREAM_CNT];
+    const pjmedia_codec_info *ci[1];
+    pj_str_t codec_id = pj_str("pcmu");
+    unsigned i, count, round;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  stream decode pool test"));
+
+    pj_bzero(ts, sizeof(ts));
+    thread_quit = PJ_FALSE;
+
+    status = pjmedia_endpt_create(mem, NULL, 0, &endpt);
+    if (status != PJ_SUCCESS)
+        return -100;
+
+    pool = pjmedia_endpt_create_pool(endpt, "decpool", 4000, 4000);
+
+    status = pjmedia_codec_g711_init(endpt);
+    if (status != PJ_SUCCESS) {
+        rc = -110;
+        goto on_return;
+    }
+
+    count = 1;
+    status = pjmedia_codec_mgr_find_codecs_by_id(
+                                    pjmedia_endpt_get_codec_mgr(endpt),
+                                    &codec_id, &count, ci, NULL);
+    if (status != PJ_SUCCESS || count == 0) {
+        rc = -120;
+        goto on_return;
+    }
+
+    status = pjmedia_stream_dec_pool_create(pool, WORKER_CNT, &dec_pool);
+    if (status != PJ_SUCCESS) {
+        rc = -130;
+        goto on_return;
+    }
+
+    for (i = 0; i < STREAM_CNT; ++i) {
+        rc = create_test_stream(endpt, pool, ci[0], &ts[i]);
+        if (rc != 0) {
+            rc -= 200;
+            goto on_return;
+        }
+    }
+
+    for (i = 0; i < STREAM_CNT; ++i) {
+        status = pj_thread_create(pool, "decpool", &stream_thread, &ts[i],
+                                  0, 0, &ts[i].thread);
+        if (status != PJ_SUCCESS) {
+            rc = -300;
+            goto on_return;
+        }
+    }
+
+    /* Attach and detach the streams while their threads pull frames */
+    for (round = 0; round < ROUNDS; ++round) {
+        i = pj_rand() % STREAM_CNT;
+        status = pjmedia_stream_set_dec_pool(ts[i].stream,
+                                             (pj_rand() & 1) ? dec_pool :
+                                                               NULL);
+        if (status != PJ_SUCCESS) {
+            rc = -400;
+            goto on_return;
+        }
+        if ((round & 3) == 0)
+            pj_thread_sleep(1);
+    }
+
+    /* Leave all of them attached, so that destroying the streams has to
+     * detach them from the busy workers.
+     */
+    for (i = 0; i < STREAM_CNT; ++i) {
+        status = pjmedia_stream_set_dec_pool(ts[i].stream, dec_pool);
+        if (status != PJ_SUCCESS) {
+            rc = -410;
+            goto on_return;
+        }
+    }
+    pj_thread_sleep(20);
+
+on_return:
+    thread_quit = PJ_TRUE;
+    for (i = 0; i < STREAM_CNT; ++i) {
+        if (ts[i].thread) {
+            pj_thread_join(ts[i].thread);
+            pj_thread_destroy(ts[i].thread);
+        }
+    }
+
+    for (i = 0; i < STREAM_CNT; ++i) {
+        if (rc == 0 && ts[i].frames == 0) {
+            PJ_LOG(3,(THIS_FILE, "   error: stream %d did not run", i));
+            rc = -500;
+        }
+        if (ts[i].stream)
+            pjmedia_stream_destroy(ts[i].stream);
+        if (ts[i].tp)
+            pjmedia_transport_close(ts[i].tp);
+    }
+
+    if (dec_pool)
+        pjmedia_stream_dec_pool_destroy(dec_pool);
+
+    pjmedia_codec_g711_deinit();
+    pj_pool_release(pool);
+    pjmedia_endpt_destroy(endpt);
+
+    return rc;
+}
+
+#else   /* PJMEDIA_HAS_G711_CODEC */
+
+int dec_pool_test(void)
+{
+    PJ_LOG(3,(THIS_FILE, "  stream decode pool test: skipped, "
+                         "G.711 is disabled"));
+    return 0;
+}
+
+#endif  /* PJMEDIA_HAS_G711_CODEC */
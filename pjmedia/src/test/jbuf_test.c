@@ -164,6 +164,163 @@ static pj_bool_t process_test_data(char data, pjmedia_jbuf *jb,
     return PJ_TRUE;
 }
 
+/* Check that the frames returned by reference have the right content, and
+ * that the slot lent to the application is not overwritten until the next
+ * get.
+ */
+static int zero_copy_test(void)
+{
+    pj_str_t jb_name = {"JBREF", 5};
+    pj_pool_t *pool;
+    pjmedia_jbuf *jb;
+    char frame[JB_BUF_SIZE];
+    const void *ref;
+    pj_size_t size;
+    char f_type;
+    int seq, rc = 0;
+    unsigned i;
+
+    pool = pj_pool_create(mem, "JBREF", 1000, 1000, NULL);
+    pjmedia_jbuf_create(pool, &jb_name, sizeof(frame), JB_PTIME,
+                        JB_BUF_SIZE, &jb);
+    pjmedia_jbuf_set_fixed(jb, 0);
+
+    /* Empty jitter buffer returns no frame */
+    pjmedia_jbuf_get_frame_ref(jb, &ref, &size, &f_type, NULL, NULL, NULL);
+    if (ref != NULL || f_type == PJMEDIA_JB_NORMAL_FRAME) {
+        rc = -100;
+        goto on_return;
+    }
+
+    /* Each frame has size and content according to its sequence */
+    for (i = 0; i < JB_BUF_SIZE; ++i) {
+        pj_memset(frame, i, i + 1);
+        pjmedia_jbuf_put_frame(jb, frame, i + 1, i);
+    }
+    for (i = 0; i < JB_BUF_SIZE / 2; ++i) {
+        pjmedia_jbuf_get_frame_ref(jb, &ref, &size, &f_type, NULL, NULL,
+                                   &seq);
+        if (f_type != PJMEDIA_JB_NORMAL_FRAME || !ref || size != i + 1 ||
+            seq != (int)i || ((const char*)ref)[i] != (char)i)
+        {
+            rc = -110;
+            goto on_return;
+        }
+    }
+
+    /* Fill up the jitter buffer, the slot of the last frame got can't be
+     * used until the next get.
+     */
+    for (i = JB_BUF_SIZE; i < JB_BUF_SIZE * 3 / 2; ++i) {
+        pj_memset(frame, 0x7F, sizeof(frame));
+        pjmedia_jbuf_put_frame(jb, frame, sizeof(frame), i);
+    }
+    if (((const char*)ref)[0] != (char)(JB_BUF_SIZE / 2 - 1)) {
+        rc = -120;
+        goto on_return;
+    }
+
+    pjmedia_jbuf_get_frame_ref(jb, &ref, &size, &f_type, NULL, NULL, &seq);
+    if (f_type != PJMEDIA_JB_NORMAL_FRAME || seq != JB_BUF_SIZE / 2 ||
+        ((const char*)ref)[0] != (char)(JB_BUF_SIZE / 2))
+    {
+        rc = -130;
+    }
+
+on_return:
+    pjmedia_jbuf_destroy(jb);
+    pj_pool_release(pool);
+    return rc;
+}
+
+#if WITH_BENCHMARK
+/* Put/get throughput, each frame is put to every stream then got from every
+ * stream. With few streams the buffers stay in cache, with many streams
+ * they don't, which is where the slot layout matters.
+ */
+#define BENCH_STREAMS       1000
+#define BENCH_FRAME_SIZE    160
+#define BENCH_FRAMES        500000
+
+static int jbuf_bench(void)
+{
+    static const unsigned stream_cnts[] = { 10, BENCH_STREAMS };
+    pj_str_t jb_name = {"JBBENCH", 7};
+    pj_pool_t *pool;
+    pjmedia_jbuf **jb;
+    char frame[BENCH_FRAME_SIZE];
+    pj_uint32_t sum = 0;
+    unsigned i, r, c, mode;
+
+    pool = pj_pool_create(mem, "JBBENCH", 4000, 4000, NULL);
+    jb = (pjmedia_jbuf**) pj_pool_calloc(pool, BENCH_STREAMS,
+                                         sizeof(pjmedia_jbuf*));
+    for (i = 0; i < BENCH_STREAMS; ++i) {
+        pj_status_t status;
+
+        status = pjmedia_jbuf_create(pool, &jb_name, BENCH_FRAME_SIZE,
+                                     JB_PTIME, JB_BUF_SIZE, &jb[i]);
+        if (status != PJ_SUCCESS) {
+            pj_pool_release(pool);
+            return -200;
+        }
+        pjmedia_jbuf_set_fixed(jb[i], 4);
+    }
+    pj_memset(frame, 0x5A, sizeof(frame));
+
+    for (c = 0; c < PJ_ARRAY_SIZE(stream_cnts); ++c) {
+        unsigned stream_cnt = stream_cnts[c];
+        unsigned rounds = BENCH_FRAMES / stream_cnt;
+
+        for (mode = 0; mode < 2; ++mode) {
+            pj_timestamp t0, t1;
+            pj_uint16_t seq = 0;
+
+            for (i = 0; i < stream_cnt; ++i)
+                pjmedia_jbuf_reset(jb[i]);
+
+            pj_get_timestamp(&t0);
+            for (r = 0; r < rounds; ++r, ++seq) {
+                for (i = 0; i < stream_cnt; ++i) {
+                    frame[0] = (char)r;
+                    pjmedia_jbuf_put_frame(jb[i], frame, sizeof(frame), seq);
+                }
+                for (i = 0; i < stream_cnt; ++i) {
+                    char out[BENCH_FRAME_SIZE];
+                    const void *ref;
+                    pj_size_t size = sizeof(out);
+                    char f_type;
+
+                    if (mode == 0) {
+                        pjmedia_jbuf_get_frame2(jb[i], out, &size, &f_type,
+                                                NULL);
+                        sum += out[0];
+                    } else {
+                        pjmedia_jbuf_get_frame_ref(jb[i], &ref, &size,
+                                                   &f_type, NULL, NULL, NULL);
+                        if (ref)
+                            sum += *(const char*)ref;
+                    }
+                }
+            }
+            pj_get_timestamp(&t1);
+
+            PJ_LOG(3,("jbuf_test.c",
+                      "  %4u streams, %-9s get: %.1f ns per put+get",
+                      stream_cnt, (mode == 0 ? "copy" : "zero-copy"),
+                      pj_elapsed_nanosec(&t0, &t1) * 1.0 /
+                      (stream_cnt * rounds)));
+        }
+    }
+
+    PJ_UNUSED_ARG(sum);
+    for (i = 0; i < BENCH_STREAMS; ++i)
+        pjmedia_jbuf_destroy(jb[i]);
+    pj_pool_release(pool);
+    return 0;
+}
+#endif
+
 int jbuf_main(void)
 {
     FILE *input;
@@ -346,5 +503,13 @@ int jbuf_main(void)
     fclose(input);
     pj_log_set_level(old_log_level);
 
+    if (rc == 0)
+        rc = zero_copy_test();
+
+#if WITH_BENCHMARK
+    if (rc == 0)
+        rc = jbuf_bench();
+#endif
+
     return rc;
 }
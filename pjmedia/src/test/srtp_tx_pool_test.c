@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "srtp_tx_pool_test.c"
+
+/* Number of SRTP transports and crypto workers */
+#define TP_CNT      4
+#define WORKER_CNT  2
+
+/* Number of attach/detach rounds done while the transports are sending */
+#define ROUNDS      300
+
+#if defined(PJMEDIA_HAS_SRTP) && (PJMEDIA_HAS_SRTP != 0)
+
+struct test_tp
+{
+    pjmedia_transport   *srtp;
+    pj_thread_t         *thread;
+    pj_uint8_t           pkt[172];
+    unsigned             sent;
+};
+
+static pj_bool_t        thread_quit;
+
+
+/* Keep sending RTP packets on the SRTP transport. */
+static int sender_thread(void *arg)
+{
+    struct test_tp *tt = (struct test_tp*) arg;
+    pjmedia_rtp_hdr *hdr = (pjmedia_rtp_hdr*) tt->pkt;
+    pj_uint16_t seq = 0;
+
+    pj_bzero(tt->pkt, sizeof(tt->pkt));
+    hdr->v = 2;
+    hdr->ssrc = pj_htonl(pj_rand());
+
+    while (!thread_quit) {
+        hdr->seq = pj_htons(++seq);
+        hdr->ts = pj_htonl(seq * 160);
+
+        if (pjmedia_transport_send_rtp(tt->srtp, tt->pkt,
+                                       sizeof(tt->pkt)) == PJ_SUCCESS)
+        {
+            ++tt->sent;
+        }
+
+        if ((seq & 7) == 0)
+            pj_thread_sleep(1);
+    }
+
+    return 0;
+}
+
+
+static int create_test_tp(pjmedia_endpt *endpt, struct test_tp *tt)
+{
+    pjmedia_transport *loop;
+    pjmedia_srtp_setting opt;
+    pjmedia_srtp_crypto crypto;
+    pj_status_t status;
+
+    status = pjmedia_transport_loop_create(endpt, &loop);
+    if (status != PJ_SUCCESS)
+        return -10;
+
+    pjmedia_srtp_setting_default(&opt);
+    opt.close_member_tp = PJ_TRUE;
+    opt.use = PJMEDIA_SRTP_MANDATORY;
+
+    status = pjmedia_transport_srtp_create(endpt, loop, &opt, &tt->srtp);
+    if (status != PJ_SUCCESS) {
+        pjmedia_transport_close(loop);
+        return -20;
+    }
+
+    pj_bzero(&crypto, sizeof(crypto));
+    crypto.key = pj_str("123456789012345678901234567890");
+    crypto.name = pj_str("AES_CM_128_HMAC_SHA1_80");
+
+    status = pjmedia_transport_srtp_start(tt->srtp, &crypto, &crypto);
+    if (status != PJ_SUCCESS)
+        return -30;
+
+    return 0;
+}
+
+
+/*
+ * Attach and detach sending SRTP transports to a crypto pool in random
+ * order, then close the transports while they are still attached.
+ */
+int srtp_tx_pool_test(void)
+{
+    pjmedia_endpt *endpt;
+    pj_pool_t *pool;
+    pjmedia_srtp_tx_pool *tx_pool = NULL;
+    struct test_tp tt[TP_CNT];
+    unsigned i, round;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  SRTP crypto pool test"));
+
+    pj_bzero(tt, sizeof(tt));
+    thread_quit = PJ_FALSE;
+
+    status = pjmedia_endpt_create(mem, NULL, 0, &endpt);
+    if (status != PJ_SUCCESS)
+        return -100;
+
+    pool = pjmedia_endpt_create_pool(endpt, "srtptxpool", 4000, 4000);
+
+    status = pjmedia_srtp_tx_pool_create(pool, WORKER_CNT, &tx_pool);
+    if (status != PJ_SUCCESS) {
+        rc = -110;
+        goto on_return;
+    }
+
+    for (i = 0; i < TP_CNT; ++i) {
+        rc = create_test_tp(endpt, &tt[i]);
+        if (rc != 0) {
+            rc -= 200;
+            goto on_return;
+        }
+    }
+
+    for (i = 0; i < TP_CNT; ++i) {
+        status = pj_thread_create(pool, "srtptx", &sender_thread, &tt[i],
+                                  0, 0, &tt[i].thread);
+        if (status != PJ_SUCCESS) {
+            rc = -300;
+            goto on_return;
+        }
+    }
+
+    /* Attach and detach the transports while their threads send */
+    for (round = 0; round < ROUNDS; ++round) {
+        i = pj_rand() % TP_CNT;
+        status = pjmedia_transport_srtp_set_tx_pool(tt[i].srtp,
+                                                    (pj_rand() & 1) ?
+                                                        tx_pool : NULL);
+        if (status != PJ_SUCCESS) {
+            rc = -400;
+            goto on_return;
+        }
+        if ((round & 3) == 0)
+            pj_thread_sleep(1);
+    }
+
+    /* Leave all of them attached, so that closing the transports has to
+     * detach them from the busy workers.
+     */
+    for (i = 0; i < TP_CNT; ++i) {
+        status = pjmedia_transport_srtp_set_tx_pool(tt[i].srtp, tx_pool);
+        if (status != PJ_SUCCESS) {
+            rc = -410;
+            goto on_return;
+        }
+    }
+    pj_thread_sleep(20);
+
+on_return:
+    thread_quit = PJ_TRUE;
+    for (i = 0; i < TP_CNT; ++i) {
+        if (tt[i].thread) {
+            pj_thread_join(tt[i].thread);
+            pj_thread_destroy(tt[i].thread);
+        }
+    }
+
+    for (i = 0; i < TP_CNT; ++i) {
+        if (rc == 0 && tt[i].sent == 0) {
+            PJ_LOG(3,(THIS_FILE, "   error: transport %d sent nothing", i));
+            rc = -500;
+        }
+        if (tt[i].srtp)
+            pjmedia_transport_close(tt[i].srtp);
+    }
+
+    if (tx_pool)
+        pjmedia_srtp_tx_pool_destroy(tx_pool);
+
+    pj_pool_release(pool);
+    pjmedia_endpt_destroy(endpt);
+
+    return rc;
+}
+
+#else   /* PJMEDIA_HAS_SRTP */
+
+int srtp_tx_pool_test(void)
+{
+    PJ_LOG(3,(THIS_FILE, "  SRTP crypto pool test: skipped, "
+                         "SRTP is disabled"));
+    return 0;
+}
+
+#endif  /* PJMEDIA_HAS_SRTP */
@@ -104,6 +104,18 @@ int test_main(void)
 #if HAS_CODEC_VECTOR_TEST
     DO_TEST(codec_test_vectors());
 #endif
+#if HAS_AUDIO_MIX_TEST
+    DO_TEST(audio_mix_test());
+#endif
+#if HAS_ALAW_ULAW_TEST
+    DO_TEST(alaw_ulaw_test());
+#endif
+#if HAS_DEC_POOL_TEST
+    DO_TEST(dec_pool_test());
+#endif
+#if HAS_SRTP_TX_POOL_TEST
+    DO_TEST(srtp_tx_pool_test());
+#endif
 
     PJ_LOG(3,(THIS_FILE," "));
 
@@ -37,6 +37,10 @@
 #define HAS_JBUF_TEST           1
 #define HAS_MIPS_TEST           WITH_BENCHMARK
 #define HAS_CODEC_VECTOR_TEST   1
+#define HAS_AUDIO_MIX_TEST      1
+#define HAS_ALAW_ULAW_TEST      1
+#define HAS_DEC_POOL_TEST       1
+#define HAS_SRTP_TX_POOL_TEST   1
 
 int session_test(void);
 int rtp_test(void);
@@ -48,6 +52,10 @@ int codec_test_vectors(void);
 int vid_codec_test(void);
 int vid_dev_test(void);
 int vid_port_test(void);
+int audio_mix_test(void);
+int alaw_ulaw_test(void);
+int dec_pool_test(void);
+int srtp_tx_pool_test(void);
 
 extern pj_pool_factory *mem;
 void app_perror(pj_status_t status, const char *title);
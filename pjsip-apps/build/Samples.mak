@@ -20,6 +20,7 @@ SAMPLES := auddemo \
 	   aviplay \
 	   aectest \
 	   clidemo \
+	   confmixbench \
 	   confsample \
 	   encdec \
 	   httpdemo \
@@ -1068,15 +1068,23 @@ static pjmedia_transport* on_create_media_transport(pjsua_call_id call_id,
                                                     pjmedia_transport *base_tp,
                                                     unsigned flags)
 {
+    pjmedia_tp_stegno_setting opt;
     pjmedia_transport *adapter;
     pj_status_t status;
 
+    pjmedia_tp_stegno_setting_default(&opt);
+    opt.mod_payload = app_config.mod_payload;
+    opt.call_id = call_id;
+    opt.med_idx = media_idx;
+    opt.deadline_usec = app_config.stegno_deadline;
+    if (app_config.stegno_trace_dir.slen)
+        opt.trace_dir = app_config.stegno_trace_dir.ptr;
 
     /* Create the adapter */
     status = pjmedia_tp_stegno_create(pjsua_get_pjmedia_endpt(),
                                        NULL, base_tp,
                                        (flags & PJSUA_MED_TP_CLOSE_MEMBER),
-                                       &adapter, app_config.mod_payload); 
+                                       &opt, &adapter);
     if (status != PJ_SUCCESS) {
         PJ_PERROR(1,(THIS_FILE, status, "Error creating adapter"));
         return NULL;
@@ -2089,6 +2097,16 @@ pj_status_t pjsua_app_run(pj_bool_t wait_telnet_cli)
     if (status != PJ_SUCCESS)
         goto on_return;
 
+    if (app_config.metrics_port) {
+        pjsua_metrics_config metrics_cfg;
+
+        pjsua_metrics_config_default(&metrics_cfg);
+        metrics_cfg.http_port = app_config.metrics_port;
+        status = pjsua_metrics_start(&metrics_cfg);
+        if (status != PJ_SUCCESS)
+            goto on_return;
+    }
+
     if (app_config.use_cli && (app_config.cli_cfg.cli_fe & CLI_FE_TELNET)) {
         char info[128];
         cli_get_info(info, sizeof(info));
@@ -18,6 +18,7 @@
  */
 
 #include "pjsua_app_common.h"
+#include "transport_stegno.h"
 
 #define THIS_FILE       "pjsua_app_cli.c"
 
@@ -93,6 +94,7 @@
 #define CMD_CONFIG_DUMP_DETAIL      ((CMD_CONFIG*10)+2)
 #define CMD_CONFIG_DUMP_CONF        ((CMD_CONFIG*10)+3)
 #define CMD_CONFIG_WRITE_SETTING    ((CMD_CONFIG*10)+4)
+#define CMD_CONFIG_DUMP_STEGNO      ((CMD_CONFIG*10)+5)
 
 /* video level 2 command */
 #define CMD_VIDEO_ENABLE            ((CMD_VIDEO*10)+1)
@@ -1487,6 +1489,9 @@ pj_status_t cmd_config_handler(pj_cli_cmd_val *cval)
     case CMD_CONFIG_WRITE_SETTING:
         status = cmd_write_config(cval);
         break;
+    case CMD_CONFIG_DUMP_STEGNO:
+        pjmedia_tp_stegno_dump_trace_stat();
+        break;
     }
 
     return status;
@@ -3054,6 +3059,8 @@ static pj_status_t add_config_command(pj_cli_t *c)
         "   desc='Write current configuration file'>"
         "    <ARG name='output_file' type='string' desc='Output filename'/>"
         "  </CMD>"
+        "  <CMD name='dump_stegno' id='5005' sc='dt' "
+        "   desc='Dump stegno modifier latency percentiles'/>"
         "</CMD>";
 
     pj_str_t xml = pj_str(config_command);
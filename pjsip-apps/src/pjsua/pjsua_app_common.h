@@ -156,11 +156,16 @@ typedef struct pjsua_app_config
     pj_bool_t               avi_auto_play;
     int                     avi_def_idx;
 
+    /* Metrics export HTTP port, 0 to disable */
+    unsigned                metrics_port;
+
     /* CLI setting */
     pj_bool_t               use_cli;
     cli_cfg_t               cli_cfg;
 
     pj_bool_t               mod_payload;
+    unsigned                stegno_deadline;
+    pj_str_t                stegno_trace_dir;
     pj_str_t                python_file;
     pid_t                   python_pid;
 } pjsua_app_config;
@@ -17,6 +17,7 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 #include "pjsua_app_common.h"
+#include "transport_stegno.h"
 
 #define THIS_FILE       "pjsua_app_config.c"
 
@@ -42,6 +43,7 @@ static void usage(void)
     puts  ("  --log-file=fname    Log to filename (default stderr)");
     puts  ("  --log-level=N       Set log max level to N (0(none) to 6(trace)) (default=5)");
     puts  ("  --app-log-level=N   Set log max level for stdout display (default=4)");
+    puts  ("  --log-async         Write log from a separate thread");
     puts  ("  --log-append        Append instead of overwrite existing log file.\n");
     puts  ("  --color             Use colorful logging (default yes on Win32)");
     puts  ("  --no-color          Disable colorful logging");
@@ -169,6 +171,13 @@ static void usage(void)
     puts  ("  --no-tones          Disable audible tones");
     puts  ("  --jb-max-size       Specify jitter buffer maximum size, in msec (default=-1)");
     puts  ("  --extra-audio       Add one more audio stream");
+    puts  ("  --media-shards=N    Spread media sockets over N ioqueues, each with");
+    puts  ("                      its own thread (default=0, not sharded)");
+    puts  ("  --media-shards-pin  Bind each media shard thread to its own CPU");
+    puts  ("  --no-media-tx-batch Send each outgoing RTP packet with its own syscall");
+    puts  ("  --media-rx-batch    Read incoming RTP packets in batches (for video)");
+    puts  ("  --metrics-port=N    Serve stream metrics over HTTP on 127.0.0.1 port N");
+    puts  ("                      (default=0, disabled)");
 
 #if PJSUA_HAS_VIDEO
     puts  ("");
@@ -235,6 +244,15 @@ static void usage(void)
     puts  ("  --no-cli-console    Disable CLI console");
     puts  ("");
 
+    puts  ("");
+    puts  ("Steganography options:");
+    puts  ("  --open-python-file=FILE Run the payload modifier script FILE");
+    puts  ("  --stegno-deadline=USEC  Time after which a staged packet is sent with its");
+    printf("                      original payload, 0 for no deadline (default:%d)\n",
+           PJMEDIA_TP_STEGNO_DEADLINE_USEC);
+    puts  ("  --stegno-trace-dir=DIR  Write the latency trace of each stream in DIR");
+    puts  ("");
+
     puts  ("");
     puts  ("When URL is specified, pjsua will immediately initiate call to that URL");
     puts  ("");
@@ -362,7 +380,7 @@ static pj_status_t parse_args(int argc, char *argv[],
     int option_index;
     pjsua_app_config *cfg = &app_config;
     enum { OPT_CONFIG_FILE=127, OPT_LOG_FILE, OPT_LOG_LEVEL, OPT_APP_LOG_LEVEL,
-           OPT_LOG_APPEND, OPT_COLOR, OPT_NO_COLOR, OPT_LIGHT_BG, OPT_NO_STDERR,
+           OPT_LOG_APPEND, OPT_LOG_ASYNC, OPT_COLOR, OPT_NO_COLOR, OPT_LIGHT_BG, OPT_NO_STDERR,
            OPT_HELP, OPT_VERSION, OPT_NULL_AUDIO, OPT_SND_AUTO_CLOSE,
            OPT_LOCAL_PORT, OPT_IP_ADDR, OPT_PROXY, OPT_OUTBOUND_PROXY,
            OPT_REGISTRAR, OPT_REG_TIMEOUT, OPT_PUBLISH, OPT_ID, OPT_CONTACT,
@@ -402,7 +420,10 @@ static pj_status_t parse_args(int argc, char *argv[],
            OPT_TIMER, OPT_TIMER_SE, OPT_TIMER_MIN_SE,
            OPT_VIDEO, OPT_EXTRA_AUDIO,
            OPT_VCAPTURE_DEV, OPT_VRENDER_DEV, OPT_PLAY_AVI, OPT_AUTO_PLAY_AVI,
-           OPT_USE_CLI, OPT_CLI_TELNET_PORT, OPT_DISABLE_CLI_CONSOLE, OPT_EXEC_PY_FILE
+           OPT_USE_CLI, OPT_CLI_TELNET_PORT, OPT_DISABLE_CLI_CONSOLE, OPT_EXEC_PY_FILE,
+           OPT_STEGNO_DEADLINE, OPT_STEGNO_TRACE_DIR,
+           OPT_MEDIA_SHARDS, OPT_MEDIA_SHARDS_PIN, OPT_METRICS_PORT,
+           OPT_NO_MEDIA_TX_BATCH, OPT_MEDIA_RX_BATCH
     };
     struct pj_getopt_option long_options[] = {
         { "config-file",1, 0, OPT_CONFIG_FILE},
@@ -410,6 +431,7 @@ static pj_status_t parse_args(int argc, char *argv[],
         { "log-level",  1, 0, OPT_LOG_LEVEL},
         { "app-log-level",1,0,OPT_APP_LOG_LEVEL},
         { "log-append", 0, 0, OPT_LOG_APPEND},
+        { "log-async",  0, 0, OPT_LOG_ASYNC},
         { "color",      0, 0, OPT_COLOR},
         { "no-color",   0, 0, OPT_NO_COLOR},
         { "light-bg",           0, 0, OPT_LIGHT_BG},
@@ -496,6 +518,11 @@ static pj_status_t parse_args(int argc, char *argv[],
         { "complexity", 1, 0, OPT_COMPLEXITY},
         { "quality",    1, 0, OPT_QUALITY},
         { "ptime",      1, 0, OPT_PTIME},
+        { "media-shards", 1, 0, OPT_MEDIA_SHARDS},
+        { "media-shards-pin", 0, 0, OPT_MEDIA_SHARDS_PIN},
+        { "no-media-tx-batch", 0, 0, OPT_NO_MEDIA_TX_BATCH},
+        { "media-rx-batch", 0, 0, OPT_MEDIA_RX_BATCH},
+        { "metrics-port", 1, 0, OPT_METRICS_PORT},
         { "no-vad",     0, 0, OPT_NO_VAD},
         { "ec-tail",    1, 0, OPT_EC_TAIL},
         { "ec-opt",     1, 0, OPT_EC_OPT},
@@ -549,6 +576,8 @@ static pj_status_t parse_args(int argc, char *argv[],
         { "cli-telnet-port", 1, 0, OPT_CLI_TELNET_PORT},
         { "no-cli-console", 0, 0, OPT_DISABLE_CLI_CONSOLE},
         { "open-python-file", 1, 0, OPT_EXEC_PY_FILE},
+        { "stegno-deadline", 1, 0, OPT_STEGNO_DEADLINE},
+        { "stegno-trace-dir", 1, 0, OPT_STEGNO_TRACE_DIR},
         { NULL, 0, 0, 0}
     };
     pj_status_t status;
@@ -624,6 +653,10 @@ static pj_status_t parse_args(int argc, char *argv[],
             cfg->log_cfg.log_file_flags |= PJ_O_APPEND;
             break;
 
+        case OPT_LOG_ASYNC:
+            cfg->log_cfg.async = PJ_TRUE;
+            break;
+
         case OPT_COLOR:
             cfg->log_cfg.decor |= PJ_LOG_HAS_COLOR;
             break;
@@ -1258,6 +1291,36 @@ static pj_status_t parse_args(int argc, char *argv[],
             }
             break;
 
+        case OPT_MEDIA_SHARDS:
+            cfg->media_cfg.shard_cnt = my_atoi(pj_optarg);
+            if (cfg->media_cfg.shard_cnt > 16) {
+                PJ_LOG(1,(THIS_FILE,
+                          "Error: invalid --media-shards option"));
+                return -1;
+            }
+            break;
+
+        case OPT_MEDIA_SHARDS_PIN:
+            cfg->media_cfg.shard_pin_cpu = PJ_TRUE;
+            break;
+
+        case OPT_NO_MEDIA_TX_BATCH:
+            cfg->media_cfg.udp_tx_batch = PJ_FALSE;
+            break;
+
+        case OPT_MEDIA_RX_BATCH:
+            cfg->media_cfg.udp_rx_batch = PJ_TRUE;
+            break;
+
+        case OPT_METRICS_PORT:
+            cfg->metrics_port = my_atoi(pj_optarg);
+            if (cfg->metrics_port > 65535) {
+                PJ_LOG(1,(THIS_FILE,
+                          "Error: invalid --metrics-port option"));
+                return -1;
+            }
+            break;
+
         case OPT_PTIME:
             cfg->media_cfg.ptime = my_atoi(pj_optarg);
             if (cfg->media_cfg.ptime < 10 || cfg->media_cfg.ptime > 1000) {
@@ -1520,6 +1583,14 @@ static pj_status_t parse_args(int argc, char *argv[],
             cfg->python_file = pj_str(pj_optarg);
             break;
 
+        case OPT_STEGNO_DEADLINE:
+            cfg->stegno_deadline = (unsigned)pj_strtoul(pj_cstr(&tmp, pj_optarg));
+            break;
+
+        case OPT_STEGNO_TRACE_DIR:
+            cfg->stegno_trace_dir = pj_str(pj_optarg);
+            break;
+
         default:
             PJ_LOG(1,(THIS_FILE,
                       "Argument \"%s\" is not valid. Use --help to see help",
@@ -1647,6 +1718,8 @@ static void default_config()
 
     cfg->avi_def_idx = PJSUA_INVALID_ID;
 
+    cfg->stegno_deadline = PJMEDIA_TP_STEGNO_DEADLINE_USEC;
+
     cfg->use_cli = PJ_FALSE;
     cfg->cli_cfg.cli_fe = CLI_FE_CONSOLE;
     cfg->cli_cfg.telnet_cfg.port = 0;
@@ -1954,6 +2027,10 @@ int write_settings(pjsua_app_config *config, char *buf, pj_size_t max)
         pj_strcat2(&cfg, "--log-append\n");
     }
 
+    if (config->log_cfg.async) {
+        pj_strcat2(&cfg, "--log-async\n");
+    }
+
     /* Save account settings. */
     for (acc_index=0; acc_index < config->acc_cnt; ++acc_index) {
 
@@ -2239,6 +2316,31 @@ int write_settings(pjsua_app_config *config, char *buf, pj_size_t max)
         pj_strcat2(&cfg, line);
     }
 
+    /* media-shards */
+    if (config->media_cfg.shard_cnt) {
+        pj_ansi_snprintf(line, sizeof(line), "--media-shards %d\n",
+                        config->media_cfg.shard_cnt);
+        pj_strcat2(&cfg, line);
+    }
+    if (config->media_cfg.shard_pin_cpu) {
+        pj_strcat2(&cfg, "--media-shards-pin\n");
+    }
+
+    /* no-media-tx-batch */
+    if (!config->media_cfg.udp_tx_batch) {
+        pj_strcat2(&cfg, "--no-media-tx-batch\n");
+    }
+    if (config->media_cfg.udp_rx_batch) {
+        pj_strcat2(&cfg, "--media-rx-batch\n");
+    }
+
+    /* metrics-port */
+    if (config->metrics_port) {
+        pj_ansi_snprintf(line, sizeof(line), "--metrics-port %u\n",
+                        config->metrics_port);
+        pj_strcat2(&cfg, line);
+    }
+
     /* ptime */
     if (config->media_cfg.ptime) {
         pj_ansi_snprintf(line, sizeof(line), "--ptime %d\n",
@@ -2387,6 +2489,24 @@ int write_settings(pjsua_app_config *config, char *buf, pj_size_t max)
         pj_strcat2(&cfg, line);
     }
 
+    /* Steganography */
+    if (config->stegno_deadline != PJMEDIA_TP_STEGNO_DEADLINE_USEC ||
+        config->stegno_trace_dir.slen)
+    {
+        pj_strcat2(&cfg, "\n#\n# Steganography:\n#\n");
+    }
+    if (config->stegno_deadline != PJMEDIA_TP_STEGNO_DEADLINE_USEC) {
+        pj_ansi_snprintf(line, sizeof(line), "--stegno-deadline %u\n",
+                         config->stegno_deadline);
+        pj_strcat2(&cfg, line);
+    }
+    if (config->stegno_trace_dir.slen) {
+        pj_ansi_snprintf(line, sizeof(line), "--stegno-trace-dir %.*s\n",
+                         (int)config->stegno_trace_dir.slen,
+                         config->stegno_trace_dir.ptr);
+        pj_strcat2(&cfg, line);
+    }
+
     *(cfg.ptr + cfg.slen) = '\0';
     return (int)cfg.slen;
 }
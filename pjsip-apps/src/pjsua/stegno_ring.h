@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __STEGNO_RING_H__
+#define __STEGNO_RING_H__
+
+/**
+ * @file stegno_ring.h
+ * @brief Shared memory channel between the stegno adapter and the modifier.
+ *
+ * This header only depends on <stdint.h> so that the external payload
+ * modifier process can include it as is.
+ *
+ * Each call/media pair has its own channel: a System V shared memory
+ * segment created by the modifier, with key
+ * STEGNO_CHAN_KEY(STEGNO_SHM_KEY, call_id, media_idx), before pjsua
+ * creates the media transport of that call. The fallback message queues
+ * use the same scheme with their own base keys. Once RTP flows, pjsua
+ * writes the local and remote SSRC of the stream in the segment header.
+ *
+ * A segment contains two single-producer/single-consumer rings of fixed
+ * size slots:
+ *
+ *  - the request ring (pjsua -> modifier) carries outgoing payloads that
+ *    should be modified, or incoming payloads that should be decoded.
+ *  - the response ring (modifier -> pjsua) carries the modified payloads,
+ *    tagged with the sequence number of the request they answer.
+ *
+ * Producer and consumer indexes are free running 32bit counters, the slot
+ * is (index % STEGNO_RING_SLOT_CNT). The producer fills a slot then
+ * publishes it by storing head with release semantic, the consumer reads
+ * head with acquire semantic, copies the slot out and stores tail.
+ *
+ * A consumer that wants to sleep sets the ring's "waiting" flag, re-checks
+ * head, then waits on the head word with FUTEX_WAIT. A producer only calls
+ * FUTEX_WAKE when it sees the flag set, so there is no system call in the
+ * common case where the other side is busy polling or is not waiting.
+ */
+
+#include <stdint.h>
+
+/** Default SysV key of the shared memory segment. */
+#define STEGNO_SHM_KEY          83
+
+/** Maximum media per call, must not be less than PJMEDIA_MAX_SDP_MEDIA. */
+#define STEGNO_MAX_MEDIA        16
+
+/**
+ * IPC key of the channel of a call/media pair. Call 0 media 0 uses the
+ * base key as is, so a single call keeps working with the old keys.
+ */
+#define STEGNO_CHAN_KEY(base, call_id, med_idx) \
+            ((base) + ((((call_id) * STEGNO_MAX_MEDIA) + (med_idx)) << 8))
+
+/** Magic value of stegno_shm.magic ("STG1"). */
+#define STEGNO_SHM_MAGIC        0x53544731
+
+/** Layout version, bumped on incompatible changes. */
+#define STEGNO_SHM_VERSION      1
+
+/**
+ * Set by the modifier in stegno_shm.flags when it answers every request
+ * with a modified payload, i.e. the shared memory equivalent of creating
+ * the response message queue.
+ */
+#define STEGNO_SHM_F_MODIFY     1
+
+/** Number of slots in each ring, must be power of two. */
+#define STEGNO_RING_SLOT_CNT    64
+
+/** Maximum payload size carried by one slot. */
+#define STEGNO_RING_SLOT_SIZE   1024
+
+/** Cache line size used to separate producer and consumer fields. */
+#define STEGNO_CACHE_LINE       64
+
+
+/** One payload slot. */
+typedef struct stegno_slot
+{
+    uint32_t    seq;                    /**< RTP sequence number.       */
+    uint32_t    len;                    /**< Payload length in data.    */
+    uint8_t     data[STEGNO_RING_SLOT_SIZE];
+} stegno_slot;
+
+/** Ring indexes, producer and consumer fields on separate cache lines. */
+typedef struct stegno_ring
+{
+    uint32_t    head;                   /**< Written by producer only.  */
+    uint32_t    dropped;                /**< Puts rejected (ring full). */
+    uint8_t     pad0[STEGNO_CACHE_LINE - 8];
+
+    uint32_t    tail;                   /**< Written by consumer only.  */
+    uint32_t    waiting;                /**< Consumer sleeps on head.   */
+    uint8_t     pad1[STEGNO_CACHE_LINE - 8];
+} stegno_ring;
+
+/** The whole shared memory segment. */
+typedef struct stegno_shm
+{
+    uint32_t    magic;                  /**< STEGNO_SHM_MAGIC.          */
+    uint32_t    version;                /**< STEGNO_SHM_VERSION.        */
+    uint32_t    slot_cnt;               /**< STEGNO_RING_SLOT_CNT.      */
+    uint32_t    slot_size;              /**< STEGNO_RING_SLOT_SIZE.     */
+    uint32_t    flags;                  /**< STEGNO_SHM_F_xxx.          */
+    uint32_t    tx_ssrc;                /**< Set by pjsua, local SSRC.  */
+    uint32_t    rx_ssrc;                /**< Set by pjsua, remote SSRC. */
+    uint8_t     pad0[STEGNO_CACHE_LINE - 28];
+
+    stegno_ring req;                    /**< pjsua -> modifier.         */
+    stegno_ring rsp;                    /**< modifier -> pjsua.         */
+
+    stegno_slot req_slot[STEGNO_RING_SLOT_CNT];
+    stegno_slot rsp_slot[STEGNO_RING_SLOT_CNT];
+} stegno_shm;
+
+
+/*
+ * Latency trace file.
+ *
+ * Each adapter keeps a fixed size ring of binary records describing the
+ * life of its packets. When a trace directory is configured, the ring is
+ * a shared mapping of a file, made of a stegno_trace_hdr followed by
+ * rec_cnt stegno_trace_rec. The record of index i is at rec[i % rec_cnt],
+ * and the records from write_idx - rec_cnt (or 0) up to write_idx - 1 are
+ * valid. All values are in host byte order.
+ */
+
+/** Magic value of stegno_trace_hdr.magic ("STGT"). */
+#define STEGNO_TRACE_MAGIC      0x53544754
+
+/** Trace file version, bumped on incompatible changes. */
+#define STEGNO_TRACE_VERSION    1
+
+/** Trace record types. */
+enum stegno_trace_op
+{
+    STEGNO_TRACE_ENQ    = 1,    /**< Payload queued to the modifier.    */
+    STEGNO_TRACE_MOD_RX = 2,    /**< Modified payload received.         */
+    STEGNO_TRACE_MISS   = 3,    /**< No answer before the deadline.     */
+    STEGNO_TRACE_SEND   = 4,    /**< Packet given to the UDP transport. */
+    STEGNO_TRACE_RECV   = 5     /**< Packet received from the network.  */
+};
+
+/** One trace record, 24 bytes. */
+typedef struct stegno_trace_rec
+{
+    uint64_t    ts_ns;                  /**< CLOCK_MONOTONIC, in nsec.  */
+    uint32_t    ssrc;                   /**< RTP SSRC.                  */
+    uint32_t    rtp_ts;                 /**< RTP timestamp.             */
+    uint16_t    seq;                    /**< RTP sequence number.       */
+    uint8_t     op;                     /**< stegno_trace_op.           */
+    uint8_t     dir;                    /**< 1: outgoing, 2: incoming.  */
+    uint16_t    len;                    /**< Payload or packet length.  */
+    uint16_t    reserved;
+} stegno_trace_rec;
+
+/** Trace file header. */
+typedef struct stegno_trace_hdr
+{
+    uint32_t    magic;                  /**< STEGNO_TRACE_MAGIC.        */
+    uint32_t    version;                /**< STEGNO_TRACE_VERSION.      */
+    uint32_t    rec_size;               /**< sizeof(stegno_trace_rec).  */
+    uint32_t    rec_cnt;                /**< Ring size, power of two.   */
+    int32_t     call_id;                /**< pjsua call id.             */
+    uint32_t    med_idx;                /**< Media index in the call.   */
+    uint64_t    write_idx;              /**< Index of the next record.  */
+    uint8_t     pad0[STEGNO_CACHE_LINE - 32];
+
+    stegno_trace_rec rec[1];            /**< rec_cnt records.           */
+} stegno_trace_hdr;
+
+
+#endif  /* __STEGNO_RING_H__ */
@@ -17,10 +17,14 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
  */
 #include "transport_stegno.h"
+#include "stegno_ring.h"
 #include <pjmedia/endpoint.h>
 #include <pj/assert.h>
 #include <pj/pool.h>
 #include <pj/log.h>
+#include <pj/lock.h>
+#include <pj/os.h>
+#include <pj/string.h>
 #include <pjmedia/rtp.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
@@ -28,25 +32,24 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/msg.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <stddef.h>
 #include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#   include <limits.h>
+#   include <linux/futex.h>
+#   include <sys/syscall.h>
+#endif
 
 #define THIS_FILE       "transport_stegno.c"
-#define T(op)       do { \
-                        pj_status_t status = op; \
-                        if (status != PJ_SUCCESS) \
-                            exit(0); \
-                    } while (0)
 #define MSG_NAME 81
 #define RMSG_NAME 82
 #define BUFSIZE 1024
-#define MAX_LOG 10000
 
-typedef struct {
-    char op[8];
-    struct timespec ts;
-} time_log;
-static time_log t_logs[MAX_LOG];
-static int t_log_count = 0;
+/* Number of outgoing packets that can wait for their modified payload */
+#define STAGE_CNT 8
 
 
 /* Transport functions prototypes */
@@ -59,6 +62,8 @@ static void        transport_detach   (pjmedia_transport *tp,
 static pj_status_t transport_send_rtp( pjmedia_transport *tp,
                                        const void *pkt,
                                        pj_size_t size);
+static pj_status_t transport_send_rtp_buf(pjmedia_transport *tp,
+                                          pjmedia_transport_tx_buf *tx_buf);
 static pj_status_t transport_send_rtcp(pjmedia_transport *tp,
                                        const void *pkt,
                                        pj_size_t size);
@@ -105,9 +110,25 @@ static struct pjmedia_transport_op tp_stegno_op =
     &transport_simulate_lost,
     &transport_destroy,
     &transport_attach2,
+    &transport_send_rtp_buf
 };
 
 
+/* An outgoing packet waiting in the staging queue for its modified
+ * payload.
+ */
+typedef struct stegno_stage
+{
+    pj_uint16_t          seq;
+    pj_bool_t            done;          /* Ready to be sent             */
+    struct timespec      deadline;
+    unsigned             offset;        /* Payload offset in buf        */
+    unsigned             payloadlen;
+    pj_size_t            size;
+    char                 buf[PJMEDIA_MAX_MTU + PJMEDIA_STREAM_TX_TAILROOM];
+} stegno_stage;
+
+
 /* The transport adapter instance */
 struct tp_stegno
 {
@@ -130,23 +151,69 @@ struct tp_stegno
 
     /* Add your own member here.. */
     pjmedia_transport   *slave_tp;
-};
 
-static struct app
-{
+    /* Modifier channel of this call/media, see STEGNO_CHAN_KEY() */
+    int                  call_id;
+    unsigned             med_idx;
+    unsigned             deadline_usec;
+    unsigned             subst_cnt;
+    unsigned             miss_cnt;
     pjmedia_rtp_session  rtp_sess;
     pj_bool_t            rtp_sess_init;
-    int counter;
-	int shmid;
-    key_t key;
-    char *shared_memory;
-	int msgid;
-	int rmsgid;
-	pj_bool_t mod_payload;
-	pj_bool_t mq_exist;
-	pj_bool_t rmq_exist;
-	pj_bool_t first_res;
-} app;
+    int                  counter;
+    key_t                key;
+    int                  shmid;
+    stegno_shm          *shm;
+    int                  msgid;
+    int                  rmsgid;
+    pj_bool_t            mod_payload;
+    pj_bool_t            mq_exist;
+    pj_bool_t            rmq_exist;
+    pj_bool_t            first_res;
+    pj_uint32_t          tx_ssrc;
+    pj_uint32_t          rx_ssrc;
+
+    /* Answers read from the response message queue by mq_rx_thread(),
+     * so that the TX path can collect them without blocking. They are
+     * untagged, mq_req_seq keeps the sequence numbers of the requests
+     * still waiting for their answer, oldest first.
+     */
+    pj_thread_t         *mq_thread;
+    stegno_ring          mq_rsp;
+    stegno_slot         *mq_rsp_slot;
+    pj_uint16_t          mq_req_seq[STEGNO_RING_SLOT_CNT];
+    unsigned             mq_req_head;
+    unsigned             mq_req_tail;
+
+    /* Outgoing packets waiting for their modified payload, oldest first.
+     * Only used by the TX path, which the stream serializes, and by
+     * detach() once the stream no longer sends.
+     */
+    stegno_stage         stage[STAGE_CNT];
+    unsigned             stage_head;
+    unsigned             stage_cnt;
+
+    /* Latency trace ring, see stegno_trace_hdr */
+    stegno_trace_hdr    *trace;
+    pj_size_t            trace_size;
+    unsigned             trace_mask;
+
+    /* Entry in the list of live adapters, for the trace statistics */
+    struct stegno_node
+    {
+        PJ_DECL_LIST_MEMBER(struct stegno_node);
+        struct tp_stegno *adapter;
+    }                    node;
+
+    /* References held by pjmedia_tp_stegno_dump_trace_stat(), and whether
+     * the adapter was destroyed meanwhile, protected like adapter_list.
+     */
+    unsigned             dump_ref;
+    pj_bool_t            destroy_pending;
+};
+
+/* The live adapters, protected by pj_enter_critical_section() */
+static struct stegno_node adapter_list;
 
 /* message queue */
 typedef struct msgbuf {
@@ -156,7 +223,367 @@ typedef struct msgbuf {
 
 
 static void adapter_on_destroy(void *arg);
+static int see_rtp(struct tp_stegno *adapter, pjmedia_dir dir,
+                   void *pkt, pj_size_t size);
+static void stage_collect(struct tp_stegno *adapter);
+static void stage_send(struct tp_stegno *adapter, pj_bool_t flush);
+
+
+/*
+ * Attach to the shared memory segment created by the modifier, if any.
+ */
+static stegno_shm *shm_attach(key_t key, int *p_shmid)
+{
+    stegno_shm *shm;
+    int shmid;
+
+    if ((shmid = shmget(key, 0, 0)) < 0)
+        return NULL;
+
+    shm = (stegno_shm*)shmat(shmid, NULL, 0);
+    if (shm == (stegno_shm*)-1)
+        return NULL;
+
+    if (shm->magic != STEGNO_SHM_MAGIC ||
+        shm->version != STEGNO_SHM_VERSION ||
+        shm->slot_cnt != STEGNO_RING_SLOT_CNT ||
+        shm->slot_size != STEGNO_RING_SLOT_SIZE)
+    {
+        PJ_LOG(2, (THIS_FILE, "shm %d has incompatible layout, ignored",
+                   (int)key));
+        shmdt(shm);
+        return NULL;
+    }
+
+    *p_shmid = shmid;
+    return shm;
+}
+
+#if defined(__linux__)
+static void shm_futex_wake(uint32_t *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+#else
+static void shm_futex_wake(uint32_t *addr)
+{
+    PJ_UNUSED_ARG(addr);
+}
+#endif
+
+/* Get the absolute CLOCK_MONOTONIC time usec from now */
+static void deadline_init(struct timespec *deadline, unsigned usec)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += usec / 1000000;
+    deadline->tv_nsec += (long)(usec % 1000000) * 1000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/* Get the time left until deadline, return PJ_FALSE if it has passed */
+static pj_bool_t deadline_left(const struct timespec *deadline,
+                               struct timespec *left)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    left->tv_sec = deadline->tv_sec - now.tv_sec;
+    left->tv_nsec = deadline->tv_nsec - now.tv_nsec;
+    if (left->tv_nsec < 0) {
+        left->tv_sec--;
+        left->tv_nsec += 1000000000;
+    }
+    return left->tv_sec > 0 || (left->tv_sec == 0 && left->tv_nsec > 0);
+}
 
+/*
+ * Producer side: copy the payload into the next free slot and publish it.
+ * Never blocks, the payload is dropped when the ring is full.
+ */
+static pj_bool_t shm_ring_put(stegno_ring *ring, stegno_slot *slots,
+                              pj_uint32_t seq, const void *data, unsigned len)
+{
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    stegno_slot *slot;
+
+    if (head - tail >= STEGNO_RING_SLOT_CNT) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return PJ_FALSE;
+    }
+
+    slot = &slots[head & (STEGNO_RING_SLOT_CNT - 1)];
+    slot->seq = seq;
+    slot->len = len;
+    pj_memcpy(slot->data, data, len);
+
+    /* Store head before loading waiting, see the wait protocol in
+     * stegno_ring.h.
+     */
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->waiting, __ATOMIC_SEQ_CST))
+        shm_futex_wake(&ring->head);
+
+    return PJ_TRUE;
+}
+
+/*
+ * Consumer side: return the oldest published slot, or NULL if the ring
+ * is empty. The slot stays owned by the consumer until shm_ring_pop().
+ */
+static stegno_slot *shm_ring_peek(stegno_ring *ring, stegno_slot *slots)
+{
+    uint32_t tail = ring->tail;
+
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+        return NULL;
+
+    return &slots[tail & (STEGNO_RING_SLOT_CNT - 1)];
+}
+
+static void shm_ring_pop(stegno_ring *ring)
+{
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Read the answers of the modifier from the response message queue and
+ * put them in the mq_rsp ring, where the TX path collects them without
+ * blocking. The thread ends when the queue is removed.
+ */
+static int mq_rx_thread(void *arg)
+{
+    struct tp_stegno *adapter = (struct tp_stegno*)arg;
+    MSGBUF rmsgbuf;
+
+    for (;;) {
+        ssize_t len = msgrcv(adapter->rmsgid, &rmsgbuf, BUFSIZE, 1,
+                             MSG_NOERROR);
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        shm_ring_put(&adapter->mq_rsp, adapter->mq_rsp_slot, 0,
+                     rmsgbuf.mtext, (unsigned)len);
+    }
+
+    __atomic_store_n(&adapter->rmq_exist, PJ_FALSE, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static pj_status_t mq_rx_start(struct tp_stegno *adapter)
+{
+    adapter->mq_rsp_slot = (stegno_slot*)
+                           pj_pool_calloc(adapter->pool, STEGNO_RING_SLOT_CNT,
+                                          sizeof(stegno_slot));
+    return pj_thread_create(adapter->pool, "stgmq", &mq_rx_thread, adapter,
+                            0, 0, &adapter->mq_thread);
+}
+
+/* Remove the response message queue and wait for the thread to end */
+static void mq_rx_stop(struct tp_stegno *adapter)
+{
+    if (adapter->mq_thread) {
+        msgctl(adapter->rmsgid, IPC_RMID, 0);
+        pj_thread_join(adapter->mq_thread);
+        pj_thread_destroy(adapter->mq_thread);
+        adapter->mq_thread = NULL;
+    }
+}
+
+/*
+ * Map the trace ring of the adapter, backed by a file in trace_dir when
+ * it is set so the records survive pjsua and need no explicit write.
+ */
+static pj_status_t trace_create(struct tp_stegno *adapter,
+                                const pjmedia_tp_stegno_setting *opt)
+{
+    unsigned cnt = 1;
+    pj_size_t size;
+    void *mem;
+
+    while (cnt < opt->trace_cnt)
+        cnt <<= 1;
+    size = offsetof(stegno_trace_hdr, rec) + cnt * sizeof(stegno_trace_rec);
+
+    if (opt->trace_dir && *opt->trace_dir) {
+        char path[PJ_MAXPATH];
+        pj_time_val now;
+        int fd;
+
+        pj_gettimeofday(&now);
+        pj_ansi_snprintf(path, sizeof(path), "%s/stegno-c%d-m%u-%lu.trace",
+                         opt->trace_dir, adapter->call_id, adapter->med_idx,
+                         (unsigned long)now.sec);
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return PJ_RETURN_OS_ERROR(errno);
+        if (ftruncate(fd, size) != 0) {
+            pj_status_t status = PJ_RETURN_OS_ERROR(errno);
+            close(fd);
+            return status;
+        }
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        PJ_LOG(4, (THIS_FILE, "call %d media %u: tracing to %s",
+                   adapter->call_id, adapter->med_idx, path));
+    } else {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (mem == MAP_FAILED)
+        return PJ_RETURN_OS_ERROR(errno);
+
+    adapter->trace = (stegno_trace_hdr*)mem;
+    adapter->trace_size = size;
+    adapter->trace_mask = cnt - 1;
+
+    adapter->trace->magic = STEGNO_TRACE_MAGIC;
+    adapter->trace->version = STEGNO_TRACE_VERSION;
+    adapter->trace->rec_size = sizeof(stegno_trace_rec);
+    adapter->trace->rec_cnt = cnt;
+    adapter->trace->call_id = adapter->call_id;
+    adapter->trace->med_idx = adapter->med_idx;
+    adapter->trace->write_idx = 0;
+
+    return PJ_SUCCESS;
+}
+
+static void trace_destroy(struct tp_stegno *adapter)
+{
+    if (adapter->trace) {
+        munmap(adapter->trace, adapter->trace_size);
+        adapter->trace = NULL;
+    }
+}
+
+/*
+ * Append a record to the trace ring. The RX and TX paths may run in
+ * different threads, so the record index is claimed atomically. Oldest
+ * records are overwritten when the ring is full.
+ */
+static void trace_add(struct tp_stegno *adapter, unsigned op, pjmedia_dir dir,
+                      const pjmedia_rtp_hdr *hdr, unsigned len)
+{
+    stegno_trace_rec *rec;
+    struct timespec now;
+    pj_uint64_t idx;
+
+    if (!adapter->trace)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    idx = __atomic_fetch_add(&adapter->trace->write_idx, 1,
+                             __ATOMIC_RELAXED);
+
+    rec = &adapter->trace->rec[idx & adapter->trace_mask];
+    rec->ts_ns = (pj_uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    rec->ssrc = pj_ntohl(hdr->ssrc);
+    rec->rtp_ts = pj_ntohl(hdr->ts);
+    rec->seq = pj_ntohs(hdr->seq);
+    rec->op = (pj_uint8_t)op;
+    rec->dir = (pj_uint8_t)dir;
+    rec->len = (pj_uint16_t)len;
+    rec->reserved = 0;
+}
+
+static int cmp_uint32(const void *a, const void *b)
+{
+    pj_uint32_t x = *(const pj_uint32_t*)a, y = *(const pj_uint32_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/*
+ * Compute the modifier round trip percentiles from a snapshot of the
+ * trace ring. Records that may have been overwritten while copying are
+ * left out.
+ */
+static void trace_get_stat(struct tp_stegno *adapter,
+                           pjmedia_tp_stegno_trace_stat *stat)
+{
+    enum { PENDING_CNT = 256 };
+    struct {
+        pj_uint32_t     ssrc;
+        pj_uint32_t     seq;
+        pj_uint64_t     ts_ns;
+    } pending[PENDING_CNT];
+    stegno_trace_rec *snap;
+    pj_uint32_t *lat;
+    pj_uint64_t first, last, i;
+    unsigned cnt, rec_cnt;
+    pj_pool_t *pool;
+
+    pj_bzero(stat, sizeof(*stat));
+    stat->subst_cnt = adapter->subst_cnt;
+    stat->miss_cnt = adapter->miss_cnt;
+
+    if (!adapter->trace)
+        return;
+
+    rec_cnt = adapter->trace->rec_cnt;
+    pool = pj_pool_create(adapter->pool->factory, "stgstat",
+                          rec_cnt * (sizeof(*snap) + sizeof(*lat)), 512,
+                          NULL);
+    if (!pool)
+        return;
+    snap = (stegno_trace_rec*)pj_pool_alloc(pool, rec_cnt * sizeof(*snap));
+    lat = (pj_uint32_t*)pj_pool_alloc(pool, rec_cnt * sizeof(*lat));
+
+    last = __atomic_load_n(&adapter->trace->write_idx, __ATOMIC_ACQUIRE);
+    pj_memcpy(snap, adapter->trace->rec, rec_cnt * sizeof(*snap));
+    first = __atomic_load_n(&adapter->trace->write_idx, __ATOMIC_ACQUIRE);
+    first = (first > rec_cnt) ? first - rec_cnt : 0;
+
+    pj_bzero(pending, sizeof(pending));
+    for (i = first, cnt = 0; i < last; ++i) {
+        const stegno_trace_rec *rec = &snap[i & adapter->trace_mask];
+        unsigned slot = rec->seq % PENDING_CNT;
+
+        stat->rec_cnt++;
+        if (rec->op == STEGNO_TRACE_ENQ) {
+            pending[slot].ssrc = rec->ssrc;
+            pending[slot].seq = rec->seq;
+            pending[slot].ts_ns = rec->ts_ns;
+        } else if (rec->op == STEGNO_TRACE_MOD_RX &&
+                   pending[slot].ts_ns && pending[slot].seq == rec->seq &&
+                   pending[slot].ssrc == rec->ssrc &&
+                   rec->ts_ns >= pending[slot].ts_ns)
+        {
+            lat[cnt++] = (pj_uint32_t)
+                         ((rec->ts_ns - pending[slot].ts_ns) / 1000);
+            pending[slot].ts_ns = 0;
+        }
+    }
+
+    if (cnt) {
+        qsort(lat, cnt, sizeof(lat[0]), &cmp_uint32);
+        stat->lat_cnt = cnt;
+        stat->lat_min = lat[0];
+        stat->lat_p50 = lat[(cnt - 1) * 50 / 100];
+        stat->lat_p90 = lat[(cnt - 1) * 90 / 100];
+        stat->lat_p99 = lat[(cnt - 1) * 99 / 100];
+        stat->lat_max = lat[cnt - 1];
+    }
+
+    pj_pool_release(pool);
+}
+
+
+/*
+ * Initialize the adapter setting with default values.
+ */
+PJ_DEF(void) pjmedia_tp_stegno_setting_default(pjmedia_tp_stegno_setting *opt)
+{
+    pj_assert(opt);
+
+    pj_bzero(opt, sizeof(*opt));
+    opt->deadline_usec = PJMEDIA_TP_STEGNO_DEADLINE_USEC;
+    opt->trace_cnt = PJMEDIA_TP_STEGNO_TRACE_CNT;
+}
 
 /*
  * Create the adapter.
@@ -165,12 +592,23 @@ PJ_DEF(pj_status_t) pjmedia_tp_stegno_create( pjmedia_endpt *endpt,
                                                const char *name,
                                                pjmedia_transport *transport,
                                                pj_bool_t del_base,
-                                               pjmedia_transport **p_tp,
-											   pj_bool_t mod_payload)
+                                               const pjmedia_tp_stegno_setting *opt,
+                                               pjmedia_transport **p_tp)
 {
+    pjmedia_tp_stegno_setting def_opt;
     pj_pool_t *pool;
     struct tp_stegno *adapter;
-    PJ_LOG(3,(THIS_FILE, "inside pjmedia_tp_stegno_create"));
+    int call_id;
+    unsigned med_idx;
+
+    PJ_ASSERT_RETURN(endpt && p_tp, PJ_EINVAL);
+
+    if (opt == NULL) {
+        pjmedia_tp_stegno_setting_default(&def_opt);
+        opt = &def_opt;
+    }
+    call_id = opt->call_id;
+    med_idx = opt->med_idx;
 
     if (name == NULL)
         name = "tpad%p";
@@ -189,11 +627,15 @@ PJ_DEF(pj_status_t) pjmedia_tp_stegno_create( pjmedia_endpt *endpt,
     adapter->slave_tp = transport;
     adapter->del_base = del_base;
 
-    app.counter = 0;
-    // don't send to mq until hear first response from RX
-    app.first_res = 0;
-	// whether we need to modify payload
-	app.mod_payload = mod_payload;
+    adapter->call_id = call_id;
+    adapter->med_idx = med_idx;
+    adapter->deadline_usec = opt->deadline_usec;
+    adapter->node.adapter = adapter;
+    adapter->counter = 0;
+    /* Don't send to the mq until the first response is heard from RX */
+    adapter->first_res = 0;
+    /* Whether the payload is modified by the stegno process */
+    adapter->mod_payload = opt->mod_payload;
 
 
     /* Setup group lock handler for destroy and callback synchronization */
@@ -205,24 +647,62 @@ PJ_DEF(pj_status_t) pjmedia_tp_stegno_create( pjmedia_endpt *endpt,
         pj_grp_lock_add_handler(grp_lock, pool, adapter, &adapter_on_destroy);
     }
 
-	
-	/* message queue */
-	if ((app.msgid = msgget((key_t)MSG_NAME, 0)) < 0) {
-		app.mq_exist = 0;
-		PJ_LOG(3, (THIS_FILE, "mq not exist" ));
-	} else {
-		app.mq_exist = 1;
-		PJ_LOG(3, (THIS_FILE, "mq exist"));
-		
-	}
-    if ((app.rmsgid = msgget((key_t)RMSG_NAME, 0)) < 0) {
-        app.rmq_exist = 0;
-        app.mod_payload = 0;
-        PJ_LOG(3, (THIS_FILE, "rmq not exist"));
+    if (opt->trace_cnt) {
+        pj_status_t status = trace_create(adapter, opt);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(2, (THIS_FILE, status, "call %d media %u: tracing "
+                          "disabled", call_id, med_idx));
+        }
+    }
+
+    pj_enter_critical_section();
+    if (adapter_list.next == NULL)
+        pj_list_init(&adapter_list);
+    pj_list_push_back(&adapter_list, &adapter->node);
+    pj_leave_critical_section();
+
+    /* shared memory channel, preferred over the message queues */
+    adapter->key = (key_t)STEGNO_CHAN_KEY(STEGNO_SHM_KEY, call_id, med_idx);
+    adapter->shm = shm_attach(adapter->key, &adapter->shmid);
+    if (adapter->shm) {
+        adapter->mq_exist = 1;
+        adapter->rmq_exist = (adapter->shm->flags & STEGNO_SHM_F_MODIFY) != 0;
+        adapter->mod_payload = adapter->rmq_exist;
+        PJ_LOG(3, (THIS_FILE, "call %d media %u: shm 0x%x exist, modify=%d",
+                   call_id, med_idx, (unsigned)adapter->key,
+                   adapter->mod_payload));
     } else {
-        app.rmq_exist = 1;
-        app.mod_payload = 1;
-        PJ_LOG(3, (THIS_FILE, "rmq exist"));
+        /* message queue */
+        if ((adapter->msgid = msgget((key_t)STEGNO_CHAN_KEY(MSG_NAME, call_id,
+                                                     med_idx), 0)) < 0)
+        {
+            adapter->mq_exist = 0;
+            PJ_LOG(3, (THIS_FILE, "call %d media %u: mq not exist",
+                       call_id, med_idx));
+        } else {
+            adapter->mq_exist = 1;
+            PJ_LOG(3, (THIS_FILE, "call %d media %u: mq exist",
+                       call_id, med_idx));
+        }
+        if ((adapter->rmsgid = msgget((key_t)STEGNO_CHAN_KEY(RMSG_NAME, call_id,
+                                                      med_idx), 0)) < 0)
+        {
+            adapter->rmq_exist = 0;
+            adapter->mod_payload = 0;
+            PJ_LOG(3, (THIS_FILE, "call %d media %u: rmq not exist",
+                       call_id, med_idx));
+        } else if (mq_rx_start(adapter) != PJ_SUCCESS) {
+            adapter->rmq_exist = 0;
+            adapter->mod_payload = 0;
+            PJ_LOG(2, (THIS_FILE, "call %d media %u: rmq exist but its "
+                       "receiver thread could not be created",
+                       call_id, med_idx));
+        } else {
+            adapter->rmq_exist = 1;
+            adapter->mod_payload = 1;
+            PJ_LOG(3, (THIS_FILE, "call %d media %u: rmq exist",
+                       call_id, med_idx));
+        }
     }
 
     
@@ -254,15 +734,19 @@ static pj_status_t transport_get_info(pjmedia_transport *tp,
 static void transport_rtp_cb2(pjmedia_tp_cb_param *param)
 {
     struct tp_stegno *adapter = (struct tp_stegno*)param->user_data;
-    unsigned char *payload;
 
     pj_assert(adapter->stream_rtp_cb != NULL ||
               adapter->stream_rtp_cb2 != NULL);
 
-    if (!app.mod_payload) {
-    	see_rtp(param->pkt, param->size, payload);
+    if (param->size >= (pj_ssize_t)sizeof(pjmedia_rtp_hdr)) {
+        trace_add(adapter, STEGNO_TRACE_RECV, PJMEDIA_DIR_DECODING,
+                  (const pjmedia_rtp_hdr*)param->pkt, (unsigned)param->size);
+    }
+
+    if (!adapter->mod_payload) {
+        see_rtp(adapter, PJMEDIA_DIR_DECODING, param->pkt, param->size);
     } else {
-	app.first_res = 1;
+        adapter->first_res = 1;
     }
 
     /* Call stream's callback */
@@ -333,18 +817,6 @@ static pj_status_t transport_attach2(pjmedia_transport *tp,
     return PJ_SUCCESS;
 }
 
-static void dump_t_logs() {
-    FILE *fp = fopen("pjsip_times.log", "w");
-    if (!fp) return;
-    for (int i = 0; i < t_log_count; ++i) {
-        fprintf(fp, "%s %ld.%09ld\n", t_logs[i].op,
-                t_logs[i].ts.tv_sec, t_logs[i].ts.tv_nsec);
-    }
-    fclose(fp);
-}
-
-
-
 /* 
  * detach() is called when the media is terminated, and the stream is 
  * to be disconnected from us.
@@ -356,6 +828,10 @@ static void transport_detach(pjmedia_transport *tp, void *strm)
     PJ_UNUSED_ARG(strm);
 
     if (adapter->stream_user_data != NULL) {
+        /* The stream no longer sends, let the staged packets go */
+        stage_collect(adapter);
+        stage_send(adapter, PJ_TRUE);
+
         pjmedia_transport_detach(adapter->slave_tp, adapter);
         adapter->stream_user_data = NULL;
         adapter->stream_rtp_cb = NULL;
@@ -363,80 +839,327 @@ static void transport_detach(pjmedia_transport *tp, void *strm)
         adapter->stream_rtcp_cb = NULL;
         adapter->stream_ref = NULL;
 
-        // remove message queue
-        msgctl(app.msgid, IPC_RMID, 0);
-        if (app.mod_payload) {
-            msgctl(app.rmsgid, IPC_RMID, 0);
+        if (adapter->rmq_exist) {
+            PJ_LOG(3, (THIS_FILE, "call %d media %u: %u payloads replaced, "
+                       "%u missed the %u usec deadline",
+                       adapter->call_id, adapter->med_idx, adapter->subst_cnt,
+                       adapter->miss_cnt, adapter->deadline_usec));
+        }
+
+        if (adapter->shm) {
+            /* Remove the shared memory, freed once the modifier detaches */
+            shmctl(adapter->shmid, IPC_RMID, NULL);
+            shmdt(adapter->shm);
+            adapter->shm = NULL;
+        } else {
+            /* Remove this call's message queues only */
+            if (adapter->mq_exist) {
+                msgctl(adapter->msgid, IPC_RMID, 0);
+            }
+            mq_rx_stop(adapter);
+            adapter->mq_exist = 0;
+            adapter->rmq_exist = 0;
         }
-        
-        dump_t_logs();
     }
 }
 
-int see_rtp(const void *pkt, pj_size_t size, const void **payload)
+/* Locate the payload of an RTP packet, without its padding. Returns the
+ * payload length, zero or negative if there is none.
+ */
+static int get_payload(const void *pkt, pj_size_t size, unsigned *offset)
 {
-    const pjmedia_rtp_hdr *rtp_header;
-    int offset;
+    const pjmedia_rtp_hdr *rtp_header = (const pjmedia_rtp_hdr*)pkt;
+    const pj_uint8_t *payload;
     int payloadlen;
-    rtp_header = (pjmedia_rtp_hdr*)pkt;
+
+    if ((pj_ssize_t)size < (pj_ssize_t)sizeof(pjmedia_rtp_hdr))
+        return 0;
+
     /* Payload is located right after header plus CSRC */
-    offset = sizeof(pjmedia_rtp_hdr) + (rtp_header->cc * sizeof(pj_uint32_t));
-    payload = (unsigned char *)(pkt + offset);
-    payloadlen = size - offset;
+    *offset = sizeof(pjmedia_rtp_hdr) + (rtp_header->cc * sizeof(pj_uint32_t));
+    payload = (const pj_uint8_t*)pkt + *offset;
+    payloadlen = (int)size - (int)*offset;
 
     /* Remove payload padding if any */
     if (rtp_header->p && payloadlen > 0) {
         pj_uint8_t pad_len;
 
-        pad_len = ((pj_uint8_t*)(*payload))[payloadlen - 1];
+        pad_len = payload[payloadlen - 1];
         if (pad_len <= payloadlen)
             payloadlen -= pad_len;
     }
 
-    
+    return payloadlen;
+}
+
+/* Publish the SSRC so the modifier can tell the streams apart */
+static void update_ssrc(struct tp_stegno *adapter, pjmedia_dir dir,
+                        const pjmedia_rtp_hdr *rtp_header)
+{
+    if (dir == PJMEDIA_DIR_ENCODING && adapter->tx_ssrc != rtp_header->ssrc) {
+        adapter->tx_ssrc = rtp_header->ssrc;
+        if (adapter->shm)
+            adapter->shm->tx_ssrc = pj_ntohl(rtp_header->ssrc);
+        PJ_LOG(4, (THIS_FILE, "call %d media %u: tx ssrc=%lx",
+                   adapter->call_id, adapter->med_idx,
+                   (unsigned long)pj_ntohl(rtp_header->ssrc)));
+    } else if (dir == PJMEDIA_DIR_DECODING &&
+               adapter->rx_ssrc != rtp_header->ssrc)
+    {
+        adapter->rx_ssrc = rtp_header->ssrc;
+        if (adapter->shm)
+            adapter->shm->rx_ssrc = pj_ntohl(rtp_header->ssrc);
+        PJ_LOG(4, (THIS_FILE, "call %d media %u: rx ssrc=%lx",
+                   adapter->call_id, adapter->med_idx,
+                   (unsigned long)pj_ntohl(rtp_header->ssrc)));
+    }
+}
+
+/*
+ * Queue the payload to the modifier, through the shared memory request
+ * ring or the message queue. Never blocks, returns PJ_FALSE if the
+ * payload could not be queued.
+ */
+static pj_bool_t put_request(struct tp_stegno *adapter, pjmedia_dir dir,
+                             const pjmedia_rtp_hdr *hdr,
+                             const pj_uint8_t *payload, int payloadlen)
+{
+    if (adapter->shm) {
+        if (!shm_ring_put(&adapter->shm->req, adapter->shm->req_slot,
+                          pj_ntohs(hdr->seq), payload, payloadlen))
+        {
+            return PJ_FALSE;
+        }
+    } else if (adapter->mq_exist) {
+        MSGBUF msgbuf;
+
+        msgbuf.mtype = 1;
+        pj_memcpy(msgbuf.mtext, payload, payloadlen);
+        if (msgsnd(adapter->msgid, &msgbuf, payloadlen, IPC_NOWAIT) != 0)
+            return PJ_FALSE;
+    } else {
+        return PJ_FALSE;
+    }
+
+    trace_add(adapter, STEGNO_TRACE_ENQ, dir, hdr, payloadlen);
+    return PJ_TRUE;
+}
+
+/*
+ * Give an incoming payload to the modifier.
+ */
+static int see_rtp(struct tp_stegno *adapter, pjmedia_dir dir,
+                   void *pkt, pj_size_t size)
+{
+    const pjmedia_rtp_hdr *rtp_header = (const pjmedia_rtp_hdr*)pkt;
+    pj_uint8_t *payload;
+    unsigned offset;
+    int payloadlen;
+
+    payloadlen = get_payload(pkt, size, &offset);
+    if (payloadlen <= 0 || payloadlen > BUFSIZE)
+        return payloadlen;
+    payload = (pj_uint8_t*)pkt + offset;
+
     if (rtp_header->v == 2) {
-       PJ_LOG(5, (THIS_FILE, "rtp version %u, payload type %u, seq %lu, ts %lu, ssrc=%lx, payload size %d, firstb %x, lastb %x",
-            rtp_header->v, rtp_header->pt, (unsigned long)pj_ntohl(rtp_header->seq),
+       PJ_LOG(5, (THIS_FILE, "rtp version %u, payload type %u, seq %u, ts %lu, ssrc=%lx, payload size %d, firstb %x, lastb %x",
+            rtp_header->v, rtp_header->pt, pj_ntohs(rtp_header->seq),
             (unsigned long) pj_ntohl(rtp_header->ts),
-            (unsigned long) pj_ntohl(rtp_header->cc),
+            (unsigned long) pj_ntohl(rtp_header->ssrc),
             payloadlen, payload[0], payload[payloadlen-1]));
     }
 
-	MSGBUF msgbuf;
-	MSGBUF rmsgbuf;
+    update_ssrc(adapter, dir, rtp_header);
+    put_request(adapter, dir, rtp_header, payload, payloadlen);
+    return payloadlen;
+}
+
+/* Find the staged packet of a sequence number */
+static stegno_stage *stage_find(struct tp_stegno *adapter, pj_uint16_t seq)
+{
+    unsigned i;
+
+    for (i = 0; i < adapter->stage_cnt; ++i) {
+        stegno_stage *st;
+
+        st = &adapter->stage[(adapter->stage_head + i) % STAGE_CNT];
+        if (st->seq == seq)
+            return st;
+    }
+    return NULL;
+}
+
+/* The modifier did not answer in time, the original payload is sent */
+static void on_deadline_miss(struct tp_stegno *adapter, stegno_stage *st)
+{
+    adapter->miss_cnt++;
+    trace_add(adapter, STEGNO_TRACE_MISS, PJMEDIA_DIR_ENCODING,
+              (const pjmedia_rtp_hdr*)st->buf, 0);
+}
+
+/* Put the answer of the modifier in its staged packet. Answers for
+ * packets that were already sent are ignored.
+ */
+static void stage_answer(struct tp_stegno *adapter, pj_uint16_t seq,
+                         const stegno_slot *slot)
+{
+    stegno_stage *st = stage_find(adapter, seq);
+
+    if (st == NULL || st->done)
+        return;
+
+    if (slot->len == st->payloadlen) {
+        trace_add(adapter, STEGNO_TRACE_MOD_RX, PJMEDIA_DIR_ENCODING,
+                  (const pjmedia_rtp_hdr*)st->buf, st->payloadlen);
+        pj_memcpy(st->buf + st->offset, slot->data, st->payloadlen);
+        adapter->subst_cnt++;
+    } else {
+        on_deadline_miss(adapter, st);
+    }
+    st->done = PJ_TRUE;
+}
+
+/* Collect the answers that have arrived so far, without waiting */
+static void stage_collect(struct tp_stegno *adapter)
+{
+    stegno_slot *slot;
 
-	if (app.mq_exist) {
-		msgbuf.mtype = 1;
-		memcpy(msgbuf.mtext, payload, payloadlen);
-		msgsnd(app.msgid, &msgbuf, payloadlen, 0);
+    if (adapter->shm) {
+        stegno_shm *shm = adapter->shm;
 
-        if (t_log_count < MAX_LOG) {
-            strcpy(t_logs[t_log_count].op, "txc");
-            clock_gettime(CLOCK_MONOTONIC, &t_logs[t_log_count].ts);
-            t_log_count++;
+        while ((slot = shm_ring_peek(&shm->rsp, shm->rsp_slot)) != NULL) {
+            stage_answer(adapter, (pj_uint16_t)slot->seq, slot);
+            shm_ring_pop(&shm->rsp);
         }
-	}
-	if (app.rmq_exist) {
-		/* if rmsq has more than one object, clear it */
-		struct msqid_ds msqinfo;
-		msgctl(app.rmsgid, IPC_STAT, &msqinfo);
-		//PJ_LOG(3, (THIS_FILE, "rmsq %d", msqinfo.msg_qnum));
-		for (int i = msqinfo.msg_qnum; i > 1; i--) {
-			msgrcv(app.rmsgid, &rmsgbuf, payloadlen, 1, IPC_NOWAIT);
-		}
-
-		msgrcv(app.rmsgid, &rmsgbuf, payloadlen, 1, 0);
-
-        if (t_log_count < MAX_LOG) {
-            strcpy(t_logs[t_log_count].op, "rxc");
-            clock_gettime(CLOCK_MONOTONIC, &t_logs[t_log_count].ts);
-            t_log_count++;
+        return;
+    }
+
+    /* The message queue answers come in the order of the requests */
+    while ((slot = shm_ring_peek(&adapter->mq_rsp,
+                                 adapter->mq_rsp_slot)) != NULL)
+    {
+        if (adapter->mq_req_tail != adapter->mq_req_head) {
+            pj_uint16_t seq;
+
+            seq = adapter->mq_req_seq[adapter->mq_req_tail %
+                                      STEGNO_RING_SLOT_CNT];
+            adapter->mq_req_tail++;
+            stage_answer(adapter, seq, slot);
         }
+        shm_ring_pop(&adapter->mq_rsp);
+    }
+}
+
+/* Send the oldest staged packet, with the original payload if its answer
+ * has not arrived.
+ */
+static void stage_send_head(struct tp_stegno *adapter)
+{
+    stegno_stage *st = &adapter->stage[adapter->stage_head];
+    pjmedia_transport_tx_buf tx_buf;
 
-		memcpy(payload, rmsgbuf.mtext, payloadlen);
-	}
+    if (!st->done)
+        on_deadline_miss(adapter, st);
 
-	return payloadlen;
+    trace_add(adapter, STEGNO_TRACE_SEND, PJMEDIA_DIR_ENCODING,
+              (const pjmedia_rtp_hdr*)st->buf, (unsigned)st->size);
+
+    tx_buf.buf = st->buf;
+    tx_buf.buf_size = sizeof(st->buf);
+    tx_buf.pkt = st->buf;
+    tx_buf.size = st->size;
+    tx_buf.flags = 0;
+    pjmedia_transport_send_rtp_buf(adapter->slave_tp, &tx_buf);
+
+    adapter->stage_head = (adapter->stage_head + 1) % STAGE_CNT;
+    adapter->stage_cnt--;
+}
+
+/* Send the staged packets in order, as long as they have their answer or
+ * their deadline has passed, or all of them if flush is set.
+ */
+static void stage_send(struct tp_stegno *adapter, pj_bool_t flush)
+{
+    while (adapter->stage_cnt) {
+        stegno_stage *st = &adapter->stage[adapter->stage_head];
+        struct timespec left;
+
+        if (!st->done && !flush &&
+            (adapter->deadline_usec == 0 ||
+             deadline_left(&st->deadline, &left)))
+        {
+            break;
+        }
+        stage_send_head(adapter);
+    }
+}
+
+/*
+ * Stage an outgoing packet until its modified payload arrives. The
+ * payload is queued to the modifier and the packet is copied to the
+ * staging queue, then the call returns without waiting for the answer.
+ * The answers are collected on the next packet, i.e. on the next tick of
+ * the stream, and the staged packets are sent in order once they have
+ * their answer, or with the original payload once their deadline has
+ * passed or when the staging queue is full.
+ */
+static pj_status_t stage_put(struct tp_stegno *adapter,
+                             const void *pkt, pj_size_t size)
+{
+    const pjmedia_rtp_hdr *rtp_header = (const pjmedia_rtp_hdr*)pkt;
+    stegno_stage *st;
+    int payloadlen;
+
+    PJ_ASSERT_RETURN(size <= PJMEDIA_MAX_MTU, PJ_ETOOBIG);
+
+    stage_collect(adapter);
+    stage_send(adapter, PJ_FALSE);
+    if (adapter->stage_cnt == STAGE_CNT)
+        stage_send_head(adapter);
+
+    st = &adapter->stage[(adapter->stage_head + adapter->stage_cnt) %
+                         STAGE_CNT];
+    pj_memcpy(st->buf, pkt, size);
+    st->size = size;
+    st->seq = pj_ntohs(rtp_header->seq);
+    st->done = PJ_TRUE;
+    adapter->stage_cnt++;
+
+    payloadlen = get_payload(pkt, size, &st->offset);
+    if (payloadlen <= 0 || payloadlen > BUFSIZE) {
+        /* Nothing to modify, sent as soon as the packets before it */
+        stage_send(adapter, PJ_FALSE);
+        return PJ_SUCCESS;
+    }
+
+    st->payloadlen = payloadlen;
+    update_ssrc(adapter, PJMEDIA_DIR_ENCODING, rtp_header);
+
+    /* Only wait for an answer if the modifier is still there */
+    if ((adapter->shm ||
+         __atomic_load_n(&adapter->rmq_exist, __ATOMIC_ACQUIRE)) &&
+        put_request(adapter, PJMEDIA_DIR_ENCODING, rtp_header,
+                    (const pj_uint8_t*)st->buf + st->offset, payloadlen))
+    {
+        st->done = PJ_FALSE;
+        if (adapter->deadline_usec)
+            deadline_init(&st->deadline, adapter->deadline_usec);
+
+        if (!adapter->shm) {
+            /* Forget the oldest request if the modifier lags that much */
+            if (adapter->mq_req_head - adapter->mq_req_tail ==
+                STEGNO_RING_SLOT_CNT)
+            {
+                adapter->mq_req_tail++;
+            }
+            adapter->mq_req_seq[adapter->mq_req_head % STEGNO_RING_SLOT_CNT] =
+                st->seq;
+            adapter->mq_req_head++;
+        }
+    }
+
+    stage_send(adapter, PJ_FALSE);
+    return PJ_SUCCESS;
 }
 
 /*
@@ -449,25 +1172,43 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
 {
     struct tp_stegno *adapter = (struct tp_stegno*)tp;
 
-    /* You may do some processing to the RTP packet here if you want. */
-    
-    
-    
-    void *payload;
-    int payloadlen;
-    if (app.mod_payload && app.first_res) {
-	    payloadlen = see_rtp(pkt, size, payload);
-	//PJ_LOG(4, (THIS_FILE, "payloadlen %d", payloadlen));
-    }
-    
+    if (adapter->mod_payload && adapter->first_res)
+        return stage_put(adapter, pkt, size);
 
-    
+    if (size >= sizeof(pjmedia_rtp_hdr)) {
+        trace_add(adapter, STEGNO_TRACE_SEND, PJMEDIA_DIR_ENCODING,
+                  (const pjmedia_rtp_hdr*)pkt, (unsigned)size);
+    }
 
     /* Send the packet using the slave transport */
     return pjmedia_transport_send_rtp(adapter->slave_tp, pkt, size);
 }
 
 
+/*
+ * send_rtp_buf() is called to send RTP packet in a writable buffer.
+ */
+static pj_status_t transport_send_rtp_buf(pjmedia_transport *tp,
+                                          pjmedia_transport_tx_buf *tx_buf)
+{
+    struct tp_stegno *adapter = (struct tp_stegno*)tp;
+
+    if (adapter->mod_payload && adapter->first_res)
+        return stage_put(adapter, tx_buf->pkt, tx_buf->size);
+
+    if (tx_buf->size >= sizeof(pjmedia_rtp_hdr)) {
+        trace_add(adapter, STEGNO_TRACE_SEND, PJMEDIA_DIR_ENCODING,
+                  (const pjmedia_rtp_hdr*)tx_buf->pkt,
+                  (unsigned)tx_buf->size);
+    }
+
+    /* Send the packet using the slave transport, which may also work in
+     * place on the same buffer.
+     */
+    return pjmedia_transport_send_rtp_buf(adapter->slave_tp, tx_buf);
+}
+
+
 /*
  * send_rtcp() is called to send RTCP packet. The "pkt" and "size" argument
  * contain the RTCP packet.
@@ -618,11 +1359,111 @@ static pj_status_t transport_simulate_lost(pjmedia_transport *tp,
 }
 
 
+static void adapter_free(struct tp_stegno *adapter)
+{
+    trace_destroy(adapter);
+    pj_pool_release(adapter->pool);
+}
+
 static void adapter_on_destroy(void *arg)
 {
     struct tp_stegno *adapter = (struct tp_stegno*)arg;
+    pj_bool_t in_use;
 
-    pj_pool_release(adapter->pool);
+    pj_enter_critical_section();
+    pj_list_erase(&adapter->node);
+    in_use = (adapter->dump_ref != 0);
+    adapter->destroy_pending = in_use;
+    pj_leave_critical_section();
+
+    /* Otherwise the last dump releasing the adapter frees it */
+    if (!in_use)
+        adapter_free(adapter);
+}
+
+/*
+ * Get the modifier latency statistics of the adapter.
+ */
+PJ_DEF(pj_status_t) pjmedia_tp_stegno_get_trace_stat(
+                                        pjmedia_transport *tp,
+                                        pjmedia_tp_stegno_trace_stat *stat)
+{
+    PJ_ASSERT_RETURN(tp && stat, PJ_EINVAL);
+    PJ_ASSERT_RETURN(tp->op == &tp_stegno_op, PJ_EINVALIDOP);
+
+    trace_get_stat((struct tp_stegno*)tp, stat);
+    return PJ_SUCCESS;
+}
+
+/*
+ * Log the modifier latency statistics of all adapters.
+ */
+PJ_DEF(void) pjmedia_tp_stegno_dump_trace_stat(void)
+{
+    struct stegno_node *node;
+    struct tp_stegno **adapters;
+    pj_pool_factory *factory = NULL;
+    pj_pool_t *pool;
+    unsigned i, max_cnt = 0, cnt = 0;
+
+    /* Only take references under the lock, the statistics are computed
+     * outside it so the media path of the adapters is not held up.
+     */
+    pj_enter_critical_section();
+    if (adapter_list.next && !pj_list_empty(&adapter_list)) {
+        factory = adapter_list.next->adapter->pool->factory;
+        max_cnt = (unsigned)pj_list_size(&adapter_list);
+    }
+    pj_leave_critical_section();
+
+    if (max_cnt == 0) {
+        PJ_LOG(3, (THIS_FILE, "No stegno adapter"));
+        return;
+    }
+
+    pool = pj_pool_create(factory, "stgdump", max_cnt * sizeof(adapters[0]),
+                          512, NULL);
+    if (!pool)
+        return;
+    adapters = (struct tp_stegno**)
+               pj_pool_calloc(pool, max_cnt, sizeof(adapters[0]));
+
+    pj_enter_critical_section();
+    for (node = adapter_list.next; node != &adapter_list && cnt < max_cnt;
+         node = node->next)
+    {
+        node->adapter->dump_ref++;
+        adapters[cnt++] = node->adapter;
+    }
+    pj_leave_critical_section();
+
+    for (i = 0; i < cnt; ++i) {
+        struct tp_stegno *adapter = adapters[i];
+        pjmedia_tp_stegno_trace_stat stat;
+        pj_bool_t free_it;
+
+        trace_get_stat(adapter, &stat);
+        PJ_LOG(3, (THIS_FILE, "call %d media %u tx ssrc=%lx: "
+                   "replaced=%u missed=%u, modifier latency (usec) over "
+                   "%u round trips: min=%u p50=%u p90=%u p99=%u max=%u",
+                   adapter->call_id, adapter->med_idx,
+                   (unsigned long)pj_ntohl(adapter->tx_ssrc),
+                   stat.subst_cnt, stat.miss_cnt, stat.lat_cnt,
+                   stat.lat_min, stat.lat_p50, stat.lat_p90,
+                   stat.lat_p99, stat.lat_max));
+
+        pj_enter_critical_section();
+        free_it = (--adapter->dump_ref == 0 && adapter->destroy_pending);
+        pj_leave_critical_section();
+
+        if (free_it)
+            adapter_free(adapter);
+    }
+
+    pj_pool_release(pool);
+
+    if (cnt == 0)
+        PJ_LOG(3, (THIS_FILE, "No stegno adapter"));
 }
 
 /*
@@ -632,6 +1473,8 @@ static pj_status_t transport_destroy  (pjmedia_transport *tp)
 {
     struct tp_stegno *adapter = (struct tp_stegno*)tp;
 
+    mq_rx_stop(adapter);
+
     /* Close the slave transport */
     if (adapter->del_base) {
         pjmedia_transport_close(adapter->slave_tp);
@@ -26,6 +26,7 @@
  */
 
 #include <pjmedia/transport.h>
+#include "stegno_ring.h"
 
 
 /**
@@ -41,6 +42,118 @@
 PJ_BEGIN_DECL
 
 
+/**
+ * Default number of records in the latency trace ring of each adapter.
+ */
+#ifndef PJMEDIA_TP_STEGNO_TRACE_CNT
+#   define PJMEDIA_TP_STEGNO_TRACE_CNT  8192
+#endif
+
+
+/**
+ * Default time after which an outgoing packet stops waiting for its
+ * modified payload, in microseconds.
+ */
+#ifndef PJMEDIA_TP_STEGNO_DEADLINE_USEC
+#   define PJMEDIA_TP_STEGNO_DEADLINE_USEC  2000
+#endif
+
+
+/**
+ * Settings to be given when creating the adapter.
+ */
+typedef struct pjmedia_tp_stegno_setting
+{
+    /**
+     * Initial payload modification setting, overridden by the presence of
+     * the modifier's response channel.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t           mod_payload;
+
+    /**
+     * The call this transport belongs to. Together with med_idx, this
+     * selects the modifier channel of the adapter, see STEGNO_CHAN_KEY()
+     * in stegno_ring.h, so several calls can be processed by the modifier
+     * at the same time.
+     *
+     * Default: 0
+     */
+    int                 call_id;
+
+    /**
+     * The media index in the call.
+     *
+     * Default: 0
+     */
+    unsigned            med_idx;
+
+    /**
+     * Time after which an outgoing packet stops waiting for its modified
+     * payload, in microseconds. The TX path never waits: outgoing packets
+     * are staged in a small queue, and the answers of the modifier are
+     * collected when the stream sends its next packet. Staged packets
+     * are then sent in order, with the modified payload if it has arrived,
+     * or with the original payload and a miss counted once the deadline
+     * has passed. So a modified packet goes out one packet time late, and
+     * a slow modifier does not disturb the RTP pacing. Zero means no
+     * deadline, packets are only sent unmodified when the staging queue
+     * is full.
+     *
+     * Default: PJMEDIA_TP_STEGNO_DEADLINE_USEC
+     */
+    unsigned            deadline_usec;
+
+    /**
+     * Number of records in the latency trace ring of the adapter, rounded
+     * up to a power of two. Each RTP packet produces a few records, see
+     * stegno_trace_rec in stegno_ring.h. Zero disables tracing.
+     *
+     * Default: PJMEDIA_TP_STEGNO_TRACE_CNT
+     */
+    unsigned            trace_cnt;
+
+    /**
+     * Directory of the trace files. When set, the trace ring is a shared
+     * mapping of the file "stegno-c<call>-m<media>-<time>.trace" there,
+     * so the records reach the file without any write on the media path.
+     * When NULL, the ring is only kept in memory.
+     *
+     * Default: NULL
+     */
+    const char         *trace_dir;
+
+} pjmedia_tp_stegno_setting;
+
+
+/**
+ * Modifier latency statistics, computed from a snapshot of the trace ring.
+ * The answers to outgoing payloads are only seen when the next packet is
+ * sent, so their latency is rounded up to the packet time.
+ */
+typedef struct pjmedia_tp_stegno_trace_stat
+{
+    unsigned            subst_cnt;      /**< Payloads replaced so far.  */
+    unsigned            miss_cnt;       /**< Deadline misses so far.    */
+    unsigned            rec_cnt;        /**< Records in the snapshot.   */
+    unsigned            lat_cnt;        /**< Round trips measured.      */
+    unsigned            lat_min;        /**< Minimum latency, in usec.  */
+    unsigned            lat_p50;        /**< Median latency, in usec.   */
+    unsigned            lat_p90;        /**< 90th percentile, in usec.  */
+    unsigned            lat_p99;        /**< 99th percentile, in usec.  */
+    unsigned            lat_max;        /**< Maximum latency, in usec.  */
+} pjmedia_tp_stegno_trace_stat;
+
+
+/**
+ * Initialize the adapter setting with default values.
+ *
+ * @param opt           The setting to be initialized.
+ */
+PJ_DECL(void) pjmedia_tp_stegno_setting_default(pjmedia_tp_stegno_setting *opt);
+
+
 /**
  * Create the transport adapter, specifying the underlying transport to be
  * used to send and receive RTP/RTCP packets.
@@ -52,6 +165,7 @@ PJ_BEGIN_DECL
  *                      receive RTP/RTCP packets.
  * @param del_base      Specify whether the base transport should also be
  *                      destroyed when destroy() is called upon us.
+ * @param opt           Optional settings, NULL to use the default.
  * @param p_tp          Pointer to receive the media transport instance.
  *
  * @return              PJ_SUCCESS on success, or the appropriate error code.
@@ -60,8 +174,28 @@ PJ_DECL(pj_status_t) pjmedia_tp_stegno_create( pjmedia_endpt *endpt,
                                                 const char *name,
                                                 pjmedia_transport *base_tp,
                                                 pj_bool_t del_base,
-                                                pjmedia_transport **p_tp,
-                                                pj_bool_t mod_payload);
+                                                const pjmedia_tp_stegno_setting *opt,
+                                                pjmedia_transport **p_tp);
+
+/**
+ * Get the modifier latency statistics of the adapter, i.e. the time between
+ * a payload is queued to the modifier and its answer is received.
+ *
+ * @param tp            The adapter.
+ * @param stat          Pointer to receive the statistics.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjmedia_tp_stegno_get_trace_stat(
+                                        pjmedia_transport *tp,
+                                        pjmedia_tp_stegno_trace_stat *stat);
+
+
+/**
+ * Log the modifier latency statistics of all adapters.
+ */
+PJ_DECL(void) pjmedia_tp_stegno_dump_trace_stat(void);
+
 
 PJ_END_DECL
 
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * \page page_pjmedia_samples_confmixbench_c Samples: Benchmarking Conference Mixing
+ *
+ * Benchmark the mixing of the conference bridge with each of the
+ * available audio mixing kernel implementations (see
+ * @ref PJMEDIA_AUDIO_MIX), with and without the incremental mixing
+ * (PJMEDIA_CONF_INCREMENTAL_MIX). Unlike confbench.c, this runs the bridge
+ * without a sound device, as fast as possible, and is portable.
+ *
+ * This file is pjsip-apps/src/samples/confmixbench.c
+ *
+ * \includelineno confmixbench.c
+ */
+
+
+static const char *desc =
+ " FILE:                                                                    \n"
+ "  confmixbench.c                                                          \n"
+ "                                                                          \n"
+ " PURPOSE:                                                                 \n"
+ "  Benchmark the conference bridge mixing with each of the available      \n"
+ "  audio mixing kernel implementations (scalar, SSE2, AVX2, NEON), with   \n"
+ "  and without incremental mixing.                                        \n"
+ "                                                                          \n"
+ " USAGE:                                                                   \n"
+ "  confmixbench [PORTS [LISTENERS [TICKS [TALKERS]]]]                      \n"
+ "                                                                          \n"
+ "  PORTS      Number of ports (default 64).                                \n"
+ "  LISTENERS  Number of listeners of each port (default 8).                \n"
+ "  TICKS      Number of 10ms ticks to run per implementation               \n"
+ "             (default 2000).                                              \n"
+ "  TALKERS    Number of ports playing a tone, the other ports are          \n"
+ "             silent (default all ports).                                  ";
+
+
+#include <pjmedia.h>
+#include <pjlib.h>
+#include <stdlib.h>     /* atoi() */
+#include <stdio.h>
+
+/* For logging purpose. */
+#define THIS_FILE   "confmixbench.c"
+
+#define CLOCK_RATE          16000
+#define SAMPLES_PER_FRAME   (CLOCK_RATE/100)
+
+
+static void app_perror(const char *title, pj_status_t status)
+{
+    char errmsg[PJ_ERR_MSG_SIZE];
+
+    pj_strerror(status, errmsg, sizeof(errmsg));
+    PJ_LOG(1,(THIS_FILE, "%s: %s", title, errmsg));
+}
+
+
+/* Create a looping tone generator port. */
+static pj_status_t create_tone_port(pj_pool_t *pool, unsigned idx,
+                                    pjmedia_port **p_port)
+{
+    pjmedia_tone_desc tone;
+    pj_status_t status;
+
+    status = pjmedia_tonegen_create(pool, CLOCK_RATE, 1, SAMPLES_PER_FRAME,
+                                    16, PJMEDIA_TONEGEN_LOOP, p_port);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    pj_bzero(&tone, sizeof(tone));
+    tone.freq1 = (short)(300 + idx * 10);
+    tone.freq2 = (short)(1000 + idx * 7);
+    tone.on_msec = 1000;
+    tone.off_msec = 0;
+    tone.volume = 0;
+
+    return pjmedia_tonegen_play(*p_port, 1, &tone, PJMEDIA_TONEGEN_LOOP);
+}
+
+
+/* Create the bridge with the ports, and time the mixing with each of the
+ * kernel implementations.
+ */
+static pj_status_t bench(pj_pool_factory *pf, unsigned options,
+                         unsigned port_cnt, unsigned listener_cnt,
+                         unsigned tick_cnt, unsigned talker_cnt)
+{
+    pj_pool_t *pool;
+    pjmedia_conf *conf;
+    pjmedia_port *master;
+    pj_int16_t *buf;
+    unsigned i, j, *slots;
+    pjmedia_mix_impl impl;
+    pj_status_t status;
+
+    pool = pj_pool_create(pf, "confmixbench", 4000, 4000, NULL);
+
+    status = pjmedia_conf_create(pool, port_cnt + 1, CLOCK_RATE, 1,
+                                 SAMPLES_PER_FRAME, 16,
+                                 PJMEDIA_CONF_NO_DEVICE | options, &conf);
+    if (status != PJ_SUCCESS) {
+        app_perror("Unable to create conference bridge", status);
+        pj_pool_release(pool);
+        return status;
+    }
+    master = pjmedia_conf_get_master_port(conf);
+
+    /* Add the ports. Each port transmits to the next listener_cnt ports,
+     * with some of the connections and ports using a non-normal level so
+     * that the level adjustment is exercised as well.
+     */
+    slots = (unsigned*) pj_pool_calloc(pool, port_cnt, sizeof(unsigned));
+    for (i = 0; i < port_cnt; ++i) {
+        pjmedia_port *port;
+
+        if (i < talker_cnt) {
+            status = create_tone_port(pool, i, &port);
+        } else {
+            status = pjmedia_null_port_create(pool, CLOCK_RATE, 1,
+                                              SAMPLES_PER_FRAME, 16, &port);
+        }
+        if (status == PJ_SUCCESS)
+            status = pjmedia_conf_add_port(conf, pool, port, NULL, &slots[i]);
+        if (status != PJ_SUCCESS) {
+            app_perror("Unable to add port", status);
+            goto on_return;
+        }
+        if (i % 4 == 1)
+            pjmedia_conf_adjust_rx_level(conf, slots[i], -32);
+        if (i % 4 == 3)
+            pjmedia_conf_adjust_tx_level(conf, slots[i], 16);
+    }
+    for (i = 0; i < port_cnt; ++i) {
+        for (j = 1; j <= listener_cnt; ++j) {
+            status = pjmedia_conf_connect_port(conf, slots[i],
+                                               slots[(i + j) % port_cnt],
+                                               (j % 3) ? 0 : -20);
+            if (status != PJ_SUCCESS) {
+                app_perror("Unable to connect ports", status);
+                goto on_return;
+            }
+        }
+    }
+    /* Also hear the first port, as a sound device would */
+    pjmedia_conf_connect_port(conf, slots[0], 0, 0);
+
+    buf = (pj_int16_t*) pj_pool_alloc(pool, SAMPLES_PER_FRAME * 2);
+
+    printf("%s mixing:\n", (options & PJMEDIA_CONF_INCREMENTAL_MIX) ?
+           "Incremental" : "Full");
+
+    for (impl = PJMEDIA_MIX_IMPL_SCALAR; impl <= PJMEDIA_MIX_IMPL_NEON;
+         ++impl)
+    {
+        pjmedia_conf_tick_stat stat;
+        pj_timestamp t0, t1;
+        pj_uint32_t usec;
+
+        if (pjmedia_mix_set_impl(impl) != PJ_SUCCESS)
+            continue;
+
+        pj_get_timestamp(&t0);
+        for (i = 0; i < tick_cnt; ++i) {
+            pjmedia_frame frame;
+
+            frame.buf = buf;
+            frame.size = SAMPLES_PER_FRAME * 2;
+            frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+            pjmedia_port_get_frame(master, &frame);
+
+            frame.buf = buf;
+            frame.size = SAMPLES_PER_FRAME * 2;
+            frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+            pjmedia_port_put_frame(master, &frame);
+        }
+        pj_get_timestamp(&t1);
+
+        pjmedia_conf_get_tick_stat(conf, &stat);
+        usec = pj_elapsed_usec(&t0, &t1);
+        printf("  %-6s: %8.2f usec/tick, %6.3f ns/sample/connection, "
+               "%u sources, %u mixes\n",
+               pjmedia_mix_impl_name(impl),
+               (double)usec / tick_cnt,
+               usec * 1000.0 / tick_cnt / SAMPLES_PER_FRAME /
+               (port_cnt * listener_cnt),
+               stat.last_src_cnt, stat.last_mix_cnt);
+    }
+
+    pjmedia_mix_set_impl(PJMEDIA_MIX_IMPL_AUTO);
+    status = PJ_SUCCESS;
+
+on_return:
+    pjmedia_conf_destroy(conf);
+    pj_pool_release(pool);
+    return status;
+}
+
+
+int main(int argc, char *argv[])
+{
+    pj_caching_pool cp;
+    unsigned port_cnt = 64, listener_cnt = 8, tick_cnt = 2000;
+    unsigned talker_cnt;
+    pj_status_t status;
+
+    if (argc > 1 && (argv[1][0] == '-' || atoi(argv[1]) <= 0)) {
+        puts(desc);
+        return 1;
+    }
+    if (argc > 1)
+        port_cnt = atoi(argv[1]);
+    if (argc > 2)
+        listener_cnt = atoi(argv[2]);
+    if (argc > 3)
+        tick_cnt = atoi(argv[3]);
+    talker_cnt = port_cnt;
+    if (argc > 4)
+        talker_cnt = atoi(argv[4]);
+    if (listener_cnt >= port_cnt)
+        listener_cnt = port_cnt - 1;
+
+    pj_log_set_level(3);
+
+    status = pj_init();
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
+
+    pj_caching_pool_init(&cp, &pj_pool_factory_default_policy, 0);
+
+    printf("Mixing %u ports (%u talking) with %u listeners each, %u ticks "
+           "of %u samples\n", port_cnt, talker_cnt, listener_cnt, tick_cnt,
+           SAMPLES_PER_FRAME);
+
+    status = bench(&cp.factory, 0, port_cnt, listener_cnt, tick_cnt,
+                   talker_cnt);
+    if (status == PJ_SUCCESS) {
+        status = bench(&cp.factory, PJMEDIA_CONF_INCREMENTAL_MIX, port_cnt,
+                       listener_cnt, tick_cnt, talker_cnt);
+    }
+
+    pj_caching_pool_destroy(&cp);
+    pj_shutdown();
+
+    return (status == PJ_SUCCESS) ? 0 : 1;
+}
@@ -193,8 +193,8 @@ typedef struct pjsip_cfg_t
     /** Transaction layer settings. */
     struct {
 
-        /** Maximum number of transactions. The value is initialized with
-         *  PJSIP_MAX_TSX_COUNT
+        /** Initial size of the transaction table. The value is initialized
+         *  with PJSIP_MAX_TSX_COUNT
          */
         unsigned max_count;
 
@@ -306,9 +306,10 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 
 
 /**
- * Specify maximum transaction count in transaction hash table.
- * For efficiency, the value should be 2^n-1 since it will be
- * rounded up to 2^n.
+ * Specify the initial transaction count in transaction hash table. The
+ * table grows as needed when more transactions are registered, so this
+ * only affects the initial memory usage. It is also used to size other
+ * structures such as the timer heap (see PJSIP_MAX_TIMER_COUNT).
  *
  * Default value is 1023
  */
@@ -317,9 +318,8 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 /**
- * Specify maximum number of dialogs in the dialog hash table.
- * For efficiency, the value should be 2^n-1 since it will be
- * rounded up to 2^n.
+ * Specify the initial number of dialogs in the dialog hash table. The
+ * table grows as needed when more dialogs are registered.
  *
  * Default value is 511.
  */
@@ -524,6 +524,27 @@ typedef struct pjsua_logging_config
      */
     void       (*cb)(int level, const char *data, int len);
 
+    /**
+     * Write the log asynchronously. When enabled, threads registered to
+     * pjlib only format the log message and append it to their own log
+     * ring, and a dedicated log thread writes it to the log file, the
+     * console and the callback above (see #pj_log_async_start()). This
+     * takes the file and console I/O off the SIP and media threads.
+     *
+     * Note that with this enabled, the callback above is called from the
+     * log thread.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t   async;
+
+    /**
+     * Asynchronous logging settings, used when \a async is enabled.
+     * Application should initialize this with
+     * #pj_log_async_param_default(), which is done by
+     * #pjsua_logging_config_default().
+     */
+    pj_log_async_param async_param;
 
 } pjsua_logging_config;
 
@@ -604,6 +625,10 @@ typedef struct pjsua_stream_stat
     /** Jitter buffer statistic. */
     pjmedia_jb_state    jbuf;
 
+    /** Per-stage latency histograms of audio streams. Only filled when
+     *  PJMEDIA_STREAM_ENABLE_LATENCY_STAT is enabled, otherwise zero. */
+    pjmedia_stream_lat_stat lat;
+
 } pjsua_stream_stat;
 
 
@@ -6343,6 +6368,202 @@ PJ_DECL(pj_status_t) pjsua_call_dump(pjsua_call_id call_id,
                                      unsigned maxlen,
                                      const char *indent);
 
+
+/**
+ * Dump the RTCP statistics of the audio and video streams of all calls
+ * as one compact JSON object, e.g. for a monitoring tool polling every
+ * second. The statistics are read with #pjmedia_rtcp_get_stat(), so the
+ * media threads are not blocked. The output looks like:
+ *
+ * \verbatim
+   {"streams":[{"call":0,"med":0,"type":"audio","start":1700000000,
+     "rx":{"pkt":..,"bytes":..,"discard":..,"loss":..,"reorder":..,"dup":..,
+           "update_cnt":..,"jitter":{"n":..,"min":..,"mean":..,"max":..,
+           "last":..},"loss_period":{..}},
+     "tx":{..},"rtt":{..}}]}
+   \endverbatim
+ *
+ * Jitter, loss period and RTT are in microseconds.
+ *
+ * @param buffer        Buffer where the statistics are to be written to.
+ *                      The output is null terminated.
+ * @param maxlen        Maximum length of buffer.
+ * @param p_len         Optional pointer to receive the length of the
+ *                      output, excluding the null terminator.
+ *
+ * @return              PJ_SUCCESS on success, or PJ_ETOOSMALL if the
+ *                      buffer is too small.
+ */
+PJ_DECL(pj_status_t) pjsua_call_dump_stat_all(char *buffer,
+                                              unsigned maxlen,
+                                              unsigned *p_len);
+
+
+/**
+ * Default interval of the metrics export sweep, in milliseconds.
+ * See #pjsua_metrics_config.
+ */
+#ifndef PJSUA_METRICS_INTERVAL
+#   define PJSUA_METRICS_INTERVAL       1000
+#endif
+
+
+/**
+ * Default number of samples in the metrics export ring.
+ * See #pjsua_metrics_config.
+ */
+#ifndef PJSUA_METRICS_RING_SIZE
+#   define PJSUA_METRICS_RING_SIZE      256
+#endif
+
+
+/**
+ * One sample of the metrics export, taken from one media stream of
+ * one call at one sweep. See #pjsua_metrics_start().
+ */
+typedef struct pjsua_metrics_sample
+{
+    /** Sweep number. All samples taken in one sweep share this number. */
+    pj_uint32_t                 sweep;
+
+    /** Time of the sweep. */
+    pj_time_val                 ts;
+
+    /** The call. */
+    pjsua_call_id               call_id;
+
+    /** Media index in the call. */
+    unsigned                    med_idx;
+
+    /** Media type, audio or video. */
+    pjmedia_type                type;
+
+    /** RTCP statistics of the decoding direction. */
+    pjmedia_rtcp_stream_stat    rx;
+
+    /** RTCP statistics of the encoding direction. */
+    pjmedia_rtcp_stream_stat    tx;
+
+    /** Round trip delay statistics, in usec. */
+    pj_math_stat                rtt;
+
+    /** Non-zero if jb contains valid jitter buffer state. */
+    pj_bool_t                   has_jb;
+
+    /** Jitter buffer state. */
+    pjmedia_jb_state            jb;
+
+    /**
+     * Non-zero if the following RTCP-XR VoIP metrics are valid, i.e.
+     * RTCP-XR is enabled on the stream and the metrics have been
+     * calculated.
+     */
+    pj_bool_t                   has_xr;
+
+    /** RTCP-XR R factor of the decoding direction. */
+    unsigned                    r_factor;
+
+    /** RTCP-XR MOS-LQ of the decoding direction, times ten. */
+    unsigned                    mos_lq;
+
+    /** RTCP-XR MOS-CQ of the decoding direction, times ten. */
+    unsigned                    mos_cq;
+
+    /** RTCP-XR burst density, in 1/256 units. */
+    unsigned                    burst_den;
+
+    /** RTCP-XR gap density, in 1/256 units. */
+    unsigned                    gap_den;
+
+    /** RTCP-XR loss rate, in 1/256 units. */
+    unsigned                    loss_rate;
+
+    /** RTCP-XR discard rate, in 1/256 units. */
+    unsigned                    discard_rate;
+
+} pjsua_metrics_sample;
+
+
+/**
+ * Metrics export settings. Use #pjsua_metrics_config_default() to
+ * initialize.
+ */
+typedef struct pjsua_metrics_config
+{
+    /**
+     * Interval between two sweeps, in milliseconds.
+     *
+     * Default: PJSUA_METRICS_INTERVAL
+     */
+    unsigned            interval;
+
+    /**
+     * Number of samples in the ring. When the ring is full, the oldest
+     * samples are overwritten.
+     *
+     * Default: PJSUA_METRICS_RING_SIZE
+     */
+    unsigned            ring_size;
+
+    /**
+     * If non-zero, serve the samples of the latest sweep in Prometheus
+     * text format over HTTP on this TCP port of the loopback interface.
+     * Scrapers are served one at a time by their own thread, so a slow
+     * scraper does not delay the sweeps, and a scraper that does not
+     * read the response within a second is dropped.
+     *
+     * Default: 0 (disabled)
+     */
+    unsigned            http_port;
+
+} pjsua_metrics_config;
+
+
+/**
+ * Initialize metrics export settings with default values.
+ *
+ * @param cfg           The settings to initialize.
+ */
+PJ_DECL(void) pjsua_metrics_config_default(pjsua_metrics_config *cfg);
+
+
+/**
+ * Start the metrics export. A dedicated thread takes a snapshot of the
+ * RTCP, RTCP-XR and jitter buffer statistics of every active stream
+ * once every interval, holding the pjsua lock once for the whole sweep,
+ * and stores them in a ring allocated up front. The samples can be
+ * drained with #pjsua_metrics_read(), and if configured, scraped over
+ * HTTP. The metrics export is stopped automatically by #pjsua_destroy().
+ *
+ * @param cfg           The settings, or NULL for default values.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsua_metrics_start(const pjsua_metrics_config *cfg);
+
+
+/**
+ * Stop the metrics export and release its resources.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsua_metrics_stop(void);
+
+
+/**
+ * Drain samples from the metrics export ring, oldest first. Samples
+ * that were overwritten before being read are lost. Draining the ring
+ * does not affect what is served over HTTP.
+ *
+ * @param samples       Array to receive the samples.
+ * @param count         On input, the number of elements in the array.
+ *                      On output, the number of samples read.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsua_metrics_read(pjsua_metrics_sample samples[],
+                                        unsigned *count);
+
 /**
  * Get the media stream index of the default video stream in the call.
  * Typically this will just retrieve the stream index of the first
@@ -7307,6 +7528,35 @@ struct pjsua_media_config
      */
     unsigned            max_media_ports;
 
+    /**
+     * Specify the number of worker threads that help the clock thread to
+     * read and write the conference bridge ports in parallel. See
+     * #pjmedia_conf_param.
+     *
+     * Default value: PJMEDIA_CONF_WORKER_THREADS
+     */
+    unsigned            conf_threads;
+
+    /**
+     * Specify the number of decode worker threads shared by the audio
+     * streams. When non-zero, received audio is decoded ahead of playout
+     * by these threads instead of by the conference bridge clock, see
+     * #pjmedia_stream_dec_pool_create().
+     *
+     * Default value: PJMEDIA_STREAM_DEC_THREADS
+     */
+    unsigned            dec_threads;
+
+    /**
+     * Specify the number of crypto worker threads shared by the SRTP
+     * media transports. When non-zero, outgoing RTP packets are protected
+     * and sent by these threads instead of by the thread that sends them,
+     * see #pjmedia_srtp_tx_pool_create().
+     *
+     * Default value: PJMEDIA_SRTP_TX_THREADS
+     */
+    unsigned            srtp_tx_threads;
+
     /**
      * Specify whether the media manager should manage its own
      * ioqueue for the RTP/RTCP sockets. If yes, ioqueue will be created
@@ -7325,6 +7575,49 @@ struct pjsua_media_config
      */
     unsigned            thread_cnt;
 
+    /**
+     * Specify the number of ioqueue shards of the media endpoint. When
+     * non-zero, the media sockets are spread over this many ioqueues,
+     * each polled by its own thread, instead of the single ioqueue
+     * polled by \a thread_cnt threads. This is only used when
+     * \a has_ioqueue is set. See #pjmedia_endpt_create_shards().
+     *
+     * Default: 0 (not sharded)
+     */
+    unsigned            shard_cnt;
+
+    /**
+     * Bind the thread of each media ioqueue shard to its own CPU.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t           shard_pin_cpu;
+
+    /**
+     * Batch the outgoing RTP packets of the UDP media transports. The
+     * packets which the stream marks as followed by more, such as the
+     * packets of a video frame or the packets protected by the SRTP
+     * crypto pool, are held and sent together with a single syscall.
+     * Other packets are sent right away as before.
+     * See #PJMEDIA_UDP_TX_BATCH.
+     *
+     * Default: PJ_TRUE
+     */
+    pj_bool_t           udp_tx_batch;
+
+    /**
+     * Read the incoming RTP packets of the UDP media transports in
+     * batches, with a single syscall for all the packets queued on the
+     * socket. This pays off for streams receiving bursts of packets,
+     * such as video, while an audio stream mostly finds a single packet
+     * per read. Each transport then keeps
+     * #PJMEDIA_TRANSPORT_UDP_RX_BATCH_MAX receive buffers.
+     * See #PJMEDIA_UDP_RX_BATCH.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t           udp_rx_batch;
+
     /**
      * Media quality, 0-10, according to this table:
      *   5-10: resampling use large filter,
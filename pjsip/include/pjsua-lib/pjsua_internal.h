@@ -547,6 +547,9 @@ struct pjsua_data
     pjmedia_endpt       *med_endpt; /**< Media endpoint.                */
     pjsua_conf_setting   mconf_cfg; /**< Additionan conf. bridge. param */
     pjmedia_conf        *mconf;     /**< Conference bridge.             */
+    pjmedia_stream_dec_pool *dec_pool; /**< Stream decode pool.     */
+    pjmedia_srtp_tx_pool *srtp_tx_pool;/**< SRTP crypto pool.           */
+    struct pjsua_metrics *metrics;  /**< Metrics export.                */
     pj_bool_t            is_mswitch;/**< Are we using audio switchboard
                                          (a.k.a APS-Direct)             */
 
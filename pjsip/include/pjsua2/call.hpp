@@ -202,6 +202,53 @@ public:
     void fromPj(const pjmedia_jb_state &prm);
 };
 
+/**
+ * This structure describes the latency histogram of one stream stage.
+ * It corresponds to the pjmedia_stream_lat_hist structure.
+ */
+struct StreamLatencyHist
+{
+    unsigned    count;              /**< Number of samples.                 */
+    unsigned    minUsec;            /**< Minimum latency, in usec.          */
+    unsigned    maxUsec;            /**< Maximum latency, in usec.          */
+    unsigned    meanUsec;           /**< Average latency, in usec.          */
+    unsigned    p50Usec;            /**< Median latency estimate, in usec.  */
+    unsigned    p90Usec;            /**< 90th percentile estimate, in usec. */
+    unsigned    p99Usec;            /**< 99th percentile estimate, in usec. */
+
+    /**
+     * Number of samples in each histogram bucket. See
+     * pjmedia_stream_lat_bucket_usec() for the bucket ranges.
+     */
+    IntVector   buckets;
+
+public:
+    /**
+     * Convert from pjsip
+     */
+    void fromPj(const pjmedia_stream_lat_hist &prm);
+};
+
+/**
+ * This structure describes per-stage stream latency statistics. It is
+ * only filled for audio streams when PJMEDIA_STREAM_ENABLE_LATENCY_STAT
+ * is enabled.
+ */
+struct StreamLatencyStat
+{
+    StreamLatencyHist   rx;         /**< RTP receive processing.            */
+    StreamLatencyHist   jbuf;       /**< Jitter buffer wait.                */
+    StreamLatencyHist   decode;     /**< Jitter buffer get and decode.      */
+    StreamLatencyHist   conf;       /**< Upstream (conference) processing.  */
+    StreamLatencyHist   encode;     /**< Encode and send.                   */
+
+public:
+    /**
+     * Convert from pjsip
+     */
+    void fromPj(const pjmedia_stream_lat_stat &prm);
+};
+
 /**
  * This structure describes SDP session description. It corresponds to the
  * pjmedia_sdp_session structure.
@@ -726,6 +773,11 @@ struct StreamStat
      */
     JbufState   jbuf;
 
+    /**
+     * Per-stage latency statistic.
+     */
+    StreamLatencyStat lat;
+
 public:
     /**
      * Convert from pjsip
@@ -898,6 +898,39 @@ struct LogConfig : public PersistentObject
      */
     LogWriter           *writer;
 
+    /**
+     * Write the log asynchronously from a dedicated log thread, so that
+     * the file, console and writer I/O is taken off the SIP and media
+     * threads. Note that the writer above is then called from the log
+     * thread. See pj_log_async_start() for details.
+     *
+     * Default: false
+     */
+    bool                async;
+
+    /**
+     * Size of each thread's log ring in bytes, when async is enabled.
+     *
+     * Default: PJ_LOG_ASYNC_RING_SIZE
+     */
+    unsigned            asyncRingSize;
+
+    /**
+     * What to do when a thread's log ring is full, when async is enabled.
+     *
+     * Default: PJ_LOG_ASYNC_DROP
+     */
+    pj_log_async_policy asyncPolicy;
+
+    /**
+     * With PJ_LOG_ASYNC_DROP policy, only messages with this level or
+     * higher (i.e. less important) are dropped, more important messages
+     * wait for space in the ring.
+     *
+     * Default: 4
+     */
+    int                 asyncDropLevel;
+
 public:
     /** Default constructor initialises with default values */
     LogConfig();
@@ -981,6 +1014,30 @@ public:
      */
     unsigned            maxMediaPorts;
 
+    /**
+     * Specify the number of worker threads that help the clock thread to
+     * read and write the conference bridge ports in parallel.
+     *
+     * Default value: PJMEDIA_CONF_WORKER_THREADS
+     */
+    unsigned            confThreads;
+
+    /**
+     * Specify the number of decode worker threads shared by the audio
+     * streams, to decode received audio ahead of playout.
+     *
+     * Default value: PJMEDIA_STREAM_DEC_THREADS
+     */
+    unsigned            decThreads;
+
+    /**
+     * Specify the number of crypto worker threads shared by the SRTP
+     * media transports, to protect and send outgoing RTP packets.
+     *
+     * Default value: PJMEDIA_SRTP_TX_THREADS
+     */
+    unsigned            srtpTxThreads;
+
     /**
      * Specify whether the media manager should manage its own
      * ioqueue for the RTP/RTCP sockets. If yes, ioqueue will be created
@@ -999,6 +1056,41 @@ public:
      */
     unsigned            threadCnt;
 
+    /**
+     * Specify the number of ioqueue shards of the media endpoint. When
+     * non-zero, the media sockets are spread over this many ioqueues,
+     * each polled by its own thread. This is only used when hasIoqueue
+     * is set.
+     *
+     * Default: 0 (not sharded)
+     */
+    unsigned            shardCnt;
+
+    /**
+     * Bind the thread of each media ioqueue shard to its own CPU.
+     *
+     * Default: false
+     */
+    bool                shardPinCpu;
+
+    /**
+     * Batch the outgoing RTP packets of the UDP media transports which
+     * the stream marks as followed by more, such as the packets of a
+     * video frame, and send them with a single syscall.
+     *
+     * Default: true
+     */
+    bool                udpTxBatch;
+
+    /**
+     * Read the incoming RTP packets of the UDP media transports in
+     * batches, with a single syscall for all the packets queued on the
+     * socket. This pays off for video streams.
+     *
+     * Default: false
+     */
+    bool                udpRxBatch;
+
     /**
      * Media quality, 0-10, according to this table:
      *   5-10: resampling use large filter,
@@ -24,6 +24,7 @@
 #include <pjsip/sip_event.h>
 #include <pjlib-util/errno.h>
 #include <pj/hash.h>
+#include <pj/ohash.h>
 #include <pj/pool.h>
 #include <pj/os.h>
 #include <pj/rand.h>
@@ -73,8 +74,8 @@ static struct mod_tsx_layer
     pj_pool_t           *pool;
     pjsip_endpoint      *endpt;
     pj_mutex_t          *mutex;
-    pj_hash_table_t     *htable;
-    pj_hash_table_t     *htable2;
+    pj_ohash_t          *htable;
+    pj_ohash_t          *htable2;
 } mod_tsx_layer = 
 {   {
         NULL, NULL,                     /* List's prev and next.    */
@@ -529,16 +530,25 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
 
 
     /* Create hash table. */
-    mod_tsx_layer.htable = pj_hash_create( pool, pjsip_cfg()->tsx.max_count );
-    mod_tsx_layer.htable2 = pj_hash_create(pool, pjsip_cfg()->tsx.max_count);
-    if (!mod_tsx_layer.htable || !mod_tsx_layer.htable2) {
+    status = pj_ohash_create(pool, pjsip_cfg()->tsx.max_count,
+                             PJ_OHASH_ICASE, &mod_tsx_layer.htable);
+    if (status != PJ_SUCCESS) {
         pjsip_endpt_release_pool(endpt, pool);
-        return PJ_ENOMEM;
+        return status;
+    }
+    status = pj_ohash_create(pool, pjsip_cfg()->tsx.max_count,
+                             PJ_OHASH_ICASE, &mod_tsx_layer.htable2);
+    if (status != PJ_SUCCESS) {
+        pj_ohash_destroy(mod_tsx_layer.htable);
+        pjsip_endpt_release_pool(endpt, pool);
+        return status;
     }
 
     /* Create group lock. */
     status = pj_mutex_create_recursive(pool, "tsxlayer", &mod_tsx_layer.mutex);
     if (status != PJ_SUCCESS) {
+        pj_ohash_destroy(mod_tsx_layer.htable2);
+        pj_ohash_destroy(mod_tsx_layer.htable);
         pjsip_endpt_release_pool(endpt, pool);
         return status;
     }
@@ -549,6 +559,8 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
     status = pjsip_endpt_register_module( endpt, &mod_tsx_layer.mod );
     if (status != PJ_SUCCESS) {
         pj_mutex_destroy(mod_tsx_layer.mutex);
+        pj_ohash_destroy(mod_tsx_layer.htable2);
+        pj_ohash_destroy(mod_tsx_layer.htable);
         pjsip_endpt_release_pool(endpt, pool);
         return status;
     }
@@ -593,6 +605,8 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_destroy(void)
  */
 static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
 {
+    pj_status_t status;
+
     pj_assert(tsx->transaction_key.slen != 0);
 
     /* Lock hash table mutex. */
@@ -602,10 +616,10 @@ static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
      * Do not use PJ_ASSERT_RETURN since it evaluates the expression
      * twice!
      */
-    if(pj_hash_get_lower(mod_tsx_layer.htable, 
-                         tsx->transaction_key.ptr,
-                         (unsigned)tsx->transaction_key.slen, 
-                         NULL))
+    if(pj_ohash_get(mod_tsx_layer.htable, 
+                    tsx->transaction_key.ptr,
+                    (unsigned)tsx->transaction_key.slen, 
+                    NULL))
     {
         pj_mutex_unlock(mod_tsx_layer.mutex);
         PJ_LOG(2,(THIS_FILE, 
@@ -625,31 +639,38 @@ static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
      * detecting merged requests.
      */
 #ifdef PRECALC_HASH
-    pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable,
-                       tsx->transaction_key.ptr,
-                       (unsigned)tsx->transaction_key.slen, 
-                       tsx->hashed_key, tsx);
-    if (tsx->role == PJSIP_ROLE_UAS) {
-        pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable2,
-                           tsx->transaction_key2.ptr,
-                           (unsigned)tsx->transaction_key2.slen,
-                           tsx->hashed_key2, tsx);
+    status = pj_ohash_set(mod_tsx_layer.htable, tsx->transaction_key.ptr,
+                          (unsigned)tsx->transaction_key.slen,
+                          tsx->hashed_key, tsx);
+    if (status == PJ_SUCCESS && tsx->role == PJSIP_ROLE_UAS) {
+        status = pj_ohash_set(mod_tsx_layer.htable2,
+                              tsx->transaction_key2.ptr,
+                              (unsigned)tsx->transaction_key2.slen,
+                              tsx->hashed_key2, tsx);
+        if (status != PJ_SUCCESS) {
+            pj_ohash_set(mod_tsx_layer.htable, tsx->transaction_key.ptr,
+                         (unsigned)tsx->transaction_key.slen,
+                         tsx->hashed_key, NULL);
+        }
     }
 #else
-    pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable,
-                       tsx->transaction_key.ptr,
-                       tsx->transaction_key.slen, 0, tsx);
-    if (tsx->role == PJSIP_ROLE_UAS) {
-        pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable2,
-                           tsx->transaction_key2.ptr,
-                           tsx->transaction_key2.slen, 0, tsx);
+    status = pj_ohash_set(mod_tsx_layer.htable, tsx->transaction_key.ptr,
+                          (unsigned)tsx->transaction_key.slen, 0, tsx);
+    if (status == PJ_SUCCESS && tsx->role == PJSIP_ROLE_UAS) {
+        status = pj_ohash_set(mod_tsx_layer.htable2,
+                              tsx->transaction_key2.ptr,
+                              (unsigned)tsx->transaction_key2.slen, 0, tsx);
+        if (status != PJ_SUCCESS) {
+            pj_ohash_set(mod_tsx_layer.htable, tsx->transaction_key.ptr,
+                         (unsigned)tsx->transaction_key.slen, 0, NULL);
+        }
     }
 #endif
 
     /* Unlock mutex. */
     pj_mutex_unlock(mod_tsx_layer.mutex);
 
-    return PJ_SUCCESS;
+    return status;
 }
 
 
@@ -675,22 +696,20 @@ static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
 
     /* Unregister the transaction from the hash tables. */
 #ifdef PRECALC_HASH
-    pj_hash_set_lower( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
-                       (unsigned)tsx->transaction_key.slen, tsx->hashed_key,
-                       NULL);
+    pj_ohash_set(mod_tsx_layer.htable, tsx->transaction_key.ptr,
+                 (unsigned)tsx->transaction_key.slen, tsx->hashed_key,
+                 NULL);
     if (tsx->role == PJSIP_ROLE_UAS) {
-        pj_hash_set_lower(NULL, mod_tsx_layer.htable2,
-                          tsx->transaction_key2.ptr,
-                          (unsigned)tsx->transaction_key2.slen,
-                          tsx->hashed_key2, NULL);
+        pj_ohash_set(mod_tsx_layer.htable2, tsx->transaction_key2.ptr,
+                     (unsigned)tsx->transaction_key2.slen,
+                     tsx->hashed_key2, NULL);
     }
 #else
-    pj_hash_set_lower( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
-                       tsx->transaction_key.slen, 0, NULL);
+    pj_ohash_set(mod_tsx_layer.htable, tsx->transaction_key.ptr,
+                 (unsigned)tsx->transaction_key.slen, 0, NULL);
     if (tsx->role == PJSIP_ROLE_UAS) {
-        pj_hash_set_lower(NULL, mod_tsx_layer.htable2,
-                          tsx->transaction_key2.ptr,
-                          tsx->transaction_key2.slen, 0, NULL);
+        pj_ohash_set(mod_tsx_layer.htable2, tsx->transaction_key2.ptr,
+                     (unsigned)tsx->transaction_key2.slen, 0, NULL);
     }
 #endif
 
@@ -716,7 +735,7 @@ PJ_DEF(unsigned) pjsip_tsx_layer_get_tsx_count(void)
     PJ_ASSERT_RETURN(mod_tsx_layer.endpt!=NULL, 0);
 
     pj_mutex_lock(mod_tsx_layer.mutex);
-    count = pj_hash_count(mod_tsx_layer.htable);
+    count = pj_ohash_count(mod_tsx_layer.htable);
     pj_mutex_unlock(mod_tsx_layer.mutex);
 
     return count;
@@ -734,8 +753,8 @@ static pjsip_transaction* find_tsx( const pj_str_t *key, pj_bool_t lock,
 
     pj_mutex_lock(mod_tsx_layer.mutex);
     tsx = (pjsip_transaction*)
-          pj_hash_get_lower( mod_tsx_layer.htable, key->ptr, 
-                             (unsigned)key->slen, &hval );
+          pj_ohash_get( mod_tsx_layer.htable, key->ptr, 
+                        (unsigned)key->slen, &hval );
     
     /* Prevent the transaction to get deleted before we have chance to lock it.
      */
@@ -796,33 +815,88 @@ static pj_status_t mod_tsx_layer_start(void)
 }
 
 
+/* Copy the transactions in the hash table to an array allocated from
+ * the pool, adding a reference to each of them, so that the transactions
+ * can be processed without iterating the table while it may be modified
+ * (e.g. a callback creating a new transaction may cause the table to
+ * grow). Call put_tsx_array() to release the references. The caller must
+ * hold the transaction layer mutex.
+ */
+static unsigned get_tsx_array(pj_pool_t *pool, pjsip_transaction ***p_tsx)
+{
+    pj_ohash_iterator_t it_buf, *it;
+    pjsip_transaction **tsx;
+    unsigned cnt = 0, max_cnt;
+
+    max_cnt = pj_ohash_count(mod_tsx_layer.htable);
+    if (max_cnt == 0) {
+        *p_tsx = NULL;
+        return 0;
+    }
+
+    tsx = (pjsip_transaction**)
+          pj_pool_calloc(pool, max_cnt, sizeof(pjsip_transaction*));
+
+    it = pj_ohash_first(mod_tsx_layer.htable, &it_buf);
+    while (it && cnt < max_cnt) {
+        pjsip_transaction *t = (pjsip_transaction*)
+                               pj_ohash_this(mod_tsx_layer.htable, it);
+        if (t) {
+            pj_grp_lock_add_ref(t->grp_lock);
+            tsx[cnt++] = t;
+        }
+        it = pj_ohash_next(mod_tsx_layer.htable, it);
+    }
+
+    *p_tsx = tsx;
+    return cnt;
+}
+
+
+/* Release the references added by get_tsx_array(). */
+static void put_tsx_array(pjsip_transaction **tsx, unsigned cnt)
+{
+    unsigned i;
+
+    for (i = 0; i < cnt; ++i)
+        pj_grp_lock_dec_ref(tsx[i]->grp_lock);
+}
+
+
 /* This module callback is called when module is being stopped by
  * endpoint. 
  */
 static pj_status_t mod_tsx_layer_stop(void)
 {
-    pj_hash_iterator_t it_buf, *it;
+    pj_pool_t *pool;
+    pjsip_transaction **tsx;
+    unsigned i, cnt;
 
     PJ_LOG(4,(THIS_FILE, "Stopping transaction layer module"));
 
+    pool = pjsip_endpt_create_pool(mod_tsx_layer.endpt, "tsxstop",
+                                   PJSIP_POOL_TSX_LAYER_LEN,
+                                   PJSIP_POOL_TSX_LAYER_INC);
+    if (!pool)
+        return PJ_ENOMEM;
+
     pj_mutex_lock(mod_tsx_layer.mutex);
 
-    /* Destroy all transactions. */
-    it = pj_hash_first(mod_tsx_layer.htable, &it_buf);
-    while (it) {
-        pjsip_transaction *tsx = (pjsip_transaction*) 
-                                 pj_hash_this(mod_tsx_layer.htable, it);
-        pj_hash_iterator_t *next = pj_hash_next(mod_tsx_layer.htable, it);
-        if (tsx) {
-            pjsip_tsx_terminate(tsx, PJSIP_SC_SERVICE_UNAVAILABLE);
-            mod_tsx_layer_unregister_tsx(tsx);
-            tsx_shutdown(tsx);
-        }
-        it = next;
+    /* Destroy all transactions. The transactions are collected first, as
+     * terminating a transaction may add or remove other transactions.
+     */
+    cnt = get_tsx_array(pool, &tsx);
+    for (i = 0; i < cnt; ++i) {
+        pjsip_tsx_terminate(tsx[i], PJSIP_SC_SERVICE_UNAVAILABLE);
+        mod_tsx_layer_unregister_tsx(tsx[i]);
+        tsx_shutdown(tsx[i]);
     }
+    put_tsx_array(tsx, cnt);
 
     pj_mutex_unlock(mod_tsx_layer.mutex);
 
+    pjsip_endpt_release_pool(mod_tsx_layer.endpt, pool);
+
     PJ_LOG(4,(THIS_FILE, "Stopped transaction layer module"));
 
     return PJ_SUCCESS;
@@ -837,6 +911,10 @@ static void tsx_layer_destroy(pjsip_endpoint *endpt)
     /* Destroy mutex. */
     pj_mutex_destroy(mod_tsx_layer.mutex);
 
+    /* Release hash tables. */
+    pj_ohash_destroy(mod_tsx_layer.htable2);
+    pj_ohash_destroy(mod_tsx_layer.htable);
+
     /* Release pool. */
     pjsip_endpt_release_pool(mod_tsx_layer.endpt, mod_tsx_layer.pool);
 
@@ -858,7 +936,7 @@ static pj_status_t mod_tsx_layer_unload(void)
      * crash when the pending transaction finally got error response
      * from transport and when it tries to unregister itself.
      */
-    if (pj_hash_count(mod_tsx_layer.htable) != 0) {
+    if (pj_ohash_count(mod_tsx_layer.htable) != 0) {
         pj_status_t status;
         status = pjsip_endpt_atexit(mod_tsx_layer.endpt, &tsx_layer_destroy);
         if (status != PJ_SUCCESS) {
@@ -901,8 +979,8 @@ pjsip_tsx_detect_merged_requests(pjsip_rx_data *rdata)
     /* This request must not match any transaction in our primary hash
      * table.
      */
-    if (pj_hash_get_lower(mod_tsx_layer.htable, key.ptr, (unsigned)key.slen,
-                          &hval) != NULL)
+    if (pj_ohash_get(mod_tsx_layer.htable, key.ptr, (unsigned)key.slen,
+                     &hval) != NULL)
     {
         pj_mutex_unlock( mod_tsx_layer.mutex);
         return NULL;
@@ -920,8 +998,8 @@ pjsip_tsx_detect_merged_requests(pjsip_rx_data *rdata)
     }
 
     hval = 0;
-    tsx = pj_hash_get_lower(mod_tsx_layer.htable2, key2.ptr,
-                            (unsigned)key2.slen, &hval);
+    tsx = pj_ohash_get(mod_tsx_layer.htable2, key2.ptr,
+                       (unsigned)key2.slen, &hval);
 
     pj_mutex_unlock( mod_tsx_layer.mutex);
 
@@ -944,8 +1022,8 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
     pj_mutex_lock( mod_tsx_layer.mutex );
 
     tsx = (pjsip_transaction*) 
-          pj_hash_get_lower( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
-                             &hval );
+          pj_ohash_get( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
+                        &hval );
 
 
     TSX_TRACE_((THIS_FILE, 
@@ -1010,8 +1088,8 @@ static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
     pj_mutex_lock( mod_tsx_layer.mutex );
 
     tsx = (pjsip_transaction*) 
-          pj_hash_get_lower( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
-                             &hval );
+          pj_ohash_get( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
+                        &hval );
 
 
     TSX_TRACE_((THIS_FILE, 
@@ -1064,39 +1142,45 @@ PJ_DEF(pjsip_transaction*) pjsip_rdata_get_tsx( pjsip_rx_data *rdata )
 PJ_DEF(void) pjsip_tsx_layer_dump(pj_bool_t detail)
 {
 #if PJ_LOG_MAX_LEVEL >= 3
-    pj_hash_iterator_t itbuf, *it;
+    pj_pool_t *pool = NULL;
+    pjsip_transaction **tsx;
+    unsigned i, cnt;
+
+    if (detail) {
+        pool = pjsip_endpt_create_pool(mod_tsx_layer.endpt, "tsxdump",
+                                       PJSIP_POOL_TSX_LAYER_LEN,
+                                       PJSIP_POOL_TSX_LAYER_INC);
+    }
 
     /* Lock mutex. */
     pj_mutex_lock(mod_tsx_layer.mutex);
 
     PJ_LOG(3, (THIS_FILE, "Dumping transaction table:"));
     PJ_LOG(3, (THIS_FILE, " Total %d transactions", 
-                          pj_hash_count(mod_tsx_layer.htable)));
+                          pj_ohash_count(mod_tsx_layer.htable)));
 
-    if (detail) {
-        it = pj_hash_first(mod_tsx_layer.htable, &itbuf);
-        if (it == NULL) {
+    if (pool) {
+        cnt = get_tsx_array(pool, &tsx);
+        if (cnt == 0) {
             PJ_LOG(3, (THIS_FILE, " - none - "));
-        } else {
-            while (it != NULL) {
-                pjsip_transaction *tsx = (pjsip_transaction*) 
-                                         pj_hash_this(mod_tsx_layer.htable,it);
-
-                PJ_LOG(3, (THIS_FILE, " %s %s|%d|%s",
-                           tsx->obj_name,
-                           (tsx->last_tx? 
-                                pjsip_tx_data_get_info(tsx->last_tx): 
-                                "none"),
-                           tsx->status_code,
-                           pjsip_tsx_state_str(tsx->state)));
-
-                it = pj_hash_next(mod_tsx_layer.htable, it);
-            }
         }
+        for (i = 0; i < cnt; ++i) {
+            PJ_LOG(3, (THIS_FILE, " %s %s|%d|%s",
+                       tsx[i]->obj_name,
+                       (tsx[i]->last_tx? 
+                            pjsip_tx_data_get_info(tsx[i]->last_tx): 
+                            "none"),
+                       tsx[i]->status_code,
+                       pjsip_tsx_state_str(tsx[i]->state)));
+        }
+        put_tsx_array(tsx, cnt);
     }
 
     /* Unlock mutex. */
     pj_mutex_unlock(mod_tsx_layer.mutex);
+
+    if (pool)
+        pjsip_endpt_release_pool(mod_tsx_layer.endpt, pool);
 #endif
 }
 
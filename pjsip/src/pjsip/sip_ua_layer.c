@@ -24,6 +24,7 @@
 #include <pjsip/sip_transaction.h>
 #include <pj/os.h>
 #include <pj/hash.h>
+#include <pj/ohash.h>
 #include <pj/assert.h>
 #include <pj/string.h>
 #include <pj/pool.h>
@@ -61,9 +62,6 @@ struct dlg_set
     /* To put this node in free dlg_set nodes in UA. */
     PJ_DECL_LIST_MEMBER(struct dlg_set);
 
-    /* This is the buffer to store this entry in the hash table. */
-    pj_hash_entry_buf ht_entry;
-
     /* Entry key in the hash table */
     pj_str_t ht_key;
 
@@ -81,7 +79,7 @@ static struct user_agent
     pj_pool_t           *pool;
     pjsip_endpoint      *endpt;
     pj_mutex_t          *mutex;
-    pj_hash_table_t     *dlg_table;
+    pj_ohash_t          *dlg_table;
     pjsip_ua_init_param  param;
     struct dlg_set       free_dlgset_nodes;
 
@@ -124,9 +122,10 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
     if (status != PJ_SUCCESS)
         return status;
 
-    mod_ua.dlg_table = pj_hash_create(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT);
-    if (mod_ua.dlg_table == NULL)
-        return PJ_ENOMEM;
+    status = pj_ohash_create(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT,
+                             PJ_OHASH_ICASE, &mod_ua.dlg_table);
+    if (status != PJ_SUCCESS)
+        return status;
 
     pj_list_init(&mod_ua.free_dlgset_nodes);
 
@@ -151,6 +150,12 @@ static pj_status_t mod_ua_unload(void)
     pj_thread_local_free(pjsip_dlg_lock_tls_id);
     pj_mutex_destroy(mod_ua.mutex);
 
+    /* Release dialog table */
+    if (mod_ua.dlg_table) {
+        pj_ohash_destroy(mod_ua.dlg_table);
+        mod_ua.dlg_table = NULL;
+    }
+
     /* Release pool */
     if (mod_ua.pool) {
         pjsip_endpt_release_pool( mod_ua.endpt, mod_ua.pool );
@@ -290,6 +295,8 @@ static struct dlg_set *alloc_dlgset_node(void)
 PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
                                            pjsip_dialog *dlg )
 {
+    pj_status_t status = PJ_SUCCESS;
+
     /* Sanity check. */
     PJ_ASSERT_RETURN(ua && dlg, PJ_EINVAL);
 
@@ -310,10 +317,10 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
         struct dlg_set *dlg_set;
 
         dlg_set = (struct dlg_set*)
-                  pj_hash_get_lower( mod_ua.dlg_table,
-                                     dlg->local.info->tag.ptr, 
-                                     (unsigned)dlg->local.info->tag.slen,
-                                     &dlg->local.tag_hval);
+                  pj_ohash_get(mod_ua.dlg_table,
+                               dlg->local.info->tag.ptr,
+                               (unsigned)dlg->local.info->tag.slen,
+                               &dlg->local.tag_hval);
 
         if (dlg_set) {
             /* This is NOT the first dialog in the dialog set. 
@@ -336,11 +343,14 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
             dlg->dlg_set = dlg_set;
 
             /* Register the dialog set in the hash table. */
-            pj_hash_set_np_lower(mod_ua.dlg_table, 
-                                 dlg_set->ht_key.ptr,
-                                 (unsigned)dlg_set->ht_key.slen,
-                                 dlg->local.tag_hval, dlg_set->ht_entry,
-                                 dlg_set);
+            status = pj_ohash_set(mod_ua.dlg_table, dlg_set->ht_key.ptr,
+                                  (unsigned)dlg_set->ht_key.slen,
+                                  dlg->local.tag_hval, dlg_set);
+            if (status != PJ_SUCCESS) {
+                pj_list_erase(dlg);
+                pj_list_push_back(&mod_ua.free_dlgset_nodes, dlg_set);
+                dlg->dlg_set = NULL;
+            }
         }
 
     } else {
@@ -354,17 +364,21 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
 
         dlg->dlg_set = dlg_set;
 
-        pj_hash_set_np_lower(mod_ua.dlg_table, 
-                             dlg_set->ht_key.ptr,
-                             (unsigned)dlg_set->ht_key.slen,
-                             dlg->local.tag_hval, dlg_set->ht_entry, dlg_set);
+        status = pj_ohash_set(mod_ua.dlg_table, dlg_set->ht_key.ptr,
+                              (unsigned)dlg_set->ht_key.slen,
+                              dlg->local.tag_hval, dlg_set);
+        if (status != PJ_SUCCESS) {
+            pj_list_erase(dlg);
+            pj_list_push_back(&mod_ua.free_dlgset_nodes, dlg_set);
+            dlg->dlg_set = NULL;
+        }
     }
 
     /* Unlock user agent. */
     pj_mutex_unlock(mod_ua.mutex);
 
     /* Done. */
-    return PJ_SUCCESS;
+    return status;
 }
 
 
@@ -403,20 +417,21 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
     if (pj_list_empty(&dlg_set->dlg_list)) {
 
         /* Verify that the dialog set is valid */
-        pj_assert(pj_hash_get_lower(mod_ua.dlg_table, dlg_set->ht_key.ptr,
-                                    (unsigned)dlg_set->ht_key.slen,
-                                    &dlg->local.tag_hval) == dlg_set);
+        pj_assert(pj_ohash_get(mod_ua.dlg_table, dlg_set->ht_key.ptr,
+                               (unsigned)dlg_set->ht_key.slen,
+                               &dlg->local.tag_hval) == dlg_set);
 
-        pj_hash_set_lower(NULL, mod_ua.dlg_table, dlg_set->ht_key.ptr,
-                          (unsigned)dlg_set->ht_key.slen,
-                          dlg->local.tag_hval, NULL);
+        pj_ohash_set(mod_ua.dlg_table, dlg_set->ht_key.ptr,
+                     (unsigned)dlg_set->ht_key.slen,
+                     dlg->local.tag_hval, NULL);
 
         /* Return dlg_set to free nodes. */
         pj_list_push_back(&mod_ua.free_dlgset_nodes, dlg_set);
     } else {
         /* If the just unregistered dialog is being used as hash key,
          * reset the dlg_set entry with a new key (i.e: from the first dialog
-         * in dlg_set).
+         * in dlg_set). Both keys hold the same tag, so setting the entry
+         * again just makes the table refer to the new key.
          */
         if (dlg_set->ht_key.ptr  == dlg->local.info->tag.ptr &&
             dlg_set->ht_key.slen == dlg->local.info->tag.slen)
@@ -426,17 +441,11 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
             /* Verify that the old & new keys share the hash value */
             pj_assert(key_dlg->local.tag_hval == dlg->local.tag_hval);
 
-            pj_hash_set_lower(NULL, mod_ua.dlg_table, dlg_set->ht_key.ptr,
-                              (unsigned)dlg_set->ht_key.slen,
-                              dlg->local.tag_hval, NULL);
-
             dlg_set->ht_key = key_dlg->local.info->tag;
 
-            pj_hash_set_np_lower(mod_ua.dlg_table,
-                                 dlg_set->ht_key.ptr,
-                                 (unsigned)dlg_set->ht_key.slen,
-                                 key_dlg->local.tag_hval, dlg_set->ht_entry,
-                                 dlg_set);
+            pj_ohash_set(mod_ua.dlg_table, dlg_set->ht_key.ptr,
+                         (unsigned)dlg_set->ht_key.slen,
+                         key_dlg->local.tag_hval, dlg_set);
         }
     }
 
@@ -475,7 +484,7 @@ PJ_DEF(unsigned) pjsip_ua_get_dlg_set_count(void)
     PJ_ASSERT_RETURN(mod_ua.endpt, 0);
 
     pj_mutex_lock(mod_ua.mutex);
-    count = pj_hash_count(mod_ua.dlg_table);
+    count = pj_ohash_count(mod_ua.dlg_table);
     pj_mutex_unlock(mod_ua.mutex);
 
     return count;
@@ -500,8 +509,8 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
 
     /* Lookup the dialog set. */
     dlg_set = (struct dlg_set*)
-              pj_hash_get_lower(mod_ua.dlg_table, local_tag->ptr,
-                                (unsigned)local_tag->slen, NULL);
+              pj_ohash_get(mod_ua.dlg_table, local_tag->ptr,
+                           (unsigned)local_tag->slen, NULL);
     if (dlg_set == NULL) {
         /* Not found */
         pj_mutex_unlock(mod_ua.mutex);
@@ -620,8 +629,8 @@ static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
 
         /* Lookup the dialog set. */
         dlg_set = (struct dlg_set*)
-                  pj_hash_get_lower(mod_ua.dlg_table, tag->ptr, 
-                                    (unsigned)tag->slen, NULL);
+                  pj_ohash_get(mod_ua.dlg_table, tag->ptr, 
+                               (unsigned)tag->slen, NULL);
         return dlg_set;
     }
 }
@@ -819,10 +828,10 @@ retry_on_deadlock:
 
         /* Get the dialog set. */
         dlg_set = (struct dlg_set*)
-                  pj_hash_get_lower(mod_ua.dlg_table, 
-                                    rdata->msg_info.from->tag.ptr,
-                                    (unsigned)rdata->msg_info.from->tag.slen,
-                                    NULL);
+                  pj_ohash_get(mod_ua.dlg_table, 
+                               rdata->msg_info.from->tag.ptr,
+                               (unsigned)rdata->msg_info.from->tag.slen,
+                               NULL);
 
         if (!dlg_set) {
             /* Unlock dialog hash table. */
@@ -992,23 +1001,23 @@ static void print_dialog( const char *title,
 PJ_DEF(void) pjsip_ua_dump(pj_bool_t detail)
 {
 #if PJ_LOG_MAX_LEVEL >= 3
-    pj_hash_iterator_t itbuf, *it;
+    pj_ohash_iterator_t itbuf, *it;
     char dlginfo[128];
 
     pj_mutex_lock(mod_ua.mutex);
 
     PJ_LOG(3, (THIS_FILE, "Number of dialog sets: %u", 
-                          pj_hash_count(mod_ua.dlg_table)));
+                          pj_ohash_count(mod_ua.dlg_table)));
 
-    if (detail && pj_hash_count(mod_ua.dlg_table)) {
+    if (detail && pj_ohash_count(mod_ua.dlg_table)) {
         PJ_LOG(3, (THIS_FILE, "Dumping dialog sets:"));
-        it = pj_hash_first(mod_ua.dlg_table, &itbuf);
-        for (; it != NULL; it = pj_hash_next(mod_ua.dlg_table, it))  {
+        it = pj_ohash_first(mod_ua.dlg_table, &itbuf);
+        for (; it != NULL; it = pj_ohash_next(mod_ua.dlg_table, it))  {
             struct dlg_set *dlg_set;
             pjsip_dialog *dlg;
             const char *title;
 
-            dlg_set = (struct dlg_set*) pj_hash_this(mod_ua.dlg_table, it);
+            dlg_set = (struct dlg_set*) pj_ohash_this(mod_ua.dlg_table, it);
             if (!dlg_set || pj_list_empty(&dlg_set->dlg_list)) continue;
 
             /* First dialog in dialog set. */
@@ -219,9 +219,14 @@ PJ_DEF(pj_status_t) pjsua_call_get_stream_stat( pjsua_call_id call_id,
         if (status == PJ_SUCCESS)
             status = pjmedia_stream_get_stat_jbuf(call_med->strm.a.stream,
                                                   &stat->jbuf);
+        if (status == PJ_SUCCESS) {
+            /* Latency statistics are optional, ignore PJ_ENOTSUP */
+            pjmedia_stream_get_stat_lat(call_med->strm.a.stream, &stat->lat);
+        }
         break;
 #if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0)
     case PJMEDIA_TYPE_VIDEO:
+        pj_bzero(&stat->lat, sizeof(stat->lat));
         status = pjmedia_vid_stream_get_stat(call_med->strm.v.stream,
                                              &stat->rtcp);
         if (status == PJ_SUCCESS)
@@ -293,6 +298,7 @@ pj_status_t pjsua_aud_subsys_init()
 {
     pj_str_t codec_id = {NULL, 0};
     unsigned opt;
+    pjmedia_conf_param conf_prm;
     pjmedia_audio_codec_config codec_cfg;
     pj_status_t status;
 #if PJMEDIA_HAS_PASSTHROUGH_CODECS
@@ -408,19 +414,34 @@ pj_status_t pjsua_aud_subsys_init()
     }
 
     /* Init conference bridge. */
-    status = pjmedia_conf_create(pjsua_var.pool,
-                                 pjsua_var.media_cfg.max_media_ports,
-                                 pjsua_var.media_cfg.clock_rate,
-                                 pjsua_var.mconf_cfg.channel_count,
-                                 pjsua_var.mconf_cfg.samples_per_frame,
-                                 pjsua_var.mconf_cfg.bits_per_sample,
-                                 opt, &pjsua_var.mconf);
+    pjmedia_conf_param_default(&conf_prm);
+    conf_prm.max_slots = pjsua_var.media_cfg.max_media_ports;
+    conf_prm.sampling_rate = pjsua_var.media_cfg.clock_rate;
+    conf_prm.channel_count = pjsua_var.mconf_cfg.channel_count;
+    conf_prm.samples_per_frame = pjsua_var.mconf_cfg.samples_per_frame;
+    conf_prm.bits_per_sample = pjsua_var.mconf_cfg.bits_per_sample;
+    conf_prm.options = opt;
+    conf_prm.worker_threads = pjsua_var.media_cfg.conf_threads;
+    status = pjmedia_conf_create2(pjsua_var.pool, &conf_prm,
+                                  &pjsua_var.mconf);
     if (status != PJ_SUCCESS) {
         pjsua_perror(THIS_FILE, "Error creating conference bridge",
                      status);
         goto on_error;
     }
 
+    /* Create the stream decode pool */
+    if (pjsua_var.media_cfg.dec_threads) {
+        status = pjmedia_stream_dec_pool_create(pjsua_var.pool,
+                                                pjsua_var.media_cfg.dec_threads,
+                                                &pjsua_var.dec_pool);
+        if (status != PJ_SUCCESS) {
+            pjsua_perror(THIS_FILE, "Error creating stream decode pool",
+                         status);
+            goto on_error;
+        }
+    }
+
     /* Are we using the audio switchboard (a.k.a APS-Direct)? */
     pjsua_var.is_mswitch = pjmedia_conf_get_master_port(pjsua_var.mconf)
                             ->info.signature == PJMEDIA_CONF_SWITCH_SIGNATURE;
@@ -558,6 +579,11 @@ pj_status_t pjsua_aud_subsys_destroy()
         pjsua_var.null_port = NULL;
     }
 
+    if (pjsua_var.dec_pool) {
+        pjmedia_stream_dec_pool_destroy(pjsua_var.dec_pool);
+        pjsua_var.dec_pool = NULL;
+    }
+
     return PJ_SUCCESS;
 }
 
@@ -781,6 +807,15 @@ pj_status_t pjsua_aud_channel_update(pjsua_call_media *call_med,
             goto on_return;
         }
 
+        /* Decode ahead on the shared decode pool */
+        if (pjsua_var.dec_pool) {
+            status = pjmedia_stream_set_dec_pool(call_med->strm.a.stream,
+                                                 pjsua_var.dec_pool);
+            if (status != PJ_SUCCESS && status != PJ_ENOTSUP) {
+                goto on_return;
+            }
+        }
+
         /* Start stream */
         status = pjmedia_stream_start(call_med->strm.a.stream);
         if (status != PJ_SUCCESS) {
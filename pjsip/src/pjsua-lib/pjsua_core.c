@@ -89,6 +89,8 @@ PJ_DEF(void) pjsua_logging_config_default(pjsua_logging_config *cfg)
 #if (defined(PJ_WIN32) && PJ_WIN32 != 0) || (defined(PJ_WIN64) && PJ_WIN64 != 0)
     cfg->decor |= PJ_LOG_HAS_COLOR;
 #endif
+
+    pj_log_async_param_default(&cfg->async_param);
 }
 
 PJ_DEF(void) pjsua_logging_config_dup(pj_pool_t *pool,
@@ -415,8 +417,12 @@ PJ_DEF(void) pjsua_media_config_default(pjsua_media_config *cfg)
     cfg->channel_count = 1;
     cfg->audio_frame_ptime = PJSUA_DEFAULT_AUDIO_FRAME_PTIME;
     cfg->max_media_ports = PJSUA_MAX_CONF_PORTS;
+    cfg->conf_threads = PJMEDIA_CONF_WORKER_THREADS;
+    cfg->dec_threads = PJMEDIA_STREAM_DEC_THREADS;
+    cfg->srtp_tx_threads = PJMEDIA_SRTP_TX_THREADS;
     cfg->has_ioqueue = PJ_TRUE;
     cfg->thread_cnt = 1;
+    cfg->udp_tx_batch = PJ_TRUE;
     cfg->quality = PJSUA_DEFAULT_CODEC_QUALITY;
     cfg->ilbc_mode = PJSUA_DEFAULT_ILBC_MODE;
     cfg->ec_tail_len = PJSUA_DEFAULT_EC_TAIL_LEN;
@@ -746,6 +752,11 @@ PJ_DEF(pj_status_t) pjsua_reconfigure_logging(const pjsua_logging_config *cfg)
 
     PJ_ASSERT_RETURN(cfg, PJ_EINVAL);
 
+    /* Stop the log thread, writing all pending messages with the
+     * current settings.
+     */
+    pj_log_async_stop();
+
     /* Save config. */
     pjsua_logging_config_dup(pjsua_var.pool, &pjsua_var.log_cfg, cfg);
 
@@ -779,6 +790,17 @@ PJ_DEF(pj_status_t) pjsua_reconfigure_logging(const pjsua_logging_config *cfg)
         }
     }
 
+    /* Start the log thread if asynchronous logging is desired */
+    if (pjsua_var.log_cfg.async) {
+        status = pj_log_async_start(&pjsua_var.cp.factory,
+                                    &pjsua_var.log_cfg.async_param);
+        if (status != PJ_SUCCESS) {
+            pjsua_perror(THIS_FILE, "Error starting asynchronous logging",
+                         status);
+            return status;
+        }
+    }
+
     /* Unregister msg logging if it's previously registered */
     if (pjsua_msg_logger.id >= 0) {
         pjsip_endpt_unregister_module(pjsua_var.endpt, &pjsua_msg_logger);
@@ -1932,6 +1954,9 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 
     /* Signal threads to quit: */
     pjsua_stop_worker_threads();
+
+    /* Stop metrics export before calls are torn down */
+    pjsua_metrics_stop();
     
     if (pjsua_var.endpt) {
         unsigned max_wait;
@@ -2137,6 +2162,11 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         pjsua_var.timer_mutex = NULL;
     }
 
+    /* Stop the log thread, its rings are allocated from our pool
+     * factory. Subsequent messages are written synchronously.
+     */
+    pj_log_async_stop();
+
     /* Destroy pools and pool factory. */
     if (pjsua_var.timer_pool) {
         pj_pool_release(pjsua_var.timer_pool);
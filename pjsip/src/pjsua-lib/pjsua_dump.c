@@ -314,8 +314,8 @@ static void dump_media_session(const char *indent,
             pjmedia_stream *stream = call_med->strm.a.stream;
             pjmedia_stream_info info;
 
-            pjmedia_stream_get_stat(stream, &stat);
-            has_stat = PJ_TRUE;
+            has_stat = (pjmedia_stream_get_stat(stream, &stat) ==
+                        PJ_SUCCESS);
 
             pjmedia_stream_get_info(stream, &info);
             pj_ansi_snprintf(codec_info, sizeof(codec_info), " %.*s @%dkHz",
@@ -334,8 +334,8 @@ static void dump_media_session(const char *indent,
             pjmedia_vid_stream *stream = call_med->strm.v.stream;
             pjmedia_vid_stream_info info;
 
-            pjmedia_vid_stream_get_stat(stream, &stat);
-            has_stat = PJ_TRUE;
+            has_stat = (pjmedia_vid_stream_get_stat(stream, &stat) ==
+                        PJ_SUCCESS);
 
             pjmedia_vid_stream_get_info(stream, &info);
             pj_ansi_snprintf(codec_info, sizeof(codec_info), " %.*s",
@@ -1041,3 +1041,158 @@ PJ_DEF(pj_status_t) pjsua_call_dump( pjsua_call_id call_id,
     return PJ_SUCCESS;
 }
 
+
+
+#if PJSUA_MEDIA_HAS_PJMEDIA
+
+/* Output buffer of the JSON statistics dump. */
+typedef struct json_buf
+{
+    char        *p;
+    char        *end;
+    pj_bool_t    full;
+} json_buf;
+
+/* Advance the buffer after pj_ansi_snprintf() wrote len bytes. */
+static void json_advance(json_buf *jb, int len)
+{
+    if (len < 0 || len >= jb->end - jb->p) {
+        jb->full = PJ_TRUE;
+        return;
+    }
+    jb->p += len;
+}
+
+static void json_math_stat(json_buf *jb, const char *name,
+                           const pj_math_stat *stat)
+{
+    if (jb->full)
+        return;
+
+    json_advance(jb, pj_ansi_snprintf(jb->p, jb->end - jb->p,
+                                      "\"%s\":{\"n\":%d,\"min\":%d,"
+                                      "\"mean\":%d,\"max\":%d,\"last\":%d}",
+                                      name, stat->n,
+                                      (stat->n? stat->min : 0),
+                                      stat->mean, stat->max, stat->last));
+}
+
+static void json_stream_dir(json_buf *jb, const char *name,
+                            const pjmedia_rtcp_stream_stat *stat)
+{
+    if (jb->full)
+        return;
+
+    json_advance(jb, pj_ansi_snprintf(jb->p, jb->end - jb->p,
+                                      "\"%s\":{\"pkt\":%u,\"bytes\":%u,"
+                                      "\"discard\":%u,\"loss\":%u,"
+                                      "\"reorder\":%u,\"dup\":%u,"
+                                      "\"update_cnt\":%u,",
+                                      name, stat->pkt, stat->bytes,
+                                      stat->discard, stat->loss,
+                                      stat->reorder, stat->dup,
+                                      stat->update_cnt));
+    json_math_stat(jb, "jitter", &stat->jitter);
+    json_advance(jb, pj_ansi_snprintf(jb->p, jb->end - jb->p, ","));
+    json_math_stat(jb, "loss_period", &stat->loss_period);
+    json_advance(jb, pj_ansi_snprintf(jb->p, jb->end - jb->p, "}"));
+}
+
+/*
+ * Dump the RTCP statistics of all streams of all calls as JSON.
+ */
+PJ_DEF(pj_status_t) pjsua_call_dump_stat_all(char *buffer,
+                                             unsigned maxlen,
+                                             unsigned *p_len)
+{
+    json_buf jb;
+    unsigned cnt = 0, i, j;
+
+    PJ_ASSERT_RETURN(buffer && maxlen, PJ_EINVAL);
+
+    jb.p = buffer;
+    jb.end = buffer + maxlen;
+    jb.full = PJ_FALSE;
+
+    json_advance(&jb, pj_ansi_snprintf(jb.p, jb.end - jb.p,
+                                       "{\"streams\":["));
+
+    PJSUA_LOCK();
+
+    for (i = 0; i < pjsua_var.ua_cfg.max_calls && !jb.full; ++i) {
+        pjsua_call *call = &pjsua_var.calls[i];
+
+        if (!call->inv)
+            continue;
+
+        for (j = 0; j < call->med_cnt && !jb.full; ++j) {
+            pjsua_call_media *call_med = &call->media[j];
+            pjmedia_rtcp_stat stat;
+            const char *type;
+
+            /* Leave out the streams whose statistics could not be read */
+            if (call_med->type == PJMEDIA_TYPE_AUDIO &&
+                call_med->strm.a.stream)
+            {
+                if (pjmedia_stream_get_stat(call_med->strm.a.stream,
+                                            &stat) != PJ_SUCCESS)
+                {
+                    continue;
+                }
+                type = "audio";
+#if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0)
+            } else if (call_med->type == PJMEDIA_TYPE_VIDEO &&
+                       call_med->strm.v.stream)
+            {
+                if (pjmedia_vid_stream_get_stat(call_med->strm.v.stream,
+                                                &stat) != PJ_SUCCESS)
+                {
+                    continue;
+                }
+                type = "video";
+#endif
+            } else {
+                continue;
+            }
+
+            json_advance(&jb, pj_ansi_snprintf(jb.p, jb.end - jb.p,
+                                               "%s{\"call\":%d,\"med\":%d,"
+                                               "\"type\":\"%s\","
+                                               "\"start\":%ld,",
+                                               (cnt? "," : ""), i, j, type,
+                                               (long)stat.start.sec));
+            json_stream_dir(&jb, "rx", &stat.rx);
+            json_advance(&jb, pj_ansi_snprintf(jb.p, jb.end - jb.p, ","));
+            json_stream_dir(&jb, "tx", &stat.tx);
+            json_advance(&jb, pj_ansi_snprintf(jb.p, jb.end - jb.p, ","));
+            json_math_stat(&jb, "rtt", &stat.rtt);
+            json_advance(&jb, pj_ansi_snprintf(jb.p, jb.end - jb.p, "}"));
+            ++cnt;
+        }
+    }
+
+    PJSUA_UNLOCK();
+
+    json_advance(&jb, pj_ansi_snprintf(jb.p, jb.end - jb.p, "]}"));
+    if (jb.full)
+        return PJ_ETOOSMALL;
+
+    if (p_len)
+        *p_len = (unsigned)(jb.p - buffer);
+
+    return PJ_SUCCESS;
+}
+
+#else   /* PJSUA_MEDIA_HAS_PJMEDIA */
+
+PJ_DEF(pj_status_t) pjsua_call_dump_stat_all(char *buffer,
+                                             unsigned maxlen,
+                                             unsigned *p_len)
+{
+    PJ_UNUSED_ARG(buffer);
+    PJ_UNUSED_ARG(maxlen);
+    PJ_UNUSED_ARG(p_len);
+    return PJ_ENOTSUP;
+}
+
+#endif  /* PJSUA_MEDIA_HAS_PJMEDIA */
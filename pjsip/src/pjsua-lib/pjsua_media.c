@@ -96,6 +96,17 @@ pj_status_t pjsua_media_subsys_init(const pjsua_media_config *cfg)
         goto on_error;
     }
 
+    if (pjsua_var.media_cfg.has_ioqueue && pjsua_var.media_cfg.shard_cnt) {
+        status = pjmedia_endpt_create_shards(pjsua_var.med_endpt,
+                                             pjsua_var.media_cfg.shard_cnt,
+                                             pjsua_var.media_cfg.shard_pin_cpu);
+        if (status != PJ_SUCCESS) {
+            pjsua_perror(THIS_FILE, "Error creating media ioqueue shards",
+                         status);
+            goto on_error;
+        }
+    }
+
     status = pjsua_aud_subsys_init();
     if (status != PJ_SUCCESS)
         goto on_error;
@@ -108,6 +119,18 @@ pj_status_t pjsua_media_subsys_init(const pjsua_media_config *cfg)
                      status);
         goto on_error;
     }
+
+    /* Create the SRTP crypto pool */
+    if (pjsua_var.media_cfg.srtp_tx_threads) {
+        status = pjmedia_srtp_tx_pool_create(pjsua_var.pool,
+                                             pjsua_var.media_cfg.srtp_tx_threads,
+                                             &pjsua_var.srtp_tx_pool);
+        if (status != PJ_SUCCESS) {
+            pjsua_perror(THIS_FILE, "Error creating SRTP crypto pool",
+                         status);
+            goto on_error;
+        }
+    }
 #endif
 
     /* Video */
@@ -210,6 +233,13 @@ pj_status_t pjsua_media_subsys_destroy(unsigned flags)
         pjsua_aud_subsys_destroy();
     }
 
+#if defined(PJMEDIA_HAS_SRTP) && (PJMEDIA_HAS_SRTP != 0)
+    if (pjsua_var.srtp_tx_pool) {
+        pjmedia_srtp_tx_pool_destroy(pjsua_var.srtp_tx_pool);
+        pjsua_var.srtp_tx_pool = NULL;
+    }
+#endif
+
 #if 0
     // This part has been moved out to pjsua_destroy() (see also #1717).
     /* Close media transports */
@@ -825,6 +855,7 @@ static pj_status_t create_udp_media_transport(const pjsua_transport_config *cfg,
                                               const pjmedia_sdp_session *rem_sdp)
 {
     pjmedia_sock_info skinfo;
+    unsigned options = 0;
     pj_status_t status;
 
     status = create_rtp_rtcp_sock(call_med, cfg, &skinfo, rem_sdp);
@@ -834,8 +865,13 @@ static pj_status_t create_udp_media_transport(const pjsua_transport_config *cfg,
         goto on_error;
     }
 
+    if (pjsua_var.media_cfg.udp_tx_batch)
+        options |= PJMEDIA_UDP_TX_BATCH;
+    if (pjsua_var.media_cfg.udp_rx_batch)
+        options |= PJMEDIA_UDP_RX_BATCH;
+
     status = pjmedia_transport_udp_attach(pjsua_var.med_endpt, NULL,
-                                          &skinfo, 0, &call_med->tp);
+                                          &skinfo, options, &call_med->tp);
     if (status != PJ_SUCCESS) {
         pjsua_perror(THIS_FILE, "Unable to create media transport",
                      status);
@@ -1953,12 +1989,12 @@ static pj_status_t call_media_init_cb(pjsua_call_media *call_med,
         goto on_return;
     }
 
-    /* Check if media is deinitializing */
-    if (call_med->call->async_call.med_ch_deinit || !call_med->tp) {
-        status = PJ_ECANCELLED;
-        goto on_return;
-    }
-
+    /* Check if media is deinitializing */
+    if (call_med->call->async_call.med_ch_deinit || !call_med->tp) {
+        status = PJ_ECANCELLED;
+        goto on_return;
+    }
+
     pjmedia_transport_simulate_lost(call_med->tp, PJMEDIA_DIR_ENCODING,
                                     pjsua_var.media_cfg.tx_drop_pct);
 
@@ -2050,6 +2086,16 @@ static pj_status_t call_media_init_cb(pjsua_call_media *call_med,
             goto on_return;
         }
 
+        /* Protect outgoing RTP on the shared crypto pool */
+        if (pjsua_var.srtp_tx_pool) {
+            status = pjmedia_transport_srtp_set_tx_pool(srtp,
+                                                   pjsua_var.srtp_tx_pool);
+            if (status != PJ_SUCCESS) {
+                pjsua_perror(THIS_FILE, "Warning: unable to use SRTP "
+                             "crypto pool", status);
+            }
+        }
+
         /* Set SRTP as current media transport */
         call_med->tp_orig = call_med->tp;
         call_med->tp = srtp;
@@ -0,0 +1,734 @@
+/* 
+ * Copyright (C) 2011-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
+ */
+#include <pjsua-lib/pjsua.h>
+#include <pjsua-lib/pjsua_internal.h>
+#include <stddef.h>
+
+
+#define THIS_FILE       "pjsua_metrics.c"
+
+/* Longest time the export threads wait before checking for quit. */
+#define MAX_WAIT_MSEC   100
+
+/* How long to wait for the HTTP request of a scraper. */
+#define HTTP_RX_MSEC    1000
+
+/* How long a scraper may take to receive the whole response. */
+#define HTTP_TX_MSEC    1000
+
+
+#if PJSUA_MEDIA_HAS_PJMEDIA
+
+/* Which part of the sample a metric requires to be valid. */
+enum metric_cond
+{
+    COND_NONE,
+    COND_JB,
+    COND_XR
+};
+
+/* Description of one metric in the Prometheus output. */
+typedef struct metric_desc
+{
+    const char  *name;
+    const char  *type;
+    const char  *help;
+    unsigned     offset;
+    pj_bool_t    is_signed;
+    unsigned     cond;
+} metric_desc;
+
+#define FIELD(f)        (unsigned)offsetof(pjsua_metrics_sample, f)
+
+static const metric_desc metrics[] =
+{
+    { "pjsua_rtp_rx_packets_total", "counter",
+      "RTP packets received.", FIELD(rx.pkt), PJ_FALSE, COND_NONE },
+    { "pjsua_rtp_rx_bytes_total", "counter",
+      "RTP payload bytes received.", FIELD(rx.bytes), PJ_FALSE, COND_NONE },
+    { "pjsua_rtp_rx_lost_total", "counter",
+      "RTP packets lost.", FIELD(rx.loss), PJ_FALSE, COND_NONE },
+    { "pjsua_rtp_rx_discarded_total", "counter",
+      "RTP packets discarded.", FIELD(rx.discard), PJ_FALSE, COND_NONE },
+    { "pjsua_rtp_rx_duplicate_total", "counter",
+      "RTP packets duplicated.", FIELD(rx.dup), PJ_FALSE, COND_NONE },
+    { "pjsua_rtp_rx_reordered_total", "counter",
+      "RTP packets out of order.", FIELD(rx.reorder), PJ_FALSE, COND_NONE },
+    { "pjsua_rtp_rx_jitter_usec", "gauge",
+      "Last receive jitter.", FIELD(rx.jitter.last), PJ_TRUE, COND_NONE },
+    { "pjsua_rtp_rx_jitter_mean_usec", "gauge",
+      "Mean receive jitter.", FIELD(rx.jitter.mean), PJ_TRUE, COND_NONE },
+    { "pjsua_rtp_tx_packets_total", "counter",
+      "RTP packets sent.", FIELD(tx.pkt), PJ_FALSE, COND_NONE },
+    { "pjsua_rtp_tx_bytes_total", "counter",
+      "RTP payload bytes sent.", FIELD(tx.bytes), PJ_FALSE, COND_NONE },
+    { "pjsua_rtp_tx_lost_total", "counter",
+      "RTP packets lost as reported by the peer.", FIELD(tx.loss),
+      PJ_FALSE, COND_NONE },
+    { "pjsua_rtp_tx_jitter_usec", "gauge",
+      "Last jitter reported by the peer.", FIELD(tx.jitter.last),
+      PJ_TRUE, COND_NONE },
+    { "pjsua_rtcp_rtt_usec", "gauge",
+      "Last round trip delay.", FIELD(rtt.last), PJ_TRUE, COND_NONE },
+    { "pjsua_rtcp_rtt_mean_usec", "gauge",
+      "Mean round trip delay.", FIELD(rtt.mean), PJ_TRUE, COND_NONE },
+    { "pjsua_jbuf_size_frames", "gauge",
+      "Jitter buffer size.", FIELD(jb.size), PJ_FALSE, COND_JB },
+    { "pjsua_jbuf_prefetch_frames", "gauge",
+      "Jitter buffer prefetch.", FIELD(jb.prefetch), PJ_FALSE, COND_JB },
+    { "pjsua_jbuf_delay_msec", "gauge",
+      "Jitter buffer average delay.", FIELD(jb.avg_delay), PJ_FALSE, COND_JB },
+    { "pjsua_jbuf_lost_total", "counter",
+      "Jitter buffer lost frames.", FIELD(jb.lost), PJ_FALSE, COND_JB },
+    { "pjsua_jbuf_discarded_total", "counter",
+      "Jitter buffer discarded frames.", FIELD(jb.discard), PJ_FALSE, COND_JB },
+    { "pjsua_jbuf_empty_total", "counter",
+      "Jitter buffer empty on get.", FIELD(jb.empty), PJ_FALSE, COND_JB },
+    { "pjsua_rtcp_xr_r_factor", "gauge",
+      "RTCP-XR R factor.", FIELD(r_factor), PJ_FALSE, COND_XR },
+    { "pjsua_rtcp_xr_mos_lq", "gauge",
+      "RTCP-XR MOS-LQ times ten.", FIELD(mos_lq), PJ_FALSE, COND_XR },
+    { "pjsua_rtcp_xr_mos_cq", "gauge",
+      "RTCP-XR MOS-CQ times ten.", FIELD(mos_cq), PJ_FALSE, COND_XR },
+    { "pjsua_rtcp_xr_burst_density", "gauge",
+      "RTCP-XR burst density in 1/256.", FIELD(burst_den), PJ_FALSE, COND_XR },
+    { "pjsua_rtcp_xr_gap_density", "gauge",
+      "RTCP-XR gap density in 1/256.", FIELD(gap_den), PJ_FALSE, COND_XR },
+    { "pjsua_rtcp_xr_loss_rate", "gauge",
+      "RTCP-XR loss rate in 1/256.", FIELD(loss_rate), PJ_FALSE, COND_XR },
+    { "pjsua_rtcp_xr_discard_rate", "gauge",
+      "RTCP-XR discard rate in 1/256.", FIELD(discard_rate),
+      PJ_FALSE, COND_XR },
+};
+
+#undef FIELD
+
+
+/* Metrics export state. */
+typedef struct pjsua_metrics
+{
+    pj_pool_t              *pool;
+    pjsua_metrics_config    cfg;
+    pj_thread_t            *thread;
+    pj_thread_t            *http_thread;
+    pj_bool_t               quit;
+    pj_sock_t               sock;
+
+    /* Ring and the scraper being served, protected by mutex */
+    pj_mutex_t             *mutex;
+    pj_sock_t               client;
+    pjsua_metrics_sample   *ring;
+    pj_uint64_t             write_pos;
+    pj_uint64_t             read_pos;
+    pj_uint64_t             last_pos;   /* Start of the latest sweep    */
+    unsigned                last_cnt;   /* Samples in the latest sweep  */
+
+    /* Owned by the export thread */
+    pj_uint32_t             sweep;
+    pjsua_metrics_sample   *scratch;
+
+    /* Owned by the HTTP thread */
+    pjsua_metrics_sample   *snapshot;
+    pj_time_val             tx_deadline;
+    char                    out[2048];
+    unsigned                out_len;
+} pjsua_metrics;
+
+
+/* Take a sample of every active stream, holding the pjsua lock once. */
+static unsigned collect(pjsua_metrics *m)
+{
+    pj_time_val now;
+    unsigned cnt = 0, i, j;
+
+    pj_gettimeofday(&now);
+    ++m->sweep;
+
+    PJSUA_LOCK();
+
+    for (i = 0; i < pjsua_var.ua_cfg.max_calls; ++i) {
+        pjsua_call *call = &pjsua_var.calls[i];
+
+        if (!call->inv)
+            continue;
+
+        for (j = 0; j < call->med_cnt && cnt < m->cfg.ring_size; ++j) {
+            pjsua_call_media *call_med = &call->media[j];
+            pjsua_metrics_sample *s = &m->scratch[cnt];
+            pjmedia_rtcp_stat stat;
+
+            if (call_med->type == PJMEDIA_TYPE_AUDIO &&
+                call_med->strm.a.stream)
+            {
+                pjmedia_stream *strm = call_med->strm.a.stream;
+#if defined(PJMEDIA_HAS_RTCP_XR) && (PJMEDIA_HAS_RTCP_XR != 0)
+                pjmedia_rtcp_xr_stat xr;
+#endif
+
+                /* Skip the stream until its statistics can be read */
+                pj_bzero(s, sizeof(*s));
+                if (pjmedia_stream_get_stat(strm, &stat) != PJ_SUCCESS)
+                    continue;
+                s->has_jb = (pjmedia_stream_get_stat_jbuf(strm, &s->jb) ==
+                             PJ_SUCCESS);
+
+#if defined(PJMEDIA_HAS_RTCP_XR) && (PJMEDIA_HAS_RTCP_XR != 0)
+                if (pjmedia_stream_get_stat_xr(strm, &xr) == PJ_SUCCESS &&
+                    xr.rx.voip_mtc.update.sec != 0)
+                {
+                    s->has_xr = PJ_TRUE;
+                    s->r_factor = xr.rx.voip_mtc.r_factor;
+                    s->mos_lq = xr.rx.voip_mtc.mos_lq;
+                    s->mos_cq = xr.rx.voip_mtc.mos_cq;
+                    s->burst_den = xr.rx.voip_mtc.burst_den;
+                    s->gap_den = xr.rx.voip_mtc.gap_den;
+                    s->loss_rate = xr.rx.voip_mtc.loss_rate;
+                    s->discard_rate = xr.rx.voip_mtc.discard_rate;
+                }
+#endif
+#if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0)
+            } else if (call_med->type == PJMEDIA_TYPE_VIDEO &&
+                       call_med->strm.v.stream)
+            {
+                pjmedia_vid_stream *strm = call_med->strm.v.stream;
+
+                pj_bzero(s, sizeof(*s));
+                if (pjmedia_vid_stream_get_stat(strm, &stat) != PJ_SUCCESS)
+                    continue;
+                s->has_jb = (pjmedia_vid_stream_get_stat_jbuf(strm, &s->jb) ==
+                             PJ_SUCCESS);
+#endif
+            } else {
+                continue;
+            }
+
+            s->sweep = m->sweep;
+            s->ts = now;
+            s->call_id = i;
+            s->med_idx = j;
+            s->type = call_med->type;
+            s->rx = stat.rx;
+            s->tx = stat.tx;
+            s->rtt = stat.rtt;
+            ++cnt;
+        }
+    }
+
+    PJSUA_UNLOCK();
+
+    return cnt;
+}
+
+/* Publish the samples of a sweep to the ring. */
+static void publish(pjsua_metrics *m, unsigned cnt)
+{
+    unsigned i;
+
+    pj_mutex_lock(m->mutex);
+    m->last_pos = m->write_pos;
+    m->last_cnt = cnt;
+    for (i = 0; i < cnt; ++i) {
+        m->ring[m->write_pos % m->cfg.ring_size] = m->scratch[i];
+        ++m->write_pos;
+    }
+    pj_mutex_unlock(m->mutex);
+}
+
+/* Wait until the socket is readable (or writable), in slices so that
+ * quitting is not held up, until the deadline. Returns PJ_ETIMEDOUT if the
+ * deadline has passed or the export is stopping.
+ */
+static pj_status_t wait_sock(pjsua_metrics *m, pj_sock_t sock,
+                             pj_bool_t writable,
+                             const pj_time_val *deadline)
+{
+    while (!m->quit) {
+        pj_fd_set_t set;
+        pj_time_val now, timeout;
+        long wait;
+        int rc;
+
+        pj_gettickcount(&now);
+        timeout = *deadline;
+        PJ_TIME_VAL_SUB(timeout, now);
+        wait = PJ_TIME_VAL_MSEC(timeout);
+        if (wait <= 0)
+            break;
+        if (wait > MAX_WAIT_MSEC)
+            wait = MAX_WAIT_MSEC;
+
+        timeout.sec = 0;
+        timeout.msec = wait;
+        PJ_FD_ZERO(&set);
+        PJ_FD_SET(sock, &set);
+        rc = pj_sock_select((int)sock + 1, writable? NULL : &set,
+                            writable? &set : NULL, NULL, &timeout);
+        if (rc > 0)
+            return PJ_SUCCESS;
+        if (rc < 0)
+            return pj_get_netos_error();
+    }
+    return PJ_ETIMEDOUT;
+}
+
+/* Send the whole buffer to the scraper, before the response deadline.
+ * The buffer is small, so once the socket is writable sending it rarely
+ * blocks, and pjsua_metrics_stop() shuts the socket down if it does.
+ */
+static pj_status_t send_all(pjsua_metrics *m, pj_sock_t sock,
+                            const char *buf, unsigned len)
+{
+    while (len) {
+        pj_ssize_t sent = len;
+        pj_status_t status;
+
+        status = wait_sock(m, sock, PJ_TRUE, &m->tx_deadline);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        status = pj_sock_send(sock, buf, &sent, 0);
+        if (status != PJ_SUCCESS)
+            return status;
+        if (sent <= 0)
+            return PJ_ECANCELLED;
+
+        buf += sent;
+        len -= (unsigned)sent;
+    }
+    return PJ_SUCCESS;
+}
+
+/* Append a line to the output buffer, flushing it when full. */
+static pj_status_t out_printf(pjsua_metrics *m, pj_sock_t sock,
+                              const char *fmt, ...)
+{
+    va_list arg;
+    int len;
+
+    for (;;) {
+        unsigned avail = sizeof(m->out) - m->out_len;
+        pj_status_t status;
+
+        va_start(arg, fmt);
+        len = pj_ansi_vsnprintf(m->out + m->out_len, avail, fmt, arg);
+        va_end(arg);
+
+        if (len < 0)
+            return PJ_ETOOSMALL;
+        if ((unsigned)len < avail)
+            break;
+
+        /* Doesn't fit, flush and retry */
+        if (m->out_len == 0)
+            return PJ_ETOOSMALL;
+        status = send_all(m, sock, m->out, m->out_len);
+        m->out_len = 0;
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+
+    m->out_len += len;
+    return PJ_SUCCESS;
+}
+
+/* Serve the latest sweep to a scraper in Prometheus text format. */
+static void serve_http(pjsua_metrics *m, pj_sock_t sock)
+{
+    pj_time_val deadline;
+    char req[512];
+    pj_ssize_t len;
+    unsigned cnt, i, j;
+    pj_status_t status;
+
+    /* Wait for the request. It's not parsed, anything gets the metrics. */
+    pj_gettickcount(&deadline);
+    deadline.msec += HTTP_RX_MSEC;
+    pj_time_val_normalize(&deadline);
+    if (wait_sock(m, sock, PJ_FALSE, &deadline) != PJ_SUCCESS)
+        return;
+    len = sizeof(req);
+    if (pj_sock_recv(sock, req, &len, 0) != PJ_SUCCESS || len <= 0)
+        return;
+
+    /* Take a snapshot of the latest sweep, the ring may be overwritten
+     * while the response is being sent.
+     */
+    pj_mutex_lock(m->mutex);
+    cnt = m->last_cnt;
+    for (i = 0; i < cnt; ++i) {
+        m->snapshot[i] = m->ring[(m->last_pos + i) % m->cfg.ring_size];
+    }
+    pj_mutex_unlock(m->mutex);
+
+    pj_gettickcount(&m->tx_deadline);
+    m->tx_deadline.msec += HTTP_TX_MSEC;
+    pj_time_val_normalize(&m->tx_deadline);
+
+    m->out_len = 0;
+    status = out_printf(m, sock, "HTTP/1.0 200 OK\r\n"
+                                 "Content-Type: text/plain; version=0.0.4\r\n"
+                                 "Connection: close\r\n\r\n");
+
+    for (i = 0; i < PJ_ARRAY_SIZE(metrics) && status == PJ_SUCCESS; ++i) {
+        const metric_desc *d = &metrics[i];
+
+        status = out_printf(m, sock, "# HELP %s %s\n# TYPE %s %s\n",
+                            d->name, d->help, d->name, d->type);
+
+        for (j = 0; j < cnt && status == PJ_SUCCESS; ++j) {
+            const pjsua_metrics_sample *s = &m->snapshot[j];
+            const char *p = (const char*)s + d->offset;
+
+            if ((d->cond == COND_JB && !s->has_jb) ||
+                (d->cond == COND_XR && !s->has_xr))
+            {
+                continue;
+            }
+
+            status = out_printf(m, sock,
+                                "%s{call=\"%d\",med=\"%u\",type=\"%s\"} ",
+                                d->name, s->call_id, s->med_idx,
+                                pjmedia_type_name(s->type));
+            if (status != PJ_SUCCESS)
+                break;
+
+            if (d->is_signed)
+                status = out_printf(m, sock, "%d\n", *(const int*)p);
+            else
+                status = out_printf(m, sock, "%u\n", *(const unsigned*)p);
+        }
+    }
+
+    if (status == PJ_SUCCESS && m->out_len)
+        send_all(m, sock, m->out, m->out_len);
+}
+
+/* Metrics export thread, taking a sample of the streams every interval. */
+static int metrics_thread(void *arg)
+{
+    pjsua_metrics *m = (pjsua_metrics*)arg;
+    pj_time_val next_sweep;
+
+    pj_gettickcount(&next_sweep);
+
+    while (!m->quit) {
+        pj_time_val now, delta;
+        long wait;
+
+        pj_gettickcount(&now);
+        delta = next_sweep;
+        PJ_TIME_VAL_SUB(delta, now);
+        wait = PJ_TIME_VAL_MSEC(delta);
+        if (wait <= 0) {
+            publish(m, collect(m));
+            next_sweep.msec += m->cfg.interval;
+            pj_time_val_normalize(&next_sweep);
+            continue;
+        }
+        if (wait > MAX_WAIT_MSEC)
+            wait = MAX_WAIT_MSEC;
+
+        pj_thread_sleep(wait);
+    }
+
+    return 0;
+}
+
+/* HTTP thread, serving the scrapers one at a time. It runs separately
+ * from the export thread, so that a slow scraper does not delay the
+ * sampling.
+ */
+static int http_thread(void *arg)
+{
+    pjsua_metrics *m = (pjsua_metrics*)arg;
+
+    while (!m->quit) {
+        pj_fd_set_t rset;
+        pj_time_val timeout;
+        pj_sock_t client;
+
+        PJ_FD_ZERO(&rset);
+        PJ_FD_SET(m->sock, &rset);
+        timeout.sec = 0;
+        timeout.msec = MAX_WAIT_MSEC;
+        if (pj_sock_select((int)m->sock + 1, &rset, NULL, NULL,
+                           &timeout) > 0 &&
+            pj_sock_accept(m->sock, &client, NULL, NULL) == PJ_SUCCESS)
+        {
+            pj_mutex_lock(m->mutex);
+            m->client = client;
+            pj_mutex_unlock(m->mutex);
+
+            serve_http(m, client);
+
+            pj_mutex_lock(m->mutex);
+            m->client = PJ_INVALID_SOCKET;
+            pj_mutex_unlock(m->mutex);
+            pj_sock_close(client);
+        }
+    }
+
+    return 0;
+}
+
+/* Open the loopback HTTP listener. */
+static pj_status_t open_http(pjsua_metrics *m)
+{
+    pj_sockaddr_in addr;
+    pj_str_t loopback = pj_str("127.0.0.1");
+    int reuse = 1;
+    pj_status_t status;
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0, &m->sock);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    pj_sock_setsockopt(m->sock, pj_SOL_SOCKET(), pj_SO_REUSEADDR(),
+                       &reuse, sizeof(reuse));
+
+    status = pj_sockaddr_in_init(&addr, &loopback,
+                                 (pj_uint16_t)m->cfg.http_port);
+    if (status == PJ_SUCCESS)
+        status = pj_sock_bind(m->sock, &addr, sizeof(addr));
+    if (status == PJ_SUCCESS)
+        status = pj_sock_listen(m->sock, 5);
+
+    if (status != PJ_SUCCESS) {
+        pj_sock_close(m->sock);
+        m->sock = PJ_INVALID_SOCKET;
+    }
+    return status;
+}
+
+
+PJ_DEF(void) pjsua_metrics_config_default(pjsua_metrics_config *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->interval = PJSUA_METRICS_INTERVAL;
+    cfg->ring_size = PJSUA_METRICS_RING_SIZE;
+}
+
+/*
+ * Start the metrics export.
+ */
+PJ_DEF(pj_status_t) pjsua_metrics_start(const pjsua_metrics_config *cfg)
+{
+    pjsua_metrics_config default_cfg;
+    pj_pool_t *pool;
+    pjsua_metrics *m;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pjsua_var.state == PJSUA_STATE_RUNNING, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(pjsua_var.metrics == NULL, PJ_EEXISTS);
+
+    if (!cfg) {
+        pjsua_metrics_config_default(&default_cfg);
+        cfg = &default_cfg;
+    }
+    PJ_ASSERT_RETURN(cfg->interval && cfg->ring_size, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cfg->http_port <= 65535, PJ_EINVAL);
+
+    pool = pjsua_pool_create("metrics%p", 512, 512);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    m = PJ_POOL_ZALLOC_T(pool, pjsua_metrics);
+    m->pool = pool;
+    pj_memcpy(&m->cfg, cfg, sizeof(*cfg));
+    m->sock = PJ_INVALID_SOCKET;
+    m->client = PJ_INVALID_SOCKET;
+    m->ring = (pjsua_metrics_sample*)
+              pj_pool_calloc(pool, cfg->ring_size, sizeof(m->ring[0]));
+    m->scratch = (pjsua_metrics_sample*)
+                 pj_pool_calloc(pool, cfg->ring_size, sizeof(m->scratch[0]));
+    m->snapshot = (pjsua_metrics_sample*)
+                  pj_pool_calloc(pool, cfg->ring_size,
+                                 sizeof(m->snapshot[0]));
+
+    status = pj_mutex_create_simple(pool, "metrics", &m->mutex);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    if (cfg->http_port) {
+        status = open_http(m);
+        if (status != PJ_SUCCESS) {
+            pjsua_perror(THIS_FILE, "Unable to open metrics HTTP port",
+                         status);
+            goto on_error;
+        }
+    }
+
+    status = pj_thread_create(pool, "metrics", &metrics_thread, m,
+                              0, 0, &m->thread);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    if (m->sock != PJ_INVALID_SOCKET) {
+        status = pj_thread_create(pool, "metricshttp", &http_thread, m,
+                                  0, 0, &m->http_thread);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+    }
+
+    PJSUA_LOCK();
+    pjsua_var.metrics = m;
+    PJSUA_UNLOCK();
+
+    PJ_LOG(4,(THIS_FILE, "Metrics export started, interval=%ums, ring=%u%s",
+              cfg->interval, cfg->ring_size,
+              (cfg->http_port? ", HTTP on 127.0.0.1" : "")));
+
+    return PJ_SUCCESS;
+
+on_error:
+    if (m->thread) {
+        m->quit = PJ_TRUE;
+        pj_thread_join(m->thread);
+        pj_thread_destroy(m->thread);
+    }
+    if (m->sock != PJ_INVALID_SOCKET)
+        pj_sock_close(m->sock);
+    if (m->mutex)
+        pj_mutex_destroy(m->mutex);
+    pj_pool_release(pool);
+    return status;
+}
+
+/*
+ * Stop the metrics export.
+ */
+PJ_DEF(pj_status_t) pjsua_metrics_stop(void)
+{
+    pjsua_metrics *m;
+
+    /* pjsua_destroy() calls this unconditionally, also once the pjsua
+     * mutex is gone, so check before locking. Only the application
+     * thread starts and stops the export.
+     */
+    if (!pjsua_var.metrics)
+        return PJ_SUCCESS;
+
+    /* Unpublish first, so that pjsua_metrics_read() no longer sees it.
+     * The threads must be joined without holding the pjsua lock, as the
+     * export thread takes it to collect the samples.
+     */
+    PJSUA_LOCK();
+    m = pjsua_var.metrics;
+    pjsua_var.metrics = NULL;
+    PJSUA_UNLOCK();
+
+    if (!m)
+        return PJ_SUCCESS;
+
+    m->quit = PJ_TRUE;
+
+    /* Wake up the HTTP thread if it is blocked sending to a scraper */
+    pj_mutex_lock(m->mutex);
+    if (m->client != PJ_INVALID_SOCKET)
+        pj_sock_shutdown(m->client, PJ_SHUT_RDWR);
+    pj_mutex_unlock(m->mutex);
+
+    pj_thread_join(m->thread);
+    pj_thread_destroy(m->thread);
+    if (m->http_thread) {
+        pj_thread_join(m->http_thread);
+        pj_thread_destroy(m->http_thread);
+    }
+
+    if (m->sock != PJ_INVALID_SOCKET)
+        pj_sock_close(m->sock);
+    pj_mutex_destroy(m->mutex);
+    pj_pool_release(m->pool);
+
+    PJ_LOG(4,(THIS_FILE, "Metrics export stopped"));
+    return PJ_SUCCESS;
+}
+
+/*
+ * Drain samples from the metrics export ring.
+ */
+PJ_DEF(pj_status_t) pjsua_metrics_read(pjsua_metrics_sample samples[],
+                                       unsigned *count)
+{
+    pjsua_metrics *m;
+    pj_uint64_t avail;
+    unsigned i, cnt;
+
+    PJ_ASSERT_RETURN(samples && count, PJ_EINVAL);
+
+    /* Hold the pjsua lock, so that the export is not stopped meanwhile */
+    PJSUA_LOCK();
+
+    m = pjsua_var.metrics;
+    if (!m) {
+        PJSUA_UNLOCK();
+        return PJ_EINVALIDOP;
+    }
+
+    pj_mutex_lock(m->mutex);
+
+    /* Skip samples that have been overwritten */
+    avail = m->write_pos - m->read_pos;
+    if (avail > m->cfg.ring_size) {
+        m->read_pos = m->write_pos - m->cfg.ring_size;
+        avail = m->cfg.ring_size;
+    }
+
+    cnt = (avail < *count)? (unsigned)avail : *count;
+    for (i = 0; i < cnt; ++i) {
+        samples[i] = m->ring[m->read_pos % m->cfg.ring_size];
+        ++m->read_pos;
+    }
+
+    pj_mutex_unlock(m->mutex);
+
+    PJSUA_UNLOCK();
+
+    *count = cnt;
+    return PJ_SUCCESS;
+}
+
+#else   /* PJSUA_MEDIA_HAS_PJMEDIA */
+
+PJ_DEF(void) pjsua_metrics_config_default(pjsua_metrics_config *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->interval = PJSUA_METRICS_INTERVAL;
+    cfg->ring_size = PJSUA_METRICS_RING_SIZE;
+}
+
+PJ_DEF(pj_status_t) pjsua_metrics_start(const pjsua_metrics_config *cfg)
+{
+    PJ_UNUSED_ARG(cfg);
+    return PJ_ENOTSUP;
+}
+
+PJ_DEF(pj_status_t) pjsua_metrics_stop(void)
+{
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjsua_metrics_read(pjsua_metrics_sample samples[],
+                                       unsigned *count)
+{
+    PJ_UNUSED_ARG(samples);
+    PJ_UNUSED_ARG(count);
+    return PJ_ENOTSUP;
+}
+
+#endif  /* PJSUA_MEDIA_HAS_PJMEDIA */
@@ -111,6 +111,30 @@ void JbufState::fromPj(const pjmedia_jb_state &prm)
     this->empty        = prm.empty;
 }
 
+void StreamLatencyHist::fromPj(const pjmedia_stream_lat_hist &prm)
+{
+    this->count    = prm.count;
+    this->minUsec  = prm.min_usec;
+    this->maxUsec  = prm.max_usec;
+    this->meanUsec = prm.count? (unsigned)(prm.sum_usec / prm.count) : 0;
+    this->p50Usec  = pjmedia_stream_lat_percentile(&prm, 50);
+    this->p90Usec  = pjmedia_stream_lat_percentile(&prm, 90);
+    this->p99Usec  = pjmedia_stream_lat_percentile(&prm, 99);
+
+    this->buckets.clear();
+    for (unsigned i = 0; i < PJMEDIA_STREAM_LAT_BUCKET_CNT; ++i)
+        this->buckets.push_back((int)prm.bucket[i]);
+}
+
+void StreamLatencyStat::fromPj(const pjmedia_stream_lat_stat &prm)
+{
+    rx.fromPj(prm.stage[PJMEDIA_STREAM_LAT_RX]);
+    jbuf.fromPj(prm.stage[PJMEDIA_STREAM_LAT_JBUF]);
+    decode.fromPj(prm.stage[PJMEDIA_STREAM_LAT_DECODE]);
+    conf.fromPj(prm.stage[PJMEDIA_STREAM_LAT_CONF]);
+    encode.fromPj(prm.stage[PJMEDIA_STREAM_LAT_ENCODE]);
+}
+
 void SdpSession::fromPj(const pjmedia_sdp_session &sdp)
 {
 #if PJSUA2_MAX_SDP_BUF_LEN
@@ -391,6 +415,7 @@ void StreamStat::fromPj(const pjsua_stream_stat &prm)
 {
     rtcp.fromPj(prm.rtcp);
     jbuf.fromPj(prm.jbuf);
+    lat.fromPj(prm.lat);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
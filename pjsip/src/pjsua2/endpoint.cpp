@@ -377,6 +377,10 @@ void LogConfig::fromPj(const pjsua_logging_config &lc)
     this->filename = pj2Str(lc.log_filename);
     this->fileFlags = lc.log_file_flags;
     this->writer = NULL;
+    this->async = PJ2BOOL(lc.async);
+    this->asyncRingSize = lc.async_param.ring_size;
+    this->asyncPolicy = lc.async_param.policy;
+    this->asyncDropLevel = lc.async_param.drop_level;
 }
 
 pjsua_logging_config LogConfig::toPj() const
@@ -391,6 +395,10 @@ pjsua_logging_config LogConfig::toPj() const
     lc.decor = this->decor;
     lc.log_file_flags = this->fileFlags;
     lc.log_filename = str2Pj(this->filename);
+    lc.async = this->async;
+    lc.async_param.ring_size = this->asyncRingSize;
+    lc.async_param.policy = this->asyncPolicy;
+    lc.async_param.drop_level = this->asyncDropLevel;
 
     return lc;
 }
@@ -405,6 +413,10 @@ void LogConfig::readObject(const ContainerNode &node) PJSUA2_THROW(Error)
     NODE_READ_UNSIGNED( this_node, decor);
     NODE_READ_STRING  ( this_node, filename);
     NODE_READ_UNSIGNED( this_node, fileFlags);
+    NODE_READ_BOOL    ( this_node, async);
+    NODE_READ_UNSIGNED( this_node, asyncRingSize);
+    NODE_READ_NUM_T   ( this_node, pj_log_async_policy, asyncPolicy);
+    NODE_READ_INT     ( this_node, asyncDropLevel);
 }
 
 void LogConfig::writeObject(ContainerNode &node) const PJSUA2_THROW(Error)
@@ -417,6 +429,10 @@ void LogConfig::writeObject(ContainerNode &node) const PJSUA2_THROW(Error)
     NODE_WRITE_UNSIGNED( this_node, decor);
     NODE_WRITE_STRING  ( this_node, filename);
     NODE_WRITE_UNSIGNED( this_node, fileFlags);
+    NODE_WRITE_BOOL    ( this_node, async);
+    NODE_WRITE_UNSIGNED( this_node, asyncRingSize);
+    NODE_WRITE_NUM_T   ( this_node, pj_log_async_policy, asyncPolicy);
+    NODE_WRITE_INT     ( this_node, asyncDropLevel);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -437,8 +453,15 @@ void MediaConfig::fromPj(const pjsua_media_config &mc)
     this->channelCount = mc.channel_count;
     this->audioFramePtime = mc.audio_frame_ptime;
     this->maxMediaPorts = mc.max_media_ports;
+    this->confThreads = mc.conf_threads;
+    this->decThreads = mc.dec_threads;
+    this->srtpTxThreads = mc.srtp_tx_threads;
     this->hasIoqueue = PJ2BOOL(mc.has_ioqueue);
     this->threadCnt = mc.thread_cnt;
+    this->shardCnt = mc.shard_cnt;
+    this->shardPinCpu = PJ2BOOL(mc.shard_pin_cpu);
+    this->udpTxBatch = PJ2BOOL(mc.udp_tx_batch);
+    this->udpRxBatch = PJ2BOOL(mc.udp_rx_batch);
     this->quality = mc.quality;
     this->ptime = mc.ptime;
     this->noVad = PJ2BOOL(mc.no_vad);
@@ -470,8 +493,15 @@ pjsua_media_config MediaConfig::toPj() const
     mcfg.channel_count = this->channelCount;
     mcfg.audio_frame_ptime = this->audioFramePtime;
     mcfg.max_media_ports = this->maxMediaPorts;
+    mcfg.conf_threads = this->confThreads;
+    mcfg.dec_threads = this->decThreads;
+    mcfg.srtp_tx_threads = this->srtpTxThreads;
     mcfg.has_ioqueue = this->hasIoqueue;
     mcfg.thread_cnt = this->threadCnt;
+    mcfg.shard_cnt = this->shardCnt;
+    mcfg.shard_pin_cpu = this->shardPinCpu;
+    mcfg.udp_tx_batch = this->udpTxBatch;
+    mcfg.udp_rx_batch = this->udpRxBatch;
     mcfg.quality = this->quality;
     mcfg.ptime = this->ptime;
     mcfg.no_vad = this->noVad;
@@ -502,8 +532,15 @@ void MediaConfig::readObject(const ContainerNode &node) PJSUA2_THROW(Error)
     NODE_READ_UNSIGNED( this_node, channelCount);
     NODE_READ_UNSIGNED( this_node, audioFramePtime);
     NODE_READ_UNSIGNED( this_node, maxMediaPorts);
+    NODE_READ_UNSIGNED( this_node, confThreads);
+    NODE_READ_UNSIGNED( this_node, decThreads);
+    NODE_READ_UNSIGNED( this_node, srtpTxThreads);
     NODE_READ_BOOL    ( this_node, hasIoqueue);
     NODE_READ_UNSIGNED( this_node, threadCnt);
+    NODE_READ_UNSIGNED( this_node, shardCnt);
+    NODE_READ_BOOL    ( this_node, shardPinCpu);
+    NODE_READ_BOOL    ( this_node, udpTxBatch);
+    NODE_READ_BOOL    ( this_node, udpRxBatch);
     NODE_READ_UNSIGNED( this_node, quality);
     NODE_READ_UNSIGNED( this_node, ptime);
     NODE_READ_BOOL    ( this_node, noVad);
@@ -533,8 +570,15 @@ void MediaConfig::writeObject(ContainerNode &node) const PJSUA2_THROW(Error)
     NODE_WRITE_UNSIGNED( this_node, channelCount);
     NODE_WRITE_UNSIGNED( this_node, audioFramePtime);
     NODE_WRITE_UNSIGNED( this_node, maxMediaPorts);
+    NODE_WRITE_UNSIGNED( this_node, confThreads);
+    NODE_WRITE_UNSIGNED( this_node, decThreads);
+    NODE_WRITE_UNSIGNED( this_node, srtpTxThreads);
     NODE_WRITE_BOOL    ( this_node, hasIoqueue);
     NODE_WRITE_UNSIGNED( this_node, threadCnt);
+    NODE_WRITE_UNSIGNED( this_node, shardCnt);
+    NODE_WRITE_BOOL    ( this_node, shardPinCpu);
+    NODE_WRITE_BOOL    ( this_node, udpTxBatch);
+    NODE_WRITE_BOOL    ( this_node, udpRxBatch);
     NODE_WRITE_UNSIGNED( this_node, quality);
     NODE_WRITE_UNSIGNED( this_node, ptime);
     NODE_WRITE_BOOL    ( this_node, noVad);
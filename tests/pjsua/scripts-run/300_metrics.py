@@ -0,0 +1,61 @@
+#
+# Metrics export over HTTP: stalled scrapers must neither block other
+# scrapers for long nor hold up the shutdown
+import socket
+import time
+
+from inc_cfg import *
+
+METRICS_PORT = 9464
+
+def connect():
+	s = socket.create_connection(("127.0.0.1", METRICS_PORT), timeout=5)
+	return s
+
+def test_func(t):
+	# A scraper that connects but never sends its request
+	silent = connect()
+
+	# A scraper that sends its request but never reads the response
+	lazy = connect()
+	lazy.send(b"GET /metrics HTTP/1.0\r\n\r\n")
+
+	# A well behaved scraper still gets the metrics
+	s = connect()
+	s.send(b"GET /metrics HTTP/1.0\r\n\r\n")
+	resp = b""
+	t0 = time.time()
+	while time.time() - t0 < 5:
+		try:
+			data = s.recv(4096)
+		except socket.timeout:
+			break
+		if not data:
+			break
+		resp += data
+	s.close()
+	if b"# TYPE pjsua_rtp_rx_packets_total" not in resp:
+		raise TestError("Metrics not served while other scrapers stall")
+
+	# Keep a stalled scraper connected over the shutdown
+	stalled = connect()
+	t.metrics_socks = [silent, lazy, stalled]
+	t.metrics_t0 = time.time()
+
+def post_func(t):
+	dur = time.time() - t.metrics_t0
+	for s in t.metrics_socks:
+		s.close()
+	if dur > 5:
+		raise TestError("Shutdown took %d seconds with a stalled scraper"
+				% dur)
+
+test_param = TestParam(
+		"Metrics export with stalled scrapers",
+		[
+			InstanceParam("pjsua", "--null-audio --rtp-port 0"
+					" --metrics-port %d" % METRICS_PORT)
+		],
+		func=test_func,
+		post_func=post_func
+		)